@@ -82,7 +82,8 @@ class Admin(LCB.Connection):
                      method='GET',
                      content=None,
                      content_type="application/json",
-                     response_format=FMT_JSON):
+                     response_format=FMT_JSON,
+                     sink=None):
         """
         Perform an administrative HTTP request. This request is sent out to
         the administrative API interface (i.e. the "Management/REST API")
@@ -117,6 +118,28 @@ class Admin(LCB.Connection):
           Note that if the conversion fails, the content will be returned as
           ``bytes``
 
+        :param sink: If set, the response body is passed to this object in
+          chunks as it is received, rather than being stored in the result.
+          This allows large responses to be saved without holding them in
+          memory. This may be an integer file descriptor (which the chunks
+          are written to directly), an object with a ``write`` method (such
+          as a file opened in binary mode), or a callable which is passed
+          each chunk as ``bytes``. The result's
+          :attr:`~couchbase.result.HttpResult.value` is then ``None``.
+
+          If the server responds with an error, the body is not passed to
+          the sink, and is available in the exception's result as usual.
+          Any exception raised while writing to the sink is raised once the
+          response is complete.
+
+        Responses sent with a ``gzip`` or ``deflate`` ``Content-Encoding``
+        (for example by a compressing proxy) are decompressed as they are
+        received, before being converted or passed to the ``sink``. This
+        requires the client to be built with zlib (which ``setup.py`` uses
+        if it is found); otherwise such responses raise an error. No
+        ``Accept-Encoding`` header is sent, as libcouchbase does not allow
+        adding request headers.
+
         :raise:
 
           :exc:`couchbase.exceptions.ArgumentError` if the method supplied was
@@ -140,4 +163,5 @@ class Admin(LCB.Connection):
                                   method=imeth,
                                   content_type=content_type,
                                   post_data=content,
-                                  response_format=response_format)
+                                  response_format=response_format,
+                                  sink=sink)
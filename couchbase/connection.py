@@ -122,10 +122,81 @@ class Connection(_Base):
             self._errors.clear()
         return ret
 
+    def set_retry_policy(self, max_attempts=1, backoff=0.001, factor=2.0,
+                         max_backoff=0.5, errors=None):
+        """
+        Retry commands which fail with a transient error.
+
+        When a policy is in effect, a command which fails with one of the
+        listed errors is scheduled again after a delay, without surfacing
+        the error to the caller. Only the failed commands of a batch are
+        re-sent; commands which already succeeded are not repeated. Retries
+        happen within the same call, so the result of the operation is
+        exactly as if the command had succeeded (or failed) on its last
+        attempt.
+
+        :param int max_attempts: The total number of times a command may be
+          sent, including the first attempt. A value of ``1`` disables
+          retries.
+
+        :param float backoff: Seconds to wait before the first retry
+
+        :param float factor: Multiplier applied to the delay for each
+          subsequent retry of the same command
+
+        :param float max_backoff: Upper bound, in seconds, for the delay
+
+        :param errors: An iterable of error codes or
+          :exc:`~couchbase.exceptions.CouchbaseError` subclasses which are
+          considered transient. The default is
+          :exc:`~couchbase.exceptions.TemporaryFailError` and
+          :exc:`~couchbase.exceptions.BusyError`
+
+        .. warning::
+
+          Adding :exc:`~couchbase.exceptions.TimeoutError` to `errors`
+          may cause non-idempotent operations (such as :meth:`incr` or
+          :meth:`append`) to be applied more than once, since a timed out
+          command may still have been executed by the server.
+
+        Retry temporary failures for up to a second::
+
+            cb.set_retry_policy(max_attempts=10, backoff=0.01,
+                                max_backoff=0.2)
+
+        .. seealso:: :attr:`retry_policy`
+        """
+        codes = None
+        if errors is not None:
+            codes = []
+            rmap = dict((v, k) for k, v in exceptions._LCB_ERRNO_MAP.items())
+            for err in errors:
+                if isinstance(err, type):
+                    if err not in rmap:
+                        raise exceptions.ArgumentError.pyexc(
+                            "No error code for exception", err)
+                    err = rmap[err]
+                codes.append(err)
+
+        self._set_retry_policy(max_attempts=max_attempts,
+                               backoff=backoff,
+                               factor=factor,
+                               max_backoff=max_backoff,
+                               errors=codes)
+
+    @property
+    def retry_policy(self):
+        """
+        A dictionary describing the current retry policy. The keys are the
+        same as the arguments to :meth:`set_retry_policy`, with ``errors``
+        being a tuple of error codes.
+        """
+        return self._get_retry_policy()
+
     # We have these wrappers so that IDEs can do param tooltips and the like.
     # we might move this directly into C some day
 
-    def set(self, key, value, cas=0, ttl=0, format=None):
+    def set(self, key, value, cas=0, ttl=0, format=None, timeout=None):
         """Unconditionally store the object in Couchbase.
 
         :param key: The key to set the value with. By default, the key must be
@@ -151,6 +222,11 @@ class Connection(_Base):
           For more info see
           :attr:`~couchbase.connection.Connection.default_format`
 
+        :param float timeout: If specified, the maximum number of seconds
+          to wait for the operation. This overrides
+          :attr:`~couchbase.connection.Connection.timeout` for this call
+          only. See :ref:`per_op_timeouts`
+
         :raise: :exc:`couchbase.exceptions.ArgumentError` if an
           argument is supplied that is not applicable in this context.
           For example setting the CAS as a string.
@@ -183,9 +259,9 @@ class Connection(_Base):
         .. seealso:: :meth:`set_multi`
 
         """
-        return _Base.set(self, key, value, cas, ttl, format)
+        return _Base.set(self, key, value, cas, ttl, format, timeout=timeout)
 
-    def add(self, key, value, ttl=0, format=None):
+    def add(self, key, value, ttl=0, format=None, timeout=None):
         """
         Store an object in Couchbase unless it already exists.
 
@@ -204,9 +280,10 @@ class Connection(_Base):
         .. seealso:: :meth:`set`, :meth:`add_multi`
 
         """
-        return _Base.add(self, key, value, ttl=ttl, format=format)
+        return _Base.add(self, key, value, ttl=ttl, format=format,
+                         timeout=timeout)
 
-    def replace(self, key, value, cas=0, ttl=0, format=None):
+    def replace(self, key, value, cas=0, ttl=0, format=None, timeout=None):
         """
         Store an object in Couchbase only if it already exists.
 
@@ -220,9 +297,10 @@ class Connection(_Base):
         .. seealso:: :meth:`set`, :meth:`replace_multi`
 
         """
-        return _Base.replace(self, key, value, ttl=ttl, cas=cas, format=format)
+        return _Base.replace(self, key, value, ttl=ttl, cas=cas,
+                             format=format, timeout=timeout)
 
-    def append(self, key, value, cas=0, ttl=0, format=None):
+    def append(self, key, value, cas=0, ttl=0, format=None, timeout=None):
         """
         Append a string to an existing value in Couchbase.
 
@@ -253,9 +331,10 @@ class Connection(_Base):
             :meth:`set`, :meth:`append_multi`
 
         """
-        return _Base.append(self, key, value, ttl=ttl, cas=cas, format=format)
+        return _Base.append(self, key, value, ttl=ttl, cas=cas, format=format,
+                            timeout=timeout)
 
-    def prepend(self, key, value, cas=0, ttl=0, format=None):
+    def prepend(self, key, value, cas=0, ttl=0, format=None, timeout=None):
         """
         Prepend a string to an existing value in Couchbase.
 
@@ -263,9 +342,11 @@ class Connection(_Base):
             :meth:`append`, :meth:`prepend_multi`
 
         """
-        return _Base.prepend(self, key, value, ttl=ttl, cas=cas, format=format)
+        return _Base.prepend(self, key, value, ttl=ttl, cas=cas,
+                             format=format, timeout=timeout)
 
-    def get(self, key, ttl=0, quiet=None):
+    def get(self, key, ttl=0, quiet=None, timeout=None,
+            replica_fallback=False, hedge=None):
         """Obtain an object stored in Couchbase by given key.
 
         :param string key: The key to fetch. The type of key is the same
@@ -288,8 +369,22 @@ class Connection(_Base):
           the :attr:`quiet`. If it is a boolean (i.e. `True` or `False) it will
           override the :class:`Connection`-level :attr:`quiet` attribute.
 
+        :param float timeout: If specified, the maximum number of seconds
+          to wait for the operation. See :ref:`per_op_timeouts`
+
+        :param boolean replica_fallback: If the active node for the key
+          cannot be reached, read the value from a replica instead.
+          See :ref:`replica_reads`
+
+        :param float hedge: If specified, a number of seconds after which
+          a read is also sent to a replica if the active node has not yet
+          replied. Whichever reply arrives first is returned.
+          See :ref:`replica_reads`
+
         :raise: :exc:`couchbase.exceptions.NotFoundError` if the key
           is missing in the bucket
+        :raise: :exc:`couchbase.exceptions.TimeoutError` if `timeout`
+          elapsed before the server replied
         :raise: :exc:`couchbase.exceptions.ConnectError` if the
           connection closed
         :raise: :exc:`couchbase.exceptions.ValueFormatError` if the
@@ -316,15 +411,21 @@ class Connection(_Base):
             rv = cb.get("key", ttl=10)
             # Expires in ten seconds
 
+        Fall back to a replica if the active node does not reply within
+        50 milliseconds::
+
+            rv = cb.get("key", hedge=0.05)
+
 
         .. seealso::
             :meth:`get_multi`
 
         """
 
-        return _Base.get(self, key, ttl, quiet)
+        return _Base.get(self, key, ttl, quiet, timeout=timeout,
+                         replica_fallback=replica_fallback, hedge=hedge)
 
-    def touch(self, key, ttl=0):
+    def touch(self, key, ttl=0, timeout=None):
         """Update a key's expiration time
 
         :param string key: The key whose expiration time should be modified
@@ -347,9 +448,9 @@ class Connection(_Base):
             :meth:`get` - which can be used to get *and* update the expiration,
             :meth:`touch_multi`
         """
-        return _Base.touch(self, key, ttl=ttl)
+        return _Base.touch(self, key, ttl=ttl, timeout=timeout)
 
-    def lock(self, key, ttl=0):
+    def lock(self, key, ttl=0, timeout=None):
         """Lock and retrieve a key-value entry in Couchbase.
 
         :param key: A string which is the key to lock.
@@ -416,9 +517,9 @@ class Connection(_Base):
             :meth:`get`, :meth:`lock_multi`, :meth:`unlock`
 
         """
-        return _Base.lock(self, key, ttl=ttl)
+        return _Base.lock(self, key, ttl=ttl, timeout=timeout)
 
-    def unlock(self, key, cas):
+    def unlock(self, key, cas, timeout=None):
         """Unlock a Locked Key in Couchbase.
 
         :param key: The key to unlock
@@ -442,9 +543,9 @@ class Connection(_Base):
         :meth:`unlock_multi`
 
         """
-        return _Base.unlock(self, key, cas=cas)
+        return _Base.unlock(self, key, cas=cas, timeout=timeout)
 
-    def delete(self, key, cas=0, quiet=None):
+    def delete(self, key, cas=0, quiet=None, timeout=None):
         """Remove the key-value entry for a given key in Couchbase.
 
         :param key: A string which is the key to delete. The format and type
@@ -500,9 +601,9 @@ class Connection(_Base):
         .. seealso:: :meth:`delete_multi`
 
         """
-        return _Base.delete(self, key, cas, quiet)
+        return _Base.delete(self, key, cas, quiet, timeout=timeout)
 
-    def incr(self, key, amount=1, initial=None, ttl=0):
+    def incr(self, key, amount=1, initial=None, ttl=0, timeout=None):
         """
         Increment the numeric value of a key.
 
@@ -554,9 +655,9 @@ class Connection(_Base):
         .. seealso:: :meth:`decr`, :meth:`incr_multi`
 
         """
-        return _Base.incr(self, key, amount, initial, ttl)
+        return _Base.incr(self, key, amount, initial, ttl, timeout=timeout)
 
-    def decr(self, key, amount=1, initial=None, ttl=0):
+    def decr(self, key, amount=1, initial=None, ttl=0, timeout=None):
         """
         Like :meth:`incr`, but decreases, rather than increaes the
         counter value
@@ -564,9 +665,9 @@ class Connection(_Base):
         .. seealso:: :meth:`incr`, :meth:`decr_multi`
 
         """
-        return _Base.decr(self, key, amount, initial, ttl)
+        return _Base.decr(self, key, amount, initial, ttl, timeout=timeout)
 
-    def stats(self, keys=None):
+    def stats(self, keys=None, timeout=None):
         """Request server statistics
         Fetches stats from each node in the cluster. Without a key
         specified the server will respond with a default set of
@@ -595,9 +696,118 @@ class Connection(_Base):
         """
         if keys and not isinstance(keys, (tuple, list)):
             keys = (keys,)
-        return self._stats(keys)
+        return self._stats(keys, timeout=timeout)
+
+    def keys_by_node(self, keys):
+        """Group keys by the server which owns them
+
+        The owner of each key is looked up in the cluster's vBucket map.
+        This can be used to split a large batch into per-server batches
+        which may then be issued in parallel (e.g. one
+        :class:`Connection` per server), so that a slow server only holds
+        up its own keys.
+
+        :param keys: The keys to group
+        :type keys: :ref:`iterable<argtypes>`
+
+        :raise: :exc:`couchbase.exceptions.NotSupportedError` if the bucket
+          has no vBucket map (i.e. it is a memcached bucket), or if the
+          client was built against a libcouchbase older than 2.1.0
+
+        :return: A `dict` whose keys are the servers' ``host:port``
+          addresses, and whose values are lists of the keys owned by each
+          server. Servers owning none of the keys are omitted.
+
+        Group a batch by server::
+
+            for server, keys in cb.keys_by_node(batch).items():
+                print(server, len(keys))
+
+        .. note::
+
+            The map may change during a rebalance or failover; a key's
+            owner at the time of the call is not guaranteed to be its owner
+            when it is next operated upon.
+        """
+        return self._keys_by_node(keys)
+
+    def node_stats(self, reset=False):
+        """Get the per-server operation counters
+
+        Counters are only updated while :attr:`track_node_stats` is
+        enabled. They are maintained by the client (not fetched from the
+        servers), so this method does not perform any network I/O.
+
+        :param boolean reset: If true, zero the counters after reading them
+
+        :raise: :exc:`couchbase.exceptions.NotSupportedError` if the client
+          was built against a libcouchbase older than 2.1.0
+
+        :return: A `dict` whose keys are the servers' ``host:port``
+          addresses. Each value is a `dict` containing
+
+          * ``ops`` - the number of responses received
+          * ``errors`` - the number of those responses with an error
+          * ``bytes_in`` - the number of value bytes received
+          * ``bytes_out`` - the number of value bytes sent for storage
 
-    def observe(self, key):
+        Find the server with the most errors::
+
+            cb.track_node_stats = True
+            # ...
+            stats = cb.node_stats(reset=True)
+            worst = max(stats, key=lambda srv: stats[srv]['errors'])
+
+        .. note::
+
+            Counters are kept by each server's position in the cluster map.
+            Reset them after the cluster topology changes.
+        """
+        return self._node_stats(reset=reset)
+
+    def start_trace(self, path, hash_keys=False):
+        """Start recording the operations performed on this connection
+
+        Each call (a single operation, or a ``*_multi`` batch) is appended
+        to the file once it completes, with its start time, latency, and,
+        for each key, the key and the size of any value stored. Values
+        themselves are never recorded. Statistics requests and view queries
+        are not recorded.
+
+        The trace can be replayed against another cluster with
+        :func:`couchbase.trace.replay`, or from the command line with
+        ``python -m couchbase.trace``.
+
+        :param string path: The file to write the trace to. It is truncated
+          if it exists
+        :param boolean hash_keys: If true, record a 64 bit hash of each key
+          rather than the key itself. The replay then uses a key of the same
+          length derived from the hash
+
+        :raise: :exc:`couchbase.exceptions.ArgumentError` if a trace is
+          already being recorded. :exc:`IOError` if the file cannot be
+          created
+
+        Record a run of the application::
+
+            cb.start_trace('/tmp/app.trace', hash_keys=True)
+            run_workload(cb)
+            print(cb.stop_trace())
+        """
+        return self._start_trace(path, hash_keys=hash_keys)
+
+    def stop_trace(self):
+        """Stop recording operations and close the trace file
+
+        :raise: :exc:`couchbase.exceptions.InternalError` if writing to the
+          trace file failed at any point. The file is then incomplete.
+
+        :return: A `dict` containing the number of ``batches`` and
+          ``commands`` recorded, or `None` if no trace was being recorded
+        """
+        return self._stop_trace()
+
+    def observe(self, key, timeout=None):
         """
         Return storage information for a key.
         The ``observe`` function maps to the low-level ``OBSERVE``
@@ -618,9 +828,9 @@ class Connection(_Base):
         .. seealso:: :ref:`observe_info`
 
         """
-        return _Base.observe(self, key)
+        return _Base.observe(self, key, timeout=timeout)
 
-    def set_multi(self, keys, ttl=0, format=None):
+    def set_multi(self, keys, ttl=0, format=None, timeout=None):
         """Set multiple keys
 
         This follows the same semantics as
@@ -637,6 +847,9 @@ class Connection(_Base):
           If specified, this is the conversion format which will be used for
           _all_ the keys.
 
+        :param float timeout: If specified, the maximum number of seconds
+          to wait for the operation. See :ref:`per_op_timeouts`
+
         :return: A :class:`~couchbase.result.MultiResult` object, which
           is a `dict` subclass.
 
@@ -647,45 +860,51 @@ class Connection(_Base):
         .. seealso:: :meth:`set`
 
         """
-        return _Base.set_multi(self, keys, ttl=ttl, format=format)
+        return _Base.set_multi(self, keys, ttl=ttl, format=format,
+                               timeout=timeout)
 
-    def add_multi(self, keys, ttl=0, format=None):
+    def add_multi(self, keys, ttl=0, format=None, timeout=None):
         """Add multiple keys.
         Multi variant of :meth:`~couchbase.connection.Connection.add`
 
         .. seealso:: :meth:`add`, :meth:`set_multi`, :meth:`set`
 
         """
-        return _Base.add_multi(self, keys, ttl=ttl, format=format)
+        return _Base.add_multi(self, keys, ttl=ttl, format=format,
+                               timeout=timeout)
 
-    def replace_multi(self, keys, ttl=0, format=None):
+    def replace_multi(self, keys, ttl=0, format=None, timeout=None):
         """Replace multiple keys.
         Multi variant of :meth:`replace`
 
         .. seealso:: :meth:`replace`, :meth:`set_multi`, :meth:`set`
 
         """
-        return _Base.replace_multi(self, keys, ttl=ttl, format=format)
+        return _Base.replace_multi(self, keys, ttl=ttl, format=format,
+                                   timeout=timeout)
 
-    def append_multi(self, keys, ttl=0, format=None):
+    def append_multi(self, keys, ttl=0, format=None, timeout=None):
         """Append to multiple keys.
         Multi variant of :meth:`append`
 
         .. seealso:: :meth:`append`, :meth:`set_multi`, :meth:`set`
 
         """
-        return _Base.append_multi(self, keys, ttl=ttl, format=format)
+        return _Base.append_multi(self, keys, ttl=ttl, format=format,
+                                  timeout=timeout)
 
-    def prepend_multi(self, keys, ttl=0, format=None):
+    def prepend_multi(self, keys, ttl=0, format=None, timeout=None):
         """Prepend to multiple keys.
         Multi variant of :meth:`prepend`
 
         .. seealso:: :meth:`prepend`, :meth:`set_multi`, :meth:`set`
 
         """
-        return _Base.prepend_multi(self, keys, ttl=ttl, format=format)
+        return _Base.prepend_multi(self, keys, ttl=ttl, format=format,
+                                   timeout=timeout)
 
-    def get_multi(self, keys, ttl=0, quiet=None):
+    def get_multi(self, keys, ttl=0, quiet=None, timeout=None,
+                  replica_fallback=False, hedge=None):
         """Get multiple keys
         Multi variant of :meth:`get`
 
@@ -694,15 +913,30 @@ class Connection(_Base):
 
         :param int ttl: Set the expiration for all keys when retrieving
 
+        :param float timeout: If specified, the maximum number of seconds
+          to wait for the operation. Keys which were not retrieved in time
+          have a :attr:`~couchbase.result.Result.rc` of
+          :const:`~couchbase._libcouchbase.LCB_ETIMEDOUT`, and the results
+          which did arrive are returned. See :ref:`per_op_timeouts`
+
+        :param boolean replica_fallback: Read keys whose active node cannot
+          be reached from a replica. See :ref:`replica_reads`
+
+        :param float hedge: Send a replica read for each key which has not
+          been retrieved after this many seconds. See :ref:`replica_reads`
+
         :return: A :class:`~couchbase.result.MultiResult` object.
           This object is a subclass of dict and contains the keys (passed as)
           `keys` as the dictionary keys, and
           :class:`~couchbase.result.Result` objects as values
 
         """
-        return _Base.get_multi(self, keys, ttl=ttl, quiet=quiet)
+        return _Base.get_multi(self, keys, ttl=ttl, quiet=quiet,
+                               timeout=timeout,
+                               replica_fallback=replica_fallback,
+                               hedge=hedge)
 
-    def touch_multi(self, keys, ttl=0):
+    def touch_multi(self, keys, ttl=0, timeout=None):
         """Touch multiple keys
 
         Multi variant of :meth:`touch`
@@ -729,9 +963,9 @@ class Connection(_Base):
 
         .. seealso:: :meth:`touch`
         """
-        return _Base.touch_multi(self, keys, ttl=ttl)
+        return _Base.touch_multi(self, keys, ttl=ttl, timeout=timeout)
 
-    def lock_multi(self, keys, ttl=0):
+    def lock_multi(self, keys, ttl=0, timeout=None):
         """Lock multiple keys
 
         Multi variant of :meth:`lock`
@@ -745,9 +979,9 @@ class Connection(_Base):
         .. seealso:: :meth:`lock`
 
         """
-        return _Base.lock_multi(self, keys, ttl=ttl)
+        return _Base.lock_multi(self, keys, ttl=ttl, timeout=timeout)
 
-    def unlock_multi(self, keys):
+    def unlock_multi(self, keys, timeout=None):
         """Unlock multiple keys
 
         Multi variant of :meth:`unlock`
@@ -771,13 +1005,13 @@ class Connection(_Base):
 
         .. seealso:: :meth:`unlock`
         """
-        return _Base.unlock_multi(self, keys)
+        return _Base.unlock_multi(self, keys, timeout=timeout)
 
-    def observe_multi(self, keys):
+    def observe_multi(self, keys, timeout=None):
         """
         Multi-variant of :meth:`observe`
         """
-        return _Base.observe_multi(self, keys)
+        return _Base.observe_multi(self, keys, timeout=timeout)
 
     def _view(self, ddoc, view,
               use_devmode=False,
@@ -797,6 +1031,17 @@ class Connection(_Base):
         :return: a :class:`~couchbase.result.HttpResult` object.
         """
 
+        url = self._view_path(ddoc, view, use_devmode, params,
+                              unrecognized_ok, passthrough)
+
+        ret = self._http_request(type=_LCB.LCB_HTTP_TYPE_VIEW,
+                                 path=url,
+                                 method=_LCB.LCB_HTTP_METHOD_GET,
+                                 response_format=FMT_JSON)
+        return ret
+
+    def _view_path(self, ddoc, view, use_devmode, params,
+                   unrecognized_ok=False, passthrough=False):
         if params:
             if not isinstance(params, str):
                 params = make_options_string(
@@ -807,13 +1052,38 @@ class Connection(_Base):
             params = ""
 
         ddoc = self._mk_devmode(ddoc, use_devmode)
-        url = make_dvpath(ddoc, view) + params
+        return make_dvpath(ddoc, view) + params
 
-        ret = self._http_request(type=_LCB.LCB_HTTP_TYPE_VIEW,
-                                 path=url,
-                                 method=_LCB.LCB_HTTP_METHOD_GET,
-                                 response_format=FMT_JSON)
-        return ret
+    def _view_multi(self, queries, use_devmode=False, quiet=False):
+        """
+        .. warning:: This method's API is not stable
+
+        Execute several view queries concurrently. All the requests are sent
+        at once, and the call returns once every response has been
+        received, so the total latency is roughly that of the slowest query
+        rather than the sum of all of them.
+
+        :param queries: A sequence of ``(ddoc, view, params)`` tuples. Each
+            element is as for :meth:`_view`
+        :param boolean quiet: If set, failed queries do not raise an
+            exception; their results should be checked for ``success``
+            instead
+
+        :return: A list of :class:`~couchbase.result.HttpResult` objects, one
+            for each query and in the same order.
+        :raise: :exc:`~couchbase.exceptions.HTTPError` for the first query
+            which failed, unless ``quiet`` is set
+        """
+        requests = []
+        for ddoc, view, params in queries:
+            requests.append({
+                'type': _LCB.LCB_HTTP_TYPE_VIEW,
+                'path': self._view_path(ddoc, view, use_devmode, params),
+                'method': _LCB.LCB_HTTP_METHOD_GET,
+                'response_format': FMT_JSON
+            })
+
+        return self._http_request_multi(requests, quiet=quiet)
 
     def _doc_rev(self, res):
         """
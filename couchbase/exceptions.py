@@ -337,6 +337,7 @@ _LCB_ERRNO_MAP = {
     C.LCB_ETIMEDOUT:        TimeoutError,
     C.LCB_CONNECT_ERROR:    ConnectError,
     C.LCB_BUCKET_ENOENT:    BucketNotFoundError,
+    C.LCB_CLIENT_ENOMEM:    ClientNoMemoryError,
     C.LCB_EBADHANDLE:       BadHandleError,
     # LCB.SERVER_BUG,
     C.LCB_INVALID_HOST_FORMAT: InvalidError,
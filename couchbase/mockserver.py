@@ -0,0 +1,1514 @@
+#
+# Copyright 2013, Couchbase, Inc.
+# All Rights Reserved
+#
+# Licensed under the Apache License, Version 2.0 (the "License")
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#
+
+"""
+A self-contained mock of a single-node Couchbase cluster, for running tests
+and benchmarks without a real cluster.
+
+The mock serves the REST bootstrap configuration and the view and design
+document endpoints over HTTP, and the memcached binary protocol for key/value
+operations. It keeps all data in memory, and needs nothing beyond the
+standard library.
+
+It may be run in-process::
+
+    from couchbase.mockserver import MockServer
+
+    with MockServer() as mock:
+        cb = Connection(**mock.connection_args())
+        cb.set("foo", "bar")
+
+or as a separate process::
+
+    python -m couchbase.mockserver --rest-port 8091
+
+When run in-process, the server's threads need the GIL while the client is
+waiting for a response, so connections must not be created with
+``unlock_gil=False``.
+
+Views cannot run JavaScript map functions. A view's rows are instead produced
+by a Python function registered with :meth:`MockServer.add_view`; views
+without one emit ``meta.id`` as the key and ``null`` as the value for every
+document. Keys are collated by type (as the server does), but strings are
+compared by code point rather than with the server's Unicode collation.
+"""
+
+import json
+import random
+import socket
+import struct
+import sys
+import threading
+import time
+import zlib
+
+try:
+    import socketserver
+except ImportError:
+    import SocketServer as socketserver
+
+try:
+    from http.server import BaseHTTPRequestHandler, HTTPServer
+    from urllib.parse import urlparse, parse_qsl, unquote
+except ImportError:
+    from BaseHTTPServer import BaseHTTPRequestHandler, HTTPServer
+    from urlparse import urlparse, parse_qsl
+    from urllib import unquote
+
+try:
+    basestring
+except NameError:
+    basestring = str
+
+try:
+    long
+except NameError:
+    long = int
+
+
+REQ_MAGIC = 0x80
+RES_MAGIC = 0x81
+HEADER = struct.Struct(">BBHBBHIIQ")
+
+STATUS_SUCCESS = 0x00
+STATUS_KEY_ENOENT = 0x01
+STATUS_KEY_EEXISTS = 0x02
+STATUS_E2BIG = 0x03
+STATUS_EINVAL = 0x04
+STATUS_NOT_STORED = 0x05
+STATUS_DELTA_BADVAL = 0x06
+STATUS_AUTH_ERROR = 0x20
+STATUS_UNKNOWN_COMMAND = 0x81
+STATUS_ENOMEM = 0x82
+STATUS_ETMPFAIL = 0x86
+
+OPCODES = {
+    'get': 0x00,
+    'set': 0x01,
+    'add': 0x02,
+    'replace': 0x03,
+    'delete': 0x04,
+    'incr': 0x05,
+    'decr': 0x06,
+    'quit': 0x07,
+    'flush': 0x08,
+    'noop': 0x0a,
+    'version': 0x0b,
+    'getk': 0x0c,
+    'append': 0x0e,
+    'prepend': 0x0f,
+    'stat': 0x10,
+    'verbosity': 0x1b,
+    'touch': 0x1c,
+    'gat': 0x1d,
+    'sasl_list_mechs': 0x20,
+    'sasl_auth': 0x21,
+    'get_replica': 0x83,
+    'observe': 0x92,
+    'get_locked': 0x94,
+    'unlock': 0x95
+}
+
+OPNAMES = dict((v, k) for k, v in OPCODES.items())
+
+# Quiet opcodes, and the operations they are quiet versions of
+QUIET = {
+    0x09: 0x00, 0x0d: 0x0c, 0x11: 0x01, 0x12: 0x02, 0x13: 0x03, 0x14: 0x04,
+    0x15: 0x05, 0x16: 0x06, 0x17: 0x07, 0x18: 0x08, 0x19: 0x0e, 0x1a: 0x0f,
+    0x1e: 0x1d
+}
+
+# Operations which may fail with an injected error
+DATA_OPS = frozenset([
+    'get', 'set', 'add', 'replace', 'delete', 'incr', 'decr', 'getk',
+    'append', 'prepend', 'touch', 'gat', 'get_replica', 'observe',
+    'get_locked', 'unlock'
+])
+
+MAX_VALUE_SIZE = 20 * 1024 * 1024
+MAX_RELATIVE_EXPIRY = 30 * 24 * 60 * 60
+MAX_LOCK_TIME = 30
+DEFAULT_LOCK_TIME = 15
+LOCKED_CAS = 0xffffffffffffffff
+
+OBS_FOUND = 0x00
+OBS_PERSISTED = 0x01
+OBS_NOTFOUND = 0x80
+
+CONFIG_DELIMITER = "\n\n\n\n"
+
+
+def _abs_expiry(exp):
+    if not exp:
+        return 0
+    if exp <= MAX_RELATIVE_EXPIRY:
+        return time.time() + exp
+    return exp
+
+
+class _Item(object):
+    __slots__ = ('value', 'flags', 'cas', 'expiry', 'locked_until')
+
+    def __init__(self, value, flags, cas, expiry):
+        self.value = value
+        self.flags = flags
+        self.cas = cas
+        self.expiry = expiry
+        self.locked_until = 0
+
+    @property
+    def locked(self):
+        return self.locked_until > time.time()
+
+
+class _View(object):
+    def __init__(self, map_fn=None, reduce_fn=None):
+        self.map_fn = map_fn
+        self.reduce_fn = reduce_fn
+
+
+class _Bucket(object):
+    def __init__(self, name, password=''):
+        self.name = name
+        self.password = password
+        self.items = {}
+        self.ddocs = {}
+        self.views = {}
+        self.lock = threading.RLock()
+
+    def get(self, key):
+        """
+        Return the item for a key, or None if it does not exist or has
+        expired. The bucket lock must be held.
+        """
+        item = self.items.get(key)
+        if item and item.expiry and item.expiry <= time.time():
+            del self.items[key]
+            return None
+        return item
+
+
+class _Failure(object):
+    def __init__(self, op, status, count, key=None):
+        self.op = op
+        self.status = status
+        self.count = count
+        self.key = key
+
+
+class _ThreadingTCPServer(socketserver.ThreadingMixIn, socketserver.TCPServer):
+    daemon_threads = True
+    allow_reuse_address = True
+
+
+class _ThreadingHTTPServer(socketserver.ThreadingMixIn, HTTPServer):
+    daemon_threads = True
+    allow_reuse_address = True
+
+
+def _pack(opcode, opaque, status=STATUS_SUCCESS, cas=0,
+          extras=b'', key=b'', value=b''):
+    return HEADER.pack(RES_MAGIC, opcode, len(key), len(extras), 0, status,
+                       len(extras) + len(key) + len(value), opaque,
+                       cas) + extras + key + value
+
+
+class _MemcachedHandler(socketserver.BaseRequestHandler):
+    """
+    Handles a single memcached protocol connection. Responses to the
+    requests in each read are sent together, after the configured latency.
+    """
+    def setup(self):
+        self.mock = self.server.mock
+        self.bucket = self.mock._buckets.get('default')
+        self.done = False
+        self.mock._add_connection(self.request)
+
+    def finish(self):
+        self.mock._remove_connection(self.request)
+
+    def handle(self):
+        sock = self.request
+        buf = b''
+
+        while not self.done:
+            try:
+                data = sock.recv(65536)
+            except socket.error:
+                break
+            if not data:
+                break
+
+            buf += data
+            out = []
+            pos = 0
+
+            while len(buf) - pos >= HEADER.size:
+                hdr = HEADER.unpack_from(buf, pos)
+                end = pos + HEADER.size + hdr[6]
+                if len(buf) < end:
+                    break
+
+                body = buf[pos + HEADER.size:end]
+                pos = end
+
+                if hdr[0] != REQ_MAGIC:
+                    self.done = True
+                    break
+
+                rv = self.dispatch(hdr, body)
+                if rv:
+                    out.append(rv)
+
+            buf = buf[pos:]
+
+            if out:
+                if self.mock.latency:
+                    time.sleep(self.mock.latency)
+                try:
+                    sock.sendall(b''.join(out))
+                except socket.error:
+                    break
+
+    def dispatch(self, hdr, body):
+        (magic, opcode, keylen, extlen, datatype,
+         vbucket, bodylen, opaque, cas) = hdr
+
+        extras = body[:extlen]
+        key = body[extlen:extlen + keylen]
+        value = body[extlen + keylen:]
+
+        quiet = opcode in QUIET
+        baseop = QUIET.get(opcode, opcode)
+        name = OPNAMES.get(baseop)
+
+        if not name:
+            return _pack(opcode, opaque, STATUS_UNKNOWN_COMMAND,
+                         value=b'Unknown command')
+
+        if name in DATA_OPS:
+            status = self.mock._injected_error(name, key)
+            if status is not None:
+                return _pack(opcode, opaque, status, value=b'Injected error')
+
+            if not self.bucket:
+                return _pack(opcode, opaque, STATUS_AUTH_ERROR,
+                             value=b'Not authenticated')
+
+        handler = getattr(self, 'op_' + name)
+        status, rv = handler(opcode, opaque, cas, vbucket, extras, key, value)
+
+        if quiet:
+            if name in ('get', 'getk', 'gat') and status != STATUS_SUCCESS:
+                return None
+            if name not in ('get', 'getk', 'gat') and \
+                    status == STATUS_SUCCESS:
+                return None
+        return rv
+
+    def _error(self, opcode, opaque, status, message):
+        return status, _pack(opcode, opaque, status, value=message)
+
+    def _stored(self, opcode, opaque, item):
+        return STATUS_SUCCESS, _pack(opcode, opaque, cas=item.cas)
+
+    def op_get(self, opcode, opaque, cas, vbucket, extras, key, value,
+               with_key=False, expiry=None, lock=None):
+        bucket = self.bucket
+        stats = self.mock._stats
+
+        with bucket.lock:
+            stats['cmd_get'] += 1
+            item = bucket.get(key)
+            if not item:
+                stats['get_misses'] += 1
+                return self._error(opcode, opaque, STATUS_KEY_ENOENT,
+                                   b'Not found')
+            stats['get_hits'] += 1
+
+            if lock is not None:
+                if item.locked:
+                    return self._error(opcode, opaque, STATUS_ETMPFAIL,
+                                       b'Temporary failure')
+                if not lock or lock > MAX_LOCK_TIME:
+                    lock = DEFAULT_LOCK_TIME
+                item.locked_until = time.time() + lock
+                item.cas = self.mock._next_cas()
+
+            if expiry is not None:
+                item.expiry = _abs_expiry(expiry)
+
+            rvcas = item.cas
+            if lock is None and item.locked:
+                rvcas = LOCKED_CAS
+
+            return STATUS_SUCCESS, _pack(opcode, opaque, cas=rvcas,
+                                         extras=struct.pack(">I", item.flags),
+                                         key=key if with_key else b'',
+                                         value=item.value)
+
+    def op_getk(self, *args):
+        return self.op_get(*args, with_key=True)
+
+    def op_get_replica(self, *args):
+        return self.op_get(*args)
+
+    def op_gat(self, opcode, opaque, cas, vbucket, extras, key, value):
+        if len(extras) != 4:
+            return self._error(opcode, opaque, STATUS_EINVAL,
+                               b'Invalid arguments')
+        exp, = struct.unpack(">I", extras)
+        return self.op_get(opcode, opaque, cas, vbucket, extras, key, value,
+                           expiry=exp)
+
+    def op_get_locked(self, opcode, opaque, cas, vbucket, extras, key, value):
+        lock = 0
+        if len(extras) == 4:
+            lock, = struct.unpack(">I", extras)
+        return self.op_get(opcode, opaque, cas, vbucket, extras, key, value,
+                           lock=lock)
+
+    def _check_cas(self, item, cas):
+        """
+        Check whether an item may be modified with the given CAS.
+        :return: An error status, or None
+        """
+        if item.locked:
+            if cas != item.cas:
+                return STATUS_KEY_EEXISTS
+            item.locked_until = 0
+        elif cas and cas != item.cas:
+            return STATUS_KEY_EEXISTS
+        return None
+
+    def _store(self, opcode, opaque, cas, extras, key, value, mode):
+        if len(extras) != 8:
+            return self._error(opcode, opaque, STATUS_EINVAL,
+                               b'Invalid arguments')
+        if len(value) > MAX_VALUE_SIZE:
+            return self._error(opcode, opaque, STATUS_E2BIG, b'Too large')
+
+        flags, exp = struct.unpack(">II", extras)
+        bucket = self.bucket
+
+        with bucket.lock:
+            self.mock._stats['cmd_set'] += 1
+            item = bucket.get(key)
+
+            if item:
+                if mode == 'add':
+                    return self._error(opcode, opaque, STATUS_KEY_EEXISTS,
+                                       b'Data exists for key')
+                status = self._check_cas(item, cas)
+                if status is not None:
+                    return self._error(opcode, opaque, status,
+                                       b'Data exists for key')
+            elif mode == 'replace' or cas:
+                return self._error(opcode, opaque, STATUS_KEY_ENOENT,
+                                   b'Not found')
+
+            item = _Item(value, flags, self.mock._next_cas(),
+                         _abs_expiry(exp))
+            bucket.items[key] = item
+            return self._stored(opcode, opaque, item)
+
+    def op_set(self, opcode, opaque, cas, vbucket, extras, key, value):
+        return self._store(opcode, opaque, cas, extras, key, value, 'set')
+
+    def op_add(self, opcode, opaque, cas, vbucket, extras, key, value):
+        return self._store(opcode, opaque, cas, extras, key, value, 'add')
+
+    def op_replace(self, opcode, opaque, cas, vbucket, extras, key, value):
+        return self._store(opcode, opaque, cas, extras, key, value, 'replace')
+
+    def _concat(self, opcode, opaque, cas, key, value, prepend):
+        bucket = self.bucket
+        with bucket.lock:
+            item = bucket.get(key)
+            if not item:
+                return self._error(opcode, opaque, STATUS_NOT_STORED,
+                                   b'Not stored')
+            status = self._check_cas(item, cas)
+            if status is not None:
+                return self._error(opcode, opaque, status,
+                                   b'Data exists for key')
+            if len(item.value) + len(value) > MAX_VALUE_SIZE:
+                return self._error(opcode, opaque, STATUS_E2BIG, b'Too large')
+
+            if prepend:
+                item.value = value + item.value
+            else:
+                item.value = item.value + value
+            item.cas = self.mock._next_cas()
+            return self._stored(opcode, opaque, item)
+
+    def op_append(self, opcode, opaque, cas, vbucket, extras, key, value):
+        return self._concat(opcode, opaque, cas, key, value, False)
+
+    def op_prepend(self, opcode, opaque, cas, vbucket, extras, key, value):
+        return self._concat(opcode, opaque, cas, key, value, True)
+
+    def op_delete(self, opcode, opaque, cas, vbucket, extras, key, value):
+        bucket = self.bucket
+        with bucket.lock:
+            item = bucket.get(key)
+            if not item:
+                return self._error(opcode, opaque, STATUS_KEY_ENOENT,
+                                   b'Not found')
+            status = self._check_cas(item, cas)
+            if status is not None:
+                return self._error(opcode, opaque, status,
+                                   b'Data exists for key')
+            del bucket.items[key]
+            return STATUS_SUCCESS, _pack(opcode, opaque,
+                                         cas=self.mock._next_cas())
+
+    def _arithmetic(self, opcode, opaque, cas, extras, key, decr):
+        if len(extras) != 20:
+            return self._error(opcode, opaque, STATUS_EINVAL,
+                               b'Invalid arguments')
+
+        delta, initial, exp = struct.unpack(">QQI", extras)
+        bucket = self.bucket
+
+        with bucket.lock:
+            item = bucket.get(key)
+            if not item:
+                if exp == 0xffffffff:
+                    return self._error(opcode, opaque, STATUS_KEY_ENOENT,
+                                       b'Not found')
+                cur = initial
+                item = _Item(b'', 0, 0, _abs_expiry(exp))
+            else:
+                status = self._check_cas(item, cas)
+                if status is not None:
+                    return self._error(opcode, opaque, status,
+                                       b'Data exists for key')
+                try:
+                    cur = long(item.value.decode('ascii').strip())
+                    if cur < 0:
+                        raise ValueError(cur)
+                except ValueError:
+                    return self._error(opcode, opaque, STATUS_DELTA_BADVAL,
+                                       b'Non-numeric value')
+                if decr:
+                    cur = max(cur - delta, 0)
+                else:
+                    cur = (cur + delta) & 0xffffffffffffffff
+
+            item.value = str(cur).encode('ascii')
+            item.cas = self.mock._next_cas()
+            bucket.items[key] = item
+            return STATUS_SUCCESS, _pack(opcode, opaque, cas=item.cas,
+                                         value=struct.pack(">Q", cur))
+
+    def op_incr(self, opcode, opaque, cas, vbucket, extras, key, value):
+        return self._arithmetic(opcode, opaque, cas, extras, key, False)
+
+    def op_decr(self, opcode, opaque, cas, vbucket, extras, key, value):
+        return self._arithmetic(opcode, opaque, cas, extras, key, True)
+
+    def op_touch(self, opcode, opaque, cas, vbucket, extras, key, value):
+        if len(extras) != 4:
+            return self._error(opcode, opaque, STATUS_EINVAL,
+                               b'Invalid arguments')
+        exp, = struct.unpack(">I", extras)
+        bucket = self.bucket
+        with bucket.lock:
+            item = bucket.get(key)
+            if not item:
+                return self._error(opcode, opaque, STATUS_KEY_ENOENT,
+                                   b'Not found')
+            if item.locked:
+                return self._error(opcode, opaque, STATUS_ETMPFAIL,
+                                   b'Temporary failure')
+            item.expiry = _abs_expiry(exp)
+            return self._stored(opcode, opaque, item)
+
+    def op_unlock(self, opcode, opaque, cas, vbucket, extras, key, value):
+        bucket = self.bucket
+        with bucket.lock:
+            item = bucket.get(key)
+            if not item:
+                return self._error(opcode, opaque, STATUS_KEY_ENOENT,
+                                   b'Not found')
+            if not item.locked or item.cas != cas:
+                return self._error(opcode, opaque, STATUS_ETMPFAIL,
+                                   b'Temporary failure')
+            item.locked_until = 0
+            return STATUS_SUCCESS, _pack(opcode, opaque)
+
+    def op_observe(self, opcode, opaque, cas, vbucket, extras, key, value):
+        """
+        Items are always reported as persisted, as they would be once the
+        server has written them to disk.
+        """
+        bucket = self.bucket
+        out = []
+        pos = 0
+
+        with bucket.lock:
+            while pos + 4 <= len(value):
+                vb, nkey = struct.unpack_from(">HH", value, pos)
+                okey = value[pos + 4:pos + 4 + nkey]
+                pos += 4 + nkey
+
+                item = bucket.get(okey)
+                if item:
+                    status, ocas = OBS_PERSISTED, item.cas
+                else:
+                    status, ocas = OBS_NOTFOUND, 0
+
+                out.append(struct.pack(">HH", vb, nkey) + okey +
+                           struct.pack(">BQ", status, ocas))
+
+        return STATUS_SUCCESS, _pack(opcode, opaque, value=b''.join(out))
+
+    def op_stat(self, opcode, opaque, cas, vbucket, extras, key, value):
+        out = []
+        group = key.decode('utf-8')
+        for k, v in self.mock._get_stats(self.bucket, group):
+            out.append(_pack(opcode, opaque, key=k.encode('utf-8'),
+                             value=str(v).encode('utf-8')))
+        out.append(_pack(opcode, opaque))
+        return STATUS_SUCCESS, b''.join(out)
+
+    def op_noop(self, opcode, opaque, cas, vbucket, extras, key, value):
+        return STATUS_SUCCESS, _pack(opcode, opaque)
+
+    def op_verbosity(self, opcode, opaque, cas, vbucket, extras, key, value):
+        return STATUS_SUCCESS, _pack(opcode, opaque)
+
+    def op_version(self, opcode, opaque, cas, vbucket, extras, key, value):
+        return STATUS_SUCCESS, _pack(opcode, opaque,
+                                     value=MockServer.VERSION.encode('ascii'))
+
+    def op_quit(self, opcode, opaque, cas, vbucket, extras, key, value):
+        self.done = True
+        return STATUS_SUCCESS, _pack(opcode, opaque)
+
+    def op_flush(self, opcode, opaque, cas, vbucket, extras, key, value):
+        if not self.bucket:
+            return self._error(opcode, opaque, STATUS_AUTH_ERROR,
+                               b'Not authenticated')
+        with self.bucket.lock:
+            self.bucket.items.clear()
+        return STATUS_SUCCESS, _pack(opcode, opaque)
+
+    def op_sasl_list_mechs(self, opcode, opaque, cas, vbucket, extras, key,
+                           value):
+        return STATUS_SUCCESS, _pack(opcode, opaque, value=b'PLAIN')
+
+    def op_sasl_auth(self, opcode, opaque, cas, vbucket, extras, key, value):
+        if key != b'PLAIN':
+            return self._error(opcode, opaque, STATUS_AUTH_ERROR,
+                               b'Auth failure')
+
+        parts = value.split(b'\0')
+        if len(parts) != 3:
+            return self._error(opcode, opaque, STATUS_AUTH_ERROR,
+                               b'Auth failure')
+
+        user = parts[1].decode('utf-8')
+        password = parts[2].decode('utf-8')
+        bucket = self.mock._buckets.get(user)
+
+        if not bucket or bucket.password != password:
+            return self._error(opcode, opaque, STATUS_AUTH_ERROR,
+                               b'Auth failure')
+
+        self.bucket = bucket
+        return STATUS_SUCCESS, _pack(opcode, opaque, value=b'Authenticated')
+
+
+def _collate_key(value):
+    """
+    Return an object which sorts in the same order as the view engine
+    collates the JSON value. Values of different types are ordered as
+    null < false < true < numbers < strings < arrays < objects
+    """
+    if value is None:
+        return (0,)
+    if value is False:
+        return (1,)
+    if value is True:
+        return (2,)
+    if isinstance(value, (int, long, float)):
+        return (3, value)
+    if isinstance(value, basestring):
+        return (4, value)
+    if isinstance(value, list):
+        return (5, tuple(_collate_key(x) for x in value))
+    if isinstance(value, dict):
+        return (6, tuple((_collate_key(k), _collate_key(v))
+                         for k, v in value.items()))
+    raise ValueError("Cannot collate {0!r}".format(value))
+
+
+def _cmp(a, b):
+    return (a > b) - (a < b)
+
+
+_UNSPEC = object()
+
+
+class _ViewQuery(object):
+    """
+    The parameters of a view query, parsed from the query string (and the
+    POST body, for 'keys')
+    """
+    def __init__(self, params, body):
+        self.key = _UNSPEC
+        self.keys = _UNSPEC
+        self.startkey = _UNSPEC
+        self.endkey = _UNSPEC
+        self.startkey_docid = None
+        self.endkey_docid = None
+        self.inclusive_end = True
+        self.descending = False
+        self.limit = None
+        self.skip = 0
+        self.reduce = None
+        self.group_level = 0
+
+        for name, value in params:
+            if name in ('key', 'keys', 'startkey', 'endkey'):
+                setattr(self, name, json.loads(value))
+            elif name in ('startkey_docid', 'endkey_docid'):
+                setattr(self, name, value)
+            elif name in ('inclusive_end', 'descending', 'reduce'):
+                setattr(self, name, self._bool(name, value))
+            elif name == 'group':
+                if self._bool(name, value):
+                    self.group_level = -1
+            elif name == 'group_level':
+                self.group_level = int(value)
+            elif name in ('limit', 'skip'):
+                setattr(self, name, int(value))
+
+        if body:
+            doc = json.loads(body.decode('utf-8'))
+            if 'keys' in doc:
+                self.keys = doc['keys']
+
+    @staticmethod
+    def _bool(name, value):
+        if value == 'true':
+            return True
+        if value == 'false':
+            return False
+        raise ValueError("Invalid value for '{0}'".format(name))
+
+    def _cmp_bound(self, row, bkey, bdocid):
+        rv = _cmp(row[0], _collate_key(bkey))
+        if rv or bdocid is None:
+            return rv
+        return _cmp(row[1], bdocid)
+
+    def _in_range(self, row):
+        if self.descending:
+            lo, lodoc = self.endkey, self.endkey_docid
+            hi, hidoc = self.startkey, self.startkey_docid
+            lo_inclusive, hi_inclusive = self.inclusive_end, True
+        else:
+            lo, lodoc = self.startkey, self.startkey_docid
+            hi, hidoc = self.endkey, self.endkey_docid
+            lo_inclusive, hi_inclusive = True, self.inclusive_end
+
+        if lo is not _UNSPEC:
+            rv = self._cmp_bound(row, lo, lodoc)
+            if rv < 0 or (rv == 0 and not lo_inclusive):
+                return False
+
+        if hi is not _UNSPEC:
+            rv = self._cmp_bound(row, hi, hidoc)
+            if rv > 0 or (rv == 0 and not hi_inclusive):
+                return False
+
+        return True
+
+    def select(self, rows):
+        """
+        Select the rows matching the query from the index. Each row is a
+        tuple of (collation key, document ID, key, value), in index order
+        """
+        if self.keys is not _UNSPEC or self.key is not _UNSPEC:
+            keys = self.keys if self.keys is not _UNSPEC else [self.key]
+            ret = []
+            for k in keys:
+                ck = _collate_key(k)
+                matches = [r for r in rows if r[0] == ck]
+                if self.descending:
+                    matches.reverse()
+                ret.extend(matches)
+            return ret
+
+        if self.descending:
+            rows = rows[::-1]
+        return [r for r in rows if self._in_range(r)]
+
+    def page(self, rows):
+        rows = rows[self.skip:]
+        if self.limit is not None:
+            rows = rows[:self.limit]
+        return rows
+
+
+def _builtin_reduce(name):
+    def _count(keys, values, rereduce):
+        return len(values)
+
+    def _sum(keys, values, rereduce):
+        return sum(values)
+
+    def _stats(keys, values, rereduce):
+        return {
+            'sum': sum(values),
+            'count': len(values),
+            'min': min(values),
+            'max': max(values),
+            'sumsqr': sum(v * v for v in values)
+        }
+
+    return {'_count': _count, '_sum': _sum, '_stats': _stats}.get(name)
+
+
+class _RestHandler(BaseHTTPRequestHandler):
+    protocol_version = 'HTTP/1.1'
+    server_version = 'CouchbaseMock'
+
+    def setup(self):
+        BaseHTTPRequestHandler.setup(self)
+        self.server.mock._add_connection(self.request, False)
+
+    def finish(self):
+        try:
+            BaseHTTPRequestHandler.finish(self)
+        finally:
+            self.server.mock._remove_connection(self.request)
+
+    def log_message(self, fmt, *args):
+        pass
+
+    def do_GET(self):
+        self._route('GET')
+
+    def do_POST(self):
+        self._route('POST')
+
+    def do_PUT(self):
+        self._route('PUT')
+
+    def do_DELETE(self):
+        self._route('DELETE')
+
+    def _read_body(self):
+        n = int(self.headers.get('Content-Length') or 0)
+        if not n:
+            return b''
+        return self.rfile.read(n)
+
+    def _compressor(self):
+        """
+        Return a compression object for the mock's ``http_encoding``, after
+        sending the Content-Encoding header, or ``None``
+        """
+        encoding = self.server.mock.http_encoding
+        if not encoding:
+            return None
+
+        self.send_header('Content-Encoding', encoding)
+        if encoding == 'gzip':
+            return zlib.compressobj(6, zlib.DEFLATED, 16 + zlib.MAX_WBITS)
+        return zlib.compressobj(6)
+
+    def _send(self, status, body, content_type='application/json'):
+        if not isinstance(body, bytes):
+            if not isinstance(body, basestring):
+                body = json.dumps(body)
+            body = body.encode('utf-8')
+
+        self.send_response(status)
+        self.send_header('Content-Type', content_type)
+        if body:
+            comp = self._compressor()
+            if comp:
+                body = comp.compress(body) + comp.flush()
+        self.send_header('Content-Length', str(len(body)))
+        self.end_headers()
+        self.wfile.write(body)
+
+    def _not_found(self):
+        self._send(404, {'error': 'not_found', 'reason': 'missing'})
+
+    def _route(self, method):
+        mock = self.server.mock
+        url = urlparse(self.path)
+        parts = [unquote(p) for p in url.path.split('/') if p]
+        params = parse_qsl(url.query, keep_blank_values=True)
+        body = self._read_body()
+
+        try:
+            if parts and parts[0] == 'pools':
+                return self._pools(method, parts[1:], body)
+
+            if len(parts) >= 3 and parts[1] == '_design':
+                bucket = mock._buckets.get(parts[0])
+                if not bucket:
+                    return self._not_found()
+
+                ddoc = '_design/' + parts[2]
+                if len(parts) == 3:
+                    return self._design(method, bucket, ddoc, body)
+                if len(parts) == 5 and parts[3] == '_view':
+                    return self._view(bucket, ddoc, parts[4], params, body)
+
+            return self._not_found()
+
+        except socket.error:
+            self.close_connection = True
+
+    def _pools(self, method, parts, body):
+        mock = self.server.mock
+
+        if not parts:
+            return self._send(200, {
+                'pools': [{'name': 'default', 'uri': '/pools/default'}],
+                'implementationVersion': MockServer.VERSION,
+                'isAdminCreds': True
+            })
+
+        if parts[0] != 'default':
+            return self._not_found()
+
+        if len(parts) == 1:
+            return self._send(200, {
+                'name': 'default',
+                'nodes': [mock._node_info()],
+                'buckets': {'uri': '/pools/default/buckets'}
+            })
+
+        if len(parts) == 2 and parts[1] == 'buckets':
+            if method == 'POST':
+                form = dict(parse_qsl(body.decode('utf-8')))
+                if not form.get('name'):
+                    return self._send(400, {'errors': {
+                        'name': 'Bucket name cannot be empty'}})
+                mock.add_bucket(form['name'], form.get('saslPassword', ''))
+                return self._send(202, '')
+
+            return self._send(200, [mock._bucket_config(b)
+                                    for b in mock._buckets.values()])
+
+        if len(parts) == 3 and parts[1] in ('buckets', 'bucketsStreaming',
+                                            'bs'):
+            bucket = mock._buckets.get(parts[2])
+            if not bucket:
+                return self._send(404, 'Requested resource not found.\r\n',
+                                  'text/plain')
+
+            if parts[1] != 'buckets':
+                return self._stream_config(bucket)
+
+            if method == 'DELETE':
+                mock.remove_bucket(bucket.name)
+                return self._send(200, '')
+
+            return self._send(200, mock._bucket_config(bucket))
+
+        return self._not_found()
+
+    def _stream_config(self, bucket):
+        """
+        Send the configuration, and keep the connection open (as the cluster
+        does, to push any changes) until the mock is stopped
+        """
+        mock = self.server.mock
+        config = json.dumps(mock._bucket_config(bucket)) + CONFIG_DELIMITER
+        config = config.encode('utf-8')
+
+        self.send_response(200)
+        self.send_header('Content-Type', 'application/json; charset=utf-8')
+        self.send_header('Transfer-Encoding', 'chunked')
+        self.end_headers()
+        self.wfile.write('{0:x}\r\n'.format(len(config)).encode('ascii') +
+                         config + b'\r\n')
+        self.wfile.flush()
+
+        while not mock._stopping.wait(0.5):
+            pass
+
+        self.close_connection = True
+
+    def _design(self, method, bucket, ddoc, body):
+        with bucket.lock:
+            if method == 'PUT':
+                try:
+                    doc = json.loads(body.decode('utf-8'))
+                except ValueError:
+                    return self._send(400, {'error': 'invalid_design_document',
+                                            'reason': 'Invalid JSON'})
+                bucket.ddocs[ddoc] = doc
+                return self._send(201, {'ok': True, 'id': ddoc})
+
+            doc = bucket.ddocs.get(ddoc)
+            if doc is None:
+                return self._not_found()
+
+            if method == 'DELETE':
+                del bucket.ddocs[ddoc]
+                return self._send(200, {'ok': True, 'id': ddoc})
+
+            return self._send(200, doc)
+
+    def _view(self, bucket, ddoc, name, params, body):
+        mock = self.server.mock
+
+        if mock.view_latency:
+            time.sleep(mock.view_latency)
+
+        status = mock._injected_error('view')
+        if status is not None:
+            return self._send(500, {'error': 'error',
+                                    'reason': 'Injected error'})
+
+        with bucket.lock:
+            doc = bucket.ddocs.get(ddoc)
+            if doc is None or name not in doc.get('views', {}):
+                return self._not_found()
+
+            view = bucket.views.get((ddoc, name), _View())
+            reduce_fn = view.reduce_fn
+            if reduce_fn is None:
+                reduce_fn = _builtin_reduce(doc['views'][name].get('reduce'))
+
+            try:
+                query = _ViewQuery(params, body)
+            except ValueError as e:
+                return self._send(400, {'error': 'query_parse_error',
+                                        'reason': str(e)})
+
+            try:
+                index = mock._build_index(bucket, view.map_fn)
+            except Exception as e:
+                return self._send(500, {'error': 'map_error',
+                                        'reason': repr(e)})
+
+        do_reduce = reduce_fn is not None and query.reduce is not False
+        if query.reduce and not reduce_fn:
+            return self._send(400, {
+                'error': 'query_parse_error',
+                'reason': 'Invalid URL parameter `reduce` for map view.'})
+
+        rows = query.select(index)
+
+        if do_reduce:
+            rows = query.page(self._reduce(rows, reduce_fn,
+                                           query.group_level))
+            rows = ['{{"key":{0},"value":{1}}}'.format(json.dumps(k),
+                                                       json.dumps(v))
+                    for k, v in rows]
+            return self._send_rows('{"rows":[\r\n', rows, '\r\n]\r\n}\n')
+
+        rows = query.page(rows)
+        rows = ['{{"id":{0},"key":{1},"value":{2}}}'.format(json.dumps(r[1]),
+                                                            json.dumps(r[2]),
+                                                            json.dumps(r[3]))
+                for r in rows]
+        return self._send_rows(
+            '{{"total_rows":{0},"rows":[\r\n'.format(len(index)), rows,
+            '\r\n]\r\n}\n')
+
+    def _send_rows(self, head, rows, tail):
+        """
+        Send a view response. With ``view_row_latency``, each row is sent in
+        its own chunk, after the delay
+        """
+        delay = self.server.mock.view_row_latency
+        if not delay:
+            return self._send(200, head + ',\r\n'.join(rows) + tail)
+
+        self.send_response(200)
+        self.send_header('Content-Type', 'application/json')
+        self.send_header('Transfer-Encoding', 'chunked')
+        comp = self._compressor()
+        self.end_headers()
+
+        chunks = [head]
+        for ii, row in enumerate(rows):
+            chunks.append((',\r\n' if ii else '') + row)
+        chunks.append(tail)
+
+        for ii, chunk in enumerate(chunks):
+            if 0 < ii < len(chunks) - 1:
+                time.sleep(delay)
+            chunk = chunk.encode('utf-8')
+            if comp:
+                # Flushed, so that each row can be decompressed on arrival
+                chunk = comp.compress(chunk) + comp.flush(zlib.Z_SYNC_FLUSH)
+            self._write_chunk(chunk)
+
+        if comp:
+            self._write_chunk(comp.flush())
+        self._write_chunk(b'')
+
+    def _write_chunk(self, data):
+        self.wfile.write('{0:x}\r\n'.format(len(data)).encode('ascii') +
+                         data + b'\r\n')
+        self.wfile.flush()
+
+    @staticmethod
+    def _reduce(rows, reduce_fn, group_level):
+        if not group_level:
+            if not rows:
+                return []
+            return [(None, reduce_fn([(r[2], r[1]) for r in rows],
+                                     [r[3] for r in rows], False))]
+
+        groups = []
+        for r in rows:
+            key = r[2]
+            if group_level > 0 and isinstance(key, list):
+                key = key[:group_level]
+            if groups and groups[-1][0] == key:
+                groups[-1][1].append(r)
+            else:
+                groups.append((key, [r]))
+
+        return [(k, reduce_fn([(r[2], r[1]) for r in g],
+                              [r[3] for r in g], False))
+                for k, g in groups]
+
+
+class MockServer(object):
+    VERSION = '2.0.0-mock'
+
+    def __init__(self,
+                 host='127.0.0.1',
+                 rest_port=0,
+                 mc_port=0,
+                 buckets=None,
+                 nvbuckets=64,
+                 latency=0,
+                 view_latency=0,
+                 view_row_latency=0,
+                 http_encoding=None,
+                 error_rate=0,
+                 error_status=STATUS_ETMPFAIL,
+                 seed=None):
+        """
+        Create a mock server. Call :meth:`start` to begin serving.
+
+        :param string host: The address to listen on
+        :param int rest_port: The port for the REST API and views. If 0, a
+            free port is chosen
+        :param int mc_port: The port for the memcached protocol. If 0, a
+            free port is chosen
+        :param dict buckets: A dict of bucket names and their passwords. By
+            default there is a single ``default`` bucket with no password
+        :param int nvbuckets: The number of vBuckets in the configuration
+        :param float latency: Seconds to wait before sending each batch of
+            memcached responses, to simulate the network
+        :param float view_latency: Seconds to wait before responding to each
+            view query
+        :param float view_row_latency: Seconds to wait before sending each
+            row of a view response. The rows are then sent in separate chunks
+        :param string http_encoding: Compress the bodies of REST and view
+            responses with this ``Content-Encoding`` (``gzip`` or
+            ``deflate``), as a compressing proxy would. The streaming
+            configuration is never compressed
+        :param float error_rate: The fraction (between 0 and 1) of key/value
+            operations and view queries which fail with ``error_status``
+        :param int error_status: The memcached status code for injected
+            errors. View queries fail with an HTTP 500 response instead
+        :param int seed: Seed for choosing which operations fail
+        """
+        if nvbuckets < 1 or nvbuckets & (nvbuckets - 1):
+            raise ValueError("nvbuckets must be a power of two")
+
+        if http_encoding not in (None, 'gzip', 'deflate'):
+            raise ValueError("http_encoding must be 'gzip' or 'deflate'")
+
+        if buckets is None:
+            buckets = {'default': ''}
+
+        self.host = host
+        self.nvbuckets = nvbuckets
+        self.latency = latency
+        self.view_latency = view_latency
+        self.view_row_latency = view_row_latency
+        self.http_encoding = http_encoding
+        self.error_rate = error_rate
+        self.error_status = error_status
+
+        self._rest_port = rest_port
+        self._mc_port = mc_port
+        self._buckets = {}
+        self._random = random.Random(seed)
+        self._failures = []
+        self._cas = 0
+        self._lock = threading.Lock()
+        self._connections = {}
+        self._stopping = threading.Event()
+        self._servers = []
+        self._threads = []
+        self._started = None
+        self._stats = {'cmd_get': 0, 'cmd_set': 0, 'get_hits': 0,
+                       'get_misses': 0, 'total_connections': 0}
+
+        for name, password in buckets.items():
+            self.add_bucket(name, password)
+
+    @property
+    def rest_port(self):
+        """
+        The port on which the REST API is served
+        """
+        return self._rest_port
+
+    @property
+    def mc_port(self):
+        """
+        The port on which the memcached protocol is served
+        """
+        return self._mc_port
+
+    def connection_args(self, bucket='default'):
+        """
+        Return the arguments for connecting to a bucket of this server, to be
+        passed to :class:`~couchbase.connection.Connection`
+        """
+        return {
+            'host': self.host,
+            'port': self.rest_port,
+            'bucket': bucket,
+            'password': self._buckets[bucket].password
+        }
+
+    def start(self):
+        """
+        Start serving, in background threads
+        """
+        mc = _ThreadingTCPServer((self.host, self._mc_port), _MemcachedHandler)
+        rest = _ThreadingHTTPServer((self.host, self._rest_port), _RestHandler)
+        self._servers = [mc, rest]
+        self._stopping.clear()
+
+        for srv in self._servers:
+            srv.mock = self
+            t = threading.Thread(target=srv.serve_forever)
+            t.daemon = True
+            t.start()
+            self._threads.append(t)
+
+        self._mc_port = mc.server_address[1]
+        self._rest_port = rest.server_address[1]
+        self._started = time.time()
+        return self
+
+    def stop(self):
+        """
+        Stop serving, closing all client connections
+        """
+        self._stopping.set()
+
+        for srv in self._servers:
+            srv.shutdown()
+            srv.server_close()
+
+        with self._lock:
+            for sock in list(self._connections):
+                try:
+                    sock.shutdown(socket.SHUT_RDWR)
+                except socket.error:
+                    pass
+
+        for t in self._threads:
+            t.join()
+
+        self._servers = []
+        self._threads = []
+
+    def __enter__(self):
+        return self.start()
+
+    def __exit__(self, *args):
+        self.stop()
+
+    def add_bucket(self, name, password=''):
+        """
+        Create a bucket. Any existing bucket of the same name is replaced.
+        """
+        self._buckets[name] = _Bucket(name, password)
+
+    def remove_bucket(self, name):
+        del self._buckets[name]
+
+    def add_view(self, design, view, map_fn, reduce_fn=None,
+                 bucket='default'):
+        """
+        Define a view, creating its design document if necessary.
+
+        :param string design: The name of the design document, without the
+            ``_design/`` prefix
+        :param string view: The name of the view
+        :param map_fn: A function taking a document and its metadata,
+            returning an iterable of ``(key, value)`` pairs to emit. The
+            document is the decoded JSON value (or ``None`` if the value is
+            not JSON), and the metadata is a dict with ``id``, ``flags``,
+            ``expiration`` and ``type`` (``json`` or ``base64``)
+        :param reduce_fn: A reduce function, or one of the built-in reduce
+            names ``_count``, ``_sum`` or ``_stats``. A function is called
+            with the list of ``(key, docid)`` pairs, the list of values and
+            a ``rereduce`` flag (always ``False``)
+
+        Index rows for documents with a name beginning with ``beer``::
+
+            def by_name(doc, meta):
+                if meta['id'].startswith('beer'):
+                    yield meta['id'], None
+
+            mock.add_view('beer', 'by_name', by_name, '_count')
+        """
+        b = self._buckets[bucket]
+        ddoc = '_design/' + design
+        if isinstance(reduce_fn, basestring):
+            reduce_name, reduce_fn = reduce_fn, _builtin_reduce(reduce_fn)
+        else:
+            reduce_name = '_mock' if reduce_fn else None
+
+        with b.lock:
+            doc = b.ddocs.setdefault(ddoc, {'views': {}})
+            doc.setdefault('views', {})[view] = {
+                'map': 'function (doc, meta) { /* mock */ }'}
+            if reduce_name:
+                doc['views'][view]['reduce'] = reduce_name
+            b.views[(ddoc, view)] = _View(map_fn, reduce_fn)
+
+    def fail_next(self, op=None, status=STATUS_ETMPFAIL, count=1, key=None):
+        """
+        Make the next operations fail.
+
+        :param string op: The operation to fail, such as ``get`` or ``set``,
+            or ``view`` for view queries. If ``None``, any key/value
+            operation or view query fails
+        :param int status: The memcached status code to fail with
+        :param int count: The number of operations to fail
+        :param key: If set, only key/value operations on this key fail
+        """
+        if op is not None and op != 'view' and op not in DATA_OPS:
+            raise ValueError("Unknown operation {0!r}".format(op))
+
+        if key is not None and not isinstance(key, bytes):
+            key = key.encode('utf-8')
+
+        with self._lock:
+            self._failures.append(_Failure(op, status, count, key))
+
+    def _injected_error(self, op, key=None):
+        with self._lock:
+            for f in self._failures:
+                if f.key is not None and f.key != key:
+                    continue
+                if f.op is None or f.op == op:
+                    f.count -= 1
+                    if not f.count:
+                        self._failures.remove(f)
+                    return f.status
+
+            if self.error_rate and self._random.random() < self.error_rate:
+                return self.error_status
+
+        return None
+
+    def _next_cas(self):
+        with self._lock:
+            self._cas += 1
+            return self._cas
+
+    def _add_connection(self, sock, memcached=True):
+        with self._lock:
+            self._connections[sock] = memcached
+            if memcached:
+                self._stats['total_connections'] += 1
+
+    def _remove_connection(self, sock):
+        with self._lock:
+            self._connections.pop(sock, None)
+
+    def _get_stats(self, bucket, group):
+        items = 0
+        mem_used = 0
+        if bucket:
+            with bucket.lock:
+                items = len(bucket.items)
+                mem_used = sum(len(k) + len(v.value)
+                               for k, v in bucket.items.items())
+
+        if group == '':
+            with self._lock:
+                ret = [
+                    ('pid', 0),
+                    ('uptime', int(time.time() - self._started)),
+                    ('time', int(time.time())),
+                    ('version', self.VERSION),
+                    ('curr_connections',
+                     sum(self._connections.values())),
+                    ('curr_items', items),
+                    ('mem_used', mem_used)
+                ]
+                ret += sorted(self._stats.items())
+            return ret
+
+        if group == 'memory':
+            return [('mem_used', mem_used), ('total_heap_bytes', mem_used)]
+
+        if group == 'tap':
+            return [('ep_tap_count', 0)]
+
+        return []
+
+    def _node_info(self):
+        return {
+            'hostname': '{0}:{1}'.format(self.host, self.rest_port),
+            'couchApiBase': 'http://{0}:{1}/'.format(self.host,
+                                                     self.rest_port),
+            'ports': {'direct': self.mc_port, 'proxy': 0},
+            'status': 'healthy',
+            'clusterMembership': 'active',
+            'version': self.VERSION
+        }
+
+    def _bucket_config(self, bucket):
+        node = self._node_info()
+        node['couchApiBase'] += bucket.name
+        server = '{0}:{1}'.format(self.host, self.mc_port)
+
+        return {
+            'name': bucket.name,
+            'bucketType': 'membase',
+            'authType': 'sasl',
+            'saslPassword': bucket.password,
+            'uri': '/pools/default/buckets/' + bucket.name,
+            'streamingUri': '/pools/default/bucketsStreaming/' + bucket.name,
+            'nodes': [node],
+            'vBucketServerMap': {
+                'hashAlgorithm': 'CRC',
+                'numReplicas': 0,
+                'serverList': [server],
+                'vBucketMap': [[0]] * self.nvbuckets
+            }
+        }
+
+    @staticmethod
+    def _default_map(doc, meta):
+        yield meta['id'], None
+
+    def _build_index(self, bucket, map_fn):
+        """
+        Run the map function over every document in the bucket, returning
+        the rows in collation order. The bucket lock must be held.
+        """
+        if map_fn is None:
+            map_fn = self._default_map
+
+        rows = []
+        for key in list(bucket.items.keys()):
+            item = bucket.get(key)
+            if not item:
+                continue
+
+            docid = key.decode('utf-8')
+            meta = {'id': docid, 'flags': item.flags,
+                    'expiration': int(item.expiry), 'type': 'json'}
+            try:
+                doc = json.loads(item.value.decode('utf-8'))
+            except ValueError:
+                doc = None
+                meta['type'] = 'base64'
+
+            for k, v in map_fn(doc, meta) or ():
+                rows.append((_collate_key(k), docid, k, v))
+
+        rows.sort(key=lambda r: (r[0], r[1]))
+        return rows
+
+
+def main(argv=None):
+    import argparse
+    import signal
+
+    ap = argparse.ArgumentParser(
+        description="Run a mock Couchbase server until interrupted")
+    ap.add_argument('-H', '--host', default='127.0.0.1')
+    ap.add_argument('-p', '--rest-port', default=8091, type=int,
+                    help="Port for the REST API and views. 0 picks a "
+                    "free port")
+    ap.add_argument('-m', '--mc-port', default=0, type=int,
+                    help="Port for the memcached protocol. 0 picks a "
+                    "free port")
+    ap.add_argument('-b', '--bucket', action='append', default=[],
+                    help="A bucket to create, as NAME or NAME:PASSWORD. "
+                    "May be given more than once. The default is a single "
+                    "'default' bucket")
+    ap.add_argument('-l', '--latency', default=0, type=float,
+                    help="Seconds to delay each batch of memcached responses")
+    ap.add_argument('-L', '--view-latency', default=0, type=float,
+                    help="Seconds to delay each view response")
+    ap.add_argument('-R', '--view-row-latency', default=0, type=float,
+                    help="Seconds to delay each row of a view response")
+    ap.add_argument('-z', '--http-encoding', default=None,
+                    choices=('gzip', 'deflate'),
+                    help="Compress REST and view responses")
+    ap.add_argument('-e', '--error-rate', default=0, type=float,
+                    help="Fraction of operations to fail with a temporary "
+                    "failure")
+    ap.add_argument('-s', '--seed', default=None, type=int)
+    options = ap.parse_args(argv)
+
+    buckets = None
+    if options.bucket:
+        buckets = dict((b.split(':', 1) + [''])[:2] for b in options.bucket)
+
+    mock = MockServer(host=options.host,
+                      rest_port=options.rest_port,
+                      mc_port=options.mc_port,
+                      buckets=buckets,
+                      latency=options.latency,
+                      view_latency=options.view_latency,
+                      view_row_latency=options.view_row_latency,
+                      http_encoding=options.http_encoding,
+                      error_rate=options.error_rate,
+                      seed=options.seed)
+    mock.start()
+
+    print("REST port: {0}".format(mock.rest_port))
+    print("Memcached port: {0}".format(mock.mc_port))
+    sys.stdout.flush()
+
+    signal.signal(signal.SIGTERM, lambda *args: sys.exit(0))
+    try:
+        while True:
+            time.sleep(3600)
+    except (KeyboardInterrupt, SystemExit):
+        pass
+    finally:
+        mock.stop()
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,93 @@
+#
+# Copyright 2013, Couchbase, Inc.
+# All Rights Reserved
+#
+# Licensed under the Apache License, Version 2.0 (the "License")
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#
+import threading
+import time
+
+from couchbase._libcouchbase import StatsSampler as _Base
+
+
+class StatsSampler(_Base):
+    def __init__(self, connection, stats, size=60, group=None):
+        """Create a sampler for a set of server statistics
+
+        :param connection: The :class:`~couchbase.connection.Connection`
+          used to request the statistics. If the sampler is run in the
+          background with :meth:`start`, this connection should not be
+          used by any other thread.
+
+        :param stats: The names of the statistics to keep, e.g.
+          ``['curr_items', 'cmd_get']``. Values for other statistics are
+          discarded without being converted to Python objects
+
+        :param int size: The number of samples to retain. Once this many
+          samples have been collected, the oldest is overwritten
+
+        :param string group: The statistics group to request (as in
+          :meth:`~couchbase.connection.Connection.stats`). The default
+          group is used if this is not specified
+        """
+        super(StatsSampler, self).__init__(connection, stats,
+                                           size=size, group=group)
+        self._thread = None
+        self._stop_event = None
+
+    def sample(self, timeout=None):
+        """Collect a sample from all nodes
+
+        :param float timeout: Maximum number of seconds to wait for the
+          nodes to reply. Nodes which do not reply in time have no values
+          for this sample
+        """
+        self._sample(time.time(), timeout=timeout)
+
+    def start(self, interval=1.0, on_error=None):
+        """Collect samples every `interval` seconds, in a background thread
+
+        :param float interval: Number of seconds between samples
+        :param on_error: A callable invoked with the exception if a sample
+          fails. By default, failed samples are skipped
+        """
+        if self._thread:
+            raise RuntimeError("Sampler already running")
+
+        self._stop_event = threading.Event()
+        self._thread = threading.Thread(target=self._run,
+                                        args=(interval, on_error,
+                                              self._stop_event))
+        self._thread.daemon = True
+        self._thread.start()
+
+    def stop(self):
+        """Stop the background thread started by :meth:`start`"""
+        if not self._thread:
+            return
+
+        self._stop_event.set()
+        self._thread.join()
+        self._thread = None
+
+    def _run(self, interval, on_error, stop_event):
+        next_run = time.time()
+        while not stop_event.is_set():
+            try:
+                self.sample(timeout=interval)
+            except Exception as e:
+                if on_error:
+                    on_error(e)
+
+            next_run += interval
+            stop_event.wait(max(0, next_run - time.time()))
@@ -0,0 +1,131 @@
+#
+# Copyright 2013, Couchbase, Inc.
+# All Rights Reserved
+#
+# Licensed under the Apache License, Version 2.0 (the "License")
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#
+
+"""
+A timeline of what the client is doing internally, for finding where the
+time goes in slow operations.
+
+While enabled, every thread records spans for:
+
+* ``operation`` - each key/value operation or HTTP request, from the call
+  until its results are ready
+* ``schedule`` - argument handling, conversion and scheduling of the
+  commands, before waiting for the responses
+* ``wait`` - the time spent in the library's event loop
+* ``callback`` - each response callback
+* ``gil`` - reacquiring the GIL after the event loop or from a callback
+* ``encode`` and ``decode`` - conversion of keys and values, including any
+  :class:`~couchbase.transcoder.Transcoder` calls
+
+The timeline is written as Chrome trace JSON, which can be opened with
+``chrome://tracing`` or https://ui.perfetto.dev::
+
+    from couchbase import timeline
+
+    timeline.enable()
+    cb.get_multi(keys)
+    timeline.dump('/tmp/get.json')
+
+Recording is cheap (a clock read and a few stores per span) and takes no
+locks, but each thread keeps its spans in a fixed-size ring buffer, so only
+the most recent ``capacity`` spans of each thread are kept.
+"""
+
+import json
+import os
+import threading
+
+import couchbase._libcouchbase as _LCB
+
+DEFAULT_CAPACITY = 8192
+
+
+def enable(capacity=DEFAULT_CAPACITY):
+    """Start recording the timeline
+
+    :param int capacity: The number of spans to keep for each thread. Once
+      a thread has recorded this many, its oldest are overwritten. This
+      applies to threads which record their first span after this call.
+      A thread's buffer is reused by a later thread once it exits, so
+      memory is bounded by the number of threads alive at once (about 48
+      bytes per span)
+    """
+    _LCB._timeline_enable(capacity=capacity)
+
+
+def disable():
+    """Stop recording the timeline. Spans already recorded are kept"""
+    _LCB._timeline_disable()
+
+
+def events(clear=False):
+    """Get the recorded spans
+
+    :param boolean clear: Whether to discard the returned spans, so that
+      the next call only returns newer ones
+
+    :return: A list of ``(thread, category, name, begin, end, n)`` tuples.
+      ``thread`` is the thread's identifier (as in ``threading``), ``begin``
+      and ``end`` are times in nanoseconds from an arbitrary point, and
+      ``n`` is a count or size associated with the span (e.g. the number of
+      commands in an operation, or the number of bytes converted)
+    """
+    return _LCB._timeline_collect(clear=clear)
+
+
+def chrome_trace(spans=None):
+    """Convert spans to the Chrome trace format
+
+    :param spans: The spans, as returned by :func:`events`. If not given,
+      the recorded spans are collected (and cleared)
+    :return: A dict which may be serialized with :mod:`json`
+    """
+    if spans is None:
+        spans = events(clear=True)
+
+    pid = os.getpid()
+    names = dict((t.ident, t.name) for t in threading.enumerate())
+    trace = []
+
+    for tid in set(span[0] for span in spans):
+        trace.append({'ph': 'M', 'name': 'thread_name', 'pid': pid,
+                      'tid': tid,
+                      'args': {'name': names.get(tid, str(tid))}})
+
+    for tid, cat, name, begin, end, n in spans:
+        trace.append({'ph': 'X', 'cat': cat, 'name': name,
+                      'pid': pid, 'tid': tid,
+                      'ts': begin / 1000.0, 'dur': (end - begin) / 1000.0,
+                      'args': {'n': n}})
+
+    return {'traceEvents': trace, 'displayTimeUnit': 'ns'}
+
+
+def dump(dest, clear=True):
+    """Write the recorded spans as a Chrome trace
+
+    :param dest: A file name, or a file-like object open for writing text
+    :param boolean clear: Whether to discard the spans written, so that the
+      next dump only contains newer ones
+    """
+    trace = chrome_trace(events(clear=clear))
+
+    if hasattr(dest, 'write'):
+        json.dump(trace, dest)
+    else:
+        with open(dest, 'w') as fp:
+            json.dump(trace, fp)
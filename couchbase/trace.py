@@ -0,0 +1,583 @@
+#
+# Copyright 2013, Couchbase, Inc.
+# All Rights Reserved
+#
+# Licensed under the Apache License, Version 2.0 (the "License")
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#
+
+"""
+Reading and replaying operation traces.
+
+A trace is recorded with :meth:`couchbase.connection.Connection.start_trace`.
+It contains every key/value call made on the connection: the operation, the
+keys, the sizes (but not the contents) of any values stored, when the call
+began and how long it took. Replaying it against another cluster (or the
+same one, after a change) re-issues the same calls with the same timing,
+which gives a realistic workload for comparing latencies::
+
+    from couchbase.connection import Connection
+    from couchbase.trace import replay
+
+    cb = Connection(bucket='default', host='staging')
+    report = replay(cb, '/tmp/app.trace', speed=2.0)
+    print(report['latency_us']['p99'])
+
+or, from the command line::
+
+    python -m couchbase.trace info /tmp/app.trace
+    python -m couchbase.trace replay /tmp/app.trace -H staging -s 2
+"""
+
+import collections
+import math
+import struct
+import time
+
+from couchbase import FMT_BYTES
+from couchbase.exceptions import CouchbaseError
+
+MAGIC = b'PYCBCTRC'
+VERSION = 1
+
+# Header flags
+F_HASHKEYS = 0x01
+
+# Batch flags
+B_ERROR = 0x01
+
+OP_GET = 1
+OP_LOCK = 2
+OP_TOUCH = 3
+OP_ARITH = 4
+OP_DELETE = 5
+OP_UNLOCK = 6
+OP_SET = 7
+OP_ADD = 8
+OP_REPLACE = 9
+OP_APPEND = 10
+OP_PREPEND = 11
+OP_OBSERVE = 12
+
+OP_NAMES = {
+    OP_GET: 'get',
+    OP_LOCK: 'lock',
+    OP_TOUCH: 'touch',
+    OP_ARITH: 'arithmetic',
+    OP_DELETE: 'delete',
+    OP_UNLOCK: 'unlock',
+    OP_SET: 'set',
+    OP_ADD: 'add',
+    OP_REPLACE: 'replace',
+    OP_APPEND: 'append',
+    OP_PREPEND: 'prepend',
+    OP_OBSERVE: 'observe'
+}
+
+STORE_OPS = (OP_SET, OP_ADD, OP_REPLACE, OP_APPEND, OP_PREPEND)
+TTL_OPS = (OP_GET, OP_LOCK, OP_TOUCH)
+
+PERCENTILES = (50, 90, 99, 99.9)
+
+_HEADER = struct.Struct("<8sBB6xQ")
+_U64 = struct.Struct("<Q")
+
+timer = getattr(time, 'perf_counter', time.time)
+
+
+class TraceFormatError(Exception):
+    """Raised when a file is not a trace, or is truncated or corrupt"""
+
+
+class Command(collections.namedtuple('Command', ['key', 'size', 'ttl',
+                                                   'delta', 'create'])):
+    """
+    A single command of a :class:`Batch`.
+
+    ``key`` is the key as bytes. ``size`` is the size of the value for
+    storage operations, ``ttl`` the expiry (or lock time), and ``delta`` and
+    ``create`` the parameters of arithmetic operations. Fields which do not
+    apply to the operation are `None`.
+    """
+    __slots__ = ()
+
+
+class Batch(object):
+    """
+    A single call made on the connection, with all of its commands
+    """
+    __slots__ = ('op', 'failed', 'start', 'latency', 'commands')
+
+    def __init__(self, op, failed, start, latency, commands):
+        #: One of the ``OP_*`` constants
+        self.op = op
+        #: Whether any of the commands failed when recorded
+        self.failed = failed
+        #: When the call began, in microseconds since the trace started
+        self.start = start
+        #: How long the call took when recorded, in microseconds
+        self.latency = latency
+        #: A list of :class:`Command` objects
+        self.commands = commands
+
+    @property
+    def name(self):
+        return OP_NAMES.get(self.op, str(self.op))
+
+    def __repr__(self):
+        return "Batch<op={0}, start={1}, latency={2}, ncmds={3}>".format(
+            self.name, self.start, self.latency, len(self.commands))
+
+
+def hashed_key(keyhash, nkey):
+    """
+    Make a key of ``nkey`` bytes from the hash of a key. The same hash
+    always gives the same key, so distinct keys in the original workload
+    stay distinct (barring hash collisions) in the replay.
+    """
+    hexed = '{0:016x}'.format(keyhash).encode('ascii')
+    reps = nkey // len(hexed) + 1
+    return (hexed * reps)[:max(nkey, 1)]
+
+
+class TraceFile(object):
+    """
+    Reader for a trace file. Iterating over it yields a :class:`Batch` for
+    each recorded call, in the order the calls completed::
+
+        with TraceFile('/tmp/app.trace') as trace:
+            for batch in trace:
+                print(batch.name, batch.latency, len(batch.commands))
+    """
+
+    _CHUNK = 65536
+
+    def __init__(self, path):
+        self._fp = open(path, 'rb')
+        self._buf = bytearray()
+        self._pos = 0
+
+        try:
+            header = self._fp.read(_HEADER.size)
+            if len(header) != _HEADER.size:
+                raise TraceFormatError("File too short for a trace header")
+
+            magic, version, flags, started = _HEADER.unpack(header)
+            if magic != MAGIC:
+                raise TraceFormatError("Not a trace file")
+            if version != VERSION:
+                raise TraceFormatError(
+                    "Unsupported trace version {0}".format(version))
+        except Exception:
+            self._fp.close()
+            raise
+
+        #: Whether keys were recorded as hashes
+        self.hashed_keys = bool(flags & F_HASHKEYS)
+        #: When the trace was started, as seconds since the epoch
+        self.started = started / 1e6
+
+    def close(self):
+        self._fp.close()
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *args):
+        self.close()
+
+    def _fill(self, n):
+        """
+        Make sure at least n bytes are buffered.
+        :return: False if the end of the file was reached first
+        """
+        while len(self._buf) - self._pos < n:
+            chunk = self._fp.read(self._CHUNK)
+            if not chunk:
+                return False
+            del self._buf[:self._pos]
+            self._pos = 0
+            self._buf.extend(chunk)
+        return True
+
+    def _bytes(self, n):
+        if not self._fill(n):
+            raise TraceFormatError("Truncated trace")
+        ret = bytes(self._buf[self._pos:self._pos + n])
+        self._pos += n
+        return ret
+
+    def _u8(self):
+        if not self._fill(1):
+            raise TraceFormatError("Truncated trace")
+        self._pos += 1
+        return self._buf[self._pos - 1]
+
+    def _varint(self):
+        ret = 0
+        shift = 0
+        while True:
+            c = self._u8()
+            ret |= (c & 0x7f) << shift
+            if not c & 0x80:
+                return ret
+            shift += 7
+            if shift > 63:
+                raise TraceFormatError("Malformed integer in trace")
+
+    def _key(self):
+        nkey = self._varint()
+        if self.hashed_keys:
+            return hashed_key(_U64.unpack(self._bytes(8))[0], nkey)
+        return self._bytes(nkey)
+
+    def _command(self, op):
+        key = self._key()
+        size = ttl = delta = create = None
+
+        if op in STORE_OPS:
+            size = self._varint()
+            ttl = self._varint()
+
+        elif op in TTL_OPS:
+            ttl = self._varint()
+
+        elif op == OP_ARITH:
+            zigzag = self._varint()
+            delta = -((zigzag + 1) >> 1) if zigzag & 1 else zigzag >> 1
+            create = bool(self._u8())
+            ttl = self._varint()
+
+        elif op not in OP_NAMES:
+            raise TraceFormatError("Unknown operation {0}".format(op))
+
+        return Command(key, size, ttl, delta, create)
+
+    def __iter__(self):
+        start = 0
+        while self._fill(1):
+            op = self._u8()
+            flags = self._u8()
+            start += self._varint()
+            latency = self._varint()
+            ncmds = self._varint()
+            commands = [self._command(op) for _ in range(ncmds)]
+            yield Batch(op, bool(flags & B_ERROR), start, latency, commands)
+
+
+def percentile(values, pct):
+    """
+    :param values: A sorted list
+    :return: The nearest-rank percentile
+    """
+    if not values:
+        return None
+    n = int(math.ceil(pct / 100.0 * len(values))) - 1
+    return values[min(max(n, 0), len(values) - 1)]
+
+
+def distribution(values):
+    """
+    Summarize a list of microsecond timings in the same form as the
+    benchmarks (``examples/bench.py``) report them
+    """
+    values = sorted(values)
+    if not values:
+        return {}
+
+    ret = {
+        'min': values[0],
+        'max': values[-1],
+        'mean': float(sum(values)) / len(values)
+    }
+    for pct in PERCENTILES:
+        ret['p{0:g}'.format(pct)] = percentile(values, pct)
+    return ret
+
+
+def summarize(path):
+    """
+    Summarize a trace without replaying it.
+
+    :return: A dict with the number of ``batches``, ``commands`` and failed
+      batches (``errors``), the ``duration`` of the trace in seconds, and the
+      recorded ``latency_us`` distribution, in total and for each operation
+      under ``ops``
+    """
+    ops = {}
+    last = 0
+
+    with TraceFile(path) as trace:
+        for batch in trace:
+            st = ops.setdefault(batch.name, {'batches': 0, 'commands': 0,
+                                             'errors': 0, 'latencies': []})
+            st['batches'] += 1
+            st['commands'] += len(batch.commands)
+            st['errors'] += batch.failed
+            st['latencies'].append(batch.latency)
+            last = max(last, batch.start + batch.latency)
+
+        ret = {'started': trace.started, 'hashed_keys': trace.hashed_keys}
+
+    return _report(ret, ops, last / 1e6)
+
+
+def _report(ret, ops, duration):
+    everything = []
+    for st in ops.values():
+        everything.extend(st['latencies'])
+        st['latency_us'] = distribution(st.pop('latencies'))
+
+    ret.update({
+        'duration': duration,
+        'batches': sum(st['batches'] for st in ops.values()),
+        'commands': sum(st['commands'] for st in ops.values()),
+        'errors': sum(st['errors'] for st in ops.values()),
+        'latency_us': distribution(everything),
+        'ops': ops
+    })
+    return ret
+
+
+class _Replayer(object):
+    def __init__(self, cb, hashed_keys):
+        self.cb = cb
+        self.hashed_keys = hashed_keys
+        self.values = {}
+        # CAS of each key locked during the replay, for the unlocks
+        self.locked = {}
+        self.skipped = 0
+
+    def key(self, cmd):
+        if self.hashed_keys:
+            return cmd.key.decode('ascii')
+        return cmd.key.decode('utf-8', 'replace')
+
+    def value(self, size):
+        try:
+            return self.values[size]
+        except KeyError:
+            return self.values.setdefault(size, b'x' * size)
+
+    def by_ttl(self, batch):
+        """
+        Group the commands of a batch by their TTL. The multi operations
+        take a single TTL, so commands recorded from one call share theirs
+        """
+        groups = collections.OrderedDict()
+        for cmd in batch.commands:
+            groups.setdefault(cmd.ttl, []).append(cmd)
+        return groups.items()
+
+    def calls(self, batch):
+        """
+        Yield (method, args, kwargs) for the calls which replay the batch
+        """
+        cb = self.cb
+        op = batch.op
+
+        if op in STORE_OPS:
+            meth = getattr(cb, OP_NAMES[op] + '_multi')
+            for ttl, cmds in self.by_ttl(batch):
+                kv = dict((self.key(c), self.value(c.size)) for c in cmds)
+                yield meth, (kv,), {'ttl': ttl, 'format': FMT_BYTES}
+
+        elif op in TTL_OPS:
+            meth = getattr(cb, OP_NAMES[op] + '_multi')
+            for ttl, cmds in self.by_ttl(batch):
+                yield meth, ([self.key(c) for c in cmds],), {'ttl': ttl}
+
+        elif op == OP_ARITH:
+            params = dict((self.key(c), {'delta': c.delta,
+                                         'initial': 0 if c.create else None,
+                                         'ttl': c.ttl})
+                          for c in batch.commands)
+            yield cb.incr_multi, (params,), {}
+
+        elif op == OP_DELETE:
+            yield cb.delete_multi, ([self.key(c) for c in batch.commands],), {}
+
+        elif op == OP_UNLOCK:
+            kv = {}
+            for cmd in batch.commands:
+                key = self.key(cmd)
+                if key in self.locked:
+                    kv[key] = self.locked.pop(key)
+                else:
+                    self.skipped += 1
+            if kv:
+                yield cb.unlock_multi, (kv,), {}
+
+        elif op == OP_OBSERVE:
+            yield cb.observe_multi, ([self.key(c) for c in batch.commands],), {}
+
+    def run(self, batch):
+        """
+        Issue a batch.
+        :return: The number of commands which failed
+        """
+        errors = 0
+        for meth, args, kwargs in self.calls(batch):
+            try:
+                results = meth(*args, **kwargs)
+            except CouchbaseError as e:
+                results = e.all_results
+                if not results:
+                    errors += len(args[0])
+                    continue
+
+            for key, result in results.items():
+                if not result.success:
+                    errors += 1
+                elif batch.op == OP_LOCK:
+                    self.locked[key] = result.cas
+
+        return errors
+
+
+def replay(cb, path, speed=1.0, limit=None):
+    """
+    Replay a trace.
+
+    :param cb: The :class:`~couchbase.connection.Connection` to issue the
+      operations on
+    :param string path: The trace file
+    :param float speed: How fast to replay the trace, relative to the
+      speed it was recorded at. ``2.0`` issues each call at half the delay
+      after the start of the replay as it had when recorded. ``0`` issues
+      the calls back to back.
+    :param int limit: If given, stop after this many batches
+
+    :return: A dict in the same form as :func:`summarize` returns, for the
+      replayed operations, with the recorded latencies added under
+      ``recorded_latency_us`` (overall and for each operation). ``lag_us``
+      is the distribution of how late calls were issued relative to the
+      schedule, which is nonzero when the client cannot keep up with the
+      requested speed. ``skipped`` counts unlocks of keys not locked during
+      the replay.
+
+    Values are stored as bytes of the recorded size (values themselves
+    are not recorded). Keys recorded as hashes are replaced by keys of the
+    same length derived from the hash. Each call is made with the ``_multi``
+    variant of its operation, and calls are made one at a time, in the
+    order they were recorded; concurrent calls from several threads
+    are therefore serialized.
+    """
+    ops = {}
+    lags = []
+    recorded = []
+
+    with TraceFile(path) as trace:
+        replayer = _Replayer(cb, trace.hashed_keys)
+        begin = timer()
+
+        for nbatches, batch in enumerate(trace):
+            if limit is not None and nbatches >= limit:
+                break
+
+            if speed:
+                lag = timer() - begin - batch.start / 1e6 / speed
+                if lag < 0:
+                    time.sleep(-lag)
+                    lag = 0
+                lags.append(lag * 1e6)
+
+            call_begin = timer()
+            errors = replayer.run(batch)
+            latency = (timer() - call_begin) * 1e6
+
+            st = ops.setdefault(batch.name, {'batches': 0, 'commands': 0,
+                                             'errors': 0, 'latencies': [],
+                                             'recorded': []})
+            st['batches'] += 1
+            st['commands'] += len(batch.commands)
+            st['errors'] += errors
+            st['latencies'].append(latency)
+            st['recorded'].append(batch.latency)
+            recorded.append(batch.latency)
+
+        duration = timer() - begin
+
+    for st in ops.values():
+        st['recorded_latency_us'] = distribution(st.pop('recorded'))
+
+    ret = _report({'speed': speed,
+                   'skipped': replayer.skipped,
+                   'lag_us': distribution(lags)},
+                  ops, duration)
+    ret['recorded_latency_us'] = distribution(recorded)
+    return ret
+
+
+def _print_report(rv):
+    print("{0:11} {1:>9} {2:>9} {3:>7} {4:>10} {5:>10} {6:>10}".format(
+        "op", "batches", "commands", "errors", "p50 us", "p99 us",
+        "rec p99 us"))
+
+    for name, st in sorted(rv['ops'].items()):
+        print("{0:11} {1:9} {2:9} {3:7} {4:10.0f} {5:10.0f} {6:>10}".format(
+            name, st['batches'], st['commands'], st['errors'],
+            st['latency_us']['p50'], st['latency_us']['p99'],
+            '{0:.0f}'.format(st['recorded_latency_us']['p99'])
+            if 'recorded_latency_us' in st else '-'))
+
+    print("{0} batches, {1} commands, {2} errors in {3:.2f}s".format(
+        rv['batches'], rv['commands'], rv['errors'], rv['duration']))
+    if rv.get('lag_us'):
+        print("Schedule lag: p50={0:.0f}us p99={1:.0f}us".format(
+            rv['lag_us']['p50'], rv['lag_us']['p99']))
+
+
+def main(argv=None):
+    import argparse
+    import json
+
+    ap = argparse.ArgumentParser(
+        description="Inspect or replay a trace recorded with "
+        "Connection.start_trace()")
+    ap.add_argument('command', choices=('info', 'replay'))
+    ap.add_argument('trace', help="The trace file")
+    ap.add_argument('-b', '--bucket', default='default', type=str)
+    ap.add_argument('-p', '--password', default=None, type=str,
+                    help="Password for the bucket")
+    ap.add_argument('-H', '--hostname', default='localhost', type=str)
+    ap.add_argument('-P', '--port', default=8091, type=int)
+    ap.add_argument('-s', '--speed', default=1.0, type=float,
+                    help="Replay speed relative to the recording. 0 replays "
+                    "as fast as possible")
+    ap.add_argument('-n', '--limit', default=None, type=int,
+                    help="Replay at most this many batches")
+    ap.add_argument('-o', '--output', default=None,
+                    help="File to write the report to, as JSON")
+    options = ap.parse_args(argv)
+
+    if options.command == 'info':
+        rv = summarize(options.trace)
+    else:
+        from couchbase.connection import Connection
+        connargs = {'host': options.hostname, 'port': options.port,
+                    'bucket': options.bucket}
+        if options.password:
+            connargs['password'] = options.password
+
+        rv = replay(Connection(**connargs), options.trace,
+                    speed=options.speed, limit=options.limit)
+
+    _print_report(rv)
+
+    if options.output:
+        with open(options.output, 'w') as fp:
+            json.dump(rv, fp, indent=2, sort_keys=True)
+
+
+if __name__ == '__main__':
+    main()
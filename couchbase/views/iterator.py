@@ -17,12 +17,11 @@
 
 from collections import namedtuple
 from copy import deepcopy
-import json
 from warnings import warn
 
 from couchbase.exceptions import ArgumentError, CouchbaseError, ViewEngineError
 from couchbase.views.params import Query, UNSPEC, make_dvpath
-from couchbase._pyport import ulp
+from couchbase._pyport import ulp, basestring, long
 import couchbase._libcouchbase as C
 
 
@@ -84,7 +83,7 @@ class RowProcessor(object):
         self._docs = None
         self.rowclass = rowclass
 
-    def handle_rows(self, rows, connection, include_docs):
+    def handle_rows(self, rows, connection, include_docs, docs=None):
         """
         Preprocesses a page of rows.
 
@@ -95,6 +94,10 @@ class RowProcessor(object):
         :param include_docs: Whether to include documents in the return value.
             This is ``True`` or ``False`` depending on what was passed to the
             :class:`View` constructor
+        :param docs: If the :class:`View` was created with ``pipeline_docs``,
+            a :class:`~couchbase.result.MultiResult` containing the documents
+            for the rows in this page, which have already been fetched.
+            This is ``None`` otherwise.
 
         :return: an iterable. When the iterable is exhausted, this method will
             be called again with a new 'page'.
@@ -104,6 +107,10 @@ class RowProcessor(object):
         if not include_docs:
             return iter(self)
 
+        if docs is not None:
+            self._docs = docs
+            return iter(self)
+
         keys = tuple(x['id'] for x in rows)
         self._docs = connection.get_multi(keys, quiet=True)
         return iter(self)
@@ -122,8 +129,9 @@ class RowProcessor(object):
                     warn("Error encountered when executing view. "
                          "Inspect 'errors' for more information")
 
-            yield self.rowclass(ret['key'],
-                                ret['value'],
+            # Use get, because a projected row may lack these fields
+            yield self.rowclass(ret.get('key'),
+                                ret.get('value'),
                                 # Use get, because reduce values don't have
                                 # IDs
                                 ret.get('id'),
@@ -142,6 +150,10 @@ class View(object):
                  streaming=0,
                  include_docs=False,
                  query=None,
+                 fields=None,
+                 pipeline_docs=False,
+                 page_rows=None,
+                 page_bytes=None,
                  **params):
         """
         Construct a iterable which can be used to iterate over view query
@@ -175,6 +187,52 @@ class View(object):
             object. It is illegal to use this in conjunction with
             additional ``params``
 
+        :param fields: If set, a list of the row fields to extract, as
+            ``/``-separated paths within each row (e.g. ``"id"``, or
+            ``"value/price"``). Each path is a JSON pointer relative to the
+            row; the leading ``/`` may be omitted. Rows then only contain the
+            requested fields, and the rest of each row is skipped over
+            without being decoded. Missing fields are reported as ``None``.
+            A numeric path component selects a list element, which keeps
+            its position: the elements before it are replaced by ``None``
+            (so ``"key/1"`` gives a ``key`` of ``[None, key[1]]``).
+
+            Rows are projected by the streaming parser, so setting this
+            implies :attr:`streaming`. If ``include_docs`` is set, ``id`` is
+            always extracted.
+
+        :param bool pipeline_docs: Fetch the document for each row as soon as
+            the row is received, while the rest of the view is still being
+            read. This overlaps the document fetches with the view
+            response, rather than fetching each page's documents once the
+            page is complete. This implies ``include_docs`` and
+            :attr:`streaming`.
+
+            The documents for each page are passed to the
+            :attr:`row_processor`'s ``handle_rows`` method in its ``docs``
+            argument.
+
+        :param int page_rows: With :attr:`streaming`, the maximum number of
+            rows passed to the :attr:`row_processor` at a time.
+        :param int page_bytes: With :attr:`streaming`, the maximum encoded
+            size of the rows passed to the :attr:`row_processor` at a time.
+            A page always contains at least one row.
+
+            Once a page's worth of rows has been received, reading from the
+            network is paused until the page has been handed to the row
+            processor. This bounds the memory used by rows which have been
+            received but not yet consumed.
+
+            Other operations on the same connection (including fetching the
+            documents for ``include_docs``) still read from the network, so
+            more rows may arrive in the meantime. If more than 16 pages are
+            buffered this way, the rest of the query is discarded and
+            iteration raises
+            :exc:`~couchbase.exceptions.ClientNoMemoryError`. Rows received
+            before iteration begins (as with
+            :class:`~couchbase.views.parallel.ParallelView`) are not counted
+            towards this.
+
         :param params: Extra view options. This may be used to pass view
             arguments (as defined in :class:`~couchbase.views.params.Query`)
             without explicitly constructing a
@@ -227,6 +285,11 @@ class View(object):
                         query=q.update(debug=True, copy=True))
 
 
+        Only extract document IDs::
+
+            view = View(c, "beer", "brewery_beers", fields=["id"])
+            keys = [result.docid for result in view]
+
         Include documents with query::
 
             view = View(c, "beer", "brewery_beer",
@@ -244,7 +307,12 @@ class View(object):
         self.raw = None
         self.rows_returned = 0
 
+        if pipeline_docs:
+            include_docs = True
+            streaming = True
+
         self.include_docs = include_docs
+        self.pipeline_docs = pipeline_docs
         self.indexed_rows = 0
 
         if not row_processor:
@@ -273,10 +341,51 @@ class View(object):
                                           "was specified",
                                           self._query)
 
+        self._fields = None
+        if fields is not None:
+            self._fields = self._normalize_fields(fields, include_docs)
+            streaming = True
+
+        for name, value in (('page_rows', page_rows),
+                            ('page_bytes', page_bytes)):
+            if value is not None and (not isinstance(value, (int, long)) or
+                                      value < 1):
+                raise ArgumentError.pyexc(
+                    "{0} must be a positive integer".format(name), value)
+
+        self._page_rows = page_rows or 0
+        self._page_bytes = page_bytes or 0
+
         # The original 'limit' parameter, passed to the query.
         self._streaming = streaming
         self._do_iter = True
 
+    @staticmethod
+    def _normalize_fields(fields, include_docs):
+        if isinstance(fields, basestring):
+            fields = [fields]
+
+        ret = []
+        for field in fields:
+            if not isinstance(field, basestring):
+                raise ArgumentError.pyexc("Field must be a string", field)
+            if not field.startswith('/'):
+                field = '/' + field
+            ret.append(field)
+
+        if include_docs and '/id' not in ret:
+            ret.append('/id')
+
+        return tuple(ret)
+
+    @property
+    def fields(self):
+        """
+        Read-Only. The row fields being extracted (as JSON pointers), or
+        ``None`` if rows are returned in full.
+        """
+        return self._fields
+
     @property
     def streaming(self):
         """
@@ -309,15 +418,21 @@ class View(object):
             warn("Error encountered when executing view. Inspect 'errors' "
                  "for more information")
 
-    def _process_page(self, rows):
+    def _process_page(self, rows, docs=None):
         if not rows:
             return
 
         self.rows_returned += len(rows)
 
-        self._rp_iter = self.row_processor.handle_rows(rows,
-                                                       self._parent,
-                                                       self.include_docs)
+        if docs is not None:
+            self._rp_iter = self.row_processor.handle_rows(rows,
+                                                           self._parent,
+                                                           self.include_docs,
+                                                           docs=docs)
+        else:
+            self._rp_iter = self.row_processor.handle_rows(rows,
+                                                           self._parent,
+                                                           self.include_docs)
 
         # Raise exceptions early on
         self._rp_iter = iter(self._rp_iter)
@@ -331,6 +446,29 @@ class View(object):
         self.indexed_rows = value.get('total_rows', 0)
         self._handle_errors(value.get('errors'))
 
+    def _start(self, **kwargs):
+        """
+        Schedule the streaming request. The request is sent (and rows are
+        buffered) whenever the connection's event loop next runs.
+        ``kwargs`` override the arguments to ``_http_request``
+        """
+        params = {
+            'method': C.LCB_HTTP_METHOD_GET,
+            'type': C.LCB_HTTP_TYPE_VIEW,
+            'chunked': True,
+            'path': ('{0}{1}'
+                     ).format(make_dvpath(self.design, self.view),
+                              self._query.encoded),
+            'fetch_headers': True,
+            'quiet': False,
+            'fields': self._fields,
+            'fetch_docs': self.pipeline_docs,
+            'max_rows': self._page_rows,
+            'max_bytes': self._page_bytes
+        }
+        params.update(kwargs)
+        self.raw = self._parent._http_request(**params)
+
     def _get_page(self):
         if not self._streaming:
             self._handle_single_view()
@@ -338,17 +476,7 @@ class View(object):
             return
 
         if not self.raw:
-            params = {
-                'method': C.LCB_HTTP_METHOD_GET,
-                'type': C.LCB_HTTP_TYPE_VIEW,
-                'chunked': True,
-                'path': ('{0}{1}'
-                         ).format(make_dvpath(self.design, self.view),
-                                  self._query.encoded),
-                'fetch_headers': True,
-                'quiet': False
-            }
-            self.raw = self._parent._http_request(**params)
+            self._start()
 
         # Fetch the rows:
         rows = self.raw._fetch()
@@ -358,8 +486,139 @@ class View(object):
             self._do_iter = False
             return
 
-        rows = tuple(json.loads(r) for r in rows)
-        self._process_page(rows)
+        self._process_page(rows, self.raw._docs)
+
+    def export(self, dest, fields=None):
+        """
+        Write the rows of the view to a file as newline-delimited JSON,
+        with one row (as a JSON object) on each line.
+
+        Rows are written by the streaming parser as they are received,
+        without being decoded into Python objects, so this is considerably
+        faster than iterating over the view for large result sets.
+
+        :param dest: The destination. This may be a path, which is created
+            or truncated, a file descriptor, or an object with a ``write``
+            method (such as a file opened in binary mode). Rows are written
+            to a ``write`` method in large blocks, as ``bytes``.
+        :param fields: The row fields to write, as for the ``fields``
+            argument to the constructor. Only the matching parts of each row
+            are written, keeping the row's structure. This defaults to the
+            view's :attr:`fields`; if neither is set, rows are written in
+            full.
+
+        :return: The number of rows written.
+
+        :raise: :exc:`~couchbase.exceptions.ArgumentError` if
+            ``include_docs`` is set, as documents are not exported.
+        :raise: :exc:`AlreadyQueriedError` if this object was already
+            iterated over or exported.
+
+        Export the IDs and keys of all rows::
+
+            nrows = View(c, "beer", "brewery_beers").export(
+                "/tmp/beers.json", fields=["id", "key"])
+        """
+        if not self._do_iter:
+            raise AlreadyQueriedError.pyexc(
+                "This object has already been executed. Create a new one to "
+                "query again")
+
+        if self.include_docs:
+            raise ArgumentError.pyexc("Documents cannot be exported")
+
+        if fields is not None:
+            fields = self._normalize_fields(fields, False)
+        else:
+            fields = self._fields
+
+        fp = None
+        if isinstance(dest, basestring):
+            fp = open(dest, 'wb')
+            dest = fp.fileno()
+
+        self._do_iter = False
+
+        try:
+            self._start(fields=fields, sink=dest, max_rows=0, max_bytes=0)
+            self.raw._fetch()
+        except:
+            # Cancel the request, so that nothing more is written to the
+            # destination (whose descriptor may be reused once closed)
+            self.raw = None
+            raise
+        finally:
+            if fp:
+                fp.close()
+
+        self.rows_returned = self.raw._sink_rows
+        self._handle_meta(self.raw.value)
+        return self.rows_returned
+
+    def aggregate(self, path=None, bounds=None):
+        """
+        Compute aggregates over the rows of the view as they are received,
+        without decoding them into Python objects.
+
+        This is useful for ranges too large for a ``reduce`` function,
+        e.g. when querying with ``reduce=False``.
+
+        :param string path: A ``/``-separated path within each row (e.g.
+            ``"value"`` or ``"value/price"``) to a number to aggregate, as
+            for the ``fields`` argument to the constructor. If a wildcard
+            (``^``) is used, the first matching number in each row is used.
+            Rows without a number at the path are only counted. If not set,
+            the rows are only counted.
+        :param bounds: A sequence of histogram bucket boundaries, in
+            ascending order. If set, the returned histogram has a count of
+            the values falling below the first boundary, one for the values
+            between each pair of adjacent boundaries (including the lower
+            boundary), and one for the values at or above the last boundary.
+
+        :return: A dict with the following keys:
+
+            * ``count``: The number of rows
+            * ``values``: The number of rows with a number at ``path``
+            * ``sum``, ``min``, ``max``: The sum, minimum and maximum of the
+              numbers found (as floats); the minimum and maximum are
+              ``None`` if there are none
+            * ``histogram``: A list of ``len(bounds) + 1`` counts, or
+              ``None`` if ``bounds`` was not given
+
+        :raise: :exc:`~couchbase.exceptions.ArgumentError` if
+            ``include_docs`` is set
+        :raise: :exc:`AlreadyQueriedError` if this object was already
+            iterated over.
+
+        Total the value emitted for a range of keys::
+
+            view = View(c, "beer", "by_abv", reduce=False,
+                        mapkey_range=[5, 10])
+            stats = view.aggregate("value", bounds=[6, 7, 8, 9])
+            print(stats['sum'] / stats['values'])
+        """
+        if not self._do_iter:
+            raise AlreadyQueriedError.pyexc(
+                "This object has already been executed. Create a new one to "
+                "query again")
+
+        if self.include_docs:
+            raise ArgumentError.pyexc("Documents cannot be aggregated")
+
+        if path is not None:
+            path = self._normalize_fields(path, False)[0]
+        else:
+            path = ''
+
+        self._do_iter = False
+        self._start(aggregate=path, bounds=bounds, fields=None,
+                    max_rows=0, max_bytes=0)
+        self.raw._fetch()
+
+        ret = self.raw._aggregates
+        self.rows_returned = ret['count']
+        self._handle_meta(self.raw.value)
+        return ret
 
     def __iter__(self):
         """
@@ -0,0 +1,227 @@
+#
+# Copyright 2013, Couchbase, Inc.
+# All Rights Reserved
+#
+# Licensed under the Apache License, Version 2.0 (the "License")
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#
+
+from copy import deepcopy
+
+from couchbase.exceptions import ArgumentError
+from couchbase.views.params import Query, UNSPEC
+from couchbase.views.iterator import View, RowProcessor, AlreadyQueriedError
+from couchbase._pyport import long
+
+
+class _KeysetTracker(object):
+    """
+    Wraps the user's row processor, recording the position of the last raw
+    row received for a page.
+    """
+    def __init__(self, paginator, row_processor):
+        self.paginator = paginator
+        self.row_processor = row_processor
+
+    def handle_rows(self, rows, *args, **kwargs):
+        self.paginator._track_rows(rows)
+        return self.row_processor.handle_rows(rows, *args, **kwargs)
+
+
+class Paginator(object):
+    def __init__(self,
+                 parent,
+                 design,
+                 view,
+                 page_size,
+                 query=None,
+                 row_processor=None,
+                 include_docs=False,
+                 prefetch=True,
+                 resume=None,
+                 **params):
+        """
+        Construct an iterable which returns the results of a view one page
+        at a time.
+
+        Rather than using ``skip`` (which requires the server to read and
+        discard every row before the page), each page is requested starting
+        at the key and document ID of the last row of the previous page,
+        using ``startkey``, ``startkey_docid`` and a ``skip`` of 1. The cost
+        of fetching a page is therefore the same no matter how deep it is.
+
+        :param parent: The parent Connection object
+        :type parent: :class:`~couchbase.connection.Connection`
+        :param string design: The design document
+        :param string view: The name of the view within the design document
+        :param int page_size: The number of rows in each page
+        :param query: A :class:`~couchbase.views.params.Query` object. As
+            with :class:`~couchbase.views.iterator.View`, this may not be
+            used together with additional ``params``. Any ``startkey``,
+            ``endkey`` or ``mapkey_range`` in the query limits the rows
+            which are paged through.
+        :param row_processor: See
+            :attr:`~couchbase.views.iterator.View.row_processor`
+        :param bool include_docs: Fetch the document for each row
+        :param bool prefetch: Request the next page as soon as the last row
+            of the current one has been received, rather than when the next
+            page is asked for. The server then computes the next page while
+            the current one is consumed. Its response is read (and buffered)
+            whenever the connection's event loop runs: while the current
+            page's documents are fetched, or during any other operation
+            performed before the next page is asked for. The request is
+            cancelled if iteration stops early.
+        :param tuple resume: A ``(key, docid)`` tuple, as returned by
+            :attr:`position`, identifying the last row already seen. Paging
+            starts with the row after it.
+
+        :raise: :exc:`~couchbase.exceptions.ArgumentError` if the query uses
+            ``skip``, ``limit``, ``key`` or ``keys``, or if it reduces its
+            results, as such rows have no document ID to page by.
+
+        Each row must be uniquely identified by its key and document ID; if
+        a document emits the same key more than once, some of those rows
+        may be skipped.
+
+        Page through a view, 100 rows at a time::
+
+            for page in Paginator(c, "beer", "brewery_beers", 100):
+                for row in page:
+                    print(row.docid)
+        """
+
+        if not isinstance(page_size, (int, long)) or page_size < 1:
+            raise ArgumentError.pyexc("page_size must be a positive integer",
+                                      page_size)
+
+        if query and params:
+            raise ArgumentError.pyexc(
+                "Extra parameters are mutually exclusive with the "
+                "'query' argument. Use query.update() to add extra arguments")
+
+        if query:
+            query = deepcopy(query)
+        else:
+            query = Query.from_any(params)
+
+        for name in ('skip', 'limit', 'mapkey_single', 'mapkey_multi',
+                     'reduce', 'group', 'group_level'):
+            if getattr(query, name):
+                raise ArgumentError.pyexc(
+                    "'{0}' cannot be used with a paginated query"
+                    .format(name), query)
+
+        if query.mapkey_range:
+            start, end = query.mapkey_range
+            query.mapkey_range = UNSPEC
+            query.startkey = start
+            query.endkey = end
+
+        query.limit = page_size
+
+        if not row_processor:
+            row_processor = RowProcessor()
+
+        self._parent = parent
+        self.design = design
+        self.view = view
+        self.page_size = page_size
+        self.include_docs = include_docs
+        self.prefetch = prefetch
+        self.pages_returned = 0
+        self._query = query
+        self._tracker = _KeysetTracker(self, row_processor)
+        self._position = resume
+        self._nrows = 0
+        self._next = None
+        self._do_iter = True
+
+    @property
+    def position(self):
+        """
+        Read-Only. A ``(key, docid)`` tuple for the last row received, or
+        ``None`` if no rows have been received. This may be passed as the
+        ``resume`` argument to continue paging from the same place later.
+        """
+        return self._position
+
+    def _make_view(self):
+        q = deepcopy(self._query)
+        if self._position:
+            q.startkey, q.startkey_docid = self._position
+            q.skip = 1
+
+        return View(self._parent, self.design, self.view,
+                    row_processor=self._tracker,
+                    include_docs=self.include_docs,
+                    streaming=True,
+                    query=q)
+
+    def _track_rows(self, rows):
+        if not rows:
+            return
+
+        last = rows[-1]
+        self._position = (last['key'], last['id'])
+        self._nrows += len(rows)
+
+        if self.prefetch and self._nrows == self.page_size and not self._next:
+            # This was the last row of the page. The rows are tracked before
+            # the row processor runs, so the request is already under way
+            # while it fetches any documents
+            self._next = self._make_view()
+            self._next._start()
+
+    def __iter__(self):
+        """
+        Returns each page in turn, as a list of the rows returned by the
+        row processor. Iteration stops after the first page which is not
+        full.
+
+        :raise: :exc:`~couchbase.views.iterator.AlreadyQueriedError`
+            If this object was already iterated over.
+        """
+        if not self._do_iter:
+            raise AlreadyQueriedError.pyexc(
+                "This object has already been executed. Create a new one to "
+                "query again")
+        self._do_iter = False
+
+        cur = self._make_view()
+
+        try:
+            while cur:
+                self._nrows = 0
+                page = list(cur)
+
+                if self._nrows != self.page_size:
+                    cur = None
+                elif self._next:
+                    cur, self._next = self._next, None
+                else:
+                    cur = self._make_view()
+
+                if page:
+                    self.pages_returned += 1
+                    yield page
+        finally:
+            # Cancel a prefetched request which was not consumed
+            self._next = None
+
+    def __repr__(self):
+        details = []
+        details.append("Design={0}".format(self.design))
+        details.append("View={0}".format(self.view))
+        details.append("Page Size={0}".format(self.page_size))
+        details.append("Position={0}".format(self._position))
+        return '{cls}<{details}>'.format(cls=self.__class__.__name__,
+                                         details=', '.join(details))
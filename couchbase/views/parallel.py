@@ -0,0 +1,350 @@
+#
+# Copyright 2013, Couchbase, Inc.
+# All Rights Reserved
+#
+# Licensed under the Apache License, Version 2.0 (the "License")
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#
+
+import os
+import tempfile
+from copy import deepcopy
+
+from couchbase.exceptions import ArgumentError
+from couchbase.views.params import Query, UNSPEC
+from couchbase.views.iterator import View, AlreadyQueriedError
+from couchbase._pyport import basestring, long
+
+
+class ParallelView(object):
+    def __init__(self,
+                 parent,
+                 design,
+                 view,
+                 splits,
+                 query=None,
+                 row_processor=None,
+                 include_docs=False,
+                 fields=None,
+                 pipeline_docs=False,
+                 page_rows=None,
+                 page_bytes=None,
+                 **params):
+        """
+        Construct an iterable which queries a key range of a view as several
+        concurrent streaming requests.
+
+        The range given by the query's ``startkey`` and ``endkey`` (or its
+        ``mapkey_range``) is divided at each of the keys in ``splits``, and
+        each of the resulting sub-ranges is queried with its own streaming
+        :class:`~couchbase.views.iterator.View`. All of the requests are
+        sent at once and are read by the same event loop, so rows for the
+        later sub-ranges are received (and buffered) while the earlier ones
+        are being iterated over.
+
+        Since the sub-ranges are disjoint and ordered, rows are returned in
+        the same order as a single query over the whole range would return
+        them.
+
+        :param parent: The parent Connection object
+        :type parent: :class:`~couchbase.connection.Connection`
+        :param string design: The design document
+        :param string view: The name of the view within the design document
+        :param list splits: The keys at which to divide the range. These
+            must be in the order in which the view returns them (i.e.
+            ascending, or descending if
+            :attr:`~couchbase.views.params.Query.descending` is set), and
+            must lie within the queried range. A split key belongs to the
+            sub-range which it begins. See :meth:`split_range`.
+
+        :param query: A :class:`~couchbase.views.params.Query` object. As
+            with :class:`~couchbase.views.iterator.View`, this may not be
+            used together with additional ``params``
+
+        The ``row_processor``, ``include_docs``, ``fields``,
+        ``pipeline_docs``, ``page_rows`` and ``page_bytes`` arguments are
+        passed to each :class:`~couchbase.views.iterator.View`.
+
+        :raise: :exc:`~couchbase.exceptions.ArgumentError` if the query uses
+            ``skip``, ``key`` or ``keys``, or if it reduces its results, as
+            these cannot be divided into sub-ranges.
+
+        Note that ``page_rows`` and ``page_bytes`` only bound the rows
+        buffered for the sub-range currently being iterated over; the others
+        are buffered in full until their turn comes, however many rows they
+        hold. :meth:`export` does not buffer rows in memory.
+
+        Export an entire view using four concurrent requests::
+
+            splits = [["f"], ["m"], ["s"]]
+            for row in ParallelView(c, "beer", "brewery_beers", splits,
+                                    fields=["id"]):
+                print(row.docid)
+        """
+
+        if query and params:
+            raise ArgumentError.pyexc(
+                "Extra parameters are mutually exclusive with the "
+                "'query' argument. Use query.update() to add extra arguments")
+
+        if query:
+            query = deepcopy(query)
+        else:
+            query = Query.from_any(params)
+
+        for name in ('skip', 'mapkey_single', 'mapkey_multi',
+                     'reduce', 'group', 'group_level'):
+            if getattr(query, name):
+                raise ArgumentError.pyexc(
+                    "'{0}' cannot be used with a parallel query".format(name),
+                    query)
+
+        if not splits:
+            raise ArgumentError.pyexc("At least one split key is required",
+                                      splits)
+
+        self._parent = parent
+        self.design = design
+        self.view = view
+        self.errors = []
+        self.rows_returned = 0
+        self.indexed_rows = 0
+        self._limit = query.limit or 0
+
+        view_args = {
+            'row_processor': row_processor,
+            'include_docs': include_docs,
+            'fields': fields,
+            'pipeline_docs': pipeline_docs,
+            'page_rows': page_rows,
+            'page_bytes': page_bytes
+        }
+
+        self._views = [View(parent, design, view, streaming=True, query=q,
+                            **view_args)
+                       for q in self._make_queries(query, list(splits))]
+        self._do_iter = True
+
+    @staticmethod
+    def _make_queries(query, splits):
+        if query.mapkey_range:
+            start, end = query.mapkey_range
+            query.mapkey_range = UNSPEC
+        else:
+            start, end = query.startkey, query.endkey
+
+        bounds = [start] + splits + [end]
+        nparts = len(bounds) - 1
+        ret = []
+
+        for ix in range(nparts):
+            q = deepcopy(query)
+            q.startkey = bounds[ix]
+            q.endkey = bounds[ix + 1]
+
+            if ix:
+                q.startkey_docid = UNSPEC
+
+            if ix != nparts - 1:
+                # The split key is the first key of the next sub-range
+                q.inclusive_end = False
+                q.endkey_docid = UNSPEC
+
+            ret.append(q)
+
+        return ret
+
+    @staticmethod
+    def split_range(start, end, nparts):
+        """
+        Divide a numeric key range into ``nparts`` sub-ranges of equal width.
+
+        :param start: The first key of the range
+        :param end: The last key of the range
+        :param int nparts: The number of sub-ranges
+        :return: A list of ``nparts - 1`` split keys, suitable for passing
+            as the ``splits`` argument. If both ``start`` and ``end`` are
+            integers, so are the split keys.
+        """
+        if not isinstance(nparts, (int, long)) or nparts < 1:
+            raise ArgumentError.pyexc("nparts must be a positive integer",
+                                      nparts)
+
+        width = end - start
+        ret = []
+        for ix in range(1, nparts):
+            if isinstance(width, (int, long)):
+                ret.append(start + width * ix // nparts)
+            else:
+                ret.append(start + width * ix / nparts)
+        return ret
+
+    @property
+    def views(self):
+        """
+        Read-Only. The :class:`~couchbase.views.iterator.View` objects for
+        each sub-range, in order.
+        """
+        return tuple(self._views)
+
+    @staticmethod
+    def _write(dest, data):
+        if not isinstance(dest, (int, long)):
+            dest.write(data)
+            return
+
+        while data:
+            data = data[os.write(dest, data):]
+
+    def _copy(self, src, dest, nrows):
+        src.seek(0)
+
+        if not self._limit:
+            while True:
+                data = src.read(65536)
+                if not data:
+                    break
+                self._write(dest, data)
+            self.rows_returned += nrows
+            return
+
+        for line in src:
+            if self.rows_returned == self._limit:
+                return
+            self._write(dest, line)
+            self.rows_returned += 1
+
+    def export(self, dest, fields=None):
+        """
+        Write the rows of every sub-range to a file as newline-delimited
+        JSON, in order, as :meth:`~couchbase.views.iterator.View.export`
+        does for a single view.
+
+        All of the requests run at once. The rows of the first sub-range are
+        written to ``dest`` as they are received. Those of the later
+        sub-ranges are written to temporary files as they are received, and
+        copied to ``dest`` once the sub-ranges before them are complete. The
+        memory used therefore does not depend on the number of rows.
+
+        :param dest: The destination; a path, a file descriptor or an object
+            with a ``write`` method
+        :param fields: The row fields to write. This defaults to the
+            ``fields`` passed to the constructor
+
+        :return: The number of rows written.
+
+        :raise: :exc:`~couchbase.exceptions.ArgumentError` if
+            ``include_docs`` is set
+        :raise: :exc:`~couchbase.views.iterator.AlreadyQueriedError`
+            If this object was already iterated over or exported.
+        """
+        if not self._do_iter:
+            raise AlreadyQueriedError.pyexc(
+                "This object has already been executed. Create a new one to "
+                "query again")
+
+        if self._views[0].include_docs:
+            raise ArgumentError.pyexc("Documents cannot be exported")
+
+        if fields is not None:
+            fields = View._normalize_fields(fields, False)
+        else:
+            fields = self._views[0].fields
+
+        self._do_iter = False
+        fp = None
+        spools = []
+
+        try:
+            if isinstance(dest, basestring):
+                fp = open(dest, 'wb')
+                dest = fp.fileno()
+
+            for ix, v in enumerate(self._views):
+                sink = dest
+                if ix:
+                    spools.append(tempfile.TemporaryFile())
+                    sink = spools[-1].fileno()
+
+                v._do_iter = False
+                v._start(fields=fields, sink=sink, max_rows=0, max_bytes=0)
+
+            for ix, v in enumerate(self._views):
+                v.raw._fetch()
+                v.rows_returned = v.raw._sink_rows
+                v._handle_meta(v.raw.value)
+                self.errors += v.errors
+                self.indexed_rows = v.indexed_rows
+
+                if ix:
+                    self._copy(spools[ix - 1], dest, v.rows_returned)
+                else:
+                    self.rows_returned = v.rows_returned
+
+                if self._limit and self.rows_returned == self._limit:
+                    break
+
+            return self.rows_returned
+
+        finally:
+            # Cancel the requests before their destinations are closed
+            for v in self._views:
+                v.raw = None
+            for spool in spools:
+                spool.close()
+            if fp:
+                fp.close()
+
+    def __iter__(self):
+        """
+        Returns each row from each sub-range in turn.
+
+        :raise: Any exception raised by iterating over a
+            :class:`~couchbase.views.iterator.View`
+        :raise: :exc:`~couchbase.views.iterator.AlreadyQueriedError`
+            If this object was already iterated over.
+        """
+        if not self._do_iter:
+            raise AlreadyQueriedError.pyexc(
+                "This object has already been executed. Create a new one to "
+                "query again")
+        self._do_iter = False
+
+        for v in self._views:
+            v._start()
+
+        try:
+            for v in self._views:
+                for row in v:
+                    self.rows_returned += 1
+                    yield row
+                    if self._limit and self.rows_returned == self._limit:
+                        return
+
+                self.errors += v.errors
+                self.indexed_rows = v.indexed_rows
+        finally:
+            # Cancel any requests which are still in progress. A view may
+            # still be streaming after it stopped iterating (e.g. if it
+            # raised), so every request is dropped, including those which
+            # have already completed
+            for v in self._views:
+                v.raw = None
+
+    def __repr__(self):
+        details = []
+        details.append("Design={0}".format(self.design))
+        details.append("View={0}".format(self.view))
+        details.append("Partitions={0}".format(len(self._views)))
+        details.append("Rows Fetched={0}".format(self.rows_returned))
+        return '{cls}<{details}>'.format(cls=self.__class__.__name__,
+                                         details=', '.join(details))
@@ -1,3 +1,4 @@
+#!/usr/bin/env python
 #
 # Copyright 2013, Couchbase, Inc.
 # All Rights Reserved
@@ -15,103 +16,542 @@
 # limitations under the License.
 #
 
-#!/usr/bin/env python
+"""
+Throughput and latency benchmarks for the client.
+
+Each operation is run for every combination of the swept parameters (given
+as comma-separated lists), and the throughput and latency percentiles of
+each combination are written out as JSON. For example, to compare the JSON
+and bytes formats for get and set at a few batch sizes:
+
+    python bench.py -O get,set -f json,bytes -B 1,10,100 -o results.json
+
+A previous run's results may be given with --baseline, in which case any
+combination whose throughput or 99th percentile latency is worse by more
+than --threshold percent is reported, and the exit status is 1.
+
+With --mock, the benchmarks run against a mock server (see
+couchbase.mockserver) in a separate process, so that the client can be
+measured without a cluster.
+"""
+
 import argparse
+import itertools
+import json
+import math
+import subprocess
+import sys
+import time
 from threading import Thread
-from time import sleep, time
-from couchbase.connection import Connection, FMT_BYTES
+
+import couchbase
+from couchbase import (FMT_JSON, FMT_BYTES, FMT_UTF8, FMT_PICKLE,
+                       LOCKMODE_NONE, LOCKMODE_EXC, LOCKMODE_WAIT)
+from couchbase.connection import Connection
+from couchbase.exceptions import CouchbaseError
 from couchbase.transcoder import Transcoder
 
-ap = argparse.ArgumentParser()
+timer = getattr(time, 'perf_counter', time.time)
+
+OPERATIONS = ('get', 'set', 'add', 'replace', 'delete', 'incr', 'touch',
+              'lock', 'observe', 'view')
+
+FORMATS = ('bytes', 'utf8', 'json', 'pickle', 'transcoder')
+
+LOCKMODES = {
+    'none': LOCKMODE_NONE,
+    'exc': LOCKMODE_EXC,
+    'wait': LOCKMODE_WAIT
+}
+
+PERCENTILES = (50, 90, 99, 99.9)
+
+DESIGN = 'pycbc_bench'
+VIEW = 'all'
 
-ap.add_argument('-t', '--threads', default=4, type=int,
-                help="Number of threads to spawn. 0 means no threads "
-                "but workload will still run in the main thread")
 
-ap.add_argument('-d', '--delay', default=0, type=float,
-                help="Number of seconds to wait between each op. "
-                "may be a fraction")
+def listof(conv, choices=None):
+    def parse(s):
+        ret = [conv(x.strip()) for x in s.split(',') if x.strip()]
+        for x in ret:
+            if choices and x not in choices:
+                raise argparse.ArgumentTypeError(
+                    "{0!r} is not one of {1}".format(x, ', '.join(choices)))
+        return ret
+    return parse
+
+
+ap = argparse.ArgumentParser(
+    description="Measure operation throughput and latency")
+
+ap.add_argument('-O', '--ops', default=list(OPERATIONS),
+                type=listof(str, OPERATIONS),
+                help="Operations to run. Default is all of " +
+                ','.join(OPERATIONS))
+ap.add_argument('-B', '--batch', default=[1], type=listof(int),
+                help="Number of keys per call. For views, the number of "
+                "rows per query. A batch of 1 uses the single-key methods")
+ap.add_argument('--ksize', default=[12], type=listof(int),
+                help="Key sizes")
+ap.add_argument('--vsize', default=[128], type=listof(int),
+                help="Value sizes")
+ap.add_argument('-f', '--format', default=['bytes'],
+                type=listof(str, FORMATS),
+                help="Value formats, from " + ','.join(FORMATS))
+ap.add_argument('-G', '--unlock-gil', default=[1], type=listof(int),
+                help="Values of unlock_gil (0 or 1)")
+ap.add_argument('-L', '--lockmode', default=['exc'],
+                type=listof(str, sorted(LOCKMODES)),
+                help="Lock modes, from " + ','.join(sorted(LOCKMODES)))
+
+ap.add_argument('-t', '--threads', default=4, type=int,
+                help="Number of threads to spawn, each with its own "
+                "connection. 0 means no threads but workload will still run "
+                "in the main thread")
+ap.add_argument('-D', '--duration', default=5, type=float,
+                help="Duration of each combination (in seconds)")
+ap.add_argument('-W', '--warmup', default=1, type=float,
+                help="Seconds to run each combination before measuring")
 
 ap.add_argument('-u', '--username', default='Administrator', type=str)
 ap.add_argument('-b', '--bucket', default='default', type=str)
-ap.add_argument('-p', '--password', default="123456", type=str)
+ap.add_argument('-p', '--password', default=None, type=str,
+                help="Bucket password")
 ap.add_argument('-H', '--hostname', default='localhost', type=str)
-ap.add_argument('-D', '--duration', default=10, type=int,
-                help="Duration of run (in seconds)")
-ap.add_argument('-T', '--transcoder', default=False,
-                action='store_true',
-                help="Use the Transcoder object rather than built-in "
-                "conversion routines")
+ap.add_argument('-P', '--port', default=8091, type=int)
+
+ap.add_argument('--mock', default=False, action='store_true',
+                help="Run against a mock server rather than a cluster")
+ap.add_argument('--mock-latency', default=0, type=float,
+                help="Seconds the mock server waits before each response")
+
+ap.add_argument('-o', '--output', default=None,
+                help="File to write the results to. Default is standard "
+                "output")
+ap.add_argument('--baseline', default=None,
+                help="Results of a previous run to compare against")
+ap.add_argument('--threshold', default=10, type=float,
+                help="Percentage by which a combination may be worse than "
+                "the baseline before it is reported")
+
+
+class Operation(object):
+    """
+    A benchmarked operation. Each worker creates one, calls :meth:`setup`
+    once, and then repeatedly calls :meth:`prepare`, :meth:`run` and
+    :meth:`cleanup`. Only :meth:`run` is timed.
+    """
+    def __init__(self, cb, keys, value, fmt):
+        self.cb = cb
+        self.keys = keys
+        self.key = keys[0]
+        self.single = len(keys) == 1
+        self.value = value
+        self.fmt = fmt
+
+    def store(self):
+        self.cb.set_multi(dict((k, self.value) for k in self.keys),
+                          format=self.fmt)
+
+    def setup(self):
+        self.store()
+
+    def prepare(self):
+        pass
+
+    def run(self):
+        """
+        :return: The result of the operation
+        """
+        raise NotImplementedError()
+
+    def count(self, rv):
+        """
+        :return: The number of items processed by :meth:`run`
+        """
+        return len(self.keys)
+
+    def cleanup(self, rv):
+        pass
+
+
+class GetOperation(Operation):
+    def run(self):
+        if self.single:
+            return self.cb.get(self.key)
+        return self.cb.get_multi(self.keys)
+
+
+class SetOperation(Operation):
+    def setup(self):
+        self.kv = dict((k, self.value) for k in self.keys)
+
+    def run(self):
+        if self.single:
+            return self.cb.set(self.key, self.value, format=self.fmt)
+        return self.cb.set_multi(self.kv, format=self.fmt)
+
+
+class AddOperation(SetOperation):
+    def prepare(self):
+        self.cb.delete_multi(self.keys, quiet=True)
+
+    def run(self):
+        if self.single:
+            return self.cb.add(self.key, self.value, format=self.fmt)
+        return self.cb.add_multi(self.kv, format=self.fmt)
+
+
+class ReplaceOperation(SetOperation):
+    def setup(self):
+        SetOperation.setup(self)
+        self.store()
+
+    def run(self):
+        if self.single:
+            return self.cb.replace(self.key, self.value, format=self.fmt)
+        return self.cb.replace_multi(self.kv, format=self.fmt)
+
+
+class DeleteOperation(Operation):
+    def prepare(self):
+        self.store()
+
+    def run(self):
+        if self.single:
+            return self.cb.delete(self.key)
+        return self.cb.delete_multi(self.keys)
+
+
+class IncrOperation(Operation):
+    def setup(self):
+        self.cb.delete_multi(self.keys, quiet=True)
+
+    def run(self):
+        if self.single:
+            return self.cb.incr(self.key, initial=0)
+        return self.cb.incr_multi(self.keys, initial=0)
+
+
+class TouchOperation(Operation):
+    def run(self):
+        if self.single:
+            return self.cb.touch(self.key, ttl=0)
+        return self.cb.touch_multi(self.keys, ttl=0)
+
+
+class LockOperation(Operation):
+    def run(self):
+        if self.single:
+            return self.cb.lock(self.key, ttl=15)
+        return self.cb.lock_multi(self.keys, ttl=15)
+
+    def cleanup(self, rv):
+        if rv is None:
+            return
+        if self.single:
+            self.cb.unlock(self.key, rv.cas)
+        else:
+            self.cb.unlock_multi(rv)
+
+
+class ObserveOperation(Operation):
+    def run(self):
+        if self.single:
+            return self.cb.observe(self.key)
+        return self.cb.observe_multi(self.keys)
 
-ap.add_argument('--ksize', default=12, type=int,
-                help="Key size to use")
 
-ap.add_argument('--vsize', default=128, type=int,
-                help="Value size to use")
+class ViewOperation(Operation):
+    """
+    Queries a view of every document, fetching as many rows as there are
+    keys. The design document is created by :func:`prepare_view`
+    """
+    def run(self):
+        return list(self.cb.query(DESIGN, VIEW, limit=len(self.keys)))
 
-options = ap.parse_args()
-DO_UNLOCK_GIL = options.threads > 0
-TC = Transcoder()
+    def count(self, rv):
+        return len(rv)
+
+
+OPERATION_CLASSES = {
+    'get': GetOperation,
+    'set': SetOperation,
+    'add': AddOperation,
+    'replace': ReplaceOperation,
+    'delete': DeleteOperation,
+    'incr': IncrOperation,
+    'touch': TouchOperation,
+    'lock': LockOperation,
+    'observe': ObserveOperation,
+    'view': ViewOperation
+}
+
+
+def make_value(fmt, vsize):
+    """
+    :return: A tuple of (value, format) for a value of (about) vsize bytes
+    """
+    if fmt == 'bytes':
+        return b'V' * vsize, FMT_BYTES
+    if fmt == 'utf8':
+        return u'V' * vsize, FMT_UTF8
+
+    # Allow for the '{"data": ""}' around the string
+    value = {'data': 'V' * max(vsize - 12, 0)}
+    if fmt == 'pickle':
+        return value, FMT_PICKLE
+    return value, FMT_JSON
+
+
+def make_key(ksize, thread, n):
+    key = 'b{0}_{1}_'.format(thread, n)
+    return key + 'K' * max(ksize - len(key), 0)
 
 
 class Worker(Thread):
-    def __init__(self):
-        self.delay = options.delay
-        self.key = 'K' * options.ksize
-        self.value = b'V' * options.vsize
-        self.wait_time = 0
-        self.opcount = 0
-        self.cb = Connection(bucket='default',
-                             host=options.hostname,
-                             unlock_gil=DO_UNLOCK_GIL)
-
-        if options.transcoder:
-            self.cb.transcoder = TC
-        self.end_time = time() + options.duration
+    def __init__(self, options, connargs, case, index):
         super(Worker, self).__init__()
+        self.options = options
+        self.latencies = []
+        self.items = 0
+        self.errors = 0
+
+        cb = Connection(unlock_gil=bool(case['unlock_gil']),
+                        lockmode=LOCKMODES[case['lockmode']],
+                        **connargs)
+        if case['format'] == 'transcoder':
+            cb.transcoder = Transcoder()
+
+        keys = [make_key(case['ksize'], index, n)
+                for n in range(case['batch'])]
+        value, fmt = make_value(case['format'], case['vsize'])
+
+        self.cb = cb
+        self.op = OPERATION_CLASSES[case['op']](cb, keys, value, fmt)
+        self.op.setup()
 
     def run(self, *args, **kwargs):
-        cb = self.cb
-
-        while time() < self.end_time:
-            begin_time = time()
-            rv = cb.set(self.key, self.value, format=FMT_BYTES)
-            assert rv.rc == 0, "Operation failed: " + str(rv.rc)
-            self.wait_time += time() - begin_time
-
-            if self.delay:
-                sleep(self.delay)
-
-            self.opcount += 1
-
-
-global_begin = None
-worker_threads = []
-if not options.threads:
-    # No threding requested:
-    w = Worker()
-    worker_threads.append(w)
-    global_begin = time()
-    w.run()
-else:
-    for x in range(options.threads):
-        worker_threads.append(Worker())
-
-    global_begin = time()
-    for t in worker_threads:
-        t.start()
-
-    for t in worker_threads:
-        t.join()
-
-global_duration = time() - global_begin
-total_ops = sum([w.opcount for w in worker_threads])
-total_time = 0
-for t in worker_threads:
-    total_time += t.wait_time
-
-print("Total run took an absolute time of %0.2f seconds" % (global_duration,))
-print("Did a total of %d operations" % (total_ops,))
-print("Total wait time of %0.2f seconds" % (total_time,))
-print("[WAIT] %0.2f ops/second" % (float(total_ops)/float(total_time),))
-print("[ABS] %0.2f ops/second" % (float(total_ops)/float(global_duration),))
+        op = self.op
+        latencies = self.latencies
+        begin = timer()
+        measure_begin = begin + self.options.warmup
+        end_time = measure_begin + self.options.duration
+
+        while True:
+            op.prepare()
+
+            begin = timer()
+            try:
+                rv = op.run()
+            except CouchbaseError:
+                rv = None
+            end = timer()
+
+            if end >= end_time:
+                op.cleanup(rv)
+                break
+
+            if begin >= measure_begin:
+                latencies.append(end - begin)
+                if rv is None:
+                    self.errors += 1
+                else:
+                    self.items += op.count(rv)
+
+            op.cleanup(rv)
+
+
+def percentile(values, pct):
+    """
+    :param values: A sorted list
+    :return: The nearest-rank percentile
+    """
+    if not values:
+        return None
+    n = int(math.ceil(pct / 100.0 * len(values))) - 1
+    return values[min(max(n, 0), len(values) - 1)]
+
+
+def run_case(options, connargs, case):
+    workers = [Worker(options, connargs, case, ii)
+               for ii in range(max(options.threads, 1))]
+
+    begin = timer()
+    if not options.threads:
+        workers[0].run()
+    else:
+        for w in workers:
+            w.start()
+        for w in workers:
+            w.join()
+    elapsed = timer() - begin - options.warmup
+
+    latencies = sorted(itertools.chain(*[w.latencies for w in workers]))
+    items = sum([w.items for w in workers])
+    errors = sum([w.errors for w in workers])
+
+    ret = dict(case)
+    ret.update({
+        'threads': options.threads,
+        'duration': elapsed,
+        'calls': len(latencies),
+        'items': items,
+        'errors': errors,
+        'calls_per_sec': len(latencies) / elapsed,
+        'items_per_sec': items / elapsed,
+        'latency_us': {}
+    })
+
+    if latencies:
+        lat = ret['latency_us']
+        lat['min'] = latencies[0] * 1e6
+        lat['max'] = latencies[-1] * 1e6
+        lat['mean'] = sum(latencies) / len(latencies) * 1e6
+        for pct in PERCENTILES:
+            lat['p{0:g}'.format(pct)] = percentile(latencies, pct) * 1e6
+
+    return ret
+
+
+def prepare_view(connargs, nrows):
+    """
+    Create the design document for the view benchmarks, and make sure it
+    has at least nrows rows
+    """
+    cb = Connection(**connargs)
+    cb.design_create(DESIGN, {
+        'views': {
+            VIEW: {'map': 'function (doc, meta) { emit(meta.id, null); }'}
+        }
+    }, use_devmode=False, syncwait=10)
+
+    cb.set_multi(dict((make_key(12, 'v', n), n) for n in range(nrows)))
+
+    # Wait for the index to include the new documents
+    list(cb.query(DESIGN, VIEW, limit=1, stale=False))
+
+
+def start_mock(latency):
+    """
+    Start a mock server in a child process, so that it neither competes for
+    the GIL nor depends on the client releasing it
+    """
+    proc = subprocess.Popen([sys.executable, '-m', 'couchbase.mockserver',
+                             '--rest-port', '0',
+                             '--latency', str(latency)],
+                            stdout=subprocess.PIPE,
+                            universal_newlines=True)
+    port = int(proc.stdout.readline().split(':')[1])
+    proc.stdout.readline()
+    return proc, port
+
+
+def case_id(case):
+    return tuple(case[k] for k in ('op', 'batch', 'ksize', 'vsize', 'format',
+                                   'unlock_gil', 'lockmode', 'threads'))
+
+
+def describe(case):
+    return ("{op:8} batch={batch:<4} ksize={ksize:<4} vsize={vsize:<6} "
+            "format={format:10} unlock_gil={unlock_gil} "
+            "lockmode={lockmode:4}").format(**case)
+
+
+def compare(results, baseline, threshold):
+    """
+    Report the combinations which are worse than in the baseline.
+    :return: The number of regressions
+    """
+    old = dict((case_id(c), c) for c in baseline['cases'])
+    nregressions = 0
+
+    for case in results['cases']:
+        prev = old.get(case_id(case))
+        if not prev or not prev['items_per_sec']:
+            continue
+
+        problems = []
+        tput = (case['items_per_sec'] / prev['items_per_sec'] - 1) * 100
+        if tput < -threshold:
+            problems.append("throughput {0:+.1f}%".format(tput))
+
+        p99, prev_p99 = (case['latency_us'].get('p99'),
+                         prev['latency_us'].get('p99'))
+        if p99 and prev_p99:
+            change = (p99 / prev_p99 - 1) * 100
+            if change > threshold:
+                problems.append("p99 latency {0:+.1f}%".format(change))
+
+        if problems:
+            nregressions += 1
+            sys.stderr.write("[REGRESSION] {0}: {1}\n".format(
+                describe(case), ', '.join(problems)))
+
+    return nregressions
+
+
+def main():
+    options = ap.parse_args()
+    mock = None
+
+    if options.mock:
+        mock, port = start_mock(options.mock_latency)
+        connargs = {'host': '127.0.0.1', 'port': port, 'bucket': 'default'}
+    else:
+        connargs = {'host': options.hostname, 'port': options.port,
+                    'bucket': options.bucket}
+        if options.password:
+            connargs['password'] = options.password
+
+    results = {
+        'client': {
+            'version': couchbase.__version__,
+            'lcb_version': Connection.lcb_version()[0],
+            'python': sys.version.split()[0]
+        },
+        'started': time.strftime('%Y-%m-%dT%H:%M:%SZ', time.gmtime()),
+        'host': 'mock' if options.mock else options.hostname,
+        'cases': []
+    }
+
+    try:
+        if 'view' in options.ops:
+            prepare_view(connargs, max(options.batch))
+
+        for params in itertools.product(options.ops, options.batch,
+                                        options.ksize, options.vsize,
+                                        options.format, options.unlock_gil,
+                                        options.lockmode):
+            case = dict(zip(('op', 'batch', 'ksize', 'vsize', 'format',
+                             'unlock_gil', 'lockmode'), params))
+            rv = run_case(options, connargs, case)
+            results['cases'].append(rv)
+
+            sys.stderr.write("{0}: {1:10.0f} items/s p50={2:.0f}us "
+                             "p99={3:.0f}us errors={4}\n".format(
+                                 describe(case), rv['items_per_sec'],
+                                 rv['latency_us'].get('p50', 0),
+                                 rv['latency_us'].get('p99', 0),
+                                 rv['errors']))
+    finally:
+        if mock:
+            mock.terminate()
+            mock.wait()
+
+    text = json.dumps(results, indent=2, sort_keys=True)
+    if options.output:
+        with open(options.output, 'w') as fp:
+            fp.write(text + '\n')
+    else:
+        print(text)
+
+    if options.baseline:
+        with open(options.baseline) as fp:
+            baseline = json.load(fp)
+        if compare(results, baseline, options.threshold):
+            sys.exit(1)
+
+
+if __name__ == '__main__':
+    main()
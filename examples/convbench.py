@@ -0,0 +1,166 @@
+#!/usr/bin/env python
+# -*- coding: utf-8 -*-
+#
+# Copyright 2013, Couchbase, Inc.
+# All Rights Reserved
+#
+# Licensed under the Apache License, Version 2.0 (the "License")
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#
+
+"""
+Microbenchmarks for key and value conversion.
+
+The conversion routines are timed in a loop in C, without any network
+access, for a range of value shapes and formats. Each is run both with the
+built-in conversion and through a Transcoder object. The time (in
+nanoseconds) and the number of Python allocations for each conversion are
+reported. Allocations are only counted on Python 3.5 and later.
+
+The extension must be built with the benchmark enabled:
+
+    PYCBC_CONVBENCH=1 python setup.py build_ext --inplace
+
+    python convbench.py -i 20000 -o conv.json
+"""
+
+import argparse
+import json
+import sys
+
+import couchbase._libcouchbase as _LCB
+from couchbase import FMT_JSON, FMT_BYTES, FMT_UTF8, FMT_PICKLE
+from couchbase.transcoder import Transcoder
+
+FORMAT_NAMES = {
+    FMT_JSON: 'json',
+    FMT_BYTES: 'bytes',
+    FMT_UTF8: 'utf8',
+    FMT_PICKLE: 'pickle'
+}
+
+KEY_OPS = ('encode_key', 'decode_key')
+VALUE_OPS = ('encode', 'decode', 'encode_value', 'decode_value')
+
+
+def make_doc(n):
+    return {
+        'id': n,
+        'name': u'document number {0}'.format(n),
+        'score': n * 1.5,
+        'active': bool(n % 2),
+        'tags': ['alpha', 'beta', 'gamma'],
+        'owner': {'name': 'someone', 'email': 'someone@example.com'}
+    }
+
+
+# Name, value, and the formats the value can be stored with
+SHAPES = (
+    ('json_small', make_doc(1), (FMT_JSON, FMT_PICKLE)),
+    ('json_large', {'docs': [make_doc(n) for n in range(100)]},
+     (FMT_JSON, FMT_PICKLE)),
+    ('ascii_small', u'a short ascii string', (FMT_UTF8, FMT_JSON,
+                                               FMT_PICKLE)),
+    ('ascii_large', u'abcdefghijklmnop' * 1024, (FMT_UTF8, FMT_JSON,
+                                                 FMT_PICKLE)),
+    ('nonascii_small', u'été € 日本',
+     (FMT_UTF8, FMT_JSON, FMT_PICKLE)),
+    ('nonascii_large', u'été € 日本 ' * 1024,
+     (FMT_UTF8, FMT_JSON, FMT_PICKLE)),
+    ('bytes_small', b'\x00\x01binary\xff' * 4, (FMT_BYTES, FMT_PICKLE)),
+    ('bytes_large', b'\x00\x01binary\xff' * 2048, (FMT_BYTES, FMT_PICKLE)),
+    ('object', set(range(50)), (FMT_PICKLE,))
+)
+
+KEYS = (
+    ('key_ascii', u'user::profile::0123456789'),
+    ('key_nonascii', u'utilisateur::été::日本')
+)
+
+ap = argparse.ArgumentParser(description="Benchmark key and value conversion")
+ap.add_argument('-i', '--iterations', default=10000, type=int,
+                help="Number of times to run each conversion")
+ap.add_argument('-s', '--shapes', default=None,
+                help="Comma-separated list of value and key shapes to run. "
+                "Default is all of " +
+                ','.join([s[0] for s in SHAPES] + [k[0] for k in KEYS]))
+ap.add_argument('-O', '--ops', default=None,
+                help="Comma-separated list of conversions to run. Default "
+                "is all of " + ','.join(VALUE_OPS + KEY_OPS))
+ap.add_argument('-T', '--no-transcoder', default=False, action='store_true',
+                help="Don't run the conversions through a Transcoder")
+ap.add_argument('-o', '--output', default=None,
+                help="File to write the results to, as JSON")
+
+
+def cases(options):
+    shapes = options.shapes and options.shapes.split(',')
+    ops = options.ops and options.ops.split(',')
+    transcoders = [None]
+    if not options.no_transcoder:
+        transcoders.append(Transcoder())
+
+    for tc in transcoders:
+        for name, value, formats in SHAPES:
+            if shapes and name not in shapes:
+                continue
+            for op in VALUE_OPS:
+                if ops and op not in ops:
+                    continue
+                # encode() and decode() never use the Transcoder
+                if tc and op in ('encode', 'decode'):
+                    continue
+                for fmt in formats:
+                    yield op, name, value, fmt, tc
+
+        for name, key in KEYS:
+            if shapes and name not in shapes:
+                continue
+            for op in KEY_OPS:
+                if ops and op not in ops:
+                    continue
+                yield op, name, key, FMT_UTF8, tc
+
+
+def main():
+    options = ap.parse_args()
+    if not hasattr(_LCB, '_convbench'):
+        sys.exit("The extension was built without the benchmark. "
+                 "Rebuild it with PYCBC_CONVBENCH=1")
+    results = []
+
+    print("{0:14} {1:16} {2:7} {3:3} {4:>8} {5:>12} {6:>10}".format(
+        "op", "shape", "format", "tc", "size", "ns/op", "allocs/op"))
+
+    for op, name, value, fmt, tc in cases(options):
+        rv = _LCB._convbench(op, value, fmt,
+                             iterations=options.iterations,
+                             transcoder=tc)
+
+        allocs = rv['allocs_per_op']
+        print("{0:14} {1:16} {2:7} {3:3} {4:8} {5:12.1f} {6:>10}".format(
+            op, name, FORMAT_NAMES[fmt], 'yes' if tc else 'no',
+            rv['encoded_size'], rv['ns_per_op'],
+            '-' if allocs is None else '{0:.1f}'.format(allocs)))
+
+        rv.update({'op': op, 'shape': name, 'format': FORMAT_NAMES[fmt],
+                   'transcoder': bool(tc)})
+        results.append(rv)
+
+    if options.output:
+        with open(options.output, 'w') as fp:
+            json.dump({'python': sys.version.split()[0],
+                       'results': results}, fp, indent=2, sort_keys=True)
+
+
+if __name__ == '__main__':
+    main()
@@ -26,9 +26,52 @@ except couchbase_version.CantInvokeGit:
 pkgversion = couchbase_version.get_version()
 
 
+def have_zlib():
+    """
+    Check whether a program using zlib can be compiled and linked
+    """
+    import shutil
+    import tempfile
+    from distutils.ccompiler import new_compiler
+    from distutils.errors import CCompilerError, DistutilsError
+    from distutils.sysconfig import customize_compiler
+
+    cc = new_compiler()
+    customize_compiler(cc)
+    tmpdir = tempfile.mkdtemp()
+    try:
+        src = os.path.join(tmpdir, 'zlibcheck.c')
+        with open(src, 'w') as fp:
+            fp.write('#include <zlib.h>\n'
+                     'int main(void) { return zlibVersion() == 0; }\n')
+        objs = cc.compile([src], output_dir=tmpdir)
+        cc.link_executable(objs, os.path.join(tmpdir, 'zlibcheck'),
+                           libraries=['z'])
+        return True
+    except (CCompilerError, DistutilsError):
+        return False
+    finally:
+        shutil.rmtree(tmpdir, ignore_errors=True)
+
+
 LCB_NAME = None
 if sys.platform != 'win32':
     extoptions['libraries'] = ['couchbase']
+
+    # zlib is used to decompress HTTP responses sent with a gzip or deflate
+    # Content-Encoding (e.g. by a compressing proxy). It is used if it can be
+    # found; PYCBC_ZLIB=1 requires it, and PYCBC_ZLIB=0 builds without it.
+    # Without zlib, such responses are reported as errors.
+    use_zlib = os.environ.get('PYCBC_ZLIB')
+    if use_zlib is None:
+        use_zlib = have_zlib()
+    else:
+        use_zlib = use_zlib not in ('', '0')
+
+    if use_zlib:
+        extoptions['libraries'].append('z')
+        extoptions.setdefault('define_macros', []).append(
+            ('PYCBC_HAVE_ZLIB', 1))
 else:
     warnings.warn("I'm detecting you're running windows."
                   "You might want to modify "
@@ -78,10 +121,26 @@ SOURCEMODS = (
         'htresult',
         'ctranscoder',
         'observe',
+        'retry',
+        'replica',
+        'nodestats',
+        'sampler',
+        'jsondec',
+        'aggregate',
+        'inflate',
+        'trace',
+        'timeline',
         os.path.join('viewrow', 'viewrow'),
         os.path.join('contrib', 'jsonsl', 'jsonsl')
         )
 
+# The conversion microbenchmark (examples/convbench.py) hooks the Python
+# allocator, so it is only built when PYCBC_CONVBENCH=1 is set
+if os.environ.get('PYCBC_CONVBENCH'):
+    SOURCEMODS += ('convbench',)
+    extoptions.setdefault('define_macros', []).append(
+        ('PYCBC_HAVE_CONVBENCH', 1))
+
 extoptions['sources'] = [ os.path.join("src", m + ".c") for m in SOURCEMODS ]
 module = Extension('couchbase._libcouchbase', **extoptions)
 
@@ -0,0 +1,255 @@
+/**
+ *     Copyright 2013 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ **/
+
+/**
+ * Aggregates over streamed view rows.
+ *
+ * Rows are counted as they are received, and the number at a JSON pointer
+ * within each row (if any) is added to a running sum, minimum, maximum and
+ * histogram. The rows are never decoded, so no Python objects are created
+ * until the results are read back.
+ */
+#include "pycbc.h"
+
+struct pycbc_htaggr_st {
+    /** Path of the value to aggregate, or NULL to only count rows */
+    jsonsl_jpr_t jpr;
+
+    /** Number of rows, and of rows with a number at 'jpr' */
+    unsigned long long nrows;
+    unsigned long long nvalues;
+
+    double sum;
+    double min;
+    double max;
+
+    /**
+     * Histogram bucket boundaries, in ascending order. Bucket 'i' counts
+     * values in [bounds[i-1], bounds[i]); the first and last buckets are
+     * unbounded below and above
+     */
+    double *bounds;
+    size_t nbounds;
+    unsigned long long *buckets;
+};
+
+static int
+set_bounds(struct pycbc_htaggr_st *aggr, PyObject *bounds)
+{
+    Py_ssize_t ii, n;
+    PyObject *seq;
+
+    seq = PySequence_Fast(bounds, "bounds must be a sequence");
+    if (!seq) {
+        return -1;
+    }
+
+    n = PySequence_Fast_GET_SIZE(seq);
+    aggr->bounds = malloc((n ? n : 1) * sizeof(*aggr->bounds));
+    aggr->buckets = calloc(n + 1, sizeof(*aggr->buckets));
+
+    if (!(aggr->bounds && aggr->buckets)) {
+        Py_DECREF(seq);
+        PyErr_NoMemory();
+        return -1;
+    }
+
+    for (ii = 0; ii < n; ii++) {
+        double d = PyFloat_AsDouble(PySequence_Fast_GET_ITEM(seq, ii));
+
+        if (d == -1 && PyErr_Occurred()) {
+            Py_DECREF(seq);
+            return -1;
+        }
+
+        if (ii && d <= aggr->bounds[ii - 1]) {
+            Py_DECREF(seq);
+            PYCBC_EXC_WRAP_OBJ(PYCBC_EXC_ARGUMENTS, 0,
+                               "Histogram bounds must be in ascending order",
+                               bounds);
+            return -1;
+        }
+        aggr->bounds[ii] = d;
+    }
+
+    aggr->nbounds = n;
+    Py_DECREF(seq);
+    return 0;
+}
+
+struct pycbc_htaggr_st *
+pycbc_htaggr_new(PyObject *path, PyObject *bounds)
+{
+    struct pycbc_htaggr_st *aggr;
+    PyObject *bpath = NULL;
+
+    aggr = calloc(1, sizeof(*aggr));
+    if (!aggr) {
+        PyErr_NoMemory();
+        return NULL;
+    }
+
+    if (PyUnicode_Check(path)) {
+        bpath = PyUnicode_AsUTF8String(path);
+        if (!bpath) {
+            goto GT_ERROR;
+        }
+    } else if (PyBytes_Check(path)) {
+        bpath = path;
+        Py_INCREF(bpath);
+    } else {
+        PYCBC_EXC_WRAP_OBJ(PYCBC_EXC_ARGUMENTS, 0,
+                           "Aggregate path must be a string", path);
+        goto GT_ERROR;
+    }
+
+    if (PyBytes_GET_SIZE(bpath)) {
+        jsonsl_error_t err;
+
+        aggr->jpr = jsonsl_jpr_new(PyBytes_AS_STRING(bpath), &err);
+        if (!aggr->jpr || aggr->jpr->ncomponents < 2) {
+            PYCBC_EXC_WRAP_OBJ(PYCBC_EXC_ARGUMENTS, 0,
+                               "Invalid aggregate path", path);
+            goto GT_ERROR;
+        }
+    }
+
+    if (bounds && bounds != Py_None) {
+        if (!aggr->jpr) {
+            PYCBC_EXC_WRAP(PYCBC_EXC_ARGUMENTS, 0,
+                           "A histogram requires a path");
+            goto GT_ERROR;
+        }
+
+        if (set_bounds(aggr, bounds) == -1) {
+            goto GT_ERROR;
+        }
+    }
+
+    Py_DECREF(bpath);
+    return aggr;
+
+    GT_ERROR:
+    Py_XDECREF(bpath);
+    pycbc_htaggr_free(aggr);
+    return NULL;
+}
+
+int
+pycbc_htaggr_add(struct pycbc_htaggr_st *aggr, const char *row, size_t nrow)
+{
+    double d;
+    int rv;
+    size_t lo, hi;
+
+    aggr->nrows++;
+    if (!aggr->jpr) {
+        return 0;
+    }
+
+    rv = pycbc_json_find_number(row, nrow, aggr->jpr, &d);
+    if (rv != 1) {
+        return rv;
+    }
+
+    if (!aggr->nvalues++) {
+        aggr->min = aggr->max = d;
+    } else if (d < aggr->min) {
+        aggr->min = d;
+    } else if (d > aggr->max) {
+        aggr->max = d;
+    }
+    aggr->sum += d;
+
+    if (aggr->buckets) {
+        /** Find the first boundary greater than the value */
+        lo = 0;
+        hi = aggr->nbounds;
+        while (lo < hi) {
+            size_t mid = lo + (hi - lo) / 2;
+            if (aggr->bounds[mid] <= d) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        aggr->buckets[lo]++;
+    }
+
+    return 0;
+}
+
+PyObject *
+pycbc_htaggr_result(struct pycbc_htaggr_st *aggr)
+{
+    PyObject *ret;
+    PyObject *hist = Py_None;
+    size_t ii;
+
+    if (aggr->buckets) {
+        hist = PyList_New(aggr->nbounds + 1);
+        if (!hist) {
+            return NULL;
+        }
+
+        for (ii = 0; ii <= aggr->nbounds; ii++) {
+            PyObject *count = PyLong_FromUnsignedLongLong(aggr->buckets[ii]);
+            if (!count) {
+                Py_DECREF(hist);
+                return NULL;
+            }
+            PyList_SET_ITEM(hist, ii, count);
+        }
+    } else {
+        Py_INCREF(hist);
+    }
+
+    if (aggr->nvalues) {
+        ret = Py_BuildValue("{s:K,s:K,s:d,s:d,s:d,s:O}",
+                            "count", aggr->nrows,
+                            "values", aggr->nvalues,
+                            "sum", aggr->sum,
+                            "min", aggr->min,
+                            "max", aggr->max,
+                            "histogram", hist);
+    } else {
+        ret = Py_BuildValue("{s:K,s:K,s:d,s:O,s:O,s:O}",
+                            "count", aggr->nrows,
+                            "values", aggr->nvalues,
+                            "sum", aggr->sum,
+                            "min", Py_None,
+                            "max", Py_None,
+                            "histogram", hist);
+    }
+
+    Py_DECREF(hist);
+    return ret;
+}
+
+void
+pycbc_htaggr_free(struct pycbc_htaggr_st *aggr)
+{
+    if (!aggr) {
+        return;
+    }
+
+    if (aggr->jpr) {
+        jsonsl_jpr_destroy(aggr->jpr);
+    }
+    free(aggr->bounds);
+    free(aggr->buckets);
+    free(aggr);
+}
@@ -123,19 +123,24 @@ arithmetic_common(pycbc_Connection *self,
     pycbc_seqtype_t seqtype;
     PyObject *all_initial_O = NULL;
     PyObject *all_ttl_O = NULL;
+    PyObject *timeout_O = NULL;
     PyObject *collection;
+    lcb_uint32_t timeout = 0;
     lcb_error_t err;
     struct pycbc_common_vars cv = PYCBC_COMMON_VARS_STATIC_INIT;
 
-    static char *kwlist[] = { "keys", "amount", "initial", "ttl", NULL };
+    static char *kwlist[] = {
+            "keys", "amount", "initial", "ttl", "timeout", NULL
+    };
 
     global_params.delta = 1;
 
-    rv = PyArg_ParseTupleAndKeywords(args, kwargs, "O|LOO", kwlist,
+    rv = PyArg_ParseTupleAndKeywords(args, kwargs, "O|LOOO", kwlist,
                                      &collection,
                                      &global_params.delta,
                                      &all_initial_O,
-                                     &all_ttl_O);
+                                     &all_ttl_O,
+                                     &timeout_O);
     if (!rv) {
         PYCBC_EXCTHROW_ARGS();
         return NULL;
@@ -146,6 +151,10 @@ arithmetic_common(pycbc_Connection *self,
         return NULL;
     }
 
+    if (pycbc_get_timeout(timeout_O, &timeout) < 0) {
+        return NULL;
+    }
+
     if (argopts & PYCBC_ARGOPT_MULTI) {
         rv = pycbc_oputil_check_sequence(collection,
                             optype != PYCBC_CMD_ARITH,
@@ -171,9 +180,15 @@ arithmetic_common(pycbc_Connection *self,
     rv = pycbc_common_vars_init(&cv,
                                 self,
                                 argopts,
+                                optype,
                                 ncmds,
                                 sizeof(lcb_arithmetic_cmd_t),
                                 0);
+    if (rv < 0) {
+        return NULL;
+    }
+
+    cv.timeout = timeout;
 
     if (argopts & PYCBC_ARGOPT_MULTI) {
         Py_ssize_t dictpos;
@@ -99,8 +99,21 @@ maybe_push_operr(pycbc_MultiResult *mres,
 }
 
 static void
-maybe_breakout(pycbc_Connection *self)
+maybe_breakout(pycbc_MultiResult *mres)
 {
+    pycbc_Connection *self = mres->parent;
+
+    assert(mres->nremaining);
+    mres->nremaining--;
+
+    if (mres->viewdocs) {
+        /** The view's _fetch() waits for these once its page is ready */
+        if (!mres->nremaining && !self->nremaining) {
+            lcb_breakout(self->instance);
+        }
+        return;
+    }
+
     assert(self->nremaining);
 
     if (!--self->nremaining) {
@@ -108,6 +121,60 @@ maybe_breakout(pycbc_Connection *self)
     }
 }
 
+/**
+ * Responses for an operation abandoned at its deadline arrive during later
+ * operations. These are discarded, counting down the final responses so the
+ * MultiResult can be released. This is called without the GIL.
+ */
+static int
+maybe_drop_late(const void *cookie, int is_final)
+{
+    pycbc_MultiResult *mres = (pycbc_MultiResult*)cookie;
+
+    if (!mres->abandoned) {
+        return 0;
+    }
+
+    if (is_final) {
+        assert(mres->nlate);
+        mres->nlate--;
+    }
+    return 1;
+}
+
+/**
+ * Check whether the command should be retried rather than having its
+ * response delivered. This is called without the GIL.
+ */
+static int
+maybe_retry(const void *cookie, const void *key, size_t nkey, lcb_error_t err)
+{
+    pycbc_MultiResult *mres = (pycbc_MultiResult*)cookie;
+
+    if (err == LCB_SUCCESS || mres->retry == NULL) {
+        return 0;
+    }
+
+    return pycbc_retry_requeue(mres->retry, key, nkey, err);
+}
+
+/**
+ * Like maybe_retry(), but for 'get' operations which may also have replica
+ * reads in flight. This is called without the GIL.
+ */
+static int
+maybe_replica(const void *cookie, const void *key, size_t nkey,
+              lcb_error_t err)
+{
+    pycbc_MultiResult *mres = (pycbc_MultiResult*)cookie;
+
+    if (mres->replica == NULL) {
+        return maybe_retry(cookie, key, nkey, err);
+    }
+
+    return pycbc_replica_handle(mres->replica, mres->retry, key, nkey, err);
+}
+
 static int
 get_common_objects(PyObject *cookie,
                    const void *key,
@@ -127,7 +194,7 @@ get_common_objects(PyObject *cookie,
     *conn = (*mres)->parent;
 
     if (!(restype & RESTYPE_VARCOUNT)) {
-        maybe_breakout(*conn);
+        maybe_breakout(*mres);
     }
 
     CB_THR_END(*conn);
@@ -214,6 +281,13 @@ store_callback(lcb_t instance,
     pycbc_MultiResult *mres;
     int rv;
 
+    pycbc_nodestats_record(instance, resp->v.v0.key, resp->v.v0.nkey, 0, err);
+
+    if (maybe_drop_late(cookie, 1) ||
+            maybe_retry(cookie, resp->v.v0.key, resp->v.v0.nkey, err)) {
+        return;
+    }
+
     rv = get_common_objects((PyObject*)cookie,
                             resp->v.v0.key,
                             resp->v.v0.nkey,
@@ -249,6 +323,14 @@ get_callback(lcb_t instance,
     pycbc_ValueResult *res = NULL;
     pycbc_MultiResult *mres = NULL;
 
+    pycbc_nodestats_record(instance, resp->v.v0.key, resp->v.v0.nkey,
+                           err == LCB_SUCCESS ? resp->v.v0.nbytes : 0, err);
+
+    if (maybe_drop_late(cookie, 1) ||
+            maybe_replica(cookie, resp->v.v0.key, resp->v.v0.nkey, err)) {
+        return;
+    }
+
     rv = get_common_objects((PyObject*)cookie,
                             resp->v.v0.key,
                             resp->v.v0.nkey,
@@ -296,6 +378,14 @@ delete_callback(lcb_t instance,
     pycbc_Connection *conn = NULL;
     pycbc_OperationResult *res = NULL;
     pycbc_MultiResult *mres = NULL;
+
+    pycbc_nodestats_record(instance, resp->v.v0.key, resp->v.v0.nkey, 0, err);
+
+    if (maybe_drop_late(cookie, 1) ||
+            maybe_retry(cookie, resp->v.v0.key, resp->v.v0.nkey, err)) {
+        return;
+    }
+
     rv = get_common_objects((PyObject*)cookie,
                             resp->v.v0.key, resp->v.v0.nkey, err,
                             &conn,
@@ -324,6 +414,13 @@ arithmetic_callback(lcb_t instance,
     pycbc_ValueResult *res = NULL;
     pycbc_MultiResult *mres = NULL;
 
+    pycbc_nodestats_record(instance, resp->v.v0.key, resp->v.v0.nkey, 0, err);
+
+    if (maybe_drop_late(cookie, 1) ||
+            maybe_retry(cookie, resp->v.v0.key, resp->v.v0.nkey, err)) {
+        return;
+    }
+
     rv = get_common_objects((PyObject*)cookie,
                             resp->v.v0.key,
                             resp->v.v0.nkey,
@@ -357,6 +454,13 @@ unlock_callback(lcb_t instance,
     pycbc_OperationResult *res = NULL;
     pycbc_MultiResult *mres = NULL;
 
+    pycbc_nodestats_record(instance, resp->v.v0.key, resp->v.v0.nkey, 0, err);
+
+    if (maybe_drop_late(cookie, 1) ||
+            maybe_retry(cookie, resp->v.v0.key, resp->v.v0.nkey, err)) {
+        return;
+    }
+
     rv = get_common_objects((PyObject*)cookie,
                             resp->v.v0.key,
                             resp->v.v0.nkey,
@@ -384,6 +488,13 @@ touch_callback(lcb_t instance,
     pycbc_OperationResult *res = NULL;
     pycbc_MultiResult *mres = NULL;
 
+    pycbc_nodestats_record(instance, resp->v.v0.key, resp->v.v0.nkey, 0, err);
+
+    if (maybe_drop_late(cookie, 1) ||
+            maybe_retry(cookie, resp->v.v0.key, resp->v.v0.nkey, err)) {
+        return;
+    }
+
     rv = get_common_objects((PyObject*) cookie,
                             resp->v.v0.key,
                             resp->v.v0.nkey,
@@ -413,11 +524,23 @@ stat_callback(lcb_t instance,
     PyObject *skey, *knodes;
 
 
+    if (maybe_drop_late(cookie, resp->v.v0.server_endpoint == NULL)) {
+        return;
+    }
+
     mres = (pycbc_MultiResult*)cookie;
+
+    if (mres->sampler && err == LCB_SUCCESS && resp->v.v0.server_endpoint) {
+        pycbc_sampler_record(mres->sampler,
+                             resp->v.v0.server_endpoint,
+                             resp->v.v0.key, resp->v.v0.nkey,
+                             resp->v.v0.bytes, resp->v.v0.nbytes);
+        return;
+    }
     CB_THR_END(mres->parent);
 
     if (!resp->v.v0.server_endpoint) {
-        maybe_breakout(mres->parent);
+        maybe_breakout(mres);
     }
 
     if (err != LCB_SUCCESS) {
@@ -480,9 +603,13 @@ observe_callback(lcb_t instance,
     pycbc_ValueResult *vres;
     pycbc_MultiResult *mres;
 
+    if (maybe_drop_late(cookie, resp->v.v0.key == NULL)) {
+        return;
+    }
+
     if (!resp->v.v0.key) {
         mres = (pycbc_MultiResult*)cookie;;
-        maybe_breakout(mres->parent);
+        maybe_breakout(mres);
         return;
     }
 
@@ -545,18 +672,56 @@ error_callback(lcb_t instance, lcb_error_t err, const char *msg)
 }
 
 
+/**
+ * Wrappers recording the time spent in each callback in the timeline.
+ * These are what is installed in the instance.
+ */
+#define TL_CALLBACK(name, resp_t) \
+static void \
+name##_tl(lcb_t instance, \
+          const void *cookie, \
+          lcb_error_t err, \
+          const resp_t *resp) \
+{ \
+    lcb_uint64_t begin = PYCBC_TL_NOW(); \
+    name(instance, cookie, err, resp); \
+    PYCBC_TL_SPAN("callback", #name, begin, 0); \
+}
+
+TL_CALLBACK(get_callback, lcb_get_resp_t)
+TL_CALLBACK(delete_callback, lcb_remove_resp_t)
+TL_CALLBACK(arithmetic_callback, lcb_arithmetic_resp_t)
+TL_CALLBACK(unlock_callback, lcb_unlock_resp_t)
+TL_CALLBACK(touch_callback, lcb_touch_resp_t)
+TL_CALLBACK(stat_callback, lcb_server_stat_resp_t)
+TL_CALLBACK(observe_callback, lcb_observe_resp_t)
+
+#undef TL_CALLBACK
+
+static void
+store_callback_tl(lcb_t instance,
+                  const void *cookie,
+                  lcb_storage_t op,
+                  lcb_error_t err,
+                  const lcb_store_resp_t *resp)
+{
+    lcb_uint64_t begin = PYCBC_TL_NOW();
+    store_callback(instance, cookie, op, err, resp);
+    PYCBC_TL_SPAN("callback", "store_callback", begin, 0);
+}
+
 void
 pycbc_callbacks_init(lcb_t instance)
 {
-    lcb_set_store_callback(instance, store_callback);
-    lcb_set_unlock_callback(instance, unlock_callback);
-    lcb_set_get_callback(instance, get_callback);
-    lcb_set_touch_callback(instance, touch_callback);
-    lcb_set_arithmetic_callback(instance, arithmetic_callback);
-    lcb_set_remove_callback(instance, delete_callback);
-    lcb_set_stat_callback(instance, stat_callback);
+    lcb_set_store_callback(instance, store_callback_tl);
+    lcb_set_unlock_callback(instance, unlock_callback_tl);
+    lcb_set_get_callback(instance, get_callback_tl);
+    lcb_set_touch_callback(instance, touch_callback_tl);
+    lcb_set_arithmetic_callback(instance, arithmetic_callback_tl);
+    lcb_set_remove_callback(instance, delete_callback_tl);
+    lcb_set_stat_callback(instance, stat_callback_tl);
     lcb_set_error_callback(instance, error_callback);
-    lcb_set_observe_callback(instance, observe_callback);
+    lcb_set_observe_callback(instance, observe_callback_tl);
 
     pycbc_http_callbacks_init(instance);
 }
@@ -247,6 +247,15 @@ static struct PyMemberDef Connection_TABLE_members[] = {
                         "See :ref:`multiple_threads` for more information\n")
         },
 
+        { "track_node_stats", T_UINT,
+                offsetof(pycbc_Connection, track_node_stats),
+                0,
+                PyDoc_STR("Whether to count operations, errors and bytes "
+                        "for each server.\n"
+                        "\n"
+                        "See :meth:`node_stats`\n")
+        },
+
         { "_privflags", T_UINT, offsetof(pycbc_Connection, flags),
                 0,
                 PyDoc_STR("Internal flags.")
@@ -294,10 +303,22 @@ static PyMethodDef Connection_TABLE_methods[] = {
         OPFUNC(_stats, "Get various server statistics"),
 
         OPFUNC(_http_request, "Internal routine for HTTP requests"),
+        OPFUNC(_http_request_multi, "Internal routine for concurrent HTTP "
+                "requests"),
 
         OPFUNC(observe, "Get replication/persistence status for keys"),
         OPFUNC(observe_multi, "multi-key variant of observe"),
 
+        OPFUNC(_set_retry_policy, "Set the policy for retrying transient "
+                "errors"),
+        OPFUNC(_get_retry_policy, "Get the current retry policy"),
+
+        OPFUNC(_keys_by_node, "Group keys by the server which owns them"),
+        OPFUNC(_node_stats, "Get per-server operation counters"),
+
+        OPFUNC(_start_trace, "Start recording operations to a trace file"),
+        OPFUNC(_stop_trace, "Stop recording operations"),
+
 
 #undef OPFUNC
 
@@ -426,6 +447,7 @@ Connection__init__(pycbc_Connection *self,
     self->flags = 0;
     self->unlock_gil = 1;
     self->lockmode = PYCBC_LOCKMODE_EXC;
+    pycbc_retry_policy_init(&self->retry);
 
     #define X(s, target, type) target,
     rv = PyArg_ParseTupleAndKeywords(args,
@@ -541,17 +563,60 @@ Connection__init__(pycbc_Connection *self,
     return 0;
 }
 
+/**
+ * Only the 'orphans' list and the transcoder are visited: abandoned
+ * MultiResult objects in the list refer back to the connection, and so may
+ * a user-defined transcoder
+ */
+static int
+Connection_traverse(pycbc_Connection *self, visitproc visit, void *arg)
+{
+    Py_VISIT(self->orphans);
+    Py_VISIT(self->tc);
+    return 0;
+}
+
+/**
+ * This only breaks the cycles through the connection. The orphans are the
+ * cookies for pending operations, so rather than being released here, they
+ * drop their reference to the connection and are released by the destructor
+ * once the instance has been destroyed.
+ */
+static int
+Connection_clear(pycbc_Connection *self)
+{
+    if (self->orphans) {
+        Py_ssize_t ii;
+        for (ii = 0; ii < PyList_GET_SIZE(self->orphans); ii++) {
+            pycbc_MultiResult *mres =
+                    (pycbc_MultiResult*)PyList_GET_ITEM(self->orphans, ii);
+            Py_CLEAR(mres->parent);
+        }
+    }
+
+    Py_CLEAR(self->tc);
+    return 0;
+}
+
 static void
 Connection_dtor(pycbc_Connection *self)
 {
+    PyObject_GC_UnTrack(self);
+
     if (self->instance) {
         lcb_destroy(self->instance);
         self->instance = NULL;
     }
 
+    /** Must be after lcb_destroy, as these are the cookies for pending ops */
+    Py_XDECREF(self->orphans);
+    Py_XDECREF(self->tc);
+
+    free(self->node_stats);
+    pycbc_trace_close(self->trace);
+
     Py_XDECREF(self->dfl_fmt);
     Py_XDECREF(self->errors);
-    Py_XDECREF(self->tc);
     Py_XDECREF(self->bucket);
 
 #ifdef WITH_THREAD
@@ -579,8 +644,10 @@ pycbc_ConnectionType_init(PyObject **ptr)
     p->tp_new = PyType_GenericNew;
     p->tp_init = (initproc)Connection__init__;
     p->tp_dealloc = (destructor)Connection_dtor;
+    p->tp_traverse = (traverseproc)Connection_traverse;
+    p->tp_clear = (inquiry)Connection_clear;
 
-    p->tp_flags = Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE;
+    p->tp_flags = Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE | Py_TPFLAGS_HAVE_GC;
     p->tp_doc = PyDoc_STR("The connection object");
 
     p->tp_basicsize = sizeof(pycbc_Connection);
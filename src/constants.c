@@ -44,6 +44,7 @@
     X(ETIMEDOUT) \
     X(BUCKET_ENOENT) \
     X(CONNECT_ERROR) \
+    X(CLIENT_ENOMEM) \
     X(EBADHANDLE) \
     X(SERVER_BUG) \
     X(PLUGIN_VERSION_MISMATCH) \
@@ -125,6 +126,12 @@ pycbc_init_pyconstants(PyObject *module)
     PyModule_AddIntConstant(module, "LOCKMODE_NONE", PYCBC_LOCKMODE_NONE);
 
     PyModule_AddIntMacro(module, PYCBC_CONN_F_WARNEXPLICIT);
+
+#ifdef PYCBC_HAVE_ZLIB
+    PyModule_AddIntConstant(module, "_HAVE_ZLIB", 1);
+#else
+    PyModule_AddIntConstant(module, "_HAVE_ZLIB", 0);
+#endif
 }
 
 
@@ -120,6 +120,186 @@ static int *Allowed_Escapes;
 #define is_allowed_escape(c) \
     Allowed_Escapes[(unsigned int)c & 0xff]
 
+/**
+ * Characters which end (or are invalid within) a run of ordinary string
+ * characters
+ */
+static int String_nopass[0x100] = { JSONSL_CHARTABLE_string_nopass };
+
+/**
+ * Block scanners. Each returns the number of bytes at the beginning of the
+ * buffer which are ordinary string characters (or whitespace), and which the
+ * state machine would simply step over. Only the byte after these needs to be
+ * handled by jsonsl_feed().
+ *
+ * The SSE2 and AVX2 versions examine 16 or 32 bytes at a time, and are chosen
+ * when the parser is created if the CPU supports them. Define JSONSL_NO_SIMD
+ * to only use the scalar versions.
+ */
+typedef size_t (*jsonsl__scanfn)(const jsonsl_uchar_t *, size_t);
+
+static size_t
+scan_string_scalar(const jsonsl_uchar_t *c, size_t n)
+{
+    size_t ii;
+    for (ii = 0; ii < n; ii++) {
+#ifdef JSONSL_USE_WCHAR
+        if (c[ii] >= 0x100) {
+            continue;
+        }
+#endif /* JSONSL_USE_WCHAR */
+        if (String_nopass[c[ii] & 0xff]) {
+            break;
+        }
+    }
+    return ii;
+}
+
+static size_t
+scan_whitespace_scalar(const jsonsl_uchar_t *c, size_t n)
+{
+    size_t ii;
+    for (ii = 0; ii < n && is_allowed_whitespace(c[ii]); ii++) {
+        ;
+    }
+    return ii;
+}
+
+#if !defined(JSONSL_NO_SIMD) && !defined(JSONSL_USE_WCHAR) && \
+    defined(__GNUC__) && defined(__SSE2__) && \
+    (defined(__x86_64__) || defined(__i386__))
+#define JSONSL_HAVE_SSE2
+#include <emmintrin.h>
+
+#if defined(__clang__) || __GNUC__ >= 5
+#define JSONSL_HAVE_AVX2
+#include <immintrin.h>
+#endif
+
+/**
+ * The lowest byte value which may appear unescaped in a string (the table
+ * above also rejects 0x00-0x13)
+ */
+#define STRING_MIN 0x14
+
+static size_t
+scan_string_sse2(const jsonsl_uchar_t *c, size_t n)
+{
+    size_t ii = 0;
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i bslash = _mm_set1_epi8('\\');
+    const __m128i low = _mm_set1_epi8(STRING_MIN);
+
+    for (; ii + 16 <= n; ii += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(c + ii));
+        __m128i ok = _mm_cmpeq_epi8(_mm_max_epu8(v, low), v);
+        __m128i special = _mm_or_si128(_mm_cmpeq_epi8(v, quote),
+                                       _mm_cmpeq_epi8(v, bslash));
+        unsigned mask = (unsigned)_mm_movemask_epi8(_mm_andnot_si128(special,
+                                                                     ok));
+        if (mask != 0xffff) {
+            return ii + __builtin_ctz(~mask);
+        }
+    }
+    return ii + scan_string_scalar(c + ii, n - ii);
+}
+
+static size_t
+scan_whitespace_sse2(const jsonsl_uchar_t *c, size_t n)
+{
+    size_t ii = 0;
+    const __m128i sp = _mm_set1_epi8(' ');
+    const __m128i tab = _mm_set1_epi8('\t');
+    const __m128i lf = _mm_set1_epi8('\n');
+    const __m128i cr = _mm_set1_epi8('\r');
+
+    for (; ii + 16 <= n; ii += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(c + ii));
+        __m128i ws = _mm_or_si128(
+                _mm_or_si128(_mm_cmpeq_epi8(v, sp), _mm_cmpeq_epi8(v, tab)),
+                _mm_or_si128(_mm_cmpeq_epi8(v, lf), _mm_cmpeq_epi8(v, cr)));
+        unsigned mask = (unsigned)_mm_movemask_epi8(ws);
+        if (mask != 0xffff) {
+            return ii + __builtin_ctz(~mask);
+        }
+    }
+    return ii + scan_whitespace_scalar(c + ii, n - ii);
+}
+
+#ifdef JSONSL_HAVE_AVX2
+__attribute__((target("avx2")))
+static size_t
+scan_string_avx2(const jsonsl_uchar_t *c, size_t n)
+{
+    size_t ii = 0;
+    const __m256i quote = _mm256_set1_epi8('"');
+    const __m256i bslash = _mm256_set1_epi8('\\');
+    const __m256i low = _mm256_set1_epi8(STRING_MIN);
+
+    for (; ii + 32 <= n; ii += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(c + ii));
+        __m256i ok = _mm256_cmpeq_epi8(_mm256_max_epu8(v, low), v);
+        __m256i special = _mm256_or_si256(_mm256_cmpeq_epi8(v, quote),
+                                          _mm256_cmpeq_epi8(v, bslash));
+        unsigned mask = (unsigned)_mm256_movemask_epi8(
+                _mm256_andnot_si256(special, ok));
+        if (mask != 0xffffffffU) {
+            return ii + __builtin_ctz(~mask);
+        }
+    }
+    return ii + scan_string_sse2(c + ii, n - ii);
+}
+
+__attribute__((target("avx2")))
+static size_t
+scan_whitespace_avx2(const jsonsl_uchar_t *c, size_t n)
+{
+    size_t ii = 0;
+    const __m256i sp = _mm256_set1_epi8(' ');
+    const __m256i tab = _mm256_set1_epi8('\t');
+    const __m256i lf = _mm256_set1_epi8('\n');
+    const __m256i cr = _mm256_set1_epi8('\r');
+
+    for (; ii + 32 <= n; ii += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(c + ii));
+        __m256i ws = _mm256_or_si256(
+                _mm256_or_si256(_mm256_cmpeq_epi8(v, sp),
+                                _mm256_cmpeq_epi8(v, tab)),
+                _mm256_or_si256(_mm256_cmpeq_epi8(v, lf),
+                                _mm256_cmpeq_epi8(v, cr)));
+        unsigned mask = (unsigned)_mm256_movemask_epi8(ws);
+        if (mask != 0xffffffffU) {
+            return ii + __builtin_ctz(~mask);
+        }
+    }
+    return ii + scan_whitespace_sse2(c + ii, n - ii);
+}
+#endif /* JSONSL_HAVE_AVX2 */
+#endif /* SIMD */
+
+static jsonsl__scanfn Scan_string = scan_string_scalar;
+static jsonsl__scanfn Scan_whitespace = scan_whitespace_scalar;
+
+/**
+ * Select the block scanners for this CPU. This always selects the same
+ * functions, so it does not matter if several threads do it at once
+ */
+static void
+select_scanners(void)
+{
+#ifdef JSONSL_HAVE_SSE2
+    Scan_string = scan_string_sse2;
+    Scan_whitespace = scan_whitespace_sse2;
+#ifdef JSONSL_HAVE_AVX2
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        Scan_string = scan_string_avx2;
+        Scan_whitespace = scan_whitespace_avx2;
+    }
+#endif
+#endif
+}
+
 JSONSL_API
 jsonsl_t jsonsl_new(int nlevels)
 {
@@ -131,6 +311,7 @@ jsonsl_t jsonsl_new(int nlevels)
     jsn->levels_max = nlevels;
     jsn->max_callback_level = -1;
     jsonsl_reset(jsn);
+    select_scanners();
     return jsn;
 }
 
@@ -234,11 +415,11 @@ jsonsl_feed(jsonsl_t jsn, const jsonsl_char_t *bytes, size_t nbytes)
     const jsonsl_uchar_t *c = (jsonsl_uchar_t*)bytes;
     size_t levels_max = jsn->levels_max;
     struct jsonsl_state_st *state = jsn->stack + jsn->level;
-    static int chrt_string_nopass[0x100] = { JSONSL_CHARTABLE_string_nopass };
     jsn->base = bytes;
 
     for (; nbytes; nbytes--, jsn->pos++, c++) {
         register jsonsl_type_t state_type;
+        size_t nskip;
         INCR_METRIC(TOTAL);
         /* Special escape handling for some stuff */
         if (jsn->in_escape) {
@@ -266,8 +447,13 @@ jsonsl_feed(jsonsl_t jsn, const jsonsl_char_t *bytes, size_t nbytes)
 #ifdef JSONSL_USE_WCHAR
                     CUR_CHAR >= 0x100 ||
 #endif /* JSONSL_USE_WCHAR */
-                    (!chrt_string_nopass[CUR_CHAR & 0xff])) {
+                    (!String_nopass[CUR_CHAR & 0xff])) {
                 INCR_METRIC(STRINGY_INSIGNIFICANT);
+                /* step over the rest of the run in blocks */
+                nskip = Scan_string(c + 1, nbytes - 1);
+                c += nskip;
+                jsn->pos += nskip;
+                nbytes -= nskip;
                 goto GT_NEXT;
             } else if (CUR_CHAR == '"') {
                 goto GT_QUOTE;
@@ -335,6 +521,11 @@ jsonsl_feed(jsonsl_t jsn, const jsonsl_char_t *bytes, size_t nbytes)
             /* So we're not special. Harmless insignificant whitespace
              * passthrough
              */
+            /* and the rest of the run, in blocks */
+            nskip = Scan_whitespace(c + 1, nbytes - 1);
+            c += nskip;
+            jsn->pos += nskip;
+            nbytes -= nskip;
             goto GT_NEXT;
         } else if (extract_special(CUR_CHAR)) {
             /* not a string, whitespace, or structural token. must be special */
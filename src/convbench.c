@@ -0,0 +1,323 @@
+/**
+ *     Copyright 2013 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ **/
+
+/**
+ * Microbenchmarks for the conversion layer.
+ *
+ * The key and value conversion routines are called in a loop from C, so the
+ * timings include nothing but the conversion itself (and the Transcoder's
+ * methods, if one is given). No connection to a cluster is made; the
+ * conversion routines are given a zeroed connection object with only the
+ * transcoder and default format set.
+ *
+ * Where the Python memory allocator can be hooked (Python 3.5 and later),
+ * the number of allocations made by each conversion is counted as well.
+ *
+ * See examples/convbench.py for a driver. This file is only built when
+ * PYCBC_CONVBENCH=1 is set for setup.py, so that the allocator hooks are not
+ * part of regular builds.
+ */
+#include "pycbc.h"
+
+#if PY_VERSION_HEX >= 0x03050000
+#define PYCBC_CONVBENCH_ALLOCS
+#endif
+
+enum {
+    CB_ENCODE = 1,
+    CB_DECODE,
+    CB_ENCODE_KEY,
+    CB_DECODE_KEY,
+    CB_ENCODE_VALUE,
+    CB_DECODE_VALUE
+};
+
+static const struct {
+    const char *name;
+    int op;
+} convbench_ops[] = {
+    { "encode", CB_ENCODE },
+    { "decode", CB_DECODE },
+    { "encode_key", CB_ENCODE_KEY },
+    { "decode_key", CB_DECODE_KEY },
+    { "encode_value", CB_ENCODE_VALUE },
+    { "decode_value", CB_DECODE_VALUE },
+    { NULL, 0 }
+};
+
+#ifdef PYCBC_CONVBENCH_ALLOCS
+static unsigned long long convbench_nallocs;
+static PyMemAllocatorEx convbench_orig_mem;
+static PyMemAllocatorEx convbench_orig_obj;
+
+static void *
+count_malloc(void *ctx, size_t n)
+{
+    PyMemAllocatorEx *orig = ctx;
+    convbench_nallocs++;
+    return orig->malloc(orig->ctx, n);
+}
+
+static void *
+count_calloc(void *ctx, size_t nelem, size_t elsize)
+{
+    PyMemAllocatorEx *orig = ctx;
+    convbench_nallocs++;
+    return orig->calloc(orig->ctx, nelem, elsize);
+}
+
+static void *
+count_realloc(void *ctx, void *ptr, size_t n)
+{
+    PyMemAllocatorEx *orig = ctx;
+    convbench_nallocs++;
+    return orig->realloc(orig->ctx, ptr, n);
+}
+
+static void
+count_free(void *ctx, void *ptr)
+{
+    PyMemAllocatorEx *orig = ctx;
+    orig->free(orig->ctx, ptr);
+}
+
+/**
+ * Wrap the 'mem' and 'object' allocators (which are only used with the GIL
+ * held) with ones which count each allocation
+ */
+static void
+hook_allocators(void)
+{
+    PyMemAllocatorEx hook;
+
+    PyMem_GetAllocator(PYMEM_DOMAIN_MEM, &convbench_orig_mem);
+    PyMem_GetAllocator(PYMEM_DOMAIN_OBJ, &convbench_orig_obj);
+
+    hook.malloc = count_malloc;
+    hook.calloc = count_calloc;
+    hook.realloc = count_realloc;
+    hook.free = count_free;
+
+    hook.ctx = &convbench_orig_mem;
+    PyMem_SetAllocator(PYMEM_DOMAIN_MEM, &hook);
+
+    hook.ctx = &convbench_orig_obj;
+    PyMem_SetAllocator(PYMEM_DOMAIN_OBJ, &hook);
+}
+
+static void
+unhook_allocators(void)
+{
+    PyMem_SetAllocator(PYMEM_DOMAIN_MEM, &convbench_orig_mem);
+    PyMem_SetAllocator(PYMEM_DOMAIN_OBJ, &convbench_orig_obj);
+}
+#endif /* PYCBC_CONVBENCH_ALLOCS */
+
+/**
+ * Encode the input once, with the same routine as 'op' uses (or its
+ * encoding counterpart). The result is the input of the decoding benchmarks.
+ * @param encoded set to the object owning the buffer
+ * @return 0 on success, -1 with an exception set on failure
+ */
+static int
+encode_input(pycbc_Connection *conn, int op, PyObject *value,
+             lcb_uint32_t format, PyObject **encoded,
+             char **buf, size_t *nbuf, lcb_uint32_t *flags)
+{
+    *encoded = value;
+    *flags = format;
+
+    switch (op) {
+    case CB_ENCODE:
+    case CB_DECODE:
+        return pycbc_tc_simple_encode(encoded, buf, nbuf, format);
+
+    case CB_ENCODE_KEY:
+    case CB_DECODE_KEY:
+        return pycbc_tc_encode_key(conn, encoded, (void **)buf, nbuf);
+
+    default:
+        return pycbc_tc_encode_value(conn, encoded, NULL,
+                                     (void **)buf, nbuf, flags);
+    }
+}
+
+static int
+run_once(pycbc_Connection *conn, int op, PyObject *value,
+         lcb_uint32_t format, const char *inbuf, size_t ninbuf)
+{
+    PyObject *obj = value;
+    char *buf;
+    size_t nbuf;
+    lcb_uint32_t flags;
+    int rv = -1;
+
+    switch (op) {
+    case CB_ENCODE:
+        rv = pycbc_tc_simple_encode(&obj, &buf, &nbuf, format);
+        break;
+
+    case CB_DECODE:
+        rv = pycbc_tc_simple_decode(&obj, inbuf, ninbuf, format);
+        break;
+
+    case CB_ENCODE_KEY:
+        rv = pycbc_tc_encode_key(conn, &obj, (void **)&buf, &nbuf);
+        break;
+
+    case CB_DECODE_KEY:
+        rv = pycbc_tc_decode_key(conn, inbuf, ninbuf, &obj);
+        break;
+
+    case CB_ENCODE_VALUE:
+        rv = pycbc_tc_encode_value(conn, &obj, NULL,
+                                   (void **)&buf, &nbuf, &flags);
+        break;
+
+    case CB_DECODE_VALUE:
+        rv = pycbc_tc_decode_value(conn, inbuf, ninbuf, format, &obj);
+        break;
+    }
+
+    if (rv == 0) {
+        /** All of the conversions return a new reference */
+        Py_DECREF(obj);
+    }
+    return rv;
+}
+
+PyObject *
+pycbc_convbench(PyObject *self, PyObject *args, PyObject *kwargs)
+{
+    const char *opname;
+    PyObject *value;
+    PyObject *format_obj = NULL;
+    PyObject *format_ref = NULL;
+    PyObject *transcoder = Py_None;
+    unsigned long iterations = 10000;
+    unsigned long format = PYCBC_FMT_JSON;
+    unsigned long ii;
+    pycbc_Connection conn;
+    PyObject *encoded = NULL;
+    PyObject *ret = NULL;
+    PyObject *nallocs_obj;
+    char *inbuf = NULL;
+    size_t ninbuf = 0;
+    lcb_uint32_t inflags;
+    lcb_uint64_t begin;
+    double elapsed;
+    int op = 0;
+    int rv;
+
+    static char *kwlist[] = {
+            "op", "value", "format", "iterations", "transcoder", NULL
+    };
+
+    rv = PyArg_ParseTupleAndKeywords(args, kwargs, "sO|OkO", kwlist,
+                                     &opname, &value, &format_obj,
+                                     &iterations, &transcoder);
+    if (!rv) {
+        return NULL;
+    }
+
+    for (ii = 0; convbench_ops[ii].name; ii++) {
+        if (!strcmp(convbench_ops[ii].name, opname)) {
+            op = convbench_ops[ii].op;
+            break;
+        }
+    }
+
+    if (!op) {
+        PYCBC_EXC_WRAP(PYCBC_EXC_ARGUMENTS, 0, "Unknown conversion");
+        return NULL;
+    }
+
+    if (!iterations) {
+        PYCBC_EXC_WRAP(PYCBC_EXC_ARGUMENTS, 0,
+                       "Iterations must be greater than 0");
+        return NULL;
+    }
+
+    if (format_obj) {
+        if (pycbc_get_u32(format_obj, &format) < 0) {
+            return NULL;
+        }
+    } else {
+        format_obj = format_ref = pycbc_IntFromUL(format);
+        if (!format_obj) {
+            return NULL;
+        }
+    }
+
+    memset(&conn, 0, sizeof(conn));
+    conn.dfl_fmt = format_obj;
+    if (transcoder != Py_None) {
+        conn.tc = transcoder;
+    }
+
+    rv = encode_input(&conn, op, value, format, &encoded,
+                      &inbuf, &ninbuf, &inflags);
+    if (rv < 0) {
+        encoded = NULL;
+        goto GT_DONE;
+    }
+
+    if (op == CB_DECODE || op == CB_DECODE_KEY || op == CB_DECODE_VALUE) {
+        format = inflags;
+    }
+
+    /** Once untimed, to report any errors and warm up any caches */
+    rv = run_once(&conn, op, value, format, inbuf, ninbuf);
+    if (rv < 0) {
+        goto GT_DONE;
+    }
+
+#ifdef PYCBC_CONVBENCH_ALLOCS
+    convbench_nallocs = 0;
+    hook_allocators();
+#endif
+
+    begin = pycbc_monotonic_ns();
+    for (ii = 0; ii < iterations && rv == 0; ii++) {
+        rv = run_once(&conn, op, value, format, inbuf, ninbuf);
+    }
+    elapsed = (pycbc_monotonic_ns() - begin) / 1e9;
+
+#ifdef PYCBC_CONVBENCH_ALLOCS
+    unhook_allocators();
+    nallocs_obj = PyFloat_FromDouble((double)convbench_nallocs / iterations);
+#else
+    nallocs_obj = Py_None;
+    Py_INCREF(nallocs_obj);
+#endif
+
+    if (rv < 0 || !nallocs_obj) {
+        Py_XDECREF(nallocs_obj);
+        goto GT_DONE;
+    }
+
+    ret = Py_BuildValue("{s:k,s:d,s:N,s:n}",
+                        "iterations", iterations,
+                        "ns_per_op", elapsed * 1e9 / iterations,
+                        "allocs_per_op", nallocs_obj,
+                        "encoded_size", (Py_ssize_t)ninbuf);
+
+    GT_DONE:
+    Py_XDECREF(encoded);
+    Py_XDECREF(format_ref);
+    (void)self;
+    return ret;
+}
@@ -301,11 +301,11 @@ do_call_tc(pycbc_Connection *conn,
 }
 
 
-int
-pycbc_tc_encode_key(pycbc_Connection *conn,
-                    PyObject **key,
-                    void **buf,
-                    size_t *nbuf)
+static int
+encode_key(pycbc_Connection *conn,
+           PyObject **key,
+           void **buf,
+           size_t *nbuf)
 {
     int rv;
     Py_ssize_t plen;
@@ -354,11 +354,11 @@ pycbc_tc_encode_key(pycbc_Connection *conn,
     return 0;
 }
 
-int
-pycbc_tc_decode_key(pycbc_Connection *conn,
-                     const void *key,
-                     size_t nkey,
-                     PyObject **pobj)
+static int
+decode_key(pycbc_Connection *conn,
+           const void *key,
+           size_t nkey,
+           PyObject **pobj)
 {
     PyObject *bobj;
     int rv = 0;
@@ -399,13 +399,13 @@ pycbc_tc_decode_key(pycbc_Connection *conn,
     return 0;
 }
 
-int
-pycbc_tc_encode_value(pycbc_Connection *conn,
-                       PyObject **value,
-                       PyObject *flag_v,
-                       void **buf,
-                       size_t *nbuf,
-                       lcb_uint32_t *flags)
+static int
+encode_value(pycbc_Connection *conn,
+             PyObject **value,
+             PyObject *flag_v,
+             void **buf,
+             size_t *nbuf,
+             lcb_uint32_t *flags)
 {
     PyObject *flags_obj;
     PyObject *orig_value;
@@ -495,12 +495,12 @@ pycbc_tc_encode_value(pycbc_Connection *conn,
     return 0;
 }
 
-int
-pycbc_tc_decode_value(pycbc_Connection *conn,
-                       const void *value,
-                       size_t nvalue,
-                       lcb_uint32_t flags,
-                       PyObject **pobj)
+static int
+decode_value(pycbc_Connection *conn,
+             const void *value,
+             size_t nvalue,
+             lcb_uint32_t flags,
+             PyObject **pobj)
 {
     PyObject *result = NULL;
     PyObject *pint = NULL;
@@ -544,3 +544,57 @@ pycbc_tc_decode_value(pycbc_Connection *conn,
     *pobj = result;
     return 0;
 }
+
+/**
+ * The public conversion functions record their time in the timeline
+ */
+int
+pycbc_tc_encode_key(pycbc_Connection *conn,
+                    PyObject **key,
+                    void **buf,
+                    size_t *nbuf)
+{
+    lcb_uint64_t begin = PYCBC_TL_NOW();
+    int rv = encode_key(conn, key, buf, nbuf);
+    PYCBC_TL_SPAN("encode", "key", begin, rv == 0 ? *nbuf : 0);
+    return rv;
+}
+
+int
+pycbc_tc_decode_key(pycbc_Connection *conn,
+                    const void *key,
+                    size_t nkey,
+                    PyObject **pobj)
+{
+    lcb_uint64_t begin = PYCBC_TL_NOW();
+    int rv = decode_key(conn, key, nkey, pobj);
+    PYCBC_TL_SPAN("decode", "key", begin, nkey);
+    return rv;
+}
+
+int
+pycbc_tc_encode_value(pycbc_Connection *conn,
+                      PyObject **value,
+                      PyObject *flag_v,
+                      void **buf,
+                      size_t *nbuf,
+                      lcb_uint32_t *flags)
+{
+    lcb_uint64_t begin = PYCBC_TL_NOW();
+    int rv = encode_value(conn, value, flag_v, buf, nbuf, flags);
+    PYCBC_TL_SPAN("encode", "value", begin, rv == 0 ? *nbuf : 0);
+    return rv;
+}
+
+int
+pycbc_tc_decode_value(pycbc_Connection *conn,
+                      const void *value,
+                      size_t nvalue,
+                      lcb_uint32_t flags,
+                      PyObject **pobj)
+{
+    lcb_uint64_t begin = PYCBC_TL_NOW();
+    int rv = decode_value(conn, value, nvalue, flags, pobj);
+    PYCBC_TL_SPAN("decode", "value", begin, nvalue);
+    return rv;
+}
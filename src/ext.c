@@ -180,6 +180,24 @@ static PyMethodDef _libcouchbase_methods[] = {
                 METH_VARARGS,
                 "Get a helper by name"
         },
+#ifdef PYCBC_HAVE_CONVBENCH
+        { "_convbench", (PyCFunction)pycbc_convbench,
+                METH_VARARGS|METH_KEYWORDS,
+                "Internal function to benchmark key and value conversion"
+        },
+#endif
+        { "_timeline_enable", (PyCFunction)pycbc_timeline_enable,
+                METH_VARARGS|METH_KEYWORDS,
+                "Internal function to start recording the timeline"
+        },
+        { "_timeline_disable", (PyCFunction)pycbc_timeline_disable,
+                METH_NOARGS,
+                "Internal function to stop recording the timeline"
+        },
+        { "_timeline_collect", (PyCFunction)pycbc_timeline_collect,
+                METH_VARARGS|METH_KEYWORDS,
+                "Internal function to get the recorded timeline"
+        },
 
         { NULL }
 };
@@ -224,6 +242,7 @@ init_libcouchbase(void)
     PyObject *transcoder_type = NULL;
     PyObject *arg_type = NULL;
     PyObject *obsinfo_type = NULL;
+    PyObject *sampler_type = NULL;
 
     if (pycbc_ConnectionType_init(&connection_type) < 0) {
         INITERROR;
@@ -261,6 +280,10 @@ init_libcouchbase(void)
         INITERROR;
     }
 
+    if (pycbc_StatsSamplerType_init(&sampler_type) < 0) {
+        INITERROR;
+    }
+
 #endif /* PYCBC_CPYCHECKER */
 
 #if PY_MAJOR_VERSION >= 3
@@ -286,6 +309,7 @@ init_libcouchbase(void)
     PyModule_AddObject(m, "Arguments", arg_type);
     PyModule_AddObject(m, "Transcoder", transcoder_type);
     PyModule_AddObject(m, "ObserveInfo", obsinfo_type);
+    PyModule_AddObject(m, "StatsSampler", sampler_type);
 #endif /* PYCBC_CPYCHECKER */
 
     /**
@@ -132,19 +132,31 @@ get_common(pycbc_Connection *self,
     PyObject *is_quiet = NULL;
     lcb_error_t err;
     PyObject *ttl_O = NULL;
+    PyObject *timeout_O = NULL;
+    PyObject *hedge_O = NULL;
+    int replica_fallback = 0;
+    int replica_mode = 0;
     unsigned long ttl = 0;
+    lcb_uint32_t timeout = 0;
+    lcb_uint32_t hedge = 0;
 
     struct pycbc_common_vars cv = PYCBC_COMMON_VARS_STATIC_INIT;
 
-    static char *kwlist[] = { "keys", "ttl", "quiet", NULL };
+    static char *kwlist[] = {
+            "keys", "ttl", "quiet", "timeout", "replica_fallback", "hedge",
+            NULL
+    };
 
     rv = PyArg_ParseTupleAndKeywords(args,
                                      kwargs,
-                                     "O|OO",
+                                     "O|OOOiO",
                                      kwlist,
                                      &kobj,
                                      &ttl_O,
-                                     &is_quiet);
+                                     &is_quiet,
+                                     &timeout_O,
+                                     &replica_fallback,
+                                     &hedge_O);
 
     if (!rv) {
         PYCBC_EXCTHROW_ARGS()
@@ -156,6 +168,27 @@ get_common(pycbc_Connection *self,
         return NULL;
     }
 
+    if (pycbc_get_timeout(timeout_O, &timeout) < 0) {
+        return NULL;
+    }
+
+    if (pycbc_get_timeout(hedge_O, &hedge) < 0) {
+        return NULL;
+    }
+
+    if (replica_fallback) {
+        replica_mode |= PYCBC_REPLICA_FALLBACK;
+    }
+    if (hedge) {
+        replica_mode |= PYCBC_REPLICA_HEDGE;
+    }
+
+    if (replica_mode && (optype != PYCBC_CMD_GET || ttl)) {
+        PYCBC_EXC_WRAP(PYCBC_EXC_ARGUMENTS, 0,
+                       "Replica reads are only supported for plain 'get'");
+        return NULL;
+    }
+
     if (argopts & PYCBC_ARGOPT_MULTI) {
         rv = pycbc_oputil_check_sequence(kobj,
                                          optype,
@@ -181,12 +214,15 @@ get_common(pycbc_Connection *self,
         break;
     }
 
-    rv = pycbc_common_vars_init(&cv, self, argopts, ncmds, cmdsize, 0);
+    rv = pycbc_common_vars_init(&cv, self, argopts, optype, ncmds,
+                                cmdsize, 0);
 
     if (rv < 0) {
         return NULL;
     }
 
+    cv.timeout = timeout;
+
     if (argopts & PYCBC_ARGOPT_MULTI) {
         Py_ssize_t dictpos;
         PyObject *curseq, *iter = NULL;
@@ -235,6 +271,14 @@ get_common(pycbc_Connection *self,
         goto GT_DONE;
     }
 
+    if (replica_mode) {
+        cv.replica = pycbc_replica_new(self, &cv, replica_mode, hedge);
+        if (!cv.replica) {
+            goto GT_DONE;
+        }
+        cv.mres->replica = cv.replica;
+    }
+
     if (optype == PYCBC_CMD_TOUCH) {
         err = lcb_touch(self->instance, cv.mres, ncmds, cv.cmdlist.touch);
 
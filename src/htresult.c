@@ -15,6 +15,7 @@
  **/
 
 #include "pycbc.h"
+#include "oputil.h"
 #include "structmember.h"
 
 int
@@ -66,10 +67,34 @@ HttpResult_dealloc(pycbc_HttpResult *self)
         self->htreq = NULL;
     }
 
+    if (self->docs && ((pycbc_MultiResult *)self->docs)->nremaining) {
+        /** The documents' gets are still in flight, with this as cookie */
+        pycbc_MultiResult *docs = (pycbc_MultiResult *)self->docs;
+        PyObject *type, *value, *traceback;
+
+        PyErr_Fetch(&type, &value, &traceback);
+        if (pycbc_oputil_orphan(parent, docs, docs->nremaining) == -1) {
+            /** Leak it rather than free it under the callbacks */
+            PyErr_Clear();
+            Py_INCREF(docs);
+        }
+        docs->nremaining = 0;
+        PyErr_Restore(type, value, traceback);
+    }
+
     Py_XDECREF(self->http_data);
     Py_XDECREF(parent);
     Py_XDECREF(self->headers);
     Py_XDECREF(self->rowsbuf);
+    Py_XDECREF(self->row_error);
+    Py_XDECREF(self->docs);
+    Py_XDECREF(self->docids);
+    Py_XDECREF(self->page_docs);
+    Py_XDECREF(self->sink);
+    free(self->sinkbuf.s);
+    pycbc_htaggr_free(self->aggr);
+    pycbc_inflate_free(self->inflate);
+    free(self->rowsizes);
 
     if (self->rctx) {
         lcbex_vrow_free(self->rctx);
@@ -95,9 +120,32 @@ static struct PyMemberDef HttpResult_TABLE_members[] = {
                 READONLY, PyDoc_STR("HTTP URI")
         },
 
+        { "_sink_rows",
+                T_ULONG, offsetof(pycbc_HttpResult, nsink_rows),
+                READONLY, PyDoc_STR("Number of rows written to the sink")
+        },
+
+        { "_docs",
+                T_OBJECT, offsetof(pycbc_HttpResult, page_docs),
+                READONLY, PyDoc_STR("Documents for the rows returned by "
+                        "the last call to _fetch(), if fetched with "
+                        "'fetch_docs'")
+        },
+
         { NULL }
 };
 
+static PyObject *
+HttpResult_aggregates(pycbc_HttpResult *self, void *unused)
+{
+    (void)unused;
+
+    if (!self->aggr) {
+        Py_RETURN_NONE;
+    }
+    return pycbc_htaggr_result(self->aggr);
+}
+
 static PyGetSetDef HttpResult_TABLE_getset[] = {
         { "success",
                 (getter)HttpResult_success,
@@ -112,6 +160,13 @@ static PyGetSetDef HttpResult_TABLE_getset[] = {
                         "None unless 'fetch_headers' was passed to the request")
         },
 
+        { "_aggregates",
+                (getter)HttpResult_aggregates,
+                NULL,
+                PyDoc_STR("Values aggregated over the rows, if "
+                        "'aggregate' was passed to the request")
+        },
+
         { NULL }
 };
 
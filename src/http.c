@@ -16,6 +16,16 @@
 
 #include "pycbc.h"
 #include "oputil.h"
+#include <errno.h>
+#include <ctype.h>
+
+#ifdef _WIN32
+#include <io.h>
+#define pycbc_write(fd, buf, n) _write(fd, buf, (unsigned int)(n))
+#else
+#include <unistd.h>
+#define pycbc_write write
+#endif
 
 static void
 get_headers(pycbc_HttpResult *htres, const lcb_http_resp_t * resp)
@@ -63,7 +73,7 @@ get_data(pycbc_HttpResult *htres, const void *data, size_t ndata)
         htres->http_data = PyBytes_FromStringAndSize(data, ndata);
     }
 
-    if ((htres->htflags & PYCBC_HTRES_F_CHUNKED) &&
+    if ((htres->htflags & (PYCBC_HTRES_F_CHUNKED|PYCBC_HTRES_F_SINK)) &&
             htres->http_data &&
             PyList_Check(htres->http_data)) {
         /**
@@ -79,6 +89,109 @@ get_data(pycbc_HttpResult *htres, const void *data, size_t ndata)
 
 }
 
+/**
+ * Keep the current exception to be raised by _fetch(). Only the first one
+ * is kept.
+ */
+static void
+set_row_error(pycbc_HttpResult *htres)
+{
+    if (!htres->row_error) {
+        PyObject *type, *value, *traceback;
+        PyErr_Fetch(&type, &value, &traceback);
+        PyErr_NormalizeException(&type, &value, &traceback);
+        htres->row_error = value;
+        Py_XDECREF(type);
+        Py_XDECREF(traceback);
+    }
+    PyErr_Clear();
+}
+
+/**
+ * Find a response header by name, ignoring case
+ */
+static const char *
+find_header(const lcb_http_resp_t *resp, const char *name)
+{
+    const char * const *p;
+
+    if (!resp->v.v0.headers) {
+        return NULL;
+    }
+
+    for (p = resp->v.v0.headers; *p; p += 2) {
+        const char *a = p[0], *b = name;
+
+        while (*a && tolower((unsigned char)*a) == tolower((unsigned char)*b)) {
+            a++;
+            b++;
+        }
+
+        if (!*a && !*b) {
+            return p[1];
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * Create a decompressor if the response has a Content-Encoding. This is
+ * done once, when the first response containing headers is received.
+ * @return 0 on success, or -1 with an exception set if the encoding is not
+ * supported
+ */
+static int
+check_encoding(pycbc_HttpResult *htres, const lcb_http_resp_t *resp)
+{
+    const char *encoding;
+
+    if ((htres->htflags & PYCBC_HTRES_F_ENCODING) || !resp->v.v0.headers) {
+        return 0;
+    }
+
+    htres->htflags |= PYCBC_HTRES_F_ENCODING;
+    encoding = find_header(resp, "Content-Encoding");
+
+    if (!encoding || !*encoding || !strcmp(encoding, "identity")) {
+        return 0;
+    }
+
+    htres->inflate = pycbc_inflate_new(encoding);
+    if (!htres->inflate) {
+        htres->htflags |= PYCBC_HTRES_F_DISCARD;
+        return -1;
+    }
+    return 0;
+}
+
+static int
+append_body(void *arg, const char *data, size_t ndata)
+{
+    lcbex_vrow_buffer *buf = arg;
+
+    if (buf->alloc - buf->len < ndata) {
+        size_t n = buf->alloc ? buf->alloc : 16384;
+        char *tmp;
+
+        while (n - buf->len < ndata) {
+            n *= 2;
+        }
+
+        tmp = realloc(buf->s, n);
+        if (!tmp) {
+            PyErr_NoMemory();
+            return -1;
+        }
+        buf->s = tmp;
+        buf->alloc = n;
+    }
+
+    memcpy(buf->s + buf->len, data, ndata);
+    buf->len += ndata;
+    return 0;
+}
+
 /**
  * This callback does things a bit differently.
  * Instead of using a MultiResult, we use a single HttpResult object.
@@ -118,7 +231,28 @@ http_complete_callback(lcb_http_request_t req,
         lcb_breakout(instance);
     }
 
-    get_data(htres, resp->v.v0.bytes, resp->v.v0.nbytes);
+    if (check_encoding(htres, resp) == -1) {
+        set_row_error(htres);
+    }
+
+    if (htres->htflags & PYCBC_HTRES_F_DISCARD) {
+        get_data(htres, NULL, 0);
+
+    } else if (htres->inflate && resp->v.v0.nbytes) {
+        lcbex_vrow_buffer body = { NULL, 0, 0 };
+
+        if (pycbc_inflate_feed(htres->inflate,
+                               resp->v.v0.bytes, resp->v.v0.nbytes,
+                               append_body, &body) == -1) {
+            set_row_error(htres);
+        }
+
+        get_data(htres, body.s ? body.s : "", body.len);
+        free(body.s);
+
+    } else {
+        get_data(htres, resp->v.v0.bytes, resp->v.v0.nbytes);
+    }
     get_headers(htres, resp);
 
     PYCBC_CONN_THR_BEGIN(htres->parent);
@@ -126,6 +260,253 @@ http_complete_callback(lcb_http_request_t req,
     (void)req;
 }
 
+/**
+ * Schedule a get for the document of a row. This is done while the rest of
+ * the view is still streaming, so the documents are fetched in the same
+ * event loop iteration as the rows. The responses are placed in htres->docs.
+ *
+ * Rows (and so these gets) may arrive while another operation is running
+ * the event loop. The gets are therefore only counted in the 'nremaining' of
+ * htres->docs, which _fetch() waits for; counting them in the connection's
+ * would tie them to whichever operation happens to be waiting.
+ */
+static void
+fetch_doc(pycbc_HttpResult *htres, PyObject *row)
+{
+    int rv;
+    void *key;
+    size_t nkey;
+    lcb_error_t err;
+    PyObject *docid, *enckey;
+    lcb_get_cmd_t cmd = { 0 };
+    const lcb_get_cmd_t *cmdp = &cmd;
+    pycbc_Connection *conn = htres->parent;
+
+    if (!PyDict_Check(row)) {
+        return;
+    }
+
+    docid = PyDict_GetItemString(row, "id");
+    if (!docid || docid == Py_None) {
+        return;
+    }
+
+    /** Views may emit more than one row per document */
+    rv = PySet_Contains(htres->docids, docid);
+    if (rv == 0) {
+        rv = PySet_Add(htres->docids, docid);
+    } else if (rv == 1) {
+        return;
+    }
+
+    if (rv == -1) {
+        set_row_error(htres);
+        return;
+    }
+
+    enckey = docid;
+    if (pycbc_tc_encode_key(conn, &enckey, &key, &nkey) < 0) {
+        set_row_error(htres);
+        return;
+    }
+
+    cmd.v.v0.key = key;
+    cmd.v.v0.nkey = nkey;
+    err = lcb_get(conn->instance, htres->docs, 1, &cmdp);
+    Py_DECREF(enckey);
+
+    if (err != LCB_SUCCESS) {
+        PYCBC_EXC_WRAP_KEY(PYCBC_EXC_LCBERR, err,
+                           "Couldn't schedule document fetch", docid);
+        set_row_error(htres);
+        return;
+    }
+
+    ((pycbc_MultiResult *)htres->docs)->nremaining++;
+}
+
+/**
+ * Pass a chunk of a successful response to the sink. Once a write has
+ * failed, the rest of the response is discarded.
+ */
+static void
+write_sink(pycbc_HttpResult *htres, const char *data, size_t ndata)
+{
+    if (htres->row_error) {
+        return;
+    }
+
+    if (!htres->sink) {
+        while (ndata) {
+            long nw = pycbc_write(htres->sink_fd, data, ndata);
+            if (nw == -1) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                PyErr_SetFromErrno(PyExc_IOError);
+                set_row_error(htres);
+                return;
+            }
+            data += nw;
+            ndata -= nw;
+        }
+
+    } else {
+        PyObject *chunk, *ret = NULL;
+
+        chunk = PyBytes_FromStringAndSize(data, ndata);
+        if (chunk) {
+            ret = PyObject_CallFunctionObjArgs(htres->sink, chunk, NULL);
+            Py_DECREF(chunk);
+        }
+
+        if (!ret) {
+            set_row_error(htres);
+            return;
+        }
+        Py_DECREF(ret);
+    }
+}
+
+static void
+flush_sink(pycbc_HttpResult *htres)
+{
+    if (htres->sinkbuf.len) {
+        write_sink(htres, htres->sinkbuf.s, htres->sinkbuf.len);
+        htres->sinkbuf.len = 0;
+    }
+}
+
+/**
+ * Write a row (or its projection) to the sink as a line of JSON. Rows are
+ * collected into large blocks, so a Python sink is not called for each row
+ */
+static void
+export_row(pycbc_HttpResult *htres, const char *data, size_t ndata)
+{
+    lcbex_vrow_ctx_t *rctx = htres->rctx;
+    lcbex_vrow_buffer *out = &htres->sinkbuf;
+
+    if (htres->row_error) {
+        return;
+    }
+
+    if (pycbc_json_project_text(data, ndata, rctx->row_jprs,
+                                rctx->nrow_jprs, out) == -1) {
+        set_row_error(htres);
+        return;
+    }
+
+    if (out->len == out->alloc) {
+        /** No room for the newline */
+        char *tmp = realloc(out->s, out->alloc * 2);
+        if (!tmp) {
+            PyErr_NoMemory();
+            set_row_error(htres);
+            return;
+        }
+        out->s = tmp;
+        out->alloc *= 2;
+    }
+
+    out->s[out->len++] = '\n';
+    htres->nsink_rows++;
+
+    if (out->len >= PYCBC_SINK_BLOCKSIZE) {
+        flush_sink(htres);
+    }
+}
+
+/**
+ * Rows are only buffered up to a page while this request's _fetch() runs
+ * the event loop. Other operations on the connection (including fetching
+ * the documents for the rows) run it too, so limit what may be buffered
+ * meanwhile, including the partial row held by the parser.
+ *
+ * Requests which have not been fetched from yet are buffered in full: they
+ * were started ahead of being iterated over, and their rows cannot be
+ * consumed until their turn comes.
+ */
+static void
+check_overflow(pycbc_HttpResult *htres)
+{
+    size_t nrows = PyList_GET_SIZE(htres->rowsbuf);
+    size_t nbytes = htres->nrowsbytes + htres->rctx->current_buf.len;
+
+    if ((htres->htflags & PYCBC_HTRES_F_DISCARD) ||
+            !(htres->htflags & PYCBC_HTRES_F_FETCHED)) {
+        return;
+    }
+
+    if (!(htres->max_rows &&
+            nrows > htres->nbacklog_rows +
+                    htres->max_rows * PYCBC_HTRES_OVERFLOW) &&
+            !(htres->max_bytes &&
+                    nbytes > htres->nbacklog_bytes +
+                            htres->max_bytes * PYCBC_HTRES_OVERFLOW)) {
+        return;
+    }
+
+    PYCBC_EXC_WRAP(PYCBC_EXC_LCBERR, LCB_CLIENT_ENOMEM,
+                   "Too many rows buffered while other operations used the "
+                   "connection; fetch the rows more often, or raise the "
+                   "page limits");
+    set_row_error(htres);
+    htres->htflags |= PYCBC_HTRES_F_DISCARD;
+}
+
+/**
+ * Convert a row into a dict. Rows are decoded straight from the parser's
+ * buffer, falling back to the json module for anything the built-in decoder
+ * rejects.
+ */
+static void
+add_row(pycbc_HttpResult *htres, const char *data, size_t ndata)
+{
+    lcbex_vrow_ctx_t *rctx = htres->rctx;
+    PyObject *o = pycbc_json_decode_projected(data, ndata,
+                                              rctx->row_jprs,
+                                              rctx->nrow_jprs);
+
+    if (!o && !rctx->nrow_jprs) {
+        PyErr_Clear();
+        pycbc_tc_simple_decode(&o, data, ndata, PYCBC_FMT_JSON);
+    }
+
+    if (!o) {
+        set_row_error(htres);
+        return;
+    }
+
+    if (htres->max_bytes && PyList_GET_SIZE(htres->rowsbuf) ==
+            (Py_ssize_t)htres->nrowsizes_alloc) {
+        size_t n = htres->nrowsizes_alloc ? htres->nrowsizes_alloc * 2 : 64;
+        size_t *tmp = realloc(htres->rowsizes, n * sizeof(*tmp));
+        if (!tmp) {
+            Py_DECREF(o);
+            PyErr_NoMemory();
+            set_row_error(htres);
+            return;
+        }
+        htres->rowsizes = tmp;
+        htres->nrowsizes_alloc = n;
+    }
+
+    if (htres->max_bytes) {
+        htres->rowsizes[PyList_GET_SIZE(htres->rowsbuf)] = ndata;
+        htres->nrowsbytes += ndata;
+    }
+
+    PyList_Append(htres->rowsbuf, o);
+
+    if (htres->htflags & PYCBC_HTRES_F_DOCS) {
+        fetch_doc(htres, o);
+    }
+
+    Py_DECREF(o);
+    check_overflow(htres);
+}
+
 static void
 http_vrow_callback(lcbex_vrow_ctx_t *rctx,
                    const void *cookie,
@@ -133,22 +514,58 @@ http_vrow_callback(lcbex_vrow_ctx_t *rctx,
 {
     pycbc_HttpResult *htres = (pycbc_HttpResult *)cookie;
 
-    if (row->type == LCBEX_VROW_ROW) {
-        if (row->ndata) {
-            PyObject *s = PyUnicode_FromStringAndSize(row->data, row->ndata);
-            PyList_Append(htres->rowsbuf, s);
-            Py_DECREF(s);
-        }
+    (void)rctx;
 
-    } else {
+    if (row->type != LCBEX_VROW_ROW) {
         Py_XDECREF(htres->http_data);
         htres->http_data = NULL;
         get_data(htres, row->data, row->ndata);
+        return;
     }
 
-    (void)rctx;
+    if (!row->ndata) {
+        return;
+    }
+
+    if (htres->aggr) {
+        if (!htres->row_error &&
+                pycbc_htaggr_add(htres->aggr, row->data, row->ndata) == -1) {
+            set_row_error(htres);
+        }
+
+    } else if (htres->htflags & PYCBC_HTRES_F_SINK) {
+        export_row(htres, row->data, row->ndata);
+
+    } else {
+        add_row(htres, row->data, row->ndata);
+    }
 }
 
+/**
+ * Pass a (decompressed) chunk of the body on to the row parser, the sink
+ * or the result's value
+ */
+static int
+deliver_body(void *arg, const char *data, size_t ndata)
+{
+    pycbc_HttpResult *htres = arg;
+
+    if (htres->rctx) {
+        if (!(htres->htflags & PYCBC_HTRES_F_DISCARD)) {
+            lcbex_vrow_feed(htres->rctx, data, ndata);
+        }
+        if (htres->rowsbuf) {
+            check_overflow(htres);
+        }
+
+    } else if ((htres->htflags & PYCBC_HTRES_F_SINK) && !htres->http_data) {
+        write_sink(htres, data, ndata);
+
+    } else {
+        get_data(htres, data, ndata);
+    }
+    return 0;
+}
 
 static void
 http_data_callback(lcb_http_request_t req,
@@ -169,8 +586,11 @@ http_data_callback(lcb_http_request_t req,
     if (err != LCB_SUCCESS || resp->v.v0.status < 200 || resp->v.v0.status > 299) {
         PyObject *old_data = htres->http_data;
 
-        lcbex_vrow_free(htres->rctx);
-        htres->rctx = NULL;
+        /** Requests with a plain sink, or a second error chunk, have none */
+        if (htres->rctx) {
+            lcbex_vrow_free(htres->rctx);
+            htres->rctx = NULL;
+        }
         htres->http_data = PyList_New(0);
 
         if (old_data) {
@@ -181,11 +601,23 @@ http_data_callback(lcb_http_request_t req,
         }
     }
 
-    if (htres->rctx) {
-        lcbex_vrow_feed(htres->rctx, resp->v.v0.bytes, resp->v.v0.nbytes);
+    if (check_encoding(htres, resp) == -1) {
+        set_row_error(htres);
+    }
 
-    } else if (resp->v.v0.bytes) {
-        get_data(htres, resp->v.v0.bytes, resp->v.v0.nbytes);
+    if (htres->htflags & PYCBC_HTRES_F_DISCARD) {
+        /** Compressed with an unsupported encoding */
+
+    } else if (htres->inflate) {
+        if (resp->v.v0.nbytes &&
+                pycbc_inflate_feed(htres->inflate,
+                                   resp->v.v0.bytes, resp->v.v0.nbytes,
+                                   deliver_body, htres) == -1) {
+            set_row_error(htres);
+        }
+
+    } else if (htres->rctx || resp->v.v0.bytes) {
+        deliver_body(htres, resp->v.v0.bytes, resp->v.v0.nbytes);
     }
 
     if (!htres->parent->nremaining) {
@@ -198,14 +630,113 @@ http_data_callback(lcb_http_request_t req,
     (void)instance;
 }
 
+/**
+ * Wrappers recording the time spent in each callback in the timeline
+ */
+static void
+http_complete_callback_tl(lcb_http_request_t req,
+                          lcb_t instance,
+                          const void *cookie,
+                          lcb_error_t err,
+                          const lcb_http_resp_t *resp)
+{
+    lcb_uint64_t begin = PYCBC_TL_NOW();
+    http_complete_callback(req, instance, cookie, err, resp);
+    PYCBC_TL_SPAN("callback", "http_complete_callback", begin,
+                  resp->v.v0.nbytes);
+}
+
+static void
+http_data_callback_tl(lcb_http_request_t req,
+                      lcb_t instance,
+                      const void *cookie,
+                      lcb_error_t err,
+                      const lcb_http_resp_t *resp)
+{
+    lcb_uint64_t begin = PYCBC_TL_NOW();
+    http_data_callback(req, instance, cookie, err, resp);
+    PYCBC_TL_SPAN("callback", "http_data_callback", begin,
+                  resp->v.v0.nbytes);
+}
+
 void
 pycbc_http_callbacks_init(lcb_t instance)
 {
-    lcb_set_http_complete_callback(instance, http_complete_callback);
-    lcb_set_http_data_callback(instance, http_data_callback);
+    lcb_set_http_complete_callback(instance, http_complete_callback_tl);
+    lcb_set_http_data_callback(instance, http_data_callback_tl);
 }
 
 
+/**
+ * Set the row projection from a sequence of JSON pointer strings
+ */
+static int
+set_projection(lcbex_vrow_ctx_t *rctx, PyObject *fields)
+{
+    Py_ssize_t ii, nfields;
+    PyObject *seq, **bufs = NULL;
+    const char **paths = NULL;
+    int rv = -1;
+
+    seq = PySequence_Fast(fields, "fields must be a sequence");
+    if (!seq) {
+        PYCBC_EXCTHROW_ARGS();
+        return -1;
+    }
+
+    nfields = PySequence_Fast_GET_SIZE(seq);
+    if (nfields > PYCBC_JSON_MAXFIELDS) {
+        PYCBC_EXC_WRAP_OBJ(PYCBC_EXC_ARGUMENTS, 0, "Too many fields", fields);
+        goto GT_DONE;
+    }
+
+    bufs = calloc(nfields + 1, sizeof(*bufs));
+    paths = calloc(nfields + 1, sizeof(*paths));
+    if (!(bufs && paths)) {
+        PyErr_SetNone(PyExc_MemoryError);
+        goto GT_DONE;
+    }
+
+    for (ii = 0; ii < nfields; ii++) {
+        PyObject *field = PySequence_Fast_GET_ITEM(seq, ii);
+
+        if (PyUnicode_Check(field)) {
+            bufs[ii] = PyUnicode_AsUTF8String(field);
+            if (!bufs[ii]) {
+                goto GT_DONE;
+            }
+        } else if (PyBytes_Check(field)) {
+            bufs[ii] = field;
+            Py_INCREF(field);
+        } else {
+            PYCBC_EXC_WRAP_OBJ(PYCBC_EXC_ARGUMENTS, 0,
+                               "Field must be a string", field);
+            goto GT_DONE;
+        }
+        paths[ii] = PyBytes_AS_STRING(bufs[ii]);
+    }
+
+    if (lcbex_vrow_set_projection(rctx, paths, nfields) != 0) {
+        PYCBC_EXC_WRAP_OBJ(PYCBC_EXC_ARGUMENTS, 0,
+                           "Invalid field path (must be a JSON pointer)",
+                           fields);
+        goto GT_DONE;
+    }
+
+    rv = 0;
+
+    GT_DONE:
+    if (bufs) {
+        for (ii = 0; ii < nfields; ii++) {
+            Py_XDECREF(bufs[ii]);
+        }
+    }
+    free(bufs);
+    free((void *)paths);
+    Py_DECREF(seq);
+    return rv;
+}
+
 static int
 maybe_raise(pycbc_HttpResult *htres)
 {
@@ -227,37 +758,142 @@ maybe_raise(pycbc_HttpResult *htres)
     return 1;
 }
 
-PyObject *
-pycbc_Connection__http_request(pycbc_Connection *self,
-                               PyObject *args,
-                               PyObject *kwargs)
+static pycbc_HttpResult *
+new_result(pycbc_Connection *self,
+           const char *path,
+           unsigned short value_format,
+           PyObject *quiet_O,
+           PyObject *fetch_headers_O)
 {
-    int rv;
-    int method;
-    int reqtype;
-    unsigned short value_format = 0;
-    lcb_error_t err;
+    pycbc_HttpResult *htres;
 
-    const char *body = NULL;
-    PyObject *ret = NULL;
-    PyObject *quiet_O = NULL;
-    PyObject *chunked_O = NULL;
-    PyObject *fetch_headers_O = Py_False;
-    pycbc_strlen_t nbody = 0;
+    htres = pycbc_httpresult_new(self);
+    htres->key = pycbc_SimpleStringZ(path);
+    htres->format = value_format;
+    htres->htflags = 0;
+
+    if (quiet_O != NULL && quiet_O != Py_None && PyObject_IsTrue(quiet_O)) {
+        htres->htflags |= PYCBC_HTRES_F_QUIET;
+    }
+
+    if (fetch_headers_O && PyObject_IsTrue(fetch_headers_O)) {
+        htres->headers = PyDict_New();
+    }
+
+    return htres;
+}
+
+/**
+ * Set the destination for a response's body. This may be a file descriptor,
+ * an object with a 'write' method, or a callable.
+ */
+static int
+set_sink(pycbc_HttpResult *htres, PyObject *sink)
+{
+    if (PyNumber_Check(sink)) {
+        long fd = PyLong_AsLong(sink);
+        if (fd == -1 && PyErr_Occurred()) {
+            return -1;
+        }
+
+        if (fd < 0 || fd > INT_MAX) {
+            PYCBC_EXC_WRAP_OBJ(PYCBC_EXC_ARGUMENTS, 0,
+                               "Invalid file descriptor", sink);
+            return -1;
+        }
+
+        htres->sink_fd = (int)fd;
+
+    } else if (PyObject_HasAttrString(sink, "write")) {
+        htres->sink = PyObject_GetAttrString(sink, "write");
+        if (!htres->sink) {
+            return -1;
+        }
+
+    } else if (PyCallable_Check(sink)) {
+        htres->sink = sink;
+        Py_INCREF(sink);
+
+    } else {
+        PYCBC_EXC_WRAP_OBJ(PYCBC_EXC_ARGUMENTS, 0,
+                           "Sink must be a file descriptor, a file-like "
+                           "object, or a callable", sink);
+        return -1;
+    }
+
+    htres->htflags |= PYCBC_HTRES_F_SINK;
+    return 0;
+}
+
+static lcb_error_t
+make_request(pycbc_HttpResult *htres,
+             int reqtype,
+             lcb_http_cmd_t *htcmd,
+             int method,
+             const char *path,
+             const char *content_type,
+             const char *body,
+             pycbc_strlen_t nbody)
+{
+    lcb_error_t err;
+    lcb_uint64_t begin;
+
+    htcmd->v.v1.body = body;
+    htcmd->v.v1.nbody = nbody;
+    htcmd->v.v1.content_type = content_type;
+    htcmd->v.v1.path = path;
+    htcmd->v.v1.npath = strlen(path);
+    htcmd->v.v1.method = method;
+
+    begin = PYCBC_TL_NOW();
+    err = lcb_make_http_request(htres->parent->instance,
+                                htres,
+                                reqtype,
+                                htcmd,
+                                &htres->htreq);
+    PYCBC_TL_SPAN("schedule", "http", begin, nbody);
+    return err;
+}
+
+PyObject *
+pycbc_Connection__http_request(pycbc_Connection *self,
+                               PyObject *args,
+                               PyObject *kwargs)
+{
+    int rv;
+    int method;
+    int reqtype;
+    unsigned short value_format = 0;
+    lcb_error_t err;
+
+    const char *body = NULL;
+    PyObject *ret = NULL;
+    PyObject *quiet_O = NULL;
+    PyObject *chunked_O = NULL;
+    PyObject *fetch_headers_O = Py_False;
+    PyObject *fields_O = NULL;
+    PyObject *fetch_docs_O = NULL;
+    PyObject *sink_O = NULL;
+    PyObject *aggregate_O = NULL;
+    PyObject *bounds_O = NULL;
+    unsigned long max_rows = 0, max_bytes = 0;
+    pycbc_strlen_t nbody = 0;
     const char *path = NULL;
     const char *content_type = NULL;
     pycbc_HttpResult *htres;
+    lcb_uint64_t tl_begin = PYCBC_TL_NOW();
 
     lcb_http_cmd_t htcmd = { 0 };
 
     static char *kwlist[] = {
             "type", "method", "path", "content_type", "post_data",
             "response_format", "quiet", "fetch_headers",
-            "chunked", NULL
+            "chunked", "fields", "fetch_docs", "max_rows", "max_bytes",
+            "sink", "aggregate", "bounds", NULL
     };
 
     rv = PyArg_ParseTupleAndKeywords(args, kwargs,
-                                     "iis|zz#HOOO", kwlist,
+                                     "iis|zz#HOOOOOkkOOO", kwlist,
                                      &reqtype,
                                      &method,
                                      &path,
@@ -267,7 +903,14 @@ pycbc_Connection__http_request(pycbc_Connection *self,
                                      &value_format,
                                      &quiet_O,
                                      &fetch_headers_O,
-                                     &chunked_O);
+                                     &chunked_O,
+                                     &fields_O,
+                                     &fetch_docs_O,
+                                     &max_rows,
+                                     &max_bytes,
+                                     &sink_O,
+                                     &aggregate_O,
+                                     &bounds_O);
     if (!rv) {
         PYCBC_EXCTHROW_ARGS();
         return NULL;
@@ -278,18 +921,7 @@ pycbc_Connection__http_request(pycbc_Connection *self,
     }
 
 
-    htres = pycbc_httpresult_new(self);
-    htres->key = pycbc_SimpleStringZ(path);
-    htres->format = value_format;
-    htres->htflags = 0;
-
-    if (quiet_O != NULL && quiet_O != Py_None && PyObject_IsTrue(quiet_O)) {
-        htres->htflags |= PYCBC_HTRES_F_QUIET;
-    }
-
-    if (fetch_headers_O && PyObject_IsTrue(fetch_headers_O)) {
-        htres->headers = PyDict_New();
-    }
+    htres = new_result(self, path, value_format, quiet_O, fetch_headers_O);
 
     if (chunked_O && PyObject_IsTrue(chunked_O)) {
         htcmd.v.v0.chunked = 1;
@@ -297,28 +929,95 @@ pycbc_Connection__http_request(pycbc_Connection *self,
         htres->rctx->callback = http_vrow_callback;
         htres->rctx->user_cookie = htres;
         htres->htflags |= PYCBC_HTRES_F_CHUNKED;
-    }
 
-    htcmd.v.v1.body = body;
-    htcmd.v.v1.nbody = nbody;
-    htcmd.v.v1.content_type = content_type;
-    htcmd.v.v1.path = path;
-    htcmd.v.v1.npath = strlen(path);
-    htcmd.v.v1.method = method;
+        if (fields_O && fields_O != Py_None &&
+                set_projection(htres->rctx, fields_O) == -1) {
+            goto GT_DONE;
+        }
 
+        if (fetch_docs_O && PyObject_IsTrue(fetch_docs_O)) {
+            htres->htflags |= PYCBC_HTRES_F_DOCS;
+        }
 
-    err = lcb_make_http_request(self->instance,
-                                htres,
-                                reqtype,
-                                &htcmd,
-                                &htres->htreq);
+        /** With a sink, rows are exported rather than buffered */
+        if (sink_O && sink_O != Py_None && set_sink(htres, sink_O) == -1) {
+            goto GT_DONE;
+        }
+
+        if ((htres->htflags & PYCBC_HTRES_F_SINK) &&
+                (htres->htflags & PYCBC_HTRES_F_DOCS)) {
+            PYCBC_EXC_WRAP(PYCBC_EXC_ARGUMENTS, 0,
+                           "fetch_docs may not be used with a sink");
+            goto GT_DONE;
+        }
+
+        /** Likewise, rows may be aggregated */
+        if (aggregate_O && aggregate_O != Py_None) {
+            if (htres->htflags & (PYCBC_HTRES_F_SINK|PYCBC_HTRES_F_DOCS)) {
+                PYCBC_EXC_WRAP(PYCBC_EXC_ARGUMENTS, 0,
+                               "aggregate may not be used with a sink or "
+                               "fetch_docs");
+                goto GT_DONE;
+            }
+
+            htres->aggr = pycbc_htaggr_new(aggregate_O, bounds_O);
+            if (!htres->aggr) {
+                goto GT_DONE;
+            }
+        }
+
+        htres->max_rows = max_rows;
+        htres->max_bytes = max_bytes;
+
+        /**
+         * Rows may arrive while another request's _fetch() is running the
+         * event loop, so the buffers must exist from the start
+         */
+        htres->rowsbuf = PyList_New(0);
+        if (!htres->rowsbuf) {
+            goto GT_DONE;
+        }
+
+        if (htres->htflags & PYCBC_HTRES_F_DOCS) {
+            htres->docs = pycbc_multiresult_new(self);
+            htres->docids = PySet_New(NULL);
+            if (!(htres->docs && htres->docids)) {
+                goto GT_DONE;
+            }
+
+            /** Missing documents are reported in their results */
+            ((pycbc_MultiResult *)htres->docs)->no_raise_enoent = 1;
+            ((pycbc_MultiResult *)htres->docs)->viewdocs = 1;
+        }
+
+    } else if ((fields_O && fields_O != Py_None) ||
+            (fetch_docs_O && PyObject_IsTrue(fetch_docs_O)) ||
+            (aggregate_O && aggregate_O != Py_None)) {
+        PYCBC_EXC_WRAP(PYCBC_EXC_ARGUMENTS, 0,
+                       "fields, fetch_docs and aggregate may only be used "
+                       "with chunked requests");
+        goto GT_DONE;
+
+    } else if (sink_O && sink_O != Py_None) {
+        /**
+         * The library hands the body over as it arrives rather than
+         * buffering it, but this call still waits for the whole response
+         */
+        htcmd.v.v0.chunked = 1;
+        if (set_sink(htres, sink_O) == -1) {
+            goto GT_DONE;
+        }
+    }
+
+    err = make_request(htres, reqtype, &htcmd, method, path, content_type,
+                       body, nbody);
 
     if (err != LCB_SUCCESS) {
         PYCBC_EXCTHROW_SCHED(err);
         goto GT_DONE;
     }
 
-    if (htcmd.v.v0.chunked) {
+    if (htres->htflags & PYCBC_HTRES_F_CHUNKED) {
         ret = (PyObject*)htres;
         htres = NULL;
         goto GT_DONE;
@@ -337,18 +1036,373 @@ pycbc_Connection__http_request(pycbc_Connection *self,
         goto GT_DONE;
     }
 
+    if (htres->row_error) {
+        PyErr_SetObject((PyObject*)Py_TYPE(htres->row_error),
+                        htres->row_error);
+        goto GT_DONE;
+    }
+
     ret = (PyObject*)htres;
     htres = NULL;
 
     GT_DONE:
     Py_XDECREF(htres);
     pycbc_oputil_conn_unlock(self);
+    PYCBC_TL_SPAN("operation", "http", tl_begin, 1);
     return ret;
 }
 
 /**
- * Fetches a bunch of results from the network. Returns False when
+ * Schedule a request for _http_request_multi(). The request is described by
+ * a dictionary of (non-chunked) _http_request() arguments. On success the
+ * request is counted in the connection's 'nremaining'
+ */
+static pycbc_HttpResult *
+schedule_spec(pycbc_Connection *self, PyObject *spec, PyObject *quiet_O)
+{
+    int rv;
+    int method;
+    int reqtype;
+    unsigned short value_format = 0;
+    const char *body = NULL;
+    const char *path = NULL;
+    const char *content_type = NULL;
+    pycbc_strlen_t nbody = 0;
+    PyObject *fetch_headers_O = Py_False;
+    PyObject *empty;
+    pycbc_HttpResult *htres;
+    lcb_error_t err;
+    lcb_http_cmd_t htcmd = { 0 };
+
+    static char *kwlist[] = {
+            "type", "method", "path", "content_type", "post_data",
+            "response_format", "quiet", "fetch_headers", NULL
+    };
+
+    if (!PyDict_Check(spec)) {
+        PYCBC_EXC_WRAP_OBJ(PYCBC_EXC_ARGUMENTS, 0,
+                           "Request must be a dictionary", spec);
+        return NULL;
+    }
+
+    empty = PyTuple_New(0);
+    if (!empty) {
+        return NULL;
+    }
+
+    rv = PyArg_ParseTupleAndKeywords(empty, spec,
+                                     "iis|zz#HOO", kwlist,
+                                     &reqtype,
+                                     &method,
+                                     &path,
+                                     &content_type,
+                                     &body,
+                                     &nbody,
+                                     &value_format,
+                                     &quiet_O,
+                                     &fetch_headers_O);
+    Py_DECREF(empty);
+
+    if (!rv) {
+        PYCBC_EXCTHROW_ARGS();
+        return NULL;
+    }
+
+    htres = new_result(self, path, value_format, quiet_O, fetch_headers_O);
+    err = make_request(htres, reqtype, &htcmd, method, path, content_type,
+                       body, nbody);
+
+    if (err != LCB_SUCCESS) {
+        Py_DECREF(htres);
+        PYCBC_EXCTHROW_SCHED(err);
+        return NULL;
+    }
+
+    self->nremaining++;
+    return htres;
+}
+
+/**
+ * Cancel any requests in the list which have not yet completed
+ */
+static void
+cancel_pending(pycbc_Connection *self, PyObject *results)
+{
+    Py_ssize_t ii;
+
+    for (ii = 0; ii < PyList_GET_SIZE(results); ii++) {
+        pycbc_HttpResult *htres;
+
+        htres = (pycbc_HttpResult *)PyList_GET_ITEM(results, ii);
+        if (!htres || !htres->htreq) {
+            continue;
+        }
+
+        lcb_cancel_http_request(self->instance, htres->htreq);
+        htres->htreq = NULL;
+        self->nremaining--;
+    }
+}
+
+/**
+ * Schedules several requests and waits for all of them at once, so that
+ * they are executed concurrently rather than one round trip at a time.
+ * Returns a list of results in the same order as the requests.
+ */
+PyObject *
+pycbc_Connection__http_request_multi(pycbc_Connection *self,
+                                     PyObject *args,
+                                     PyObject *kwargs)
+{
+    int rv;
+    Py_ssize_t ii, nreqs;
+    PyObject *specs = NULL;
+    PyObject *quiet_O = NULL;
+    PyObject *seq;
+    PyObject *ret = NULL;
+    lcb_error_t err;
+    lcb_uint64_t tl_begin = PYCBC_TL_NOW();
+
+    static char *kwlist[] = { "requests", "quiet", NULL };
+
+    rv = PyArg_ParseTupleAndKeywords(args, kwargs, "O|O", kwlist,
+                                     &specs, &quiet_O);
+    if (!rv) {
+        PYCBC_EXCTHROW_ARGS();
+        return NULL;
+    }
+
+    seq = PySequence_Fast(specs, "requests must be a sequence");
+    if (!seq) {
+        return NULL;
+    }
+
+    if (-1 == pycbc_oputil_conn_lock(self)) {
+        Py_DECREF(seq);
+        return NULL;
+    }
+
+    nreqs = PySequence_Fast_GET_SIZE(seq);
+    ret = PyList_New(nreqs);
+    if (!ret) {
+        goto GT_DONE;
+    }
+
+    for (ii = 0; ii < nreqs; ii++) {
+        pycbc_HttpResult *htres;
+
+        htres = schedule_spec(self, PySequence_Fast_GET_ITEM(seq, ii),
+                              quiet_O);
+        if (!htres) {
+            goto GT_ERROR;
+        }
+        PyList_SET_ITEM(ret, ii, (PyObject *)htres);
+    }
+
+    if (nreqs) {
+        err = pycbc_oputil_wait_common(self);
+        if (err != LCB_SUCCESS) {
+            PYCBC_EXCTHROW_WAIT(err);
+            goto GT_ERROR;
+        }
+    }
+
+    for (ii = 0; ii < nreqs; ii++) {
+        if (maybe_raise((pycbc_HttpResult *)PyList_GET_ITEM(ret, ii))) {
+            Py_CLEAR(ret);
+            break;
+        }
+    }
+    goto GT_DONE;
+
+    GT_ERROR:
+    cancel_pending(self, ret);
+    Py_CLEAR(ret);
+
+    GT_DONE:
+    Py_DECREF(seq);
+    pycbc_oputil_conn_unlock(self);
+    PYCBC_TL_SPAN("operation", "http", tl_begin, nreqs);
+    return ret;
+}
+
+/**
+ * Whether enough rows are buffered to return a full page
+ */
+static int
+page_ready(pycbc_HttpResult *self)
+{
+    Py_ssize_t nrows = PyList_GET_SIZE(self->rowsbuf);
+
+    if (!self->max_rows && !self->max_bytes) {
+        return nrows > 0;
+    }
+
+    if (self->max_rows && (unsigned long)nrows >= self->max_rows) {
+        return 1;
+    }
+
+    return self->max_bytes && self->nrowsbytes >= self->max_bytes;
+}
+
+/**
+ * Collect the documents for 'rows' into a new MultiResult, and drop the
+ * documents which are not needed by any row still buffered.
+ *
+ * htres->docs itself is kept, as it is the cookie of any gets in flight.
+ */
+static int
+take_docs(pycbc_HttpResult *self, PyObject *rows)
+{
+    Py_ssize_t ii;
+    pycbc_MultiResult *page;
+    PyObject *keepids = NULL, *fetched = NULL;
+
+    page = (pycbc_MultiResult *)pycbc_multiresult_new(self->parent);
+    keepids = PySet_New(NULL);
+
+    if (!(page && keepids)) {
+        goto GT_ERROR;
+    }
+
+    for (ii = 0; ii < PyList_GET_SIZE(rows); ii++) {
+        PyObject *row = PyList_GET_ITEM(rows, ii);
+        PyObject *docid, *doc;
+
+        if (!PyDict_Check(row)) {
+            continue;
+        }
+
+        docid = PyDict_GetItemString(row, "id");
+        if (!docid) {
+            continue;
+        }
+
+        doc = PyDict_GetItem(self->docs, docid);
+        if (doc && PyDict_SetItem((PyObject *)page, docid, doc) == -1) {
+            goto GT_ERROR;
+        }
+    }
+
+    for (ii = 0; ii < PyList_GET_SIZE(self->rowsbuf); ii++) {
+        PyObject *row = PyList_GET_ITEM(self->rowsbuf, ii);
+        PyObject *docid;
+
+        if (!PyDict_Check(row)) {
+            continue;
+        }
+
+        docid = PyDict_GetItemString(row, "id");
+        if (docid && PySet_Add(keepids, docid) == -1) {
+            goto GT_ERROR;
+        }
+    }
+
+    fetched = PyDict_Keys(self->docs);
+    if (!fetched) {
+        goto GT_ERROR;
+    }
+
+    for (ii = 0; ii < PyList_GET_SIZE(fetched); ii++) {
+        PyObject *docid = PyList_GET_ITEM(fetched, ii);
+        int rv = PySet_Contains(keepids, docid);
+
+        if (rv == 0) {
+            rv = PyDict_DelItem(self->docs, docid);
+        }
+
+        if (rv == -1) {
+            goto GT_ERROR;
+        }
+    }
+
+    Py_DECREF(fetched);
+    Py_XDECREF(self->page_docs);
+    Py_DECREF(self->docids);
+    self->page_docs = (PyObject *)page;
+    self->docids = keepids;
+    return 0;
+
+    GT_ERROR:
+    Py_XDECREF(page);
+    Py_XDECREF(keepids);
+    Py_XDECREF(fetched);
+    return -1;
+}
+
+/**
+ * Whether any documents for the buffered rows are still being fetched
+ */
+static int
+docs_pending(pycbc_HttpResult *self)
+{
+    return self->docs && ((pycbc_MultiResult *)self->docs)->nremaining;
+}
+
+/**
+ * Remove a page of rows from the front of the buffer
+ */
+static PyObject *
+take_page(pycbc_HttpResult *self)
+{
+    Py_ssize_t nrows = PyList_GET_SIZE(self->rowsbuf);
+    Py_ssize_t ntake = nrows;
+    size_t nbytes = 0;
+    PyObject *ret;
+
+    if (self->max_rows && (unsigned long)ntake > self->max_rows) {
+        ntake = self->max_rows;
+    }
+
+    if (self->max_bytes) {
+        Py_ssize_t ii;
+
+        for (ii = 0, nbytes = 0; ii < ntake; ii++) {
+            nbytes += self->rowsizes[ii];
+            if (nbytes >= self->max_bytes) {
+                ntake = ii + 1;
+                break;
+            }
+        }
+    }
+
+    if (ntake == nrows) {
+        ret = self->rowsbuf;
+        self->rowsbuf = PyList_New(0);
+        if (!self->rowsbuf) {
+            self->rowsbuf = ret;
+            return NULL;
+        }
+
+    } else {
+        ret = PyList_GetSlice(self->rowsbuf, 0, ntake);
+        if (!ret || PyList_SetSlice(self->rowsbuf, 0, ntake, NULL) == -1) {
+            Py_XDECREF(ret);
+            return NULL;
+        }
+    }
+
+    if (self->max_bytes) {
+        memmove(self->rowsizes, self->rowsizes + ntake,
+                (nrows - ntake) * sizeof(*self->rowsizes));
+        self->nrowsbytes -= nbytes;
+    }
+
+    if (self->docs && take_docs(self, ret) == -1) {
+        Py_DECREF(ret);
+        return NULL;
+    }
+
+    return ret;
+}
+
+/**
+ * Fetches a page of results from the network. Returns None when
  * no more results remain.
+ *
+ * The event loop is only run while fewer than a page of rows is buffered.
+ * This bounds the memory used by rows which Python has not yet consumed,
+ * along with check_overflow() for rows arriving during other operations.
  */
 PyObject *
 pycbc_HttpResult__fetch(pycbc_HttpResult *self)
@@ -360,32 +1414,67 @@ pycbc_HttpResult__fetch(pycbc_HttpResult *self)
         return NULL;
     }
 
-    if (!self->htreq) {
+    if (!self->rowsbuf) {
+        /** Not a chunked request */
         ret = Py_None;
         Py_INCREF(ret);
         goto GT_RET;
     }
 
-    if (!self->rowsbuf) {
-        self->rowsbuf = PyList_New(0);
+    if (!(self->htflags & PYCBC_HTRES_F_FETCHED)) {
+        self->htflags |= PYCBC_HTRES_F_FETCHED;
+        self->nbacklog_rows = PyList_GET_SIZE(self->rowsbuf);
+        self->nbacklog_bytes = self->nrowsbytes;
     }
 
-    err = pycbc_oputil_wait_common(self->parent);
+    /**
+     * The documents for the page may still be in flight once its last row
+     * has arrived (also if it arrived during another operation)
+     */
+    while (!self->row_error &&
+            ((self->htreq && !page_ready(self)) || docs_pending(self))) {
+        err = pycbc_oputil_wait_common(self->parent);
 
-    if (err != LCB_SUCCESS) {
-        PYCBC_EXCTHROW_WAIT(err);
+        if (err != LCB_SUCCESS) {
+            PYCBC_EXCTHROW_WAIT(err);
+            goto GT_RET;
+        }
+
+        assert(!self->parent->nremaining);
+    }
+
+    if (self->htflags & PYCBC_HTRES_F_SINK) {
+        flush_sink(self);
+    }
+
+    if (maybe_raise(self)) {
         goto GT_RET;
+    }
 
-    } else {
-        if (maybe_raise(self)) {
-            goto GT_RET;
+    if (self->row_error) {
+        PyErr_SetObject((PyObject*)Py_TYPE(self->row_error),
+                        self->row_error);
+        Py_CLEAR(self->row_error);
+
+        /** Nothing more may be written to a sink after it has failed */
+        if (self->htflags & PYCBC_HTRES_F_SINK) {
+            self->htflags |= PYCBC_HTRES_F_DISCARD;
         }
+        goto GT_RET;
+    }
 
-        ret = self->rowsbuf;
-        self->rowsbuf = NULL;
+    if (self->docs &&
+            pycbc_multiresult_maybe_raise((pycbc_MultiResult *)self->docs)) {
+        goto GT_RET;
+    }
+
+    if (!PyList_GET_SIZE(self->rowsbuf)) {
+        ret = Py_None;
+        Py_INCREF(ret);
+        goto GT_RET;
     }
 
-    assert(!self->parent->nremaining);
+    ret = take_page(self);
 
     GT_RET:
     pycbc_oputil_conn_unlock(self->parent);
@@ -0,0 +1,170 @@
+/**
+ *     Copyright 2013 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ **/
+
+/**
+ * Streaming decompression of HTTP response bodies.
+ *
+ * Bodies sent with a 'gzip' or 'deflate' Content-Encoding are inflated as
+ * each chunk arrives, and the output is handed on in blocks of up to
+ * INFLATE_BLOCKSIZE bytes, so a compressed response never needs to be held
+ * in full.
+ *
+ * This requires zlib (PYCBC_HAVE_ZLIB). Without it, compressed responses
+ * are reported as errors.
+ */
+#include "pycbc.h"
+
+#ifdef PYCBC_HAVE_ZLIB
+#include <zlib.h>
+
+#define INFLATE_BLOCKSIZE 16384
+
+struct pycbc_inflate_st {
+    z_stream zs;
+
+    /**
+     * Set once the end of the compressed stream has been seen, or once an
+     * error has occurred
+     */
+    int done;
+
+    char out[INFLATE_BLOCKSIZE];
+};
+
+struct pycbc_inflate_st *
+pycbc_inflate_new(const char *encoding)
+{
+    struct pycbc_inflate_st *ctx;
+    int wbits;
+
+    if (!strcmp(encoding, "gzip") || !strcmp(encoding, "x-gzip")) {
+        wbits = 16 + MAX_WBITS;
+    } else if (!strcmp(encoding, "deflate")) {
+        /** zlib format, as most servers send for 'deflate' */
+        wbits = MAX_WBITS;
+    } else {
+        PYCBC_EXC_WRAP(PYCBC_EXC_INTERNAL, 0,
+                       "Unsupported response Content-Encoding");
+        return NULL;
+    }
+
+    ctx = calloc(1, sizeof(*ctx));
+    if (!ctx) {
+        PyErr_NoMemory();
+        return NULL;
+    }
+
+    if (inflateInit2(&ctx->zs, wbits) != Z_OK) {
+        free(ctx);
+        PYCBC_EXC_WRAP(PYCBC_EXC_INTERNAL, 0,
+                       "Couldn't initialize decompression");
+        return NULL;
+    }
+
+    return ctx;
+}
+
+int
+pycbc_inflate_feed(struct pycbc_inflate_st *ctx,
+                   const void *data,
+                   size_t ndata,
+                   pycbc_inflate_cb callback,
+                   void *arg)
+{
+    ctx->zs.next_in = (Bytef *)data;
+    ctx->zs.avail_in = (uInt)ndata;
+
+    while (!ctx->done) {
+        int rv;
+        size_t nout;
+
+        ctx->zs.next_out = (Bytef *)ctx->out;
+        ctx->zs.avail_out = sizeof(ctx->out);
+
+        rv = inflate(&ctx->zs, Z_NO_FLUSH);
+
+        if (rv == Z_STREAM_END) {
+            /** Anything after the stream is ignored */
+            ctx->done = 1;
+
+        } else if (rv != Z_OK && rv != Z_BUF_ERROR) {
+            /** The rest of the body is discarded */
+            ctx->done = 1;
+            PYCBC_EXC_WRAP(PYCBC_EXC_INTERNAL, 0,
+                           "Couldn't decompress response");
+            return -1;
+        }
+
+        nout = sizeof(ctx->out) - ctx->zs.avail_out;
+        if (nout && callback(arg, ctx->out, nout) == -1) {
+            ctx->done = 1;
+            return -1;
+        }
+
+        if (ctx->zs.avail_out) {
+            /** All the input has been consumed */
+            break;
+        }
+    }
+
+    return 0;
+}
+
+void
+pycbc_inflate_free(struct pycbc_inflate_st *ctx)
+{
+    if (!ctx) {
+        return;
+    }
+
+    inflateEnd(&ctx->zs);
+    free(ctx);
+}
+
+#else
+
+struct pycbc_inflate_st *
+pycbc_inflate_new(const char *encoding)
+{
+    (void)encoding;
+    PYCBC_EXC_WRAP(PYCBC_EXC_INTERNAL, 0,
+                   "Response is compressed, but this build does not "
+                   "include zlib");
+    return NULL;
+}
+
+int
+pycbc_inflate_feed(struct pycbc_inflate_st *ctx,
+                   const void *data,
+                   size_t ndata,
+                   pycbc_inflate_cb callback,
+                   void *arg)
+{
+    (void)ctx;
+    (void)data;
+    (void)ndata;
+    (void)callback;
+    (void)arg;
+    return -1;
+}
+
+void
+pycbc_inflate_free(struct pycbc_inflate_st *ctx)
+{
+    (void)ctx;
+}
+
+#endif /* PYCBC_HAVE_ZLIB */
@@ -0,0 +1,1506 @@
+/**
+ *     Copyright 2013 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ **/
+
+/**
+ * A small JSON decoder which builds Python objects directly from a buffer.
+ *
+ * This is used for view rows, whose boundaries are already known from the
+ * streaming parser, so that each row does not need to be copied into a
+ * Python string and handed to json.loads().
+ *
+ * The output matches json.loads() for valid input. Input this decoder does
+ * not handle (e.g. strings with lone surrogate escapes) is rejected with a
+ * ValueError so that callers can fall back to the json module.
+ *
+ * The decoder can also project a document onto a set of JSON pointers
+ * (see pycbc_json_decode_projected). Values outside the requested paths are
+ * only scanned over; no objects are created for them.
+ *
+ * Projections can also be written out as JSON text (see
+ * pycbc_json_project_text), copying the matched values from the input, and
+ * single numbers can be extracted (see pycbc_json_find_number).
+ */
+
+#include "pycbc.h"
+#include <ctype.h>
+
+/** Nesting limit, matching the order of Python's recursion limit */
+#define JSONDEC_MAXDEPTH 512
+
+/** One bit per projection path */
+typedef unsigned long jsondec_mask_t;
+
+typedef struct {
+    const char *p;
+    const char *end;
+    int depth;
+
+    /** Projection paths, if any */
+    const jsonsl_jpr_t *jprs;
+
+    /** Scratch buffer for strings containing escapes */
+    char *buf;
+    size_t nbuf;
+} jsondec_t;
+
+static PyObject *decode_value(jsondec_t *dec);
+
+static PyObject *
+dec_error(jsondec_t *dec, const char *msg)
+{
+    if (!PyErr_Occurred()) {
+        PyErr_SetString(PyExc_ValueError, msg);
+    }
+    (void)dec;
+    return NULL;
+}
+
+static void
+skip_ws(jsondec_t *dec)
+{
+    while (dec->p < dec->end) {
+        switch (*dec->p) {
+        case ' ':
+        case '\t':
+        case '\n':
+        case '\r':
+            dec->p++;
+            break;
+        default:
+            return;
+        }
+    }
+}
+
+static int
+expect_literal(jsondec_t *dec, const char *lit, size_t nlit)
+{
+    if ((size_t)(dec->end - dec->p) < nlit || memcmp(dec->p, lit, nlit)) {
+        return -1;
+    }
+    dec->p += nlit;
+    return 0;
+}
+
+static int
+hexval(char c)
+{
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    } else if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    } else if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+static int
+read_hex4(const char *p, unsigned long *out)
+{
+    int ii;
+    *out = 0;
+
+    for (ii = 0; ii < 4; ii++) {
+        int v = hexval(p[ii]);
+        if (v < 0) {
+            return -1;
+        }
+        *out = (*out << 4) | v;
+    }
+    return 0;
+}
+
+static char *
+put_utf8(char *out, unsigned long cp)
+{
+    if (cp < 0x80) {
+        *out++ = (char)cp;
+    } else if (cp < 0x800) {
+        *out++ = (char)(0xC0 | (cp >> 6));
+        *out++ = (char)(0x80 | (cp & 0x3F));
+    } else if (cp < 0x10000) {
+        *out++ = (char)(0xE0 | (cp >> 12));
+        *out++ = (char)(0x80 | ((cp >> 6) & 0x3F));
+        *out++ = (char)(0x80 | (cp & 0x3F));
+    } else {
+        *out++ = (char)(0xF0 | (cp >> 18));
+        *out++ = (char)(0x80 | ((cp >> 12) & 0x3F));
+        *out++ = (char)(0x80 | ((cp >> 6) & 0x3F));
+        *out++ = (char)(0x80 | (cp & 0x3F));
+    }
+    return out;
+}
+
+/**
+ * Unescape the string at [begin, end) into the scratch buffer.
+ * An escape never expands into more bytes than it occupies.
+ */
+static PyObject *
+decode_escaped(jsondec_t *dec, const char *begin, const char *end)
+{
+    const char *p;
+    char *out;
+
+    if (dec->nbuf < (size_t)(end - begin)) {
+        char *tmp = realloc(dec->buf, end - begin);
+        if (!tmp) {
+            return PyErr_NoMemory();
+        }
+        dec->buf = tmp;
+        dec->nbuf = end - begin;
+    }
+
+    out = dec->buf;
+    for (p = begin; p < end; p++) {
+        unsigned long cp, lo;
+
+        if (*p != '\\') {
+            *out++ = *p;
+            continue;
+        }
+
+        switch (*++p) {
+        case '"': *out++ = '"'; break;
+        case '\\': *out++ = '\\'; break;
+        case '/': *out++ = '/'; break;
+        case 'b': *out++ = '\b'; break;
+        case 'f': *out++ = '\f'; break;
+        case 'n': *out++ = '\n'; break;
+        case 'r': *out++ = '\r'; break;
+        case 't': *out++ = '\t'; break;
+        case 'u':
+            if (end - p < 5 || read_hex4(p + 1, &cp) == -1) {
+                return dec_error(dec, "Invalid \\u escape");
+            }
+            p += 4;
+
+            if (cp >= 0xD800 && cp <= 0xDBFF) {
+                if (end - p < 7 || p[1] != '\\' || p[2] != 'u' ||
+                        read_hex4(p + 3, &lo) == -1 ||
+                        lo < 0xDC00 || lo > 0xDFFF) {
+                    return dec_error(dec, "Unpaired surrogate");
+                }
+                cp = 0x10000 + ((cp - 0xD800) << 10) + (lo - 0xDC00);
+                p += 6;
+
+            } else if (cp >= 0xDC00 && cp <= 0xDFFF) {
+                return dec_error(dec, "Unpaired surrogate");
+            }
+
+            out = put_utf8(out, cp);
+            break;
+
+        default:
+            return dec_error(dec, "Invalid escape");
+        }
+    }
+
+    return PyUnicode_DecodeUTF8(dec->buf, out - dec->buf, "strict");
+}
+
+/**
+ * Find the bounds of the string at the current position. On success, the
+ * contents are at [*begin, *end) and the position is after the closing quote
+ */
+static int
+scan_string(jsondec_t *dec,
+            const char **begin,
+            const char **end,
+            int *has_escapes)
+{
+    *begin = ++dec->p;
+    *has_escapes = 0;
+
+    while (dec->p < dec->end && *dec->p != '"') {
+        if (*dec->p == '\\') {
+            *has_escapes = 1;
+            dec->p++;
+        } else if ((unsigned char)*dec->p < 0x20) {
+            dec_error(dec, "Control character in string");
+            return -1;
+        }
+        dec->p++;
+    }
+
+    if (dec->p >= dec->end) {
+        dec_error(dec, "Unterminated string");
+        return -1;
+    }
+
+    *end = dec->p++;
+    return 0;
+}
+
+static PyObject *
+make_string(jsondec_t *dec, const char *begin, const char *end,
+            int has_escapes)
+{
+    if (has_escapes) {
+        return decode_escaped(dec, begin, end);
+    }
+    return PyUnicode_DecodeUTF8(begin, end - begin, "strict");
+}
+
+static PyObject *
+decode_string(jsondec_t *dec)
+{
+    const char *begin, *end;
+    int has_escapes;
+
+    if (scan_string(dec, &begin, &end, &has_escapes) == -1) {
+        return NULL;
+    }
+    return make_string(dec, begin, end, has_escapes);
+}
+
+static size_t
+skip_digits(jsondec_t *dec)
+{
+    const char *begin = dec->p;
+
+    while (dec->p < dec->end && *dec->p >= '0' && *dec->p <= '9') {
+        dec->p++;
+    }
+    return dec->p - begin;
+}
+
+static PyObject *
+decode_number(jsondec_t *dec)
+{
+    const char *begin = dec->p;
+    int is_float = 0;
+    char sbuf[64], *buf = sbuf;
+    size_t len;
+    PyObject *ret;
+
+    if (dec->p < dec->end && *dec->p == '-') {
+        dec->p++;
+    }
+
+    /** No leading zeros, as in json.loads() */
+    if (dec->p < dec->end && *dec->p == '0') {
+        dec->p++;
+    } else if (skip_digits(dec) == 0) {
+        return dec_error(dec, "Invalid number");
+    }
+
+    if (dec->p < dec->end && *dec->p == '.') {
+        is_float = 1;
+        dec->p++;
+        if (skip_digits(dec) == 0) {
+            return dec_error(dec, "Invalid number");
+        }
+    }
+
+    if (dec->p < dec->end && (*dec->p == 'e' || *dec->p == 'E')) {
+        is_float = 1;
+        dec->p++;
+        if (dec->p < dec->end && (*dec->p == '+' || *dec->p == '-')) {
+            dec->p++;
+        }
+        if (skip_digits(dec) == 0) {
+            return dec_error(dec, "Invalid number");
+        }
+    }
+
+    if (dec->p < dec->end && isdigit((unsigned char)*dec->p)) {
+        /** A leading zero followed by more digits */
+        return dec_error(dec, "Invalid number");
+    }
+
+    len = dec->p - begin;
+    if (len >= sizeof(sbuf)) {
+        buf = malloc(len + 1);
+        if (!buf) {
+            return PyErr_NoMemory();
+        }
+    }
+
+    memcpy(buf, begin, len);
+    buf[len] = '\0';
+
+    if (is_float) {
+        char *endp;
+        double d = PyOS_string_to_double(buf, &endp, NULL);
+        if (d == -1.0 && PyErr_Occurred()) {
+            ret = NULL;
+        } else if (endp != buf + len) {
+            ret = dec_error(dec, "Invalid number");
+        } else {
+            ret = PyFloat_FromDouble(d);
+        }
+
+    } else if (len < 10) {
+        ret = pycbc_IntFromL(strtol(buf, NULL, 10));
+
+    } else {
+        ret = PyLong_FromString(buf, NULL, 10);
+#if PY_MAJOR_VERSION == 2
+        /** json.loads() returns an 'int' if the value fits */
+        if (ret) {
+            long l = PyLong_AsLong(ret);
+            if (l != -1 || !PyErr_Occurred()) {
+                Py_DECREF(ret);
+                ret = PyInt_FromLong(l);
+            } else {
+                PyErr_Clear();
+            }
+        }
+#endif
+    }
+
+    if (buf != sbuf) {
+        free(buf);
+    }
+    return ret;
+}
+
+static PyObject *
+decode_array(jsondec_t *dec)
+{
+    PyObject *ret = PyList_New(0);
+
+    if (!ret) {
+        return NULL;
+    }
+
+    dec->p++;
+    skip_ws(dec);
+
+    if (dec->p < dec->end && *dec->p == ']') {
+        dec->p++;
+        return ret;
+    }
+
+    while (1) {
+        int rv;
+        PyObject *item = decode_value(dec);
+
+        if (!item) {
+            Py_DECREF(ret);
+            return NULL;
+        }
+
+        rv = PyList_Append(ret, item);
+        Py_DECREF(item);
+        if (rv == -1) {
+            Py_DECREF(ret);
+            return NULL;
+        }
+
+        skip_ws(dec);
+        if (dec->p >= dec->end) {
+            break;
+        }
+
+        if (*dec->p == ',') {
+            dec->p++;
+            continue;
+        }
+
+        if (*dec->p == ']') {
+            dec->p++;
+            return ret;
+        }
+        break;
+    }
+
+    Py_DECREF(ret);
+    return dec_error(dec, "Invalid array");
+}
+
+static PyObject *
+decode_object(jsondec_t *dec)
+{
+    PyObject *ret = PyDict_New();
+
+    if (!ret) {
+        return NULL;
+    }
+
+    dec->p++;
+    skip_ws(dec);
+
+    if (dec->p < dec->end && *dec->p == '}') {
+        dec->p++;
+        return ret;
+    }
+
+    while (1) {
+        int rv;
+        PyObject *key, *value;
+
+        skip_ws(dec);
+        if (dec->p >= dec->end || *dec->p != '"') {
+            break;
+        }
+
+        key = decode_string(dec);
+        if (!key) {
+            Py_DECREF(ret);
+            return NULL;
+        }
+
+#if PY_MAJOR_VERSION >= 3
+        /** Row objects repeat the same few keys */
+        PyUnicode_InternInPlace(&key);
+#endif
+
+        skip_ws(dec);
+        if (dec->p >= dec->end || *dec->p != ':') {
+            Py_DECREF(key);
+            break;
+        }
+        dec->p++;
+
+        value = decode_value(dec);
+        if (!value) {
+            Py_DECREF(key);
+            Py_DECREF(ret);
+            return NULL;
+        }
+
+        rv = PyDict_SetItem(ret, key, value);
+        Py_DECREF(key);
+        Py_DECREF(value);
+        if (rv == -1) {
+            Py_DECREF(ret);
+            return NULL;
+        }
+
+        skip_ws(dec);
+        if (dec->p >= dec->end) {
+            break;
+        }
+
+        if (*dec->p == ',') {
+            dec->p++;
+            continue;
+        }
+
+        if (*dec->p == '}') {
+            dec->p++;
+            return ret;
+        }
+        break;
+    }
+
+    Py_DECREF(ret);
+    return dec_error(dec, "Invalid object");
+}
+
+static PyObject *
+decode_value(jsondec_t *dec)
+{
+    PyObject *ret;
+
+    skip_ws(dec);
+    if (dec->p >= dec->end) {
+        return dec_error(dec, "Unexpected end of input");
+    }
+
+    if (++dec->depth > JSONDEC_MAXDEPTH) {
+        return dec_error(dec, "Nesting too deep");
+    }
+
+    switch (*dec->p) {
+    case '{':
+        ret = decode_object(dec);
+        break;
+
+    case '[':
+        ret = decode_array(dec);
+        break;
+
+    case '"':
+        ret = decode_string(dec);
+        break;
+
+    case 't':
+        ret = expect_literal(dec, "true", 4) == 0 ?
+                (Py_INCREF(Py_True), Py_True) :
+                dec_error(dec, "Invalid literal");
+        break;
+
+    case 'f':
+        ret = expect_literal(dec, "false", 5) == 0 ?
+                (Py_INCREF(Py_False), Py_False) :
+                dec_error(dec, "Invalid literal");
+        break;
+
+    case 'n':
+        ret = expect_literal(dec, "null", 4) == 0 ?
+                (Py_INCREF(Py_None), Py_None) :
+                dec_error(dec, "Invalid literal");
+        break;
+
+    default:
+        ret = decode_number(dec);
+        break;
+    }
+
+    dec->depth--;
+    return ret;
+}
+
+/**
+ * Skip over the value at the current position without creating any objects.
+ * The input has already been validated by the streaming parser, so this only
+ * checks what it needs to find the end of the value
+ */
+static int
+skip_value(jsondec_t *dec)
+{
+    int level = 0;
+
+    skip_ws(dec);
+
+    do {
+        const char *begin, *end;
+        int has_escapes;
+
+        if (dec->p >= dec->end) {
+            dec_error(dec, "Unexpected end of input");
+            return -1;
+        }
+
+        switch (*dec->p) {
+        case '{':
+        case '[':
+            level++;
+            dec->p++;
+            break;
+
+        case '}':
+        case ']':
+            if (!level--) {
+                dec_error(dec, "Unbalanced container");
+                return -1;
+            }
+            dec->p++;
+            break;
+
+        case '"':
+            if (scan_string(dec, &begin, &end, &has_escapes) == -1) {
+                return -1;
+            }
+            break;
+
+        case ',':
+        case ':':
+        case ' ':
+        case '\t':
+        case '\n':
+        case '\r':
+            if (!level) {
+                dec_error(dec, "Invalid value");
+                return -1;
+            }
+            dec->p++;
+            break;
+
+        default:
+            /** Number or literal */
+            while (dec->p < dec->end && !strchr(",:]} \t\n\r", *dec->p)) {
+                dec->p++;
+            }
+            break;
+        }
+    } while (level);
+
+    return 0;
+}
+
+/**
+ * Match a child against the projection paths in 'alive'. 'level' is the
+ * child's depth below the root (the root's children are at level 1).
+ *
+ * @param key the raw key, for object members
+ * @param idx the index, for list elements (key is NULL)
+ * @param complete set if the child matches a path in full
+ * @return the paths which may match descendants of the child
+ */
+static jsondec_mask_t
+match_child(jsondec_t *dec,
+            jsondec_mask_t alive,
+            unsigned level,
+            const char *key,
+            size_t nkey,
+            size_t idx,
+            int *complete)
+{
+    jsondec_mask_t ret = 0;
+    unsigned ii;
+
+    *complete = 0;
+
+    for (ii = 0; alive; ii++, alive >>= 1) {
+        jsonsl_jpr_t jpr = dec->jprs[ii];
+        jsonsl_jpr_match_t match;
+
+        if (!(alive & 1) || level >= jpr->ncomponents) {
+            continue;
+        }
+
+        if (key) {
+            match = jsonsl_jpr_match(jpr, JSONSL_T_OBJECT, level, key, nkey);
+
+        } else if (jpr->components[level].ptype == JSONSL_PATH_NUMERIC ||
+                jpr->components[level].ptype == JSONSL_PATH_WILDCARD) {
+            match = jsonsl_jpr_match(jpr, JSONSL_T_LIST, level, NULL, idx);
+
+        } else {
+            continue;
+        }
+
+        if (match == JSONSL_MATCH_COMPLETE) {
+            *complete = 1;
+        } else if (match == JSONSL_MATCH_POSSIBLE) {
+            ret |= (jsondec_mask_t)1 << ii;
+        }
+    }
+
+    return ret;
+}
+
+static int project_value(jsondec_t *dec, jsondec_mask_t alive,
+                         unsigned level, PyObject **out);
+
+/**
+ * Decode, project or skip a child depending on how it matches
+ */
+static int
+project_child(jsondec_t *dec,
+              jsondec_mask_t alive,
+              unsigned level,
+              const char *key,
+              size_t nkey,
+              size_t idx,
+              PyObject **out)
+{
+    int complete;
+
+    *out = NULL;
+    alive = match_child(dec, alive, level, key, nkey, idx, &complete);
+
+    if (complete) {
+        *out = decode_value(dec);
+        return *out ? 0 : -1;
+
+    } else if (alive) {
+        return project_value(dec, alive, level, out);
+
+    } else {
+        return skip_value(dec);
+    }
+}
+
+static int
+project_object(jsondec_t *dec,
+               jsondec_mask_t alive,
+               unsigned level,
+               PyObject **out)
+{
+    PyObject *ret = NULL;
+
+    dec->p++;
+    skip_ws(dec);
+
+    if (dec->p < dec->end && *dec->p == '}') {
+        dec->p++;
+        return 0;
+    }
+
+    while (1) {
+        const char *begin, *end;
+        int has_escapes, rv;
+        PyObject *key = NULL, *value, *kbytes = NULL;
+        const char *kmatch;
+        size_t nkmatch;
+
+        skip_ws(dec);
+        if (dec->p >= dec->end || *dec->p != '"') {
+            break;
+        }
+
+        if (scan_string(dec, &begin, &end, &has_escapes) == -1) {
+            goto GT_ERROR;
+        }
+
+        kmatch = begin;
+        nkmatch = end - begin;
+
+        if (has_escapes) {
+            /** Match against the unescaped form */
+            key = make_string(dec, begin, end, has_escapes);
+            kbytes = key ? PyUnicode_AsUTF8String(key) : NULL;
+            if (!kbytes) {
+                Py_XDECREF(key);
+                goto GT_ERROR;
+            }
+            kmatch = PyBytes_AS_STRING(kbytes);
+            nkmatch = PyBytes_GET_SIZE(kbytes);
+        }
+
+        skip_ws(dec);
+        if (dec->p >= dec->end || *dec->p != ':') {
+            Py_XDECREF(key);
+            Py_XDECREF(kbytes);
+            break;
+        }
+        dec->p++;
+
+        rv = project_child(dec, alive, level + 1, kmatch, nkmatch, 0, &value);
+        Py_XDECREF(kbytes);
+
+        if (rv == -1) {
+            Py_XDECREF(key);
+            goto GT_ERROR;
+        }
+
+        if (value) {
+            if (!key) {
+                key = make_string(dec, begin, end, has_escapes);
+            }
+            if (!ret) {
+                ret = PyDict_New();
+            }
+
+            rv = (key && ret) ? PyDict_SetItem(ret, key, value) : -1;
+            Py_XDECREF(key);
+            Py_DECREF(value);
+            if (rv == -1) {
+                goto GT_ERROR;
+            }
+
+        } else {
+            Py_XDECREF(key);
+        }
+
+        skip_ws(dec);
+        if (dec->p >= dec->end) {
+            break;
+        }
+
+        if (*dec->p == ',') {
+            dec->p++;
+            continue;
+        }
+
+        if (*dec->p == '}') {
+            dec->p++;
+            *out = ret;
+            return 0;
+        }
+        break;
+    }
+
+    dec_error(dec, "Invalid object");
+
+    GT_ERROR:
+    Py_XDECREF(ret);
+    return -1;
+}
+
+/**
+ * Matched elements keep their index: the elements before them which did not
+ * match are replaced by None. Elements after the last match are dropped.
+ */
+static int
+project_array(jsondec_t *dec,
+              jsondec_mask_t alive,
+              unsigned level,
+              PyObject **out)
+{
+    PyObject *ret = NULL;
+    size_t idx;
+
+    dec->p++;
+    skip_ws(dec);
+
+    if (dec->p < dec->end && *dec->p == ']') {
+        dec->p++;
+        return 0;
+    }
+
+    for (idx = 0; ; idx++) {
+        PyObject *item;
+        int rv;
+
+        if (project_child(dec, alive, level + 1, NULL, 0, idx, &item) == -1) {
+            goto GT_ERROR;
+        }
+
+        if (item) {
+            if (!ret) {
+                ret = PyList_New(0);
+            }
+            rv = ret ? 0 : -1;
+            while (rv == 0 && (size_t)PyList_GET_SIZE(ret) < idx) {
+                rv = PyList_Append(ret, Py_None);
+            }
+            if (rv == 0) {
+                rv = PyList_Append(ret, item);
+            }
+            Py_DECREF(item);
+            if (rv == -1) {
+                goto GT_ERROR;
+            }
+        }
+
+        skip_ws(dec);
+        if (dec->p >= dec->end) {
+            break;
+        }
+
+        if (*dec->p == ',') {
+            dec->p++;
+            continue;
+        }
+
+        if (*dec->p == ']') {
+            dec->p++;
+            *out = ret;
+            return 0;
+        }
+        break;
+    }
+
+    dec_error(dec, "Invalid array");
+
+    GT_ERROR:
+    Py_XDECREF(ret);
+    return -1;
+}
+
+/**
+ * Project the value at the current position onto the paths in 'alive'.
+ * Only containers can contain further matches; a scalar is skipped.
+ * '*out' is left NULL if nothing in the value matched.
+ */
+static int
+project_value(jsondec_t *dec,
+              jsondec_mask_t alive,
+              unsigned level,
+              PyObject **out)
+{
+    int rv;
+
+    *out = NULL;
+    skip_ws(dec);
+    if (dec->p >= dec->end) {
+        dec_error(dec, "Unexpected end of input");
+        return -1;
+    }
+
+    if (++dec->depth > JSONDEC_MAXDEPTH) {
+        dec_error(dec, "Nesting too deep");
+        return -1;
+    }
+
+    switch (*dec->p) {
+    case '{':
+        rv = project_object(dec, alive, level, out);
+        break;
+
+    case '[':
+        rv = project_array(dec, alive, level, out);
+        break;
+
+    default:
+        rv = skip_value(dec);
+        break;
+    }
+
+    dec->depth--;
+    return rv;
+}
+
+PyObject *
+pycbc_json_decode_projected(const char *s,
+                            size_t n,
+                            const jsonsl_jpr_t *jprs,
+                            size_t njprs)
+{
+    jsondec_t dec = { 0 };
+    PyObject *ret = NULL;
+    jsondec_mask_t alive;
+
+    if (!njprs) {
+        return pycbc_json_decode(s, n);
+    }
+
+    if (njprs > PYCBC_JSON_MAXFIELDS) {
+        PyErr_SetString(PyExc_ValueError, "Too many projection paths");
+        return NULL;
+    }
+
+    dec.p = s;
+    dec.end = s + n;
+    dec.jprs = jprs;
+
+    /** Shift in two steps; a full-width shift is undefined */
+    alive = (((jsondec_mask_t)1 << (njprs - 1)) << 1) - 1;
+
+    if (project_value(&dec, alive, 0, &ret) == 0) {
+        skip_ws(&dec);
+        if (dec.p != dec.end) {
+            Py_XDECREF(ret);
+            ret = dec_error(&dec, "Extra data after JSON value");
+
+        } else if (!ret) {
+            /** Nothing matched. Still return an (empty) container */
+            ret = PyDict_New();
+        }
+    }
+
+    free(dec.buf);
+    return ret;
+}
+
+static int
+out_append(lcbex_vrow_buffer *out, const char *s, size_t n)
+{
+    if (out->alloc - out->len < n) {
+        size_t wanted = out->alloc ? out->alloc : 256;
+        char *tmp;
+
+        while (wanted - out->len < n) {
+            wanted *= 2;
+        }
+
+        tmp = realloc(out->s, wanted);
+        if (!tmp) {
+            PyErr_NoMemory();
+            return -1;
+        }
+        out->s = tmp;
+        out->alloc = wanted;
+    }
+
+    memcpy(out->s + out->len, s, n);
+    out->len += n;
+    return 0;
+}
+
+/**
+ * Append a value copied from the input, dropping the whitespace outside of
+ * strings so that the output is on a single line
+ */
+static int
+out_compact(lcbex_vrow_buffer *out, const char *s, const char *end)
+{
+    const char *run = s;
+    int in_string = 0;
+
+    for (; s < end; s++) {
+        if (in_string) {
+            if (*s == '\\') {
+                s++;
+            } else if (*s == '"') {
+                in_string = 0;
+            }
+
+        } else if (*s == '"') {
+            in_string = 1;
+
+        } else if (*s == ' ' || *s == '\t' || *s == '\n' || *s == '\r') {
+            if (out_append(out, run, s - run) == -1) {
+                return -1;
+            }
+            run = s + 1;
+        }
+    }
+
+    return out_append(out, run, end - run);
+}
+
+static int emit_value(jsondec_t *dec, jsondec_mask_t alive, unsigned level,
+                      lcbex_vrow_buffer *out);
+
+/**
+ * Like project_child, but appends the projected child to 'out'. Nothing is
+ * appended if the child does not match
+ */
+static int
+emit_child(jsondec_t *dec,
+           jsondec_mask_t alive,
+           unsigned level,
+           const char *key,
+           size_t nkey,
+           size_t idx,
+           lcbex_vrow_buffer *out)
+{
+    int complete;
+    const char *begin;
+
+    alive = match_child(dec, alive, level, key, nkey, idx, &complete);
+
+    if (complete) {
+        skip_ws(dec);
+        begin = dec->p;
+        if (skip_value(dec) == -1) {
+            return -1;
+        }
+        return out_compact(out, begin, dec->p);
+
+    } else if (alive) {
+        return emit_value(dec, alive, level, out);
+
+    } else {
+        return skip_value(dec);
+    }
+}
+
+/**
+ * Each member is written out speculatively, and truncated again if its
+ * value did not match
+ */
+static int
+emit_object(jsondec_t *dec,
+            jsondec_mask_t alive,
+            unsigned level,
+            lcbex_vrow_buffer *out)
+{
+    size_t nmatched = 0;
+
+    dec->p++;
+    skip_ws(dec);
+
+    if (dec->p < dec->end && *dec->p == '}') {
+        dec->p++;
+        return 0;
+    }
+
+    while (1) {
+        const char *begin, *end;
+        int has_escapes, rv;
+        PyObject *kbytes = NULL;
+        const char *kmatch;
+        size_t nkmatch, mark, nprefix;
+
+        skip_ws(dec);
+        if (dec->p >= dec->end || *dec->p != '"') {
+            break;
+        }
+
+        if (scan_string(dec, &begin, &end, &has_escapes) == -1) {
+            return -1;
+        }
+
+        kmatch = begin;
+        nkmatch = end - begin;
+
+        if (has_escapes) {
+            /** Match against the unescaped form */
+            PyObject *key = make_string(dec, begin, end, has_escapes);
+            kbytes = key ? PyUnicode_AsUTF8String(key) : NULL;
+            Py_XDECREF(key);
+            if (!kbytes) {
+                return -1;
+            }
+            kmatch = PyBytes_AS_STRING(kbytes);
+            nkmatch = PyBytes_GET_SIZE(kbytes);
+        }
+
+        skip_ws(dec);
+        if (dec->p >= dec->end || *dec->p != ':') {
+            Py_XDECREF(kbytes);
+            break;
+        }
+        dec->p++;
+
+        /** The key is copied with its quotes */
+        mark = out->len;
+        rv = out_append(out, nmatched ? "," : "{", 1);
+        if (rv == 0) {
+            rv = out_append(out, begin - 1, end - begin + 2);
+        }
+        if (rv == 0) {
+            rv = out_append(out, ":", 1);
+        }
+        nprefix = out->len - mark;
+
+        if (rv == 0) {
+            rv = emit_child(dec, alive, level + 1, kmatch, nkmatch, 0, out);
+        }
+        Py_XDECREF(kbytes);
+
+        if (rv == -1) {
+            return -1;
+        }
+
+        if (out->len == mark + nprefix) {
+            out->len = mark;
+        } else {
+            nmatched++;
+        }
+
+        skip_ws(dec);
+        if (dec->p >= dec->end) {
+            break;
+        }
+
+        if (*dec->p == ',') {
+            dec->p++;
+            continue;
+        }
+
+        if (*dec->p == '}') {
+            dec->p++;
+            return nmatched ? out_append(out, "}", 1) : 0;
+        }
+        break;
+    }
+
+    dec_error(dec, "Invalid object");
+    return -1;
+}
+
+/**
+ * As with project_array, elements before a match which did not match
+ * themselves are written as null
+ */
+static int
+emit_array(jsondec_t *dec,
+           jsondec_mask_t alive,
+           unsigned level,
+           lcbex_vrow_buffer *out)
+{
+    size_t idx, nout = 0;
+
+    dec->p++;
+    skip_ws(dec);
+
+    if (dec->p < dec->end && *dec->p == ']') {
+        dec->p++;
+        return 0;
+    }
+
+    for (idx = 0; ; idx++) {
+        size_t mark = out->len, nprefix, ii;
+        int rv = out_append(out, nout ? "," : "[", 1);
+
+        for (ii = nout; rv == 0 && ii < idx; ii++) {
+            rv = out_append(out, "null,", 5);
+        }
+        nprefix = out->len - mark;
+
+        if (rv == -1 ||
+                emit_child(dec, alive, level + 1, NULL, 0, idx, out) == -1) {
+            return -1;
+        }
+
+        if (out->len == mark + nprefix) {
+            out->len = mark;
+        } else {
+            nout = idx + 1;
+        }
+
+        skip_ws(dec);
+        if (dec->p >= dec->end) {
+            break;
+        }
+
+        if (*dec->p == ',') {
+            dec->p++;
+            continue;
+        }
+
+        if (*dec->p == ']') {
+            dec->p++;
+            return nout ? out_append(out, "]", 1) : 0;
+        }
+        break;
+    }
+
+    dec_error(dec, "Invalid array");
+    return -1;
+}
+
+/**
+ * Like project_value, but appends the projection to 'out'
+ */
+static int
+emit_value(jsondec_t *dec,
+           jsondec_mask_t alive,
+           unsigned level,
+           lcbex_vrow_buffer *out)
+{
+    int rv;
+
+    skip_ws(dec);
+    if (dec->p >= dec->end) {
+        dec_error(dec, "Unexpected end of input");
+        return -1;
+    }
+
+    if (++dec->depth > JSONDEC_MAXDEPTH) {
+        dec_error(dec, "Nesting too deep");
+        return -1;
+    }
+
+    switch (*dec->p) {
+    case '{':
+        rv = emit_object(dec, alive, level, out);
+        break;
+
+    case '[':
+        rv = emit_array(dec, alive, level, out);
+        break;
+
+    default:
+        rv = skip_value(dec);
+        break;
+    }
+
+    dec->depth--;
+    return rv;
+}
+
+int
+pycbc_json_project_text(const char *s,
+                        size_t n,
+                        const jsonsl_jpr_t *jprs,
+                        size_t njprs,
+                        lcbex_vrow_buffer *out)
+{
+    jsondec_t dec = { 0 };
+    size_t orig_len = out->len;
+    jsondec_mask_t alive;
+    int rv;
+
+    dec.p = s;
+    dec.end = s + n;
+    dec.jprs = jprs;
+
+    if (!njprs) {
+        rv = skip_value(&dec);
+        if (rv == 0) {
+            rv = out_compact(out, s, dec.p);
+        }
+
+    } else if (njprs > PYCBC_JSON_MAXFIELDS) {
+        PyErr_SetString(PyExc_ValueError, "Too many projection paths");
+        return -1;
+
+    } else {
+        alive = (((jsondec_mask_t)1 << (njprs - 1)) << 1) - 1;
+        rv = emit_value(&dec, alive, 0, out);
+
+        if (rv == 0 && out->len == orig_len) {
+            /** Nothing matched */
+            rv = out_append(out, "{}", 2);
+        }
+    }
+
+    if (rv == 0) {
+        skip_ws(&dec);
+        if (dec.p != dec.end) {
+            dec_error(&dec, "Extra data after JSON value");
+            rv = -1;
+        }
+    }
+
+    if (rv == -1) {
+        out->len = orig_len;
+    }
+
+    free(dec.buf);
+    return rv;
+}
+
+/**
+ * Find the value at dec->jprs[0] within the container at the current
+ * position. Only the path's ancestors are scanned; everything else is
+ * skipped over.
+ * @return 1 if found (and the position is at the value), 0 if the path is
+ * not present, or -1 on error
+ */
+static int
+find_value(jsondec_t *dec, unsigned level)
+{
+    int is_object;
+    size_t idx;
+
+    skip_ws(dec);
+    if (dec->p >= dec->end) {
+        dec_error(dec, "Unexpected end of input");
+        return -1;
+    }
+
+    if (*dec->p != '{' && *dec->p != '[') {
+        return skip_value(dec);
+    }
+
+    if (++dec->depth > JSONDEC_MAXDEPTH) {
+        dec_error(dec, "Nesting too deep");
+        return -1;
+    }
+
+    is_object = *dec->p == '{';
+    dec->p++;
+    skip_ws(dec);
+
+    if (dec->p < dec->end && *dec->p == (is_object ? '}' : ']')) {
+        dec->p++;
+        dec->depth--;
+        return 0;
+    }
+
+    for (idx = 0; ; idx++) {
+        const char *key = NULL;
+        size_t nkey = 0;
+        PyObject *kbytes = NULL;
+        int complete, rv;
+        jsondec_mask_t alive;
+
+        skip_ws(dec);
+
+        if (is_object) {
+            const char *begin, *end;
+            int has_escapes;
+
+            if (dec->p >= dec->end || *dec->p != '"') {
+                break;
+            }
+
+            if (scan_string(dec, &begin, &end, &has_escapes) == -1) {
+                return -1;
+            }
+
+            key = begin;
+            nkey = end - begin;
+
+            if (has_escapes) {
+                PyObject *ukey = make_string(dec, begin, end, has_escapes);
+                kbytes = ukey ? PyUnicode_AsUTF8String(ukey) : NULL;
+                Py_XDECREF(ukey);
+                if (!kbytes) {
+                    return -1;
+                }
+                key = PyBytes_AS_STRING(kbytes);
+                nkey = PyBytes_GET_SIZE(kbytes);
+            }
+
+            skip_ws(dec);
+            if (dec->p >= dec->end || *dec->p != ':') {
+                Py_XDECREF(kbytes);
+                break;
+            }
+            dec->p++;
+        }
+
+        alive = match_child(dec, 1, level + 1, key, nkey, idx, &complete);
+        Py_XDECREF(kbytes);
+
+        if (complete) {
+            skip_ws(dec);
+            return 1;
+        }
+
+        rv = alive ? find_value(dec, level + 1) : skip_value(dec);
+        if (rv) {
+            return rv;
+        }
+
+        skip_ws(dec);
+        if (dec->p >= dec->end) {
+            break;
+        }
+
+        if (*dec->p == ',') {
+            dec->p++;
+            continue;
+        }
+
+        if (*dec->p == (is_object ? '}' : ']')) {
+            dec->p++;
+            dec->depth--;
+            return 0;
+        }
+        break;
+    }
+
+    dec_error(dec, is_object ? "Invalid object" : "Invalid array");
+    return -1;
+}
+
+int
+pycbc_json_find_number(const char *s,
+                       size_t n,
+                       jsonsl_jpr_t jpr,
+                       double *out)
+{
+    jsondec_t dec = { 0 };
+    int rv;
+
+    dec.p = s;
+    dec.end = s + n;
+    dec.jprs = &jpr;
+
+    rv = find_value(&dec, 0);
+
+    if (rv == 1) {
+        char buf[64];
+        size_t len = 0;
+
+        if (*dec.p != '-' && !isdigit((unsigned char)*dec.p)) {
+            /** Not a number */
+            rv = 0;
+        }
+
+        while (rv && dec.p < dec.end && strchr("+-.eE0123456789", *dec.p)) {
+            if (len == sizeof(buf) - 1) {
+                dec_error(&dec, "Number too long");
+                rv = -1;
+                break;
+            }
+            buf[len++] = *dec.p++;
+        }
+
+        if (rv == 1) {
+            buf[len] = '\0';
+            *out = strtod(buf, NULL);
+        }
+    }
+
+    free(dec.buf);
+    return rv;
+}
+
+PyObject *
+pycbc_json_decode(const char *s, size_t n)
+{
+    jsondec_t dec = { 0 };
+    PyObject *ret;
+
+    dec.p = s;
+    dec.end = s + n;
+
+    ret = decode_value(&dec);
+    if (ret) {
+        skip_ws(&dec);
+        if (dec.p != dec.end) {
+            Py_DECREF(ret);
+            ret = dec_error(&dec, "Extra data after JSON value");
+        }
+    }
+
+    free(dec.buf);
+    return ret;
+}
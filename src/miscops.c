@@ -126,24 +126,31 @@ keyop_common(pycbc_Connection *self,
     PyObject *casobj = NULL;
     PyObject *is_quiet = NULL;
     PyObject *kobj = NULL;
+    PyObject *timeout_O = NULL;
+    lcb_uint32_t timeout = 0;
     lcb_error_t err;
     struct pycbc_common_vars cv = PYCBC_COMMON_VARS_STATIC_INIT;
 
-    static char *kwlist[] = { "keys", "cas", "quiet", NULL };
+    static char *kwlist[] = { "keys", "cas", "quiet", "timeout", NULL };
 
     rv = PyArg_ParseTupleAndKeywords(args,
                                      kwargs,
-                                     "O|OO",
+                                     "O|OOO",
                                      kwlist,
                                      &kobj,
                                      &casobj,
-                                     &is_quiet);
+                                     &is_quiet,
+                                     &timeout_O);
 
     if (!rv) {
         PYCBC_EXCTHROW_ARGS();
         return NULL;
     }
 
+    if (pycbc_get_timeout(timeout_O, &timeout) < 0) {
+        return NULL;
+    }
+
     if (argopts & PYCBC_ARGOPT_MULTI) {
         rv = pycbc_oputil_check_sequence(kobj, 1, &ncmds, &seqtype);
         if (rv < 0) {
@@ -161,6 +168,7 @@ keyop_common(pycbc_Connection *self,
     rv = pycbc_common_vars_init(&cv,
                                 self,
                                 argopts,
+                                optype,
                                 ncmds,
                                 sizeof(lcb_remove_cmd_t),
                                 0);
@@ -168,6 +176,8 @@ keyop_common(pycbc_Connection *self,
         return NULL;
     }
 
+    cv.timeout = timeout;
+
     if (argopts & PYCBC_ARGOPT_MULTI) {
         Py_ssize_t dictpos = 0;
         PyObject *curseq, *iter = NULL;
@@ -263,16 +273,23 @@ pycbc_Connection__stats(pycbc_Connection *self,
     Py_ssize_t ncmds;
     lcb_error_t err;
     PyObject *keys = NULL;
+    PyObject *timeout_O = NULL;
+    lcb_uint32_t timeout = 0;
     struct pycbc_common_vars cv = PYCBC_COMMON_VARS_STATIC_INIT;
-    static char *kwlist[] = {  "keys", NULL };
+    static char *kwlist[] = {  "keys", "timeout", NULL };
 
-    rv = PyArg_ParseTupleAndKeywords(args, kwargs, "|O", kwlist, &keys);
+    rv = PyArg_ParseTupleAndKeywords(args, kwargs, "|OO", kwlist,
+                                     &keys, &timeout_O);
 
     if (!rv) {
         PYCBC_EXCTHROW_ARGS();
         return NULL;
     }
 
+    if (pycbc_get_timeout(timeout_O, &timeout) < 0) {
+        return NULL;
+    }
+
     if (keys == NULL || PyObject_IsTrue(keys) == 0) {
         keys = NULL;
         ncmds = 1;
@@ -288,6 +305,7 @@ pycbc_Connection__stats(pycbc_Connection *self,
     rv = pycbc_common_vars_init(&cv,
                                 self,
                                 PYCBC_ARGOPT_MULTI,
+                                PYCBC_CMD_STATS,
                                 ncmds,
                                 sizeof(lcb_server_stats_cmd_t),
                                 0);
@@ -295,6 +313,8 @@ pycbc_Connection__stats(pycbc_Connection *self,
         return NULL;
     }
 
+    cv.timeout = timeout;
+
     if (keys) {
         for (ii =0; ii < ncmds; ii++) {
             char *key;
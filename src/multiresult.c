@@ -49,6 +49,13 @@ MultiResultType__init__(pycbc_MultiResult *self, PyObject *args, PyObject *kwarg
     self->exceptions = NULL;
     self->errop = NULL;
     self->no_raise_enoent = 0;
+    self->retry = NULL;
+    self->replica = NULL;
+    self->sampler = NULL;
+    self->abandoned = 0;
+    self->nlate = 0;
+    self->nremaining = 0;
+    self->viewdocs = 0;
 
     return 0;
 }
@@ -56,12 +63,24 @@ MultiResultType__init__(pycbc_MultiResult *self, PyObject *args, PyObject *kwarg
 static void
 MultiResult_dealloc(pycbc_MultiResult *self)
 {
+    PyObject_GC_UnTrack(self);
     Py_XDECREF(self->parent);
     Py_XDECREF(self->exceptions);
     Py_XDECREF(self->errop);
     PyDict_Type.tp_dealloc((PyObject*)self);
 }
 
+/**
+ * The parent is visited so that the cycle formed by an abandoned object and
+ * its connection's 'orphans' list can be collected
+ */
+static int
+MultiResult_traverse(pycbc_MultiResult *self, visitproc visit, void *arg)
+{
+    Py_VISIT(self->parent);
+    return PyDict_Type.tp_traverse((PyObject*)self, visit, arg);
+}
+
 int
 pycbc_MultiResultType_init(PyObject **ptr)
 {
@@ -75,6 +94,8 @@ pycbc_MultiResultType_init(PyObject **ptr)
     p->tp_base = &PyDict_Type;
     p->tp_init = (initproc)MultiResultType__init__;
     p->tp_dealloc = (destructor)MultiResult_dealloc;
+    p->tp_traverse = (traverseproc)MultiResult_traverse;
+    p->tp_clear = PyDict_Type.tp_clear;
 
     p->tp_name = "MultiResult";
     p->tp_doc = PyDoc_STR(
@@ -90,7 +111,8 @@ pycbc_MultiResultType_init(PyObject **ptr)
     p->tp_basicsize = sizeof(pycbc_MultiResult);
     p->tp_members = MultiResult_TABLE_members;
     p->tp_methods = MultiResult_TABLE_methods;
-    p->tp_flags = Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE;
+    p->tp_flags = Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE |
+            Py_TPFLAGS_HAVE_GC;
 
     return PyType_Ready(p);
 }
@@ -0,0 +1,434 @@
+/**
+ *     Copyright 2013 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ **/
+
+#include "oputil.h"
+
+/**
+ * This file maps keys to the server owning them (via the vBucket map), and
+ * keeps per-server operation counters.
+ *
+ * Counters are indexed by the server's position in the current cluster
+ * map. They are updated from the callbacks (without the GIL) when the
+ * connection's 'track_node_stats' flag is set. The callbacks never resize
+ * the array: it is sized for the cluster map with the GIL held, before
+ * each wait (see pycbc_nodestats_update), and responses from servers
+ * beyond it are not counted.
+ *
+ * The map is read with lcb_cntl(), which first appeared in libcouchbase
+ * 2.1.0. With older versions keys cannot be mapped, and the methods here
+ * raise NotSupportedError.
+ */
+#if defined(LCB_CNTL_VBMAP) && defined(LCB_CNTL_VBCONFIG)
+#define PYCBC_HAVE_VBMAP
+#endif
+
+#ifdef PYCBC_HAVE_VBMAP
+#include <libvbucket/vbucket.h>
+
+/**
+ * Get the index of the server which owns the key
+ * @return the index, or -1 if there is no vBucket map (e.g. for memcached
+ * buckets, or if the instance is not yet connected)
+ */
+static int
+map_key(lcb_t instance, const void *key, size_t nkey, lcb_error_t *err)
+{
+    lcb_cntl_vbinfo_t vbi;
+
+    memset(&vbi, 0, sizeof(vbi));
+    vbi.v.v0.key = key;
+    vbi.v.v0.nkey = nkey;
+
+    *err = lcb_cntl(instance, LCB_CNTL_GET, LCB_CNTL_VBMAP, &vbi);
+    if (*err != LCB_SUCCESS) {
+        return -1;
+    }
+    return vbi.v.v0.server_index;
+}
+
+static VBUCKET_CONFIG_HANDLE
+get_config(lcb_t instance)
+{
+    VBUCKET_CONFIG_HANDLE config = NULL;
+
+    if (lcb_cntl(instance, LCB_CNTL_GET, LCB_CNTL_VBCONFIG,
+                 &config) != LCB_SUCCESS) {
+        return NULL;
+    }
+    return config;
+}
+
+static struct pycbc_node_counters *
+get_counters(pycbc_Connection *conn, int ix)
+{
+    if (ix < 0 || (size_t)ix >= conn->nnode_stats) {
+        return NULL;
+    }
+    return conn->node_stats + ix;
+}
+
+void
+pycbc_nodestats_update(pycbc_Connection *conn)
+{
+    VBUCKET_CONFIG_HANDLE config;
+    struct pycbc_node_counters *tmp;
+    size_t n;
+
+    if (!conn->track_node_stats) {
+        return;
+    }
+
+    config = get_config(conn->instance);
+    if (!config) {
+        return;
+    }
+
+    n = vbucket_config_get_num_servers(config);
+    if (n <= conn->nnode_stats) {
+        return;
+    }
+
+    tmp = realloc(conn->node_stats, n * sizeof(*tmp));
+    if (!tmp) {
+        return;
+    }
+
+    memset(tmp + conn->nnode_stats, 0,
+           (n - conn->nnode_stats) * sizeof(*tmp));
+    conn->node_stats = tmp;
+    conn->nnode_stats = n;
+}
+
+void
+pycbc_nodestats_record(lcb_t instance,
+                       const void *key,
+                       size_t nkey,
+                       size_t nbytes,
+                       lcb_error_t err)
+{
+    pycbc_Connection *conn = (pycbc_Connection *)lcb_get_cookie(instance);
+    struct pycbc_node_counters *counters;
+    lcb_error_t maperr;
+
+    if (!conn->track_node_stats || !conn->nnode_stats) {
+        return;
+    }
+
+    counters = get_counters(conn, map_key(conn->instance, key, nkey,
+                                          &maperr));
+    if (!counters) {
+        return;
+    }
+
+    counters->ops++;
+    counters->bytes_in += nbytes;
+    if (err != LCB_SUCCESS) {
+        counters->errors++;
+    }
+}
+
+void
+pycbc_nodestats_sent(pycbc_Connection *conn,
+                     const void *key,
+                     size_t nkey,
+                     size_t nbytes)
+{
+    struct pycbc_node_counters *counters;
+    lcb_error_t maperr;
+
+    int ix;
+
+    if (!conn->track_node_stats) {
+        return;
+    }
+
+    ix = map_key(conn->instance, key, nkey, &maperr);
+    if (ix >= 0 && (size_t)ix >= conn->nnode_stats) {
+        /** Tracking was just enabled, or the cluster has grown */
+        pycbc_nodestats_update(conn);
+    }
+
+    counters = get_counters(conn, ix);
+    if (counters) {
+        counters->bytes_out += nbytes;
+    }
+}
+
+static PyObject *
+server_name(VBUCKET_CONFIG_HANDLE config, int ix)
+{
+    const char *name = NULL;
+
+    if (ix >= 0 && ix < vbucket_config_get_num_servers(config)) {
+        name = vbucket_config_get_server(config, ix);
+    }
+
+    if (!name) {
+        PYCBC_EXC_WRAP(PYCBC_EXC_INTERNAL, 0,
+                       "Server index not in cluster map");
+        return NULL;
+    }
+
+    return pycbc_SimpleStringZ(name);
+}
+
+PyObject *
+pycbc_Connection__keys_by_node(pycbc_Connection *self,
+                               PyObject *args,
+                               PyObject *kwargs)
+{
+    int rv;
+    PyObject *keys = NULL;
+    PyObject *iter = NULL;
+    PyObject *curkey;
+    PyObject *ret = NULL;
+    PyObject **names = NULL;
+    VBUCKET_CONFIG_HANDLE config;
+    int nservers;
+
+    static char *kwlist[] = { "keys", NULL };
+
+    rv = PyArg_ParseTupleAndKeywords(args, kwargs, "O", kwlist, &keys);
+    if (!rv) {
+        PYCBC_EXCTHROW_ARGS();
+        return NULL;
+    }
+
+    config = get_config(self->instance);
+    if (!config) {
+        PYCBC_EXC_WRAP(PYCBC_EXC_LCBERR, LCB_NOT_SUPPORTED,
+                       "No vBucket map available (is this a memcached "
+                       "bucket?)");
+        return NULL;
+    }
+
+    nservers = vbucket_config_get_num_servers(config);
+    names = calloc(nservers ? nservers : 1, sizeof(*names));
+    ret = PyDict_New();
+    iter = PyObject_GetIter(keys);
+
+    if (!(names && ret && iter)) {
+        if (!PyErr_Occurred()) {
+            PyErr_SetNone(PyExc_MemoryError);
+        }
+        goto GT_ERROR;
+    }
+
+    while ((curkey = PyIter_Next(iter))) {
+        PyObject *enckey = curkey, *list;
+        void *key;
+        size_t nkey;
+        lcb_error_t err;
+        int ix;
+
+        rv = pycbc_tc_encode_key(self, &enckey, &key, &nkey);
+        if (rv < 0) {
+            Py_DECREF(curkey);
+            goto GT_ERROR;
+        }
+
+        ix = map_key(self->instance, key, nkey, &err);
+        Py_DECREF(enckey);
+
+        if (ix < 0 || ix >= nservers) {
+            PYCBC_EXC_WRAP_KEY(PYCBC_EXC_LCBERR, err, "Couldn't map key",
+                               curkey);
+            Py_DECREF(curkey);
+            goto GT_ERROR;
+        }
+
+        if (!names[ix]) {
+            names[ix] = server_name(config, ix);
+            if (!names[ix]) {
+                Py_DECREF(curkey);
+                goto GT_ERROR;
+            }
+        }
+
+        list = PyDict_GetItem(ret, names[ix]);
+        if (!list) {
+            list = PyList_New(0);
+            if (!list || PyDict_SetItem(ret, names[ix], list) == -1) {
+                Py_XDECREF(list);
+                Py_DECREF(curkey);
+                goto GT_ERROR;
+            }
+            Py_DECREF(list);
+        }
+
+        rv = PyList_Append(list, curkey);
+        Py_DECREF(curkey);
+        if (rv == -1) {
+            goto GT_ERROR;
+        }
+    }
+
+    if (PyErr_Occurred()) {
+        goto GT_ERROR;
+    }
+    goto GT_DONE;
+
+    GT_ERROR:
+    Py_XDECREF(ret);
+    ret = NULL;
+
+    GT_DONE:
+    if (names) {
+        int ii;
+        for (ii = 0; ii < nservers; ii++) {
+            Py_XDECREF(names[ii]);
+        }
+        free(names);
+    }
+    Py_XDECREF(iter);
+    return ret;
+}
+
+PyObject *
+pycbc_Connection__node_stats(pycbc_Connection *self,
+                             PyObject *args,
+                             PyObject *kwargs)
+{
+    int rv;
+    int reset = 0;
+    size_t ii;
+    PyObject *ret;
+    VBUCKET_CONFIG_HANDLE config;
+
+    static char *kwlist[] = { "reset", NULL };
+
+    rv = PyArg_ParseTupleAndKeywords(args, kwargs, "|i", kwlist, &reset);
+    if (!rv) {
+        PYCBC_EXCTHROW_ARGS();
+        return NULL;
+    }
+
+    ret = PyDict_New();
+    if (!ret) {
+        return NULL;
+    }
+
+    config = get_config(self->instance);
+
+    for (ii = 0; config && ii < self->nnode_stats; ii++) {
+        struct pycbc_node_counters *counters = self->node_stats + ii;
+        PyObject *name, *value;
+
+        if (!counters->ops && !counters->bytes_out) {
+            continue;
+        }
+
+        name = server_name(config, (int)ii);
+        if (!name) {
+            /** The cluster has shrunk since these were recorded */
+            PyErr_Clear();
+            continue;
+        }
+
+        value = Py_BuildValue("{s:K,s:K,s:K,s:K}",
+                              "ops", counters->ops,
+                              "errors", counters->errors,
+                              "bytes_in", counters->bytes_in,
+                              "bytes_out", counters->bytes_out);
+        if (!value) {
+            Py_DECREF(name);
+            Py_DECREF(ret);
+            return NULL;
+        }
+
+        rv = PyDict_SetItem(ret, name, value);
+        Py_DECREF(name);
+        Py_DECREF(value);
+        if (rv == -1) {
+            Py_DECREF(ret);
+            return NULL;
+        }
+    }
+
+    if (reset && self->nnode_stats) {
+        memset(self->node_stats, 0,
+               self->nnode_stats * sizeof(*self->node_stats));
+    }
+
+    return ret;
+}
+
+#else /* !PYCBC_HAVE_VBMAP */
+
+static PyObject *
+vbmap_not_supported(void)
+{
+    PYCBC_EXC_WRAP(PYCBC_EXC_LCBERR, LCB_NOT_SUPPORTED,
+                   "Mapping keys to servers requires libcouchbase 2.1.0 "
+                   "or greater");
+    return NULL;
+}
+
+void
+pycbc_nodestats_record(lcb_t instance,
+                       const void *key,
+                       size_t nkey,
+                       size_t nbytes,
+                       lcb_error_t err)
+{
+    (void)instance;
+    (void)key;
+    (void)nkey;
+    (void)nbytes;
+    (void)err;
+}
+
+void
+pycbc_nodestats_update(pycbc_Connection *conn)
+{
+    (void)conn;
+}
+
+void
+pycbc_nodestats_sent(pycbc_Connection *conn,
+                     const void *key,
+                     size_t nkey,
+                     size_t nbytes)
+{
+    (void)conn;
+    (void)key;
+    (void)nkey;
+    (void)nbytes;
+}
+
+PyObject *
+pycbc_Connection__keys_by_node(pycbc_Connection *self,
+                               PyObject *args,
+                               PyObject *kwargs)
+{
+    (void)self;
+    (void)args;
+    (void)kwargs;
+    return vbmap_not_supported();
+}
+
+PyObject *
+pycbc_Connection__node_stats(pycbc_Connection *self,
+                             PyObject *args,
+                             PyObject *kwargs)
+{
+    (void)self;
+    (void)args;
+    (void)kwargs;
+    return vbmap_not_supported();
+}
+
+#endif /* PYCBC_HAVE_VBMAP */
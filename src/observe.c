@@ -129,22 +129,29 @@ observe_common(pycbc_Connection *self,
     int ii;
     Py_ssize_t ncmds;
     PyObject *kobj = NULL;
+    PyObject *timeout_O = NULL;
     pycbc_seqtype_t seqtype;
+    lcb_uint32_t timeout = 0;
     lcb_error_t err;
 
     struct pycbc_common_vars cv = PYCBC_COMMON_VARS_STATIC_INIT;
 
-    static char *kwlist[] = { "keys", NULL };
+    static char *kwlist[] = { "keys", "timeout", NULL };
     rv = PyArg_ParseTupleAndKeywords(args,
                                      kwargs,
-                                     "O",
+                                     "O|O",
                                      kwlist,
-                                     &kobj);
+                                     &kobj,
+                                     &timeout_O);
     if (!rv) {
         PYCBC_EXCTHROW_ARGS();
         return NULL;
     }
 
+    if (pycbc_get_timeout(timeout_O, &timeout) < 0) {
+        return NULL;
+    }
+
     if (argopts & PYCBC_ARGOPT_MULTI) {
         rv = pycbc_oputil_check_sequence(kobj, 1, &ncmds, &seqtype);
         if (rv < 0) {
@@ -157,12 +164,15 @@ observe_common(pycbc_Connection *self,
     rv = pycbc_common_vars_init(&cv,
                                 self,
                                 argopts,
+                                PYCBC_CMD_OBSERVE,
                                 ncmds, sizeof(lcb_observe_cmd_t),
                                 0);
     if (rv < 0) {
         return NULL;
     }
 
+    cv.timeout = timeout;
+
     if (argopts & PYCBC_ARGOPT_MULTI) {
         Py_ssize_t dictpos;
         PyObject *curseq, *iter = NULL;
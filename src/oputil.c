@@ -20,6 +20,22 @@ void
 pycbc_common_vars_finalize(struct pycbc_common_vars *cv, pycbc_Connection *conn)
 {
     int ii;
+
+    if (cv->retry) {
+        pycbc_retry_free(cv->retry);
+        cv->retry = NULL;
+    }
+
+    if (cv->replica) {
+        pycbc_replica_free(cv->replica);
+        cv->replica = NULL;
+    }
+
+    if (cv->deadline) {
+        lcb_timer_destroy(conn->instance, cv->deadline);
+        cv->deadline = NULL;
+    }
+
     if (cv->enckeys) {
         for (ii = 0; ii < cv->ncmds; ii++) {
             Py_XDECREF(cv->enckeys[ii]);
@@ -50,22 +66,285 @@ pycbc_common_vars_finalize(struct pycbc_common_vars *cv, pycbc_Connection *conn)
     }
 }
 
+static void
+deadline_callback(lcb_timer_t timer, lcb_t instance, const void *cookie)
+{
+    struct pycbc_common_vars *cv = (struct pycbc_common_vars *)cookie;
+
+    /** Non-periodic timers are destroyed by the library once we return */
+    cv->deadline = NULL;
+    cv->timed_out = 1;
+    lcb_breakout(instance);
+
+    (void)timer;
+}
+
+/**
+ * Make a result object with an LCB_ETIMEDOUT code for each command which
+ * did not receive a response before the deadline
+ */
+static int
+add_timeout_results(struct pycbc_common_vars *cv, pycbc_Connection *self)
+{
+    Py_ssize_t ii;
+    pycbc_MultiResult *mres = cv->mres;
+
+    if (cv->optype == PYCBC_CMD_STATS) {
+        return 0;
+    }
+
+    mres->all_ok = 0;
+
+    for (ii = 0; ii < cv->ncmds; ii++) {
+        const void *key;
+        size_t nkey;
+        PyObject *hkey;
+        pycbc_Result *res;
+
+        pycbc_oputil_cmd_at(&cv->cmds, cv->optype, ii, &key, &nkey);
+        if (pycbc_tc_decode_key(self, key, nkey, &hkey) < 0) {
+            return -1;
+        }
+
+        if (PyDict_GetItem((PyObject*)mres, hkey)) {
+            Py_DECREF(hkey);
+            continue;
+        }
+
+        switch (cv->optype) {
+        case PYCBC_CMD_GET:
+        case PYCBC_CMD_LOCK:
+        case PYCBC_CMD_GAT:
+        case PYCBC_CMD_INCR:
+        case PYCBC_CMD_DECR:
+        case PYCBC_CMD_ARITH:
+        case PYCBC_CMD_OBSERVE:
+            res = (pycbc_Result*)pycbc_valresult_new(self);
+            break;
+        default:
+            res = (pycbc_Result*)pycbc_opresult_new(self);
+            break;
+        }
+
+        if (!res) {
+            Py_DECREF(hkey);
+            return -1;
+        }
+
+        res->rc = LCB_ETIMEDOUT;
+        res->key = hkey;
+        PyDict_SetItem((PyObject*)mres, hkey, (PyObject*)res);
+        Py_DECREF(res);
+
+        /**
+         * Single key operations raise a TimeoutError. Multi operations
+         * return the partial results.
+         */
+        if ((cv->argopts & PYCBC_ARGOPT_SINGLE) && mres->errop == NULL) {
+            mres->errop = (PyObject*)res;
+            Py_INCREF(res);
+        }
+    }
+    return 0;
+}
+
+int
+pycbc_oputil_orphan(pycbc_Connection *self,
+                    pycbc_MultiResult *mres,
+                    Py_ssize_t nlate)
+{
+    if (!self->orphans) {
+        self->orphans = PyList_New(0);
+        if (!self->orphans) {
+            return -1;
+        }
+    }
+
+    if (PyList_Append(self->orphans, (PyObject*)mres) == -1) {
+        return -1;
+    }
+
+    /**
+     * The object keeps its reference to us. The cycle this forms is broken
+     * by the garbage collector (see Connection_clear) if the connection is
+     * dropped before the late responses arrive.
+     */
+    mres->nlate = nlate;
+    mres->abandoned = 1;
+    return 0;
+}
+
+/**
+ * Called if the deadline fired before all responses were received. The
+ * responses for the commands still in flight will arrive during subsequent
+ * operations; the MultiResult (which is their cookie) is kept alive in the
+ * connection's 'orphans' list until then.
+ *
+ * Only the operation's own commands are abandoned. Anything else in flight
+ * (such as the documents of a view being iterated) is not counted in its
+ * MultiResult.
+ */
+static int
+abandon_operation(struct pycbc_common_vars *cv, pycbc_Connection *self)
+{
+    pycbc_MultiResult *mres = cv->mres;
+    Py_ssize_t nlate = mres->nremaining;
+
+    assert(self->nremaining >= nlate);
+    self->nremaining -= nlate;
+    mres->nremaining = 0;
+
+    if (cv->retry) {
+        nlate -= pycbc_retry_cancel(cv->retry);
+    }
+
+    if (nlate > 0 && pycbc_oputil_orphan(self, mres, nlate) == -1) {
+        return -1;
+    }
+
+    return add_timeout_results(cv, self);
+}
+
+/**
+ * Release the MultiResult objects of abandoned operations which have
+ * received all of their responses
+ */
+static void
+sweep_orphans(pycbc_Connection *self)
+{
+    Py_ssize_t ii;
+
+    if (!self->orphans) {
+        return;
+    }
+
+    for (ii = PyList_GET_SIZE(self->orphans) - 1; ii >= 0; ii--) {
+        pycbc_MultiResult *mres =
+                (pycbc_MultiResult*)PyList_GET_ITEM(self->orphans, ii);
+
+        if (mres->nlate == 0) {
+            PySequence_DelItem(self->orphans, ii);
+        }
+    }
+}
+
+/**
+ * Name of the operation, for the timeline
+ */
+static const char *
+optype_name(int optype)
+{
+    switch (optype) {
+    case PYCBC_CMD_GET:
+        return "get";
+    case PYCBC_CMD_LOCK:
+        return "lock";
+    case PYCBC_CMD_TOUCH:
+        return "touch";
+    case PYCBC_CMD_GAT:
+        return "get_and_touch";
+    case PYCBC_CMD_INCR:
+    case PYCBC_CMD_DECR:
+    case PYCBC_CMD_ARITH:
+        return "arithmetic";
+    case PYCBC_CMD_DELETE:
+        return "delete";
+    case PYCBC_CMD_UNLOCK:
+        return "unlock";
+    case PYCBC_CMD_STORE:
+        return "store";
+    case PYCBC_CMD_OBSERVE:
+        return "observe";
+    case PYCBC_CMD_STATS:
+        return "stats";
+    default:
+        return "unknown";
+    }
+}
+
 int
 pycbc_common_vars_wait(struct pycbc_common_vars *cv, pycbc_Connection *self)
 {
     lcb_error_t err;
     Py_ssize_t nsched = cv->is_seqcmd ? 1 : cv->ncmds;
     self->nremaining += nsched;
+    cv->mres->nremaining += nsched;
+
+    /** Argument handling, conversion and scheduling of the commands */
+    PYCBC_TL_SPAN("schedule", optype_name(cv->optype), cv->tl_begin,
+                  cv->ncmds);
+
+    if (cv->timeout) {
+        cv->deadline = lcb_timer_create(self->instance,
+                                        cv,
+                                        cv->timeout,
+                                        0,
+                                        deadline_callback,
+                                        &err);
+        if (!cv->deadline) {
+            /** We've already scheduled; this must be drained normally */
+            cv->timeout = 0;
+        }
+    }
+
     err = pycbc_oputil_wait_common(self);
 
+    /**
+     * Commands waiting for a retry timer are still counted in nremaining;
+     * keep the loop running until they have been re-scheduled and answered.
+     */
+    while (err == LCB_SUCCESS &&
+            self->nremaining &&
+            !cv->timed_out &&
+            pycbc_retry_pending(cv->retry)) {
+        err = pycbc_oputil_wait_common(self);
+    }
+
+    if (cv->deadline) {
+        lcb_timer_destroy(self->instance, cv->deadline);
+        cv->deadline = NULL;
+    }
+
+    if (self->trace) {
+        pycbc_trace_batch(self->trace, cv,
+                          err != LCB_SUCCESS || cv->timed_out ||
+                          !cv->mres->all_ok);
+    }
+
+    PYCBC_TL_SPAN("operation", optype_name(cv->optype), cv->tl_begin,
+                  cv->ncmds);
+
     if (err != LCB_SUCCESS) {
-        self->nremaining -= nsched;
+        self->nremaining = 0;
+        cv->mres->nremaining = 0;
         PYCBC_EXCTHROW_WAIT(err);
         return -1;
     }
 
+    if (cv->timed_out && self->nremaining) {
+        if (abandon_operation(cv, self) == -1) {
+            return -1;
+        }
+    }
+
     assert(self->nremaining == 0);
 
+    if (cv->replica) {
+        pycbc_replica_free(cv->replica);
+        cv->replica = NULL;
+    }
+
+    if (cv->retry) {
+        err = pycbc_retry_sched_error(cv->retry);
+        pycbc_retry_free(cv->retry);
+        cv->retry = NULL;
+
+        if (err != LCB_SUCCESS) {
+            PYCBC_EXCTHROW_SCHED(err);
+            return -1;
+        }
+    }
+
     if (pycbc_multiresult_maybe_raise(cv->mres)) {
         return -1;
     }
@@ -96,6 +375,7 @@ int
 pycbc_common_vars_init(struct pycbc_common_vars *cv,
                        pycbc_Connection *self,
                        int argopts,
+                       int optype,
                        Py_ssize_t ncmds,
                        size_t tsize,
                        int want_vals)
@@ -107,10 +387,19 @@ pycbc_common_vars_init(struct pycbc_common_vars *cv,
         return -1;
     }
 
+    sweep_orphans(self);
+
     cv->ncmds = ncmds;
+    cv->optype = optype;
     cv->mres = (pycbc_MultiResult*)pycbc_multiresult_new(self);
     cv->argopts = argopts;
 
+    if (self->trace) {
+        cv->trace_begin = pycbc_trace_now();
+    }
+
+    cv->tl_begin = PYCBC_TL_NOW();
+
     if (!cv->mres) {
         pycbc_oputil_conn_unlock(self);
         return -1;
@@ -124,7 +413,7 @@ pycbc_common_vars_init(struct pycbc_common_vars *cv,
         cv->cmdlist.get = (void*)&cv->cmds.get;
         cv->enckeys = cv->_po_single;
         cv->encvals = cv->_po_single + 1;
-        return 0;
+        goto GT_RETRY;
     }
 
     /**
@@ -152,6 +441,15 @@ pycbc_common_vars_init(struct pycbc_common_vars *cv,
         return -1;
     }
 
+    GT_RETRY:
+    if (self->retry.max_attempts > 1) {
+        cv->retry = pycbc_retry_new(self, cv, optype);
+        if (PyErr_Occurred()) {
+            pycbc_common_vars_finalize(cv, self);
+            return -1;
+        }
+        cv->mres->retry = cv->retry;
+    }
 
     return 0;
 }
@@ -359,10 +657,139 @@ pycbc_oputil_conn_unlock(pycbc_Connection *self)
     PyThread_release_lock(self->lock);
 }
 
+const void *
+pycbc_oputil_cmd_at(union pycbc_u_pcmd *cmds,
+                    int optype,
+                    Py_ssize_t ii,
+                    const void **key,
+                    size_t *nkey)
+{
+    const void *dummy_key;
+    size_t dummy_nkey;
+
+    if (!key) {
+        key = &dummy_key;
+        nkey = &dummy_nkey;
+    }
+
+#define X(cmdname) \
+    *key = cmds->cmdname[ii].v.v0.key; \
+    *nkey = cmds->cmdname[ii].v.v0.nkey; \
+    return cmds->cmdname + ii;
+
+    switch (optype) {
+    case PYCBC_CMD_GET:
+    case PYCBC_CMD_LOCK:
+    case PYCBC_CMD_GAT:
+        X(get);
+    case PYCBC_CMD_TOUCH:
+        X(touch);
+    case PYCBC_CMD_INCR:
+    case PYCBC_CMD_DECR:
+    case PYCBC_CMD_ARITH:
+        X(arith);
+    case PYCBC_CMD_DELETE:
+        X(remove);
+    case PYCBC_CMD_UNLOCK:
+        X(unlock);
+    case PYCBC_CMD_STORE:
+        X(store);
+    case PYCBC_CMD_OBSERVE:
+        X(obs);
+    case PYCBC_CMD_STATS:
+        *key = cmds->stats[ii].v.v0.name;
+        *nkey = cmds->stats[ii].v.v0.nname;
+        return cmds->stats + ii;
+    default:
+        abort();
+        return NULL;
+    }
+#undef X
+}
+
+static size_t
+hash_key(const void *key, size_t nkey)
+{
+    const unsigned char *p = key;
+    size_t ii, h = 2166136261U;
+
+    for (ii = 0; ii < nkey; ii++) {
+        h ^= p[ii];
+        h *= 16777619U;
+    }
+    return h;
+}
+
+Py_ssize_t
+pycbc_cmdindex_find(struct pycbc_cmdindex *index,
+                    union pycbc_u_pcmd *cmds,
+                    int optype,
+                    Py_ssize_t ncmds,
+                    const void *key,
+                    size_t nkey)
+{
+    size_t pos, mask;
+    const void *ckey;
+    size_t cnkey;
+    Py_ssize_t ii;
+
+    if (ncmds == 1) {
+        pycbc_oputil_cmd_at(cmds, optype, 0, &ckey, &cnkey);
+        if (cnkey == nkey && memcmp(ckey, key, nkey) == 0) {
+            return 0;
+        }
+        return -1;
+    }
+
+    if (!index->slots) {
+        index->nslots = 8;
+        while (index->nslots < (size_t)ncmds * 2) {
+            index->nslots <<= 1;
+        }
+
+        index->slots = calloc(index->nslots, sizeof(*index->slots));
+        if (!index->slots) {
+            return -1;
+        }
+
+        mask = index->nslots - 1;
+        for (ii = 0; ii < ncmds; ii++) {
+            pycbc_oputil_cmd_at(cmds, optype, ii, &ckey, &cnkey);
+            pos = hash_key(ckey, cnkey) & mask;
+            while (index->slots[pos]) {
+                pos = (pos + 1) & mask;
+            }
+            index->slots[pos] = ii + 1;
+        }
+    }
+
+    mask = index->nslots - 1;
+    pos = hash_key(key, nkey) & mask;
+
+    while (index->slots[pos]) {
+        ii = index->slots[pos] - 1;
+        pycbc_oputil_cmd_at(cmds, optype, ii, &ckey, &cnkey);
+        if (cnkey == nkey && memcmp(ckey, key, nkey) == 0) {
+            return ii;
+        }
+        pos = (pos + 1) & mask;
+    }
+    return -1;
+}
+
+void
+pycbc_cmdindex_clear(struct pycbc_cmdindex *index)
+{
+    free(index->slots);
+    index->slots = NULL;
+    index->nslots = 0;
+}
+
 lcb_error_t
 pycbc_oputil_wait_common(pycbc_Connection *self)
 {
     lcb_error_t ret;
+    lcb_uint64_t begin;
     /**
      * If we have a 'lockmode' specified, check to see that nothing else is
      * using us. We lock in any event.
@@ -377,8 +804,12 @@ pycbc_oputil_wait_common(pycbc_Connection *self)
      * possible
      */
 
+    pycbc_nodestats_update(self);
+
+    begin = PYCBC_TL_NOW();
     PYCBC_CONN_THR_BEGIN(self);
     ret = lcb_wait(self->instance);
+    PYCBC_TL_SPAN("wait", "lcb_wait", begin, 0);
     PYCBC_CONN_THR_END(self);
 
 
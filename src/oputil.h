@@ -158,6 +158,37 @@ struct pycbc_common_vars {
      * only, with the callback decrementing it as needed
      */
     char is_seqcmd;
+
+    /**
+     * Retry context, if the connection has a retry policy and the operation
+     * supports retries. Freed once the operation has completed.
+     */
+    struct pycbc_retry_ctx_st *retry;
+
+    /** PYCBC_CMD_* constant for the operation */
+    int optype;
+
+    /** Replica read context, for 'get' with replica reads enabled */
+    struct pycbc_replica_ctx_st *replica;
+
+    /**
+     * Deadline for the operation, in microseconds. If the deadline passes,
+     * the operation returns with LCB_ETIMEDOUT for the outstanding commands.
+     * Set this after common_vars_init(). 0 means no deadline.
+     */
+    lcb_uint32_t timeout;
+
+    /** Timer enforcing the deadline, while armed */
+    lcb_timer_t deadline;
+
+    /** Whether the deadline timer has fired */
+    int timed_out;
+
+    /** When the operation began, if the connection is being traced */
+    lcb_uint64_t trace_begin;
+
+    /** When the operation began, if the timeline is being recorded */
+    lcb_uint64_t tl_begin;
 };
 
 #define PYCBC_COMMON_VARS_STATIC_INIT { { { 0 } } }
@@ -253,6 +284,8 @@ int pycbc_oputil_sequence_next(pycbc_seqtype_t seqtype,
 /**
  * Initialize the 'common_vars' structure.
  * @param cv a pointer to a zero-populated common_vars struct
+ * @param optype the PYCBC_CMD_* constant for the operation. This determines
+ * how commands are re-scheduled if a retry policy is in effect
  * @param ncmds the number of keys in the operation
  * @param tsize the size of the lcb_cmd_t structure to use
  * @param want_vals whether this operation will need to use values. This is
@@ -261,6 +294,7 @@ int pycbc_oputil_sequence_next(pycbc_seqtype_t seqtype,
 int pycbc_common_vars_init(struct pycbc_common_vars *cv,
                            pycbc_Connection *self,
                            int argopts,
+                           int optype,
                            Py_ssize_t ncmds,
                            size_t tsize,
                            int want_vals);
@@ -277,6 +311,36 @@ void pycbc_common_vars_finalize(struct pycbc_common_vars *cv, pycbc_Connection *
  */
 int pycbc_common_vars_wait(struct pycbc_common_vars *cv, pycbc_Connection *self);
 
+/**
+ * Monotonic clock used for traces, in microseconds
+ */
+lcb_uint64_t pycbc_trace_now(void);
+
+/**
+ * Append the completed operation to the trace. Write errors are recorded
+ * in the trace and reported when it is stopped.
+ * @param failed whether any of the commands failed
+ */
+void pycbc_trace_batch(struct pycbc_trace_st *trace,
+                       const struct pycbc_common_vars *cv,
+                       int failed);
+
+/**
+ * Close the trace file and free the trace
+ */
+void pycbc_trace_close(struct pycbc_trace_st *trace);
+
+
+/**
+ * Keep a MultiResult alive in the connection's 'orphans' list until 'nlate'
+ * more responses have arrived for it. These responses are discarded.
+ * @return 0 on success, -1 with a Python exception on failure
+ */
+int
+pycbc_oputil_orphan(pycbc_Connection *self,
+                    pycbc_MultiResult *mres,
+                    Py_ssize_t nlate);
+
 
 /**
  * Wrapper around lcb_wait(). This ensures threading contexts are properly
@@ -297,6 +361,101 @@ int pycbc_oputil_conn_lock(pycbc_Connection *self);
  */
 void pycbc_oputil_conn_unlock(pycbc_Connection *self);
 
+/**
+ * Get the command at the given index of a command array, along with its key.
+ * @param cmds the command array
+ * @param optype the PYCBC_CMD_* constant, determining the command type
+ * @param ii the index
+ * @param key if not NULL, populated with the command's key
+ * @param nkey if key is not NULL, populated with the key's length
+ * @return a pointer to the command
+ */
+const void *
+pycbc_oputil_cmd_at(union pycbc_u_pcmd *cmds,
+                    int optype,
+                    Py_ssize_t ii,
+                    const void **key,
+                    size_t *nkey);
+
+/**
+ * Hash table for looking up a command by its key. This is used by callbacks
+ * which need to find the command a response belongs to. Zero-initialize
+ * before use.
+ */
+struct pycbc_cmdindex {
+    /** Open-addressed slots, containing the command index + 1 */
+    Py_ssize_t *slots;
+    size_t nslots;
+};
+
+/**
+ * Find the index of the command with the given key. The table is built on
+ * the first call. Does not require the GIL.
+ * @return the index, or -1 if no command has this key (or if the table
+ * could not be allocated)
+ */
+Py_ssize_t
+pycbc_cmdindex_find(struct pycbc_cmdindex *index,
+                    union pycbc_u_pcmd *cmds,
+                    int optype,
+                    Py_ssize_t ncmds,
+                    const void *key,
+                    size_t nkey);
+
+/**
+ * Free the table's memory
+ */
+void pycbc_cmdindex_clear(struct pycbc_cmdindex *index);
+
+/**
+ * Create a retry context for the commands in 'cv'. This returns NULL
+ * (without an error) if retries are disabled or not supported for the
+ * operation type.
+ */
+struct pycbc_retry_ctx_st *
+pycbc_retry_new(pycbc_Connection *conn,
+                struct pycbc_common_vars *cv,
+                int optype);
+
+/**
+ * Destroy the retry context, cancelling any pending backoff timer
+ */
+void pycbc_retry_free(struct pycbc_retry_ctx_st *ctx);
+
+/**
+ * Cancel the backoff timer
+ * @return the number of commands which were waiting for the timer, and
+ * thus will not be re-sent
+ */
+Py_ssize_t pycbc_retry_cancel(struct pycbc_retry_ctx_st *ctx);
+
+/**
+ * Whether there are commands waiting on a backoff timer
+ */
+int pycbc_retry_pending(struct pycbc_retry_ctx_st *ctx);
+
+/**
+ * Error code from re-scheduling commands, if any
+ */
+lcb_error_t pycbc_retry_sched_error(struct pycbc_retry_ctx_st *ctx);
+
+/**
+ * Create a replica read context for the get commands in 'cv'. This must be
+ * called after the commands are populated, and before they are scheduled.
+ * @param mode PYCBC_REPLICA_* flags
+ * @param hedge delay before sending hedged reads, in microseconds
+ */
+struct pycbc_replica_ctx_st *
+pycbc_replica_new(pycbc_Connection *conn,
+                  struct pycbc_common_vars *cv,
+                  int mode,
+                  lcb_uint32_t hedge);
+
+/**
+ * Destroy the replica context, cancelling the hedge timer
+ */
+void pycbc_replica_free(struct pycbc_replica_ctx_st *ctx);
+
 /**
  * Macro to declare prototypes for entry points.
  * If the entry point is foo, then it is expected that there exist a C
@@ -348,9 +507,22 @@ PYCBC_DECL_OP(lock_multi);
 
 /* http.c */
 PYCBC_DECL_OP(_http_request);
+PYCBC_DECL_OP(_http_request_multi);
 
 /* observe.c */
 PYCBC_DECL_OP(observe);
 PYCBC_DECL_OP(observe_multi);
 
+/* retry.c */
+PYCBC_DECL_OP(_set_retry_policy);
+PYCBC_DECL_OP(_get_retry_policy);
+
+/* nodestats.c */
+PYCBC_DECL_OP(_keys_by_node);
+PYCBC_DECL_OP(_node_stats);
+
+/* trace.c */
+PYCBC_DECL_OP(_start_trace);
+PYCBC_DECL_OP(_stop_trace);
+
 #endif /* PYCBC_OPUTIL_H */
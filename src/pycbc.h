@@ -112,6 +112,14 @@ unsigned long pycbc_IntAsUL(PyObject *o);
  */
 int pycbc_get_ttl(PyObject *obj, unsigned long *ttl, int nonzero);
 
+/**
+ * Converts a timeout in seconds into microseconds
+ * @param obj a float or int in seconds. None or NULL mean no timeout
+ * @param usecs populated with the timeout, or 0 if there is no timeout
+ * @return 0 on success, -1 (with an exception set) if the timeout is invalid
+ */
+int pycbc_get_timeout(PyObject *obj, lcb_uint32_t *usecs);
+
 /**
  * Fetches a valid 32 bit integer from the object. The object must be a long
  * or int.
@@ -142,6 +150,12 @@ int pycbc_BufFromString(PyObject *orig,
                         Py_ssize_t *nbuf,
                         PyObject **newkey);
 
+/**
+ * Monotonic clock, in nanoseconds from an arbitrary point. This is used
+ * for all internal timing (traces, the timeline and benchmarks)
+ */
+lcb_uint64_t pycbc_monotonic_ns(void);
+
 
 /**
  * These constants are used internally to figure out the high level
@@ -159,7 +173,10 @@ enum {
     PYCBC_CMD_DECR,
     PYCBC_CMD_ARITH,
     PYCBC_CMD_DELETE,
-    PYCBC_CMD_UNLOCK
+    PYCBC_CMD_UNLOCK,
+    PYCBC_CMD_STORE,
+    PYCBC_CMD_OBSERVE,
+    PYCBC_CMD_STATS
 };
 
 /**
@@ -219,6 +236,66 @@ enum {
     /** more flags will follow.. */
 };
 
+/** Maximum number of error codes a retry policy may list */
+#define PYCBC_RETRY_MAXCODES 16
+
+/**
+ * Policy for re-scheduling commands which failed with a transient error.
+ * A copy of this is taken at the start of each operation. See retry.c
+ */
+struct pycbc_retry_policy {
+    /** Total attempts per command, including the first. 1 disables retries */
+    unsigned int max_attempts;
+
+    /** Delay before the first retry, in microseconds */
+    lcb_uint32_t backoff;
+
+    /** Multiplier applied to the delay for each subsequent retry */
+    double factor;
+
+    /** Upper bound for the delay, in microseconds */
+    lcb_uint32_t max_backoff;
+
+    /** Error codes which are considered transient */
+    lcb_error_t codes[PYCBC_RETRY_MAXCODES];
+    unsigned int ncodes;
+};
+
+struct pycbc_retry_ctx_st;
+
+/**
+ * Replica read modes for 'get'. See replica.c
+ */
+enum {
+    /** Read from a replica if the active node fails */
+    PYCBC_REPLICA_FALLBACK = 1 << 0,
+
+    /** Read from a replica if the active node is slow to respond */
+    PYCBC_REPLICA_HEDGE = 1 << 1
+};
+
+struct pycbc_replica_ctx_st;
+struct pycbc_StatsSampler_st;
+struct pycbc_htaggr_st;
+struct pycbc_inflate_st;
+
+/**
+ * Operation counters for a single server. See nodestats.c
+ */
+struct pycbc_node_counters {
+    /** Responses received */
+    lcb_uint64_t ops;
+
+    /** Responses with an error */
+    lcb_uint64_t errors;
+
+    /** Value bytes received */
+    lcb_uint64_t bytes_in;
+
+    /** Value bytes scheduled for storage */
+    lcb_uint64_t bytes_out;
+};
+
 typedef struct {
     PyObject_HEAD
 
@@ -255,7 +332,10 @@ typedef struct {
     /** whether __init__ has already been called */
     unsigned char init_called;
 
-    /** How many operations are waiting for a reply */
+    /**
+     * How many operations are waiting for a reply. Documents fetched for
+     * view rows are not counted here (see pycbc_MultiResult.viewdocs)
+     */
     Py_ssize_t nremaining;
 
     /**
@@ -264,6 +344,25 @@ typedef struct {
      */
     unsigned int flags;
 
+    /** Retry policy for transient errors */
+    struct pycbc_retry_policy retry;
+
+    /**
+     * List of MultiResult objects for operations which were abandoned at
+     * their deadline, and are still expecting responses.
+     */
+    PyObject *orphans;
+
+    /** Whether to update the per-server counters */
+    unsigned int track_node_stats;
+
+    /** Per-server counters, indexed by the server's position in the map */
+    struct pycbc_node_counters *node_stats;
+    size_t nnode_stats;
+
+    /** Operation trace being recorded, if any. See trace.c */
+    struct pycbc_trace_st *trace;
+
 } pycbc_Connection;
 
 
@@ -316,6 +415,73 @@ typedef struct {
      */
     lcbex_vrow_ctx_t *rctx;
 
+    /**
+     * Exception raised while decoding a row, or while writing to the sink.
+     * This is raised by the next call to _fetch(), or once a request with a
+     * sink completes
+     */
+    PyObject *row_error;
+
+    /**
+     * If documents are fetched as their rows arrive (PYCBC_HTRES_F_DOCS),
+     * the MultiResult receiving the documents for the buffered rows, and the
+     * set of IDs already requested for them
+     */
+    PyObject *docs;
+    PyObject *docids;
+
+    /** The documents for the rows last returned by _fetch() */
+    PyObject *page_docs;
+
+    /**
+     * Limits on the rows returned by each _fetch(); 0 if unlimited. Rows
+     * past these stay in 'rowsbuf', and this request's _fetch() does not
+     * read from the connection again until they have been returned.
+     * Other operations on the connection still run its event loop, so
+     * rows may be buffered past the limits; once PYCBC_HTRES_OVERFLOW
+     * times the limits are buffered, the rest of the body is discarded
+     * and _fetch() raises an error. This only applies once _fetch() has
+     * been called (PYCBC_HTRES_F_FETCHED).
+     */
+    unsigned long max_rows;
+    unsigned long max_bytes;
+
+    /**
+     * Rows, and their encoded size, buffered when _fetch() was first
+     * called. These were received before the request was iterated over
+     * (e.g. by a ParallelView) and do not count towards the overflow.
+     */
+    unsigned long nbacklog_rows;
+    size_t nbacklog_bytes;
+
+    /** Encoded size of each row in 'rowsbuf', if max_bytes is set */
+    size_t *rowsizes;
+    size_t nrowsizes_alloc;
+
+    /** Sum of 'rowsizes' */
+    size_t nrowsbytes;
+
+    /**
+     * If the body is written to a sink (PYCBC_HTRES_F_SINK), the callable
+     * receiving each chunk. If this is NULL, chunks are written to
+     * 'sink_fd' instead
+     */
+    PyObject *sink;
+    int sink_fd;
+
+    /**
+     * For chunked requests with a sink, rows waiting to be written, and
+     * the number of rows exported
+     */
+    lcbex_vrow_buffer sinkbuf;
+    unsigned long nsink_rows;
+
+    /** If set, rows are aggregated rather than buffered. See aggregate.c */
+    struct pycbc_htaggr_st *aggr;
+
+    /** If the response body is compressed, its decompressor */
+    struct pycbc_inflate_st *inflate;
+
     /**
      * HTTP Request handle
      */
@@ -331,11 +497,31 @@ typedef struct {
 enum {
     PYCBC_HTRES_F_CHUNKED   = 1 << 0,
     PYCBC_HTRES_F_QUIET     = 1 << 1,
-    PYCBC_HTRES_F_COMPLETE  = 1 << 2
+    PYCBC_HTRES_F_COMPLETE  = 1 << 2,
+    PYCBC_HTRES_F_DOCS      = 1 << 3,
+    PYCBC_HTRES_F_SINK      = 1 << 4,
+
+    /** Set once the response's Content-Encoding has been checked */
+    PYCBC_HTRES_F_ENCODING  = 1 << 5,
+
+    /**
+     * Set if the body cannot be decoded, or if too many rows were buffered,
+     * and the rest of it is discarded
+     */
+    PYCBC_HTRES_F_DISCARD   = 1 << 6,
+
+    /** Set once _fetch() has been called */
+    PYCBC_HTRES_F_FETCHED   = 1 << 7
 };
 
+/** Multiple of the page limits at which buffered rows are discarded */
+#define PYCBC_HTRES_OVERFLOW 16
+
 PyObject* pycbc_HttpResult__fetch(pycbc_HttpResult *self);
 
+/** Size of the blocks in which exported rows are written to a sink */
+#define PYCBC_SINK_BLOCKSIZE 65536
+
 /**
  * Object containing the result of a 'Multi' operation. It's the same as a
  * normal dict, except we add an 'all_ok' field, so a user doesn't need to
@@ -364,6 +550,41 @@ typedef struct {
 
     /** Equivalent to 'quiet' in the API. Don't raise exceptions on ENOENT */
     int no_raise_enoent;
+
+    /**
+     * Retry state for the operation, if the connection has a retry policy.
+     * Owned by the operation's common_vars, not by this object.
+     */
+    struct pycbc_retry_ctx_st *retry;
+
+    /**
+     * Replica read state, if replica reads were requested. Owned by the
+     * operation's common_vars.
+     */
+    struct pycbc_replica_ctx_st *replica;
+
+    /**
+     * Stats sampler receiving the values for a STATS operation, rather than
+     * this object. Borrowed.
+     */
+    struct pycbc_StatsSampler_st *sampler;
+
+    /**
+     * Set if the operation's deadline passed before all responses arrived.
+     * Late responses are discarded; 'nlate' is the number still expected.
+     */
+    int abandoned;
+    Py_ssize_t nlate;
+
+    /** How many of this object's commands are waiting for a reply */
+    Py_ssize_t nremaining;
+
+    /**
+     * Set for the documents fetched along with a view's rows. Their gets may
+     * be in flight across other operations, so they are only counted in
+     * 'nremaining' here, and not in the connection's.
+     */
+    int viewdocs;
 } pycbc_MultiResult;
 
 
@@ -543,6 +764,46 @@ struct pycbc_helpers_ST {
  */
 extern struct pycbc_helpers_ST pycbc_helpers;
 
+/**
+ * Timeline of internal activity (timeline.c). Spans are recorded while
+ * pycbc_timeline_enabled is set:
+ *
+ *  lcb_uint64_t begin = PYCBC_TL_NOW();
+ *  ... do something ...
+ *  PYCBC_TL_SPAN("category", "name", begin, 0);
+ *
+ * The category and name must be static strings. A span whose begin is 0
+ * (because the timeline was disabled when it began) is not recorded.
+ */
+extern int pycbc_timeline_enabled;
+
+#define PYCBC_TL_NOW() (pycbc_timeline_enabled ? pycbc_monotonic_ns() : 0)
+
+#define PYCBC_TL_SPAN(cat, name, begin, n) \
+    do { \
+        if (begin) { \
+            pycbc_timeline_span(cat, name, begin, n); \
+        } \
+    } while (0)
+
+/**
+ * Record a span from 'begin' until now, in the calling thread's buffer.
+ * This does not need the GIL.
+ * @param n a number to display with the span (e.g. a count or size)
+ */
+void pycbc_timeline_span(const char *cat,
+                         const char *name,
+                         lcb_uint64_t begin,
+                         lcb_uint64_t n);
+
+PyObject *pycbc_timeline_enable(PyObject *self,
+                                PyObject *args,
+                                PyObject *kwargs);
+PyObject *pycbc_timeline_disable(PyObject *self, PyObject *args);
+PyObject *pycbc_timeline_collect(PyObject *self,
+                                 PyObject *args,
+                                 PyObject *kwargs);
+
 /**
  * Threading macros
  */
@@ -557,9 +818,11 @@ extern struct pycbc_helpers_ST pycbc_helpers;
 
 #define PYCBC_CONN_THR_END(conn) \
     if ((conn)->unlock_gil) { \
+        lcb_uint64_t pycbc__gil_begin = PYCBC_TL_NOW(); \
         assert((conn)->thrstate); \
         PyEval_RestoreThread((conn)->thrstate); \
         (conn)->thrstate = NULL; \
+        PYCBC_TL_SPAN("gil", "acquire", pycbc__gil_begin, 0); \
     }
 
 #else
@@ -591,6 +854,7 @@ int pycbc_OperationResultType_init(PyObject **ptr);
 int pycbc_HttpResultType_init(PyObject **ptr);
 int pycbc_TranscoderType_init(PyObject **ptr);
 int pycbc_ObserveInfoType_init(PyObject **ptr);
+int pycbc_StatsSamplerType_init(PyObject **ptr);
 
 
 /**
@@ -630,6 +894,75 @@ int pycbc_multiresult_maybe_raise(pycbc_MultiResult *self);
 void pycbc_callbacks_init(lcb_t instance);
 void pycbc_http_callbacks_init(lcb_t instance);
 
+/**
+ * Called from the operation callbacks (without the GIL) when a command
+ * fails. If the error is retryable under the connection's policy, the command
+ * is queued for re-scheduling and the response should be discarded.
+ * See retry.c
+ *
+ * @return 1 if the command was re-queued, 0 otherwise
+ */
+int pycbc_retry_requeue(struct pycbc_retry_ctx_st *ctx,
+                        const void *key,
+                        size_t nkey,
+                        lcb_error_t err);
+
+/**
+ * Called from the get callback (without the GIL) when replica reads are in
+ * use. Decides whether the response should be delivered or discarded in
+ * favor of another read for the same key; the retry policy, if any, is
+ * applied to errors which would otherwise be delivered. See replica.c
+ *
+ * @return 1 if the response should be discarded, 0 otherwise
+ */
+int pycbc_replica_handle(struct pycbc_replica_ctx_st *ctx,
+                         struct pycbc_retry_ctx_st *retry,
+                         const void *key,
+                         size_t nkey,
+                         lcb_error_t err);
+
+/**
+ * Update the counters for the server owning 'key' with a response. Called
+ * from the callbacks (without the GIL). See nodestats.c
+ * @param nbytes the size of the value received, if any
+ */
+void pycbc_nodestats_record(lcb_t instance,
+                            const void *key,
+                            size_t nkey,
+                            size_t nbytes,
+                            lcb_error_t err);
+
+/**
+ * Size the per-server counters for the current cluster map. This must be
+ * called with the GIL held, as the counters may be read by other threads.
+ */
+void pycbc_nodestats_update(pycbc_Connection *conn);
+
+/**
+ * Add 'nbytes' to the outgoing byte count of the server owning 'key'
+ */
+void pycbc_nodestats_sent(pycbc_Connection *conn,
+                          const void *key,
+                          size_t nkey,
+                          size_t nbytes);
+
+/**
+ * Store a single statistic in the sampler's current slot, if it is one of
+ * the sampled statistics and is numeric. Called without the GIL.
+ * See sampler.c
+ */
+void pycbc_sampler_record(struct pycbc_StatsSampler_st *sampler,
+                          const char *endpoint,
+                          const void *key,
+                          size_t nkey,
+                          const void *bytes,
+                          size_t nbytes);
+
+/**
+ * Initialize a retry policy with the defaults (i.e. retries disabled)
+ */
+void pycbc_retry_policy_init(struct pycbc_retry_policy *policy);
+
 
 /**
  * "Real" exception handler.
@@ -759,6 +1092,108 @@ int pycbc_tc_decode_value(pycbc_Connection *conn,
 
 
 
+/**
+ * Decode a JSON document directly into Python objects. See jsondec.c
+ * @return a new reference, or NULL with a ValueError set if the input
+ * could not be decoded
+ */
+PyObject *pycbc_json_decode(const char *s, size_t n);
+
+/** Maximum number of paths for pycbc_json_decode_projected */
+#define PYCBC_JSON_MAXFIELDS 32
+
+/**
+ * Like pycbc_json_decode, but only extract the values at the given JSON
+ * pointers. The result keeps the structure of the document, containing only
+ * the matched paths. Other values are skipped without being decoded.
+ * Array elements keep their index; unmatched elements before the last
+ * matched one are replaced by None.
+ * @param jprs the paths. If there are none, the whole document is decoded
+ */
+PyObject *pycbc_json_decode_projected(const char *s,
+                                      size_t n,
+                                      const jsonsl_jpr_t *jprs,
+                                      size_t njprs);
+
+/**
+ * Append the document, or its projection onto the given JSON pointers, to
+ * 'out' as JSON text on a single line. Matched values are copied from the
+ * input rather than being decoded.
+ * @return 0 on success, or -1 with an exception set (and 'out' unchanged)
+ */
+int pycbc_json_project_text(const char *s,
+                            size_t n,
+                            const jsonsl_jpr_t *jprs,
+                            size_t njprs,
+                            lcbex_vrow_buffer *out);
+
+/**
+ * Find the number at the given JSON pointer within a document, without
+ * decoding the document.
+ * @return 1 if a number was found (and stored in 'out'), 0 if the path is
+ * not present or is not a number, or -1 with an exception set on error
+ */
+int pycbc_json_find_number(const char *s,
+                           size_t n,
+                           jsonsl_jpr_t jpr,
+                           double *out);
+
+/**
+ * Create an aggregate over view rows. See aggregate.c
+ * @param path JSON pointer of the number to aggregate within each row, or
+ * an empty string to only count the rows
+ * @param bounds histogram bucket boundaries, or NULL
+ * @return the aggregate, or NULL with an exception set
+ */
+struct pycbc_htaggr_st *pycbc_htaggr_new(PyObject *path, PyObject *bounds);
+
+/**
+ * Add a row to the aggregate.
+ * @return 0 on success, or -1 with an exception set if the row is invalid
+ */
+int pycbc_htaggr_add(struct pycbc_htaggr_st *aggr,
+                     const char *row,
+                     size_t nrow);
+
+/** Return the aggregated values as a dict */
+PyObject *pycbc_htaggr_result(struct pycbc_htaggr_st *aggr);
+
+void pycbc_htaggr_free(struct pycbc_htaggr_st *aggr);
+
+/**
+ * Receives decompressed data.
+ * @return 0 to continue, or -1 with an exception set to stop
+ */
+typedef int (*pycbc_inflate_cb)(void *arg, const char *data, size_t ndata);
+
+/**
+ * Create a decompressor for an HTTP Content-Encoding. See inflate.c
+ * @param encoding the encoding, either "gzip" or "deflate"
+ * @return the decompressor, or NULL with an exception set
+ */
+struct pycbc_inflate_st *pycbc_inflate_new(const char *encoding);
+
+/**
+ * Decompress the next chunk of the body, invoking 'callback' for each
+ * block of output. Once the end of the compressed data has been reached, or
+ * an error has occurred, any further data is ignored.
+ * @return 0 on success, or -1 with an exception set if the data is invalid
+ * or the callback failed
+ */
+int pycbc_inflate_feed(struct pycbc_inflate_st *ctx,
+                       const void *data,
+                       size_t ndata,
+                       pycbc_inflate_cb callback,
+                       void *arg);
+
+void pycbc_inflate_free(struct pycbc_inflate_st *ctx);
+
+/**
+ * Time a key or value conversion routine over a number of iterations. See
+ * convbench.c, which is only built if PYCBC_HAVE_CONVBENCH is defined
+ */
+PyObject *pycbc_convbench(PyObject *self, PyObject *args, PyObject *kwargs);
+
 /**
  * Like encode_value, but only uses built-in encoders
  */
@@ -0,0 +1,309 @@
+/**
+ *     Copyright 2013 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ **/
+
+#include "oputil.h"
+
+/**
+ * This file implements replica reads for 'get'.
+ *
+ * In 'fallback' mode, a replica read is sent for a key once its read from
+ * the active node has failed with an error indicating the node is not
+ * reachable.
+ *
+ * In 'hedged' mode, a timer is armed when the operation is scheduled. When it
+ * fires, a replica read is sent for each key which has not yet been answered.
+ *
+ * Both the primary and replica responses share the operation's cookie and
+ * arrive in the get callback. The first successful response for a key is
+ * delivered; any other response for the key is discarded. An error is only
+ * delivered if there are no other reads still in flight for the key.
+ *
+ * A key repeated within the batch is tracked in the slot of its first
+ * occurrence, which counts the reads for every occurrence. Replica reads are
+ * only sent for that slot.
+ *
+ * Each additional read is added to the 'nremaining' counts of the connection
+ * and the MultiResult, and each discarded response subtracts from them. As with retries, these functions
+ * operate only on C data and do not need the GIL.
+ */
+
+enum {
+    /** A response has been delivered for this key */
+    REPLICA_F_DONE = 1 << 0,
+
+    /** A replica read has been sent for this key */
+    REPLICA_F_SENT = 1 << 1,
+
+    /** The key is a repeat of an earlier one, whose slot is used instead */
+    REPLICA_F_DUP = 1 << 2
+};
+
+struct replica_key {
+    /** Number of reads in flight for this key */
+    unsigned int inflight;
+    unsigned char flags;
+};
+
+struct pycbc_replica_ctx_st {
+    /** Parent connection. Borrowed */
+    pycbc_Connection *conn;
+
+    /** Cookie for the commands. Borrowed */
+    pycbc_MultiResult *mres;
+
+    /** Primary get commands, owned by the common_vars */
+    union pycbc_u_pcmd cmds;
+    Py_ssize_t ncmds;
+
+    /** PYCBC_REPLICA_* flags */
+    int mode;
+
+    /** Per-key state */
+    struct replica_key *keys;
+
+    /** Key lookup table */
+    struct pycbc_cmdindex index;
+
+    /** Replica commands, and a list of pointers for scheduling them */
+    lcb_get_replica_cmd_t *rcmds;
+    const lcb_get_replica_cmd_t **sched;
+
+    /** Hedge timer, while armed */
+    lcb_timer_t timer;
+};
+
+/**
+ * Errors which suggest the active node for the key is unavailable
+ */
+static int
+is_fallback_error(lcb_error_t err)
+{
+    switch (err) {
+    case LCB_NETWORK_ERROR:
+    case LCB_CONNECT_ERROR:
+    case LCB_ETIMEDOUT:
+    case LCB_ETMPFAIL:
+        return 1;
+
+    default:
+        return 0;
+    }
+}
+
+static void
+drop_response(struct pycbc_replica_ctx_st *ctx)
+{
+    assert(ctx->conn->nremaining && ctx->mres->nremaining);
+
+    ctx->mres->nremaining--;
+    if (!--ctx->conn->nremaining) {
+        lcb_breakout(ctx->conn->instance);
+    }
+}
+
+/**
+ * Schedule replica reads for the first 'n' entries in ctx->sched.
+ */
+static lcb_error_t
+send_replicas(struct pycbc_replica_ctx_st *ctx, Py_ssize_t n)
+{
+    lcb_error_t err;
+
+    err = lcb_get_replica(ctx->conn->instance, ctx->mres, n, ctx->sched);
+    if (err == LCB_SUCCESS) {
+        ctx->conn->nremaining += n;
+        ctx->mres->nremaining += n;
+    }
+    return err;
+}
+
+static void
+timer_callback(lcb_timer_t timer, lcb_t instance, const void *cookie)
+{
+    struct pycbc_replica_ctx_st *ctx = (struct pycbc_replica_ctx_st *)cookie;
+    Py_ssize_t ii, nsched = 0;
+
+    /** Non-periodic timers are destroyed by the library once we return */
+    ctx->timer = NULL;
+
+    for (ii = 0; ii < ctx->ncmds; ii++) {
+        if (ctx->keys[ii].flags &
+                (REPLICA_F_DONE|REPLICA_F_SENT|REPLICA_F_DUP)) {
+            continue;
+        }
+        ctx->sched[nsched++] = ctx->rcmds + ii;
+    }
+
+    if (!nsched || send_replicas(ctx, nsched) != LCB_SUCCESS) {
+        /** The primary reads are still in flight */
+        return;
+    }
+
+    for (ii = 0; ii < nsched; ii++) {
+        struct replica_key *rk = ctx->keys + (ctx->sched[ii] - ctx->rcmds);
+        rk->flags |= REPLICA_F_SENT;
+        rk->inflight++;
+    }
+
+    (void)timer;
+    (void)instance;
+}
+
+int
+pycbc_replica_handle(struct pycbc_replica_ctx_st *ctx,
+                     struct pycbc_retry_ctx_st *retry,
+                     const void *key,
+                     size_t nkey,
+                     lcb_error_t err)
+{
+    Py_ssize_t ix;
+    struct replica_key *rk;
+
+    ix = pycbc_cmdindex_find(&ctx->index, &ctx->cmds, PYCBC_CMD_GET,
+                             ctx->ncmds, key, nkey);
+    if (ix < 0) {
+        return 0;
+    }
+
+    rk = ctx->keys + ix;
+    rk->inflight--;
+
+    if (rk->flags & REPLICA_F_DONE) {
+        /** Lost the race */
+        drop_response(ctx);
+        return 1;
+    }
+
+    if (err == LCB_SUCCESS) {
+        rk->flags |= REPLICA_F_DONE;
+        return 0;
+    }
+
+    if ((ctx->mode & PYCBC_REPLICA_FALLBACK) &&
+            !(rk->flags & REPLICA_F_SENT) &&
+            is_fallback_error(err)) {
+        ctx->sched[0] = ctx->rcmds + ix;
+        if (send_replicas(ctx, 1) == LCB_SUCCESS) {
+            rk->flags |= REPLICA_F_SENT;
+            rk->inflight++;
+            drop_response(ctx);
+            return 1;
+        }
+    }
+
+    if (rk->inflight) {
+        /** Another read may still succeed */
+        drop_response(ctx);
+        return 1;
+    }
+
+    if (retry && pycbc_retry_requeue(retry, key, nkey, err)) {
+        rk->inflight++;
+        return 1;
+    }
+
+    rk->flags |= REPLICA_F_DONE;
+    return 0;
+}
+
+struct pycbc_replica_ctx_st *
+pycbc_replica_new(pycbc_Connection *conn,
+                  struct pycbc_common_vars *cv,
+                  int mode,
+                  lcb_uint32_t hedge)
+{
+    Py_ssize_t ii;
+    struct pycbc_replica_ctx_st *ctx;
+
+    ctx = calloc(1, sizeof(*ctx));
+    if (!ctx) {
+        PyErr_SetNone(PyExc_MemoryError);
+        return NULL;
+    }
+
+    ctx->conn = conn;
+    ctx->mres = cv->mres;
+    ctx->cmds = cv->cmds;
+    ctx->ncmds = cv->ncmds;
+    ctx->mode = mode;
+    ctx->keys = calloc(cv->ncmds, sizeof(*ctx->keys));
+    ctx->rcmds = calloc(cv->ncmds, sizeof(*ctx->rcmds));
+    ctx->sched = malloc(cv->ncmds * sizeof(*ctx->sched));
+
+    if (!(ctx->keys && ctx->rcmds && ctx->sched)) {
+        pycbc_replica_free(ctx);
+        PyErr_SetNone(PyExc_MemoryError);
+        return NULL;
+    }
+
+    for (ii = 0; ii < ctx->ncmds; ii++) {
+        const lcb_get_cmd_t *gcmd = ctx->cmds.get + ii;
+        Py_ssize_t ix;
+
+        ctx->rcmds[ii].v.v0.key = gcmd->v.v0.key;
+        ctx->rcmds[ii].v.v0.nkey = gcmd->v.v0.nkey;
+
+        ix = pycbc_cmdindex_find(&ctx->index, &ctx->cmds, PYCBC_CMD_GET,
+                                 ctx->ncmds,
+                                 gcmd->v.v0.key, gcmd->v.v0.nkey);
+        if (ix < 0) {
+            pycbc_replica_free(ctx);
+            PyErr_SetNone(PyExc_MemoryError);
+            return NULL;
+        }
+
+        ctx->keys[ix].inflight++;
+        if (ix != ii) {
+            ctx->keys[ii].flags |= REPLICA_F_DUP;
+        }
+    }
+
+    if (mode & PYCBC_REPLICA_HEDGE) {
+        lcb_error_t err;
+        ctx->timer = lcb_timer_create(conn->instance, ctx, hedge, 0,
+                                      timer_callback, &err);
+        if (!ctx->timer) {
+            pycbc_replica_free(ctx);
+            PYCBC_EXC_WRAP(PYCBC_EXC_LCBERR, err,
+                           "Couldn't create hedge timer");
+            return NULL;
+        }
+    }
+
+    return ctx;
+}
+
+void
+pycbc_replica_free(struct pycbc_replica_ctx_st *ctx)
+{
+    if (!ctx) {
+        return;
+    }
+
+    if (ctx->timer) {
+        lcb_timer_destroy(ctx->conn->instance, ctx->timer);
+    }
+
+    if (ctx->mres && ctx->mres->replica == ctx) {
+        ctx->mres->replica = NULL;
+    }
+
+    free(ctx->keys);
+    free(ctx->rcmds);
+    free((void *)ctx->sched);
+    pycbc_cmdindex_clear(&ctx->index);
+    free(ctx);
+}
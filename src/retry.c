@@ -0,0 +1,506 @@
+/**
+ *     Copyright 2013 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ **/
+
+#include "oputil.h"
+
+/**
+ * This file implements re-scheduling of commands which failed with a
+ * transient error (e.g. LCB_ETMPFAIL during a rebalance).
+ *
+ * A retry context is created for each operation (if the connection has a
+ * retry policy). When a callback receives a retryable error, the response is
+ * discarded and the command's index is placed on a pending list, due after
+ * the backoff interval for its own number of attempts. A single timer is
+ * armed for the earliest due command; when it fires, the commands which are
+ * due are scheduled again with the same cookie, within the same lcb_wait()
+ * cycle, and the timer is re-armed for the next one.
+ *
+ * Re-queued commands are not subtracted from the connection's 'nremaining'
+ * count, so the wait loop keeps running until the retried command is
+ * answered (or has exhausted its attempts).
+ *
+ * All of the functions called from the callbacks or from the timer operate
+ * only on C data, so they do not need the GIL.
+ */
+
+struct pycbc_retry_ctx_st {
+    /** Parent connection. Borrowed */
+    pycbc_Connection *conn;
+
+    /** Cookie for the commands. Borrowed */
+    pycbc_MultiResult *mres;
+
+    /** Snapshot of the connection's policy */
+    struct pycbc_retry_policy policy;
+
+    /** PYCBC_CMD_* constant for the operation */
+    int optype;
+
+    /** Command array, owned by the common_vars */
+    union pycbc_u_pcmd cmds;
+    Py_ssize_t ncmds;
+
+    /** Number of retries performed, per command */
+    unsigned short *attempts;
+
+    /** Key lookup table. Built lazily on the first retry */
+    struct pycbc_cmdindex index;
+
+    /** Indexes of commands waiting for the timer */
+    Py_ssize_t *pending;
+    Py_ssize_t npending;
+
+    /** When each pending command is due to be re-sent (pycbc_monotonic_ns) */
+    lcb_uint64_t *due;
+
+    /** Scratch command list for re-scheduling */
+    const void **sched;
+
+    /** Backoff timer, if armed, and when it fires */
+    lcb_timer_t timer;
+    lcb_uint64_t timer_due;
+
+    /** First error received while re-scheduling */
+    lcb_error_t sched_err;
+};
+
+void
+pycbc_retry_policy_init(struct pycbc_retry_policy *policy)
+{
+    memset(policy, 0, sizeof(*policy));
+    policy->max_attempts = 1;
+    policy->backoff = 1000;
+    policy->factor = 2.0;
+    policy->max_backoff = 500000;
+    policy->codes[policy->ncodes++] = LCB_ETMPFAIL;
+    policy->codes[policy->ncodes++] = LCB_EBUSY;
+}
+
+static int
+is_retryable_op(int optype)
+{
+    switch (optype) {
+    case PYCBC_CMD_GET:
+    case PYCBC_CMD_LOCK:
+    case PYCBC_CMD_GAT:
+    case PYCBC_CMD_TOUCH:
+    case PYCBC_CMD_INCR:
+    case PYCBC_CMD_DECR:
+    case PYCBC_CMD_ARITH:
+    case PYCBC_CMD_DELETE:
+    case PYCBC_CMD_UNLOCK:
+    case PYCBC_CMD_STORE:
+        return 1;
+
+    default:
+        /** Stats and observe have multiple responses per command */
+        return 0;
+    }
+}
+
+static const void *
+cmd_at(struct pycbc_retry_ctx_st *ctx,
+       Py_ssize_t ii,
+       const void **key,
+       size_t *nkey)
+{
+    return pycbc_oputil_cmd_at(&ctx->cmds, ctx->optype, ii, key, nkey);
+}
+
+static lcb_error_t
+schedule_cmds(struct pycbc_retry_ctx_st *ctx, lcb_t instance, Py_ssize_t n)
+{
+    const void *cookie = ctx->mres;
+
+    switch (ctx->optype) {
+    case PYCBC_CMD_GET:
+    case PYCBC_CMD_LOCK:
+    case PYCBC_CMD_GAT:
+        return lcb_get(instance, cookie, n,
+                       (const lcb_get_cmd_t * const *)ctx->sched);
+    case PYCBC_CMD_TOUCH:
+        return lcb_touch(instance, cookie, n,
+                         (const lcb_touch_cmd_t * const *)ctx->sched);
+    case PYCBC_CMD_INCR:
+    case PYCBC_CMD_DECR:
+    case PYCBC_CMD_ARITH:
+        return lcb_arithmetic(instance, cookie, n,
+                              (const lcb_arithmetic_cmd_t * const *)ctx->sched);
+    case PYCBC_CMD_DELETE:
+        return lcb_remove(instance, cookie, n,
+                          (const lcb_remove_cmd_t * const *)ctx->sched);
+    case PYCBC_CMD_UNLOCK:
+        return lcb_unlock(instance, cookie, n,
+                          (const lcb_unlock_cmd_t * const *)ctx->sched);
+    case PYCBC_CMD_STORE:
+        return lcb_store(instance, cookie, n,
+                         (const lcb_store_cmd_t * const *)ctx->sched);
+    default:
+        return LCB_EINTERNAL;
+    }
+}
+
+static lcb_uint32_t
+get_delay(struct pycbc_retry_policy *policy, unsigned int attempt)
+{
+    double delay = policy->backoff;
+
+    while (--attempt && delay < policy->max_backoff) {
+        delay *= policy->factor;
+    }
+
+    if (delay > policy->max_backoff) {
+        delay = policy->max_backoff;
+    }
+    return (lcb_uint32_t)delay;
+}
+
+static void timer_callback(lcb_timer_t timer, lcb_t instance,
+                           const void *cookie);
+
+/**
+ * Arm the timer to fire at 'due', replacing a timer which fires later
+ * @return 0 on success, -1 if the timer could not be created
+ */
+static int
+arm_timer(struct pycbc_retry_ctx_st *ctx, lcb_uint64_t due)
+{
+    lcb_uint64_t now;
+    lcb_uint32_t usecs = 0;
+    lcb_timer_t timer;
+    lcb_error_t err;
+
+    if (ctx->timer && ctx->timer_due <= due) {
+        return 0;
+    }
+
+    now = pycbc_monotonic_ns();
+    if (due > now) {
+        usecs = (lcb_uint32_t)((due - now + 999) / 1000);
+    }
+
+    /** Keep the old timer if a new one can't be created */
+    timer = lcb_timer_create(ctx->conn->instance, ctx, usecs, 0,
+                             timer_callback, &err);
+    if (!timer) {
+        return -1;
+    }
+
+    if (ctx->timer) {
+        lcb_timer_destroy(ctx->conn->instance, ctx->timer);
+    }
+    ctx->timer = timer;
+    ctx->timer_due = due;
+    return 0;
+}
+
+static void
+timer_callback(lcb_timer_t timer, lcb_t instance, const void *cookie)
+{
+    struct pycbc_retry_ctx_st *ctx = (struct pycbc_retry_ctx_st *)cookie;
+    Py_ssize_t ii, nsched = 0, nwait = 0;
+    lcb_uint64_t now = pycbc_monotonic_ns(), next = 0;
+    lcb_error_t err;
+
+    /** Non-periodic timers are destroyed by the library once we return */
+    ctx->timer = NULL;
+
+    for (ii = 0; ii < ctx->npending; ii++) {
+        Py_ssize_t ix = ctx->pending[ii];
+
+        if (ctx->due[ix] <= now) {
+            ctx->sched[nsched++] = cmd_at(ctx, ix, NULL, NULL);
+            continue;
+        }
+
+        if (!nwait || ctx->due[ix] < next) {
+            next = ctx->due[ix];
+        }
+        ctx->pending[nwait++] = ix;
+    }
+
+    ctx->npending = nwait;
+
+    if (nwait && arm_timer(ctx, next) == -1) {
+        /** Send the rest now rather than never */
+        for (ii = 0; ii < nwait; ii++) {
+            ctx->sched[nsched++] = cmd_at(ctx, ctx->pending[ii], NULL, NULL);
+        }
+        ctx->npending = 0;
+    }
+
+    if (!nsched) {
+        return;
+    }
+
+    err = schedule_cmds(ctx, instance, nsched);
+    if (err != LCB_SUCCESS) {
+        if (ctx->sched_err == LCB_SUCCESS) {
+            ctx->sched_err = err;
+        }
+
+        /** These commands will never receive a callback */
+        ctx->conn->nremaining -= nsched;
+        ctx->mres->nremaining -= nsched;
+        if (!ctx->conn->nremaining) {
+            lcb_breakout(instance);
+        }
+    }
+
+    (void)timer;
+}
+
+int
+pycbc_retry_requeue(struct pycbc_retry_ctx_st *ctx,
+                    const void *key,
+                    size_t nkey,
+                    lcb_error_t err)
+{
+    unsigned int ii;
+    Py_ssize_t ix;
+    lcb_uint64_t due;
+
+    if (ctx == NULL || err == LCB_SUCCESS) {
+        return 0;
+    }
+
+    for (ii = 0; ii < ctx->policy.ncodes; ii++) {
+        if (ctx->policy.codes[ii] == err) {
+            break;
+        }
+    }
+
+    if (ii == ctx->policy.ncodes) {
+        return 0;
+    }
+
+    ix = pycbc_cmdindex_find(&ctx->index, &ctx->cmds, ctx->optype,
+                             ctx->ncmds, key, nkey);
+    if (ix < 0 || ctx->attempts[ix] + 1U >= ctx->policy.max_attempts) {
+        return 0;
+    }
+
+    due = pycbc_monotonic_ns() +
+            (lcb_uint64_t)get_delay(&ctx->policy, ctx->attempts[ix] + 1) * 1000;
+
+    if (arm_timer(ctx, due) == -1) {
+        return 0;
+    }
+
+    ctx->attempts[ix]++;
+    ctx->due[ix] = due;
+    ctx->pending[ctx->npending++] = ix;
+    return 1;
+}
+
+struct pycbc_retry_ctx_st *
+pycbc_retry_new(pycbc_Connection *conn,
+                struct pycbc_common_vars *cv,
+                int optype)
+{
+    struct pycbc_retry_ctx_st *ctx;
+
+    if (!is_retryable_op(optype)) {
+        return NULL;
+    }
+
+    ctx = calloc(1, sizeof(*ctx));
+    if (!ctx) {
+        PyErr_SetNone(PyExc_MemoryError);
+        return NULL;
+    }
+
+    ctx->conn = conn;
+    ctx->mres = cv->mres;
+    ctx->policy = conn->retry;
+    ctx->optype = optype;
+    ctx->cmds = cv->cmds;
+    ctx->ncmds = cv->ncmds;
+    ctx->attempts = calloc(cv->ncmds, sizeof(*ctx->attempts));
+    ctx->pending = malloc(cv->ncmds * sizeof(*ctx->pending));
+    ctx->due = malloc(cv->ncmds * sizeof(*ctx->due));
+    ctx->sched = malloc(cv->ncmds * sizeof(*ctx->sched));
+
+    if (!(ctx->attempts && ctx->pending && ctx->due && ctx->sched)) {
+        pycbc_retry_free(ctx);
+        PyErr_SetNone(PyExc_MemoryError);
+        return NULL;
+    }
+
+    return ctx;
+}
+
+void
+pycbc_retry_free(struct pycbc_retry_ctx_st *ctx)
+{
+    if (!ctx) {
+        return;
+    }
+
+    if (ctx->timer) {
+        lcb_timer_destroy(ctx->conn->instance, ctx->timer);
+    }
+
+    if (ctx->mres && ctx->mres->retry == ctx) {
+        ctx->mres->retry = NULL;
+    }
+
+    free(ctx->attempts);
+    pycbc_cmdindex_clear(&ctx->index);
+    free(ctx->pending);
+    free(ctx->due);
+    free((void *)ctx->sched);
+    free(ctx);
+}
+
+Py_ssize_t
+pycbc_retry_cancel(struct pycbc_retry_ctx_st *ctx)
+{
+    Py_ssize_t ret = ctx->npending;
+
+    if (ctx->timer) {
+        lcb_timer_destroy(ctx->conn->instance, ctx->timer);
+        ctx->timer = NULL;
+    }
+    ctx->npending = 0;
+    return ret;
+}
+
+int
+pycbc_retry_pending(struct pycbc_retry_ctx_st *ctx)
+{
+    return ctx != NULL && ctx->timer != NULL;
+}
+
+lcb_error_t
+pycbc_retry_sched_error(struct pycbc_retry_ctx_st *ctx)
+{
+    return ctx->sched_err;
+}
+
+
+PyObject *
+pycbc_Connection__set_retry_policy(pycbc_Connection *self,
+                                   PyObject *args,
+                                   PyObject *kwargs)
+{
+    int rv;
+    unsigned int max_attempts = 1;
+    double backoff, max_backoff, factor;
+    PyObject *codes_O = NULL;
+    struct pycbc_retry_policy policy;
+
+    static char *kwlist[] = {
+            "max_attempts", "backoff", "factor", "max_backoff", "errors", NULL
+    };
+
+    pycbc_retry_policy_init(&policy);
+    backoff = (double)policy.backoff / 1000000;
+    max_backoff = (double)policy.max_backoff / 1000000;
+    factor = policy.factor;
+
+    rv = PyArg_ParseTupleAndKeywords(args, kwargs, "|IdddO", kwlist,
+                                     &max_attempts,
+                                     &backoff,
+                                     &factor,
+                                     &max_backoff,
+                                     &codes_O);
+    if (!rv) {
+        PYCBC_EXCTHROW_ARGS();
+        return NULL;
+    }
+
+    if (max_attempts < 1 || max_attempts > USHRT_MAX) {
+        PYCBC_EXC_WRAP(PYCBC_EXC_ARGUMENTS, 0,
+                       "max_attempts must be between 1 and 65535");
+        return NULL;
+    }
+
+    if (backoff < 0 || max_backoff < backoff || factor < 1 ||
+            max_backoff > 4294) {
+        PYCBC_EXC_WRAP(PYCBC_EXC_ARGUMENTS, 0,
+                       "Invalid backoff. Require 0 <= backoff <= max_backoff "
+                       "and factor >= 1");
+        return NULL;
+    }
+
+    policy.max_attempts = max_attempts;
+    policy.backoff = (lcb_uint32_t)(backoff * 1000000);
+    policy.max_backoff = (lcb_uint32_t)(max_backoff * 1000000);
+    policy.factor = factor;
+
+    if (codes_O && codes_O != Py_None) {
+        Py_ssize_t ii, ncodes;
+        PyObject *seq = PySequence_Fast(codes_O, "errors must be a sequence");
+
+        if (!seq) {
+            return NULL;
+        }
+
+        ncodes = PySequence_Fast_GET_SIZE(seq);
+        if (ncodes > PYCBC_RETRY_MAXCODES) {
+            Py_DECREF(seq);
+            PYCBC_EXC_WRAP_OBJ(PYCBC_EXC_ARGUMENTS, 0,
+                               "Too many error codes", codes_O);
+            return NULL;
+        }
+
+        policy.ncodes = 0;
+        for (ii = 0; ii < ncodes; ii++) {
+            long code = pycbc_IntAsL(PySequence_Fast_GET_ITEM(seq, ii));
+            if (code == -1 && PyErr_Occurred()) {
+                Py_DECREF(seq);
+                PYCBC_EXC_WRAP_OBJ(PYCBC_EXC_ARGUMENTS, 0,
+                                   "Error codes must be integers", codes_O);
+                return NULL;
+            }
+            policy.codes[policy.ncodes++] = (lcb_error_t)code;
+        }
+        Py_DECREF(seq);
+    }
+
+    self->retry = policy;
+    Py_RETURN_NONE;
+}
+
+PyObject *
+pycbc_Connection__get_retry_policy(pycbc_Connection *self,
+                                   PyObject *args,
+                                   PyObject *kwargs)
+{
+    unsigned int ii;
+    PyObject *codes;
+    struct pycbc_retry_policy *policy = &self->retry;
+
+    codes = PyTuple_New(policy->ncodes);
+    if (!codes) {
+        return NULL;
+    }
+
+    for (ii = 0; ii < policy->ncodes; ii++) {
+        PyTuple_SET_ITEM(codes, ii, pycbc_IntFromL(policy->codes[ii]));
+    }
+
+    (void)args;
+    (void)kwargs;
+
+    return Py_BuildValue("{s:I,s:d,s:d,s:d,s:N}",
+                         "max_attempts", policy->max_attempts,
+                         "backoff", (double)policy->backoff / 1000000,
+                         "factor", policy->factor,
+                         "max_backoff", (double)policy->max_backoff / 1000000,
+                         "errors", codes);
+}
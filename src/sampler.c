@@ -0,0 +1,731 @@
+/**
+ *     Copyright 2013 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ **/
+
+/**
+ * A sampler for a fixed set of server statistics.
+ *
+ * Rather than building a dict of dicts for each STATS response, the values
+ * of the requested statistics are parsed as numbers in the callback (without
+ * the GIL) and stored in a ring buffer. Python objects are only created when
+ * the samples are read back.
+ *
+ * Values are laid out as [slot][node][stat]. The nodes are taken from the
+ * cluster map when the sampler is created, so the buffer never changes size
+ * while samples may be read from another thread. The callbacks write into a
+ * separate row, which is copied into the ring buffer (with the GIL) once
+ * the sample is complete.
+ */
+#include "oputil.h"
+#include "structmember.h"
+#include <math.h>
+
+/** Longest numeric value we attempt to parse */
+#define SAMPLER_MAXNUM 63
+
+struct pycbc_StatsSampler_st {
+    PyObject_HEAD
+
+    /** Connection used for sampling */
+    pycbc_Connection *conn;
+
+    /** Stats group to request (bytes), or NULL for the default group */
+    PyObject *group;
+
+    /** Names of the statistics to keep (a tuple of str) */
+    PyObject *stats_O;
+    char **stats;
+    size_t *nstats_len;
+    unsigned int nstats;
+
+    /** Server endpoints being sampled */
+    char **nodes;
+    unsigned int nnodes;
+
+    /** Ring buffer */
+    unsigned int size;
+    unsigned int count;
+    unsigned int head;
+    double *times;
+    double *values;
+
+    /** Values of the sample in progress, written by the callbacks */
+    double *pending;
+};
+
+typedef struct pycbc_StatsSampler_st pycbc_StatsSampler;
+
+static PyTypeObject StatsSamplerType = {
+        PYCBC_POBJ_HEAD_INIT(NULL)
+        0
+};
+
+#define ROW_SIZE(self) ((size_t)(self)->nnodes * (self)->nstats)
+#define SLOT_VALUES(self, slot) \
+    ((self)->values + (size_t)(slot) * ROW_SIZE(self))
+
+static void
+fill_nan(double *values, size_t n)
+{
+    size_t ii;
+    for (ii = 0; ii < n; ii++) {
+        values[ii] = Py_NAN;
+    }
+}
+
+static int
+find_node(pycbc_StatsSampler *self, const char *endpoint)
+{
+    unsigned int ii;
+
+    for (ii = 0; ii < self->nnodes; ii++) {
+        if (strcmp(self->nodes[ii], endpoint) == 0) {
+            return ii;
+        }
+    }
+    return -1;
+}
+
+/**
+ * Copy the endpoints from the cluster map, and size the buffers for them
+ */
+static int
+init_nodes(pycbc_StatsSampler *self, pycbc_Connection *conn)
+{
+    const char * const *cnodes;
+    unsigned int ii;
+
+    cnodes = lcb_get_server_list(conn->instance);
+    if (!cnodes) {
+        PYCBC_EXC_WRAP(PYCBC_EXC_INTERNAL, 0, "Can't get server nodes");
+        return -1;
+    }
+
+    for (ii = 0; cnodes[ii]; ii++) {
+        ;
+    }
+
+    self->nodes = calloc(ii ? ii : 1, sizeof(*self->nodes));
+    if (!self->nodes) {
+        PyErr_SetNone(PyExc_MemoryError);
+        return -1;
+    }
+
+    for (self->nnodes = 0; self->nnodes < ii; self->nnodes++) {
+        char *copy = malloc(strlen(cnodes[self->nnodes]) + 1);
+        if (!copy) {
+            PyErr_SetNone(PyExc_MemoryError);
+            return -1;
+        }
+        strcpy(copy, cnodes[self->nnodes]);
+        self->nodes[self->nnodes] = copy;
+    }
+
+    self->values = malloc((ROW_SIZE(self) * self->size + 1) *
+                          sizeof(*self->values));
+    self->pending = malloc((ROW_SIZE(self) + 1) * sizeof(*self->pending));
+    if (!(self->values && self->pending)) {
+        PyErr_SetNone(PyExc_MemoryError);
+        return -1;
+    }
+
+    fill_nan(self->values, ROW_SIZE(self) * self->size);
+    return 0;
+}
+
+void
+pycbc_sampler_record(struct pycbc_StatsSampler_st *self,
+                     const char *endpoint,
+                     const void *key,
+                     size_t nkey,
+                     const void *bytes,
+                     size_t nbytes)
+{
+    unsigned int ii;
+    int node;
+    char buf[SAMPLER_MAXNUM + 1];
+    char *end;
+    double value;
+
+    for (ii = 0; ii < self->nstats; ii++) {
+        if (self->nstats_len[ii] == nkey &&
+                memcmp(self->stats[ii], key, nkey) == 0) {
+            break;
+        }
+    }
+
+    if (ii == self->nstats || nbytes == 0 || nbytes > SAMPLER_MAXNUM) {
+        return;
+    }
+
+    memcpy(buf, bytes, nbytes);
+    buf[nbytes] = '\0';
+    value = strtod(buf, &end);
+    if (end != buf + nbytes) {
+        /** Not a number */
+        return;
+    }
+
+    node = find_node(self, endpoint);
+    if (node < 0) {
+        /** Joined the cluster after the sampler was created */
+        return;
+    }
+
+    self->pending[(size_t)node * self->nstats + ii] = value;
+}
+
+static int
+StatsSampler__init__(pycbc_StatsSampler *self,
+                     PyObject *args,
+                     PyObject *kwargs)
+{
+    int rv;
+    unsigned int ii;
+    unsigned int size = 60;
+    PyObject *conn_O = NULL, *stats_O = NULL, *group_O = NULL;
+    PyObject *conntype;
+
+    static char *kwlist[] = { "connection", "stats", "size", "group", NULL };
+
+    rv = PyArg_ParseTupleAndKeywords(args, kwargs, "OO|IO", kwlist,
+                                     &conn_O, &stats_O, &size, &group_O);
+    if (!rv) {
+        PYCBC_EXCTHROW_ARGS();
+        return -1;
+    }
+
+    if (self->conn) {
+        PYCBC_EXC_WRAP(PYCBC_EXC_ARGUMENTS, 0, "Sampler already initialized");
+        return -1;
+    }
+
+    pycbc_ConnectionType_init(&conntype);
+    if (!PyObject_TypeCheck(conn_O, (PyTypeObject*)conntype)) {
+        PYCBC_EXC_WRAP_OBJ(PYCBC_EXC_ARGUMENTS, 0,
+                           "Expected a Connection", conn_O);
+        return -1;
+    }
+
+    if (size < 2) {
+        PYCBC_EXC_WRAP(PYCBC_EXC_ARGUMENTS, 0,
+                       "Sampler size must be at least 2");
+        return -1;
+    }
+
+    self->stats_O = PySequence_Tuple(stats_O);
+    if (!self->stats_O) {
+        return -1;
+    }
+
+    self->nstats = (unsigned int)PyTuple_GET_SIZE(self->stats_O);
+    if (!self->nstats) {
+        PYCBC_EXC_WRAP(PYCBC_EXC_ARGUMENTS, 0, "No stats specified");
+        return -1;
+    }
+
+    self->stats = calloc(self->nstats, sizeof(*self->stats));
+    self->nstats_len = calloc(self->nstats, sizeof(*self->nstats_len));
+    self->times = calloc(size, sizeof(*self->times));
+    self->size = size;
+
+    if (!(self->stats && self->nstats_len && self->times)) {
+        PyErr_SetNone(PyExc_MemoryError);
+        return -1;
+    }
+
+    for (ii = 0; ii < self->nstats; ii++) {
+        PyObject *newkey = NULL;
+        char *key;
+        Py_ssize_t nkey;
+        PyObject *curstat = PyTuple_GET_ITEM(self->stats_O, ii);
+
+        rv = pycbc_BufFromString(curstat, &key, &nkey, &newkey);
+        if (rv < 0) {
+            PYCBC_EXC_WRAP_OBJ(PYCBC_EXC_ARGUMENTS, 0,
+                               "Stat names must be strings", curstat);
+            return -1;
+        }
+
+        self->stats[ii] = malloc(nkey + 1);
+        if (!self->stats[ii]) {
+            Py_XDECREF(newkey);
+            PyErr_SetNone(PyExc_MemoryError);
+            return -1;
+        }
+
+        memcpy(self->stats[ii], key, nkey);
+        self->nstats_len[ii] = nkey;
+        Py_XDECREF(newkey);
+    }
+
+    if (group_O && group_O != Py_None) {
+        char *buf;
+        Py_ssize_t nbuf;
+
+        rv = pycbc_BufFromString(group_O, &buf, &nbuf, &self->group);
+        if (rv < 0) {
+            PYCBC_EXC_WRAP_OBJ(PYCBC_EXC_ARGUMENTS, 0,
+                               "Group must be a string", group_O);
+            return -1;
+        }
+
+        if (!self->group) {
+            self->group = group_O;
+            Py_INCREF(group_O);
+        }
+    }
+
+    if (init_nodes(self, (pycbc_Connection*)conn_O) == -1) {
+        return -1;
+    }
+
+    self->conn = (pycbc_Connection*)conn_O;
+    Py_INCREF(conn_O);
+    return 0;
+}
+
+static void
+StatsSampler_dealloc(pycbc_StatsSampler *self)
+{
+    unsigned int ii;
+
+    if (self->stats) {
+        for (ii = 0; ii < self->nstats; ii++) {
+            free(self->stats[ii]);
+        }
+        free(self->stats);
+    }
+
+    for (ii = 0; ii < self->nnodes; ii++) {
+        free(self->nodes[ii]);
+    }
+
+    free(self->nodes);
+    free(self->nstats_len);
+    free(self->times);
+    free(self->values);
+    free(self->pending);
+
+    Py_XDECREF(self->stats_O);
+    Py_XDECREF(self->group);
+    Py_XDECREF(self->conn);
+    Py_TYPE(self)->tp_free((PyObject*)self);
+}
+
+static int
+check_init(pycbc_StatsSampler *self)
+{
+    if (!self->conn) {
+        PYCBC_EXC_WRAP(PYCBC_EXC_INTERNAL, 0, "Sampler not initialized");
+        return -1;
+    }
+    return 0;
+}
+
+static PyObject *
+StatsSampler__sample(pycbc_StatsSampler *self,
+                     PyObject *args,
+                     PyObject *kwargs)
+{
+    int rv;
+    double timestamp;
+    lcb_error_t err;
+    PyObject *timeout_O = NULL;
+    lcb_uint32_t timeout = 0;
+    lcb_server_stats_cmd_t *cmd;
+    struct pycbc_common_vars cv = PYCBC_COMMON_VARS_STATIC_INIT;
+
+    static char *kwlist[] = { "timestamp", "timeout", NULL };
+
+    rv = PyArg_ParseTupleAndKeywords(args, kwargs, "d|O", kwlist,
+                                     &timestamp, &timeout_O);
+    if (!rv) {
+        PYCBC_EXCTHROW_ARGS();
+        return NULL;
+    }
+
+    if (check_init(self) == -1 ||
+            pycbc_get_timeout(timeout_O, &timeout) < 0) {
+        return NULL;
+    }
+
+    rv = pycbc_common_vars_init(&cv, self->conn, PYCBC_ARGOPT_MULTI,
+                                PYCBC_CMD_STATS, 1,
+                                sizeof(lcb_server_stats_cmd_t), 0);
+    if (rv < 0) {
+        return NULL;
+    }
+
+    cv.timeout = timeout;
+    cv.mres->sampler = self;
+
+    cmd = cv.cmds.stats;
+    if (self->group) {
+        cmd->v.v0.name = PyBytes_AS_STRING(self->group);
+        cmd->v.v0.nname = PyBytes_GET_SIZE(self->group);
+    }
+    cv.cmdlist.stats[0] = cmd;
+
+    fill_nan(self->pending, ROW_SIZE(self));
+
+    err = lcb_server_stats(self->conn->instance, cv.mres, 1, cv.cmdlist.stats);
+    if (err != LCB_SUCCESS) {
+        PYCBC_EXCTHROW_SCHED(err);
+        goto GT_DONE;
+    }
+
+    if (-1 == pycbc_common_vars_wait(&cv, self->conn)) {
+        goto GT_DONE;
+    }
+
+    memcpy(SLOT_VALUES(self, self->head), self->pending,
+           ROW_SIZE(self) * sizeof(*self->pending));
+    self->times[self->head] = timestamp;
+    self->head = (self->head + 1) % self->size;
+    if (self->count < self->size) {
+        self->count++;
+    }
+
+    Py_DECREF(cv.ret);
+    cv.ret = Py_None;
+    Py_INCREF(Py_None);
+
+    GT_DONE:
+    pycbc_common_vars_finalize(&cv, self->conn);
+    return cv.ret;
+}
+
+/**
+ * Slot of the n-th most recent sample (0 being the latest)
+ */
+static unsigned int
+nth_slot(pycbc_StatsSampler *self, unsigned int n)
+{
+    return (self->head + self->size - 1 - n) % self->size;
+}
+
+/**
+ * Integral values (i.e. most counters) are returned as integers
+ */
+static PyObject *
+number_to_object(double value)
+{
+    if (value == floor(value) && fabs(value) < 9.007199254740992e15) {
+        return PyLong_FromLongLong((PY_LONG_LONG)value);
+    }
+    return PyFloat_FromDouble(value);
+}
+
+/**
+ * Add {node: value} to ret[stat], creating the inner dict if needed
+ */
+static int
+add_value(PyObject *ret, PyObject *stat, const char *node, double value)
+{
+    int rv;
+    PyObject *inner, *value_O;
+
+    inner = PyDict_GetItem(ret, stat);
+    if (!inner) {
+        inner = PyDict_New();
+        if (!inner) {
+            return -1;
+        }
+        rv = PyDict_SetItem(ret, stat, inner);
+        Py_DECREF(inner);
+        if (rv == -1) {
+            return -1;
+        }
+    }
+
+    value_O = number_to_object(value);
+    if (!value_O) {
+        return -1;
+    }
+
+    rv = PyDict_SetItemString(inner, node, value_O);
+    Py_DECREF(value_O);
+    return rv;
+}
+
+/**
+ * Build {stat: {node: value}} for a single slot
+ */
+static PyObject *
+slot_to_dict(pycbc_StatsSampler *self, unsigned int slot)
+{
+    unsigned int ii, jj;
+    double *values = SLOT_VALUES(self, slot);
+    PyObject *ret = PyDict_New();
+
+    if (!ret) {
+        return NULL;
+    }
+
+    for (ii = 0; ii < self->nnodes; ii++) {
+        for (jj = 0; jj < self->nstats; jj++) {
+            double value = values[ii * self->nstats + jj];
+            if (Py_IS_NAN(value)) {
+                continue;
+            }
+
+            if (add_value(ret, PyTuple_GET_ITEM(self->stats_O, jj),
+                          self->nodes[ii], value) == -1) {
+                Py_DECREF(ret);
+                return NULL;
+            }
+        }
+    }
+    return ret;
+}
+
+static PyObject *
+StatsSampler_latest(pycbc_StatsSampler *self, PyObject *unused)
+{
+    (void)unused;
+
+    if (!self->count) {
+        return PyDict_New();
+    }
+    return slot_to_dict(self, nth_slot(self, 0));
+}
+
+static PyObject *
+StatsSampler_rates(pycbc_StatsSampler *self, PyObject *unused)
+{
+    unsigned int ii, jj;
+    double *cur, *prev;
+    double elapsed;
+    PyObject *ret = PyDict_New();
+
+    (void)unused;
+
+    if (!ret || self->count < 2) {
+        return ret;
+    }
+
+    cur = SLOT_VALUES(self, nth_slot(self, 0));
+    prev = SLOT_VALUES(self, nth_slot(self, 1));
+    elapsed = self->times[nth_slot(self, 0)] - self->times[nth_slot(self, 1)];
+
+    if (elapsed <= 0) {
+        return ret;
+    }
+
+    for (ii = 0; ii < self->nnodes; ii++) {
+        for (jj = 0; jj < self->nstats; jj++) {
+            size_t ix = ii * self->nstats + jj;
+            if (Py_IS_NAN(cur[ix]) || Py_IS_NAN(prev[ix])) {
+                continue;
+            }
+
+            if (add_value(ret, PyTuple_GET_ITEM(self->stats_O, jj),
+                          self->nodes[ii],
+                          (cur[ix] - prev[ix]) / elapsed) == -1) {
+                Py_DECREF(ret);
+                return NULL;
+            }
+        }
+    }
+
+    return ret;
+}
+
+static PyObject *
+StatsSampler_history(pycbc_StatsSampler *self, PyObject *args)
+{
+    int rv;
+    unsigned int ii, jj, stat;
+    PyObject *stat_O;
+    PyObject *ret;
+
+    rv = PyArg_ParseTuple(args, "O", &stat_O);
+    if (!rv) {
+        return NULL;
+    }
+
+    for (stat = 0; stat < self->nstats; stat++) {
+        rv = PyObject_RichCompareBool(PyTuple_GET_ITEM(self->stats_O, stat),
+                                      stat_O, Py_EQ);
+        if (rv == -1) {
+            return NULL;
+        }
+        if (rv) {
+            break;
+        }
+    }
+
+    if (stat == self->nstats) {
+        PYCBC_EXC_WRAP_OBJ(PYCBC_EXC_ARGUMENTS, 0,
+                           "Stat is not being sampled", stat_O);
+        return NULL;
+    }
+
+    ret = PyList_New(self->count);
+    if (!ret) {
+        return NULL;
+    }
+
+    for (ii = 0; ii < self->count; ii++) {
+        unsigned int slot = nth_slot(self, self->count - 1 - ii);
+        double *values = SLOT_VALUES(self, slot);
+        PyObject *nodes = PyDict_New(), *tuple;
+
+        if (!nodes) {
+            Py_DECREF(ret);
+            return NULL;
+        }
+
+        for (jj = 0; jj < self->nnodes; jj++) {
+            double value = values[jj * self->nstats + stat];
+            PyObject *value_O;
+
+            if (Py_IS_NAN(value)) {
+                continue;
+            }
+
+            value_O = number_to_object(value);
+            if (!value_O ||
+                    PyDict_SetItemString(nodes, self->nodes[jj], value_O)) {
+                Py_XDECREF(value_O);
+                Py_DECREF(nodes);
+                Py_DECREF(ret);
+                return NULL;
+            }
+            Py_DECREF(value_O);
+        }
+
+        tuple = Py_BuildValue("(dN)", self->times[slot], nodes);
+        if (!tuple) {
+            Py_DECREF(ret);
+            return NULL;
+        }
+        PyList_SET_ITEM(ret, ii, tuple);
+    }
+
+    return ret;
+}
+
+static PyObject *
+StatsSampler_clear(pycbc_StatsSampler *self, PyObject *unused)
+{
+    (void)unused;
+
+    self->count = 0;
+    self->head = 0;
+    Py_RETURN_NONE;
+}
+
+static PyObject *
+StatsSampler_get_nodes(pycbc_StatsSampler *self, void *unused)
+{
+    unsigned int ii;
+    PyObject *ret = PyTuple_New(self->nnodes);
+
+    (void)unused;
+
+    if (!ret) {
+        return NULL;
+    }
+
+    for (ii = 0; ii < self->nnodes; ii++) {
+        PyObject *node = pycbc_SimpleStringZ(self->nodes[ii]);
+        if (!node) {
+            Py_DECREF(ret);
+            return NULL;
+        }
+        PyTuple_SET_ITEM(ret, ii, node);
+    }
+    return ret;
+}
+
+static PyGetSetDef StatsSampler_TABLE_getset[] = {
+        { "nodes",
+                (getter)StatsSampler_get_nodes,
+                NULL,
+                PyDoc_STR("Server endpoints being sampled. These are taken "
+                        "from the cluster map when the sampler is created")
+        },
+        { NULL }
+};
+
+static struct PyMemberDef StatsSampler_TABLE_members[] = {
+        { "stats", T_OBJECT_EX, offsetof(pycbc_StatsSampler, stats_O),
+                READONLY,
+                PyDoc_STR("Names of the statistics being sampled")
+        },
+        { "connection", T_OBJECT_EX, offsetof(pycbc_StatsSampler, conn),
+                READONLY,
+                PyDoc_STR("The connection used for sampling")
+        },
+        { "size", T_UINT, offsetof(pycbc_StatsSampler, size),
+                READONLY,
+                PyDoc_STR("Maximum number of samples retained")
+        },
+        { "count", T_UINT, offsetof(pycbc_StatsSampler, count),
+                READONLY,
+                PyDoc_STR("Number of samples currently retained")
+        },
+        { NULL }
+};
+
+static PyMethodDef StatsSampler_TABLE_methods[] = {
+        { "_sample", (PyCFunction)StatsSampler__sample,
+                METH_VARARGS|METH_KEYWORDS,
+                PyDoc_STR("Collect a sample, recording it at the given "
+                        "timestamp")
+        },
+        { "latest", (PyCFunction)StatsSampler_latest, METH_NOARGS,
+                PyDoc_STR("Get the most recent sample, as a dict of "
+                        "``{stat: {node: value}}``")
+        },
+        { "rates", (PyCFunction)StatsSampler_rates, METH_NOARGS,
+                PyDoc_STR("Get the change per second between the two most "
+                        "recent samples, as a dict of ``{stat: {node: rate}}``")
+        },
+        { "history", (PyCFunction)StatsSampler_history, METH_VARARGS,
+                PyDoc_STR("Get the retained samples for a single stat, "
+                        "oldest first, as a list of "
+                        "``(timestamp, {node: value})``")
+        },
+        { "clear", (PyCFunction)StatsSampler_clear, METH_NOARGS,
+                PyDoc_STR("Discard all retained samples")
+        },
+        { NULL }
+};
+
+int
+pycbc_StatsSamplerType_init(PyObject **ptr)
+{
+    PyTypeObject *p = &StatsSamplerType;
+
+    *ptr = (PyObject*)p;
+    if (p->tp_name) {
+        return 0;
+    }
+
+    p->tp_name = "StatsSampler";
+    p->tp_doc = PyDoc_STR("Periodic sampler for server statistics");
+    p->tp_new = PyType_GenericNew;
+    p->tp_init = (initproc)StatsSampler__init__;
+    p->tp_dealloc = (destructor)StatsSampler_dealloc;
+    p->tp_basicsize = sizeof(pycbc_StatsSampler);
+    p->tp_methods = StatsSampler_TABLE_methods;
+    p->tp_members = StatsSampler_TABLE_members;
+    p->tp_getset = StatsSampler_TABLE_getset;
+    p->tp_flags = Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE;
+    return PyType_Ready(p);
+}
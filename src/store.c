@@ -81,6 +81,9 @@ handle_single_kv(pycbc_Connection *self,
         return -1;
     }
 
+    pycbc_nodestats_sent(self, scmd->v.v0.key, scmd->v.v0.nkey,
+                         scmd->v.v0.nbytes);
+
     scmd->v.v0.operation = operation;
     scmd->v.v0.cas = cas;
     scmd->v.v0.exptime = cur_ttl;
@@ -146,29 +149,37 @@ set_common(pycbc_Connection *self,
     struct pycbc_common_vars cv = PYCBC_COMMON_VARS_STATIC_INIT;
 
     PyObject *flagsobj = NULL;
+    PyObject *timeout_O = NULL;
+    lcb_uint32_t timeout = 0;
 
-    static char *kwlist_multi[] = { "kv", "ttl", "format", NULL };
-    static char *kwlist_single[] = { "key", "value", "cas", "ttl", "format", NULL };
+    static char *kwlist_multi[] = {
+            "kv", "ttl", "format", "timeout", NULL
+    };
+    static char *kwlist_single[] = {
+            "key", "value", "cas", "ttl", "format", "timeout", NULL
+    };
 
     if (argopts & PYCBC_ARGOPT_MULTI) {
         rv = PyArg_ParseTupleAndKeywords(args,
                                          kwargs,
-                                         "O|OO",
+                                         "O|OOO",
                                          kwlist_multi,
                                          &dict,
                                          &ttl_O,
-                                         &flagsobj);
+                                         &flagsobj,
+                                         &timeout_O);
 
     } else {
         rv = PyArg_ParseTupleAndKeywords(args,
                                          kwargs,
-                                         "OO|KOO",
+                                         "OO|KOOO",
                                          kwlist_single,
                                          &curkey,
                                          &curvalue,
                                          &single_cas,
                                          &ttl_O,
-                                         &flagsobj);
+                                         &flagsobj,
+                                         &timeout_O);
     }
     if (!rv) {
         PYCBC_EXC_WRAP(PYCBC_EXC_ARGUMENTS, 0, "couldn't parse arguments");
@@ -180,6 +191,10 @@ set_common(pycbc_Connection *self,
         return NULL;
     }
 
+    if (pycbc_get_timeout(timeout_O, &timeout) < 0) {
+        return NULL;
+    }
+
     if (argopts & PYCBC_ARGOPT_MULTI) {
         rv = pycbc_oputil_check_sequence(dict, 0, &ncmds, NULL);
         if (rv < 0) {
@@ -205,6 +220,7 @@ set_common(pycbc_Connection *self,
     rv = pycbc_common_vars_init(&cv,
                                 self,
                                 argopts,
+                                PYCBC_CMD_STORE,
                                 ncmds,
                                 sizeof(lcb_store_cmd_t),
                                 1);
@@ -213,6 +229,8 @@ set_common(pycbc_Connection *self,
         return NULL;
     }
 
+    cv.timeout = timeout;
+
     if (argopts & PYCBC_ARGOPT_MULTI) {
         while (PyDict_Next(dict, &dictpos, &curkey, &curvalue)) {
             rv = handle_single_kv(self,
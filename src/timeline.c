@@ -0,0 +1,357 @@
+/**
+ *     Copyright 2013 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ **/
+
+/**
+ * Timeline of the client's internal activity, for viewing as a Chrome trace
+ * (see couchbase/timeline.py).
+ *
+ * While enabled, spans are recorded for operations, scheduling, waiting in
+ * lcb_wait(), callbacks, reacquiring the GIL and transcoding. Each thread
+ * appends to its own ring buffer, found through a thread-local pointer, so
+ * recording needs neither the GIL nor a lock. The buffers are linked into a
+ * global list (with an atomic push) when a thread records its first span,
+ * and are read from there when the timeline is collected.
+ *
+ * Readers never block the threads recording. A ring buffer may wrap while
+ * it is being copied; such events are detected by re-reading the count of
+ * events written afterwards, and are discarded.
+ *
+ * Buffers are never freed, as a reader may be copying from one at any time.
+ * Instead, a thread-exit destructor marks the thread's buffer as unused, and
+ * the next thread to record a span claims it (if it is of the current
+ * capacity). Each event records its own thread, so the spans of the exiting
+ * thread are kept until they are overwritten.
+ */
+#include "pycbc.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#define TL_THREAD_LOCAL __declspec(thread)
+#define TL_BARRIER() MemoryBarrier()
+#define TL_CAS(p, old, new) \
+    (InterlockedCompareExchangePointer((PVOID*)(p), new, old) == old)
+#define TL_CLAIM(p) (InterlockedCompareExchange(p, 1, 0) == 0)
+#else
+#include <pthread.h>
+#define TL_THREAD_LOCAL __thread
+#define TL_BARRIER() __sync_synchronize()
+#define TL_CAS(p, old, new) __sync_bool_compare_and_swap(p, old, new)
+#define TL_CLAIM(p) __sync_bool_compare_and_swap(p, 0, 1)
+#endif
+
+#define TL_DEFAULT_CAPACITY 8192
+
+struct tl_event {
+    unsigned long tid;
+    const char *cat;
+    const char *name;
+    lcb_uint64_t begin;
+    lcb_uint64_t end;
+    lcb_uint64_t n;
+};
+
+struct tl_buffer {
+    struct tl_buffer *next;
+    size_t capacity;
+
+    /** Set while a thread owns the buffer */
+    volatile long in_use;
+
+    /** Number of events written. Only the owning thread modifies this */
+    volatile lcb_uint64_t nwritten;
+
+    /** Events before this were collected with clear=True */
+    volatile lcb_uint64_t ncleared;
+
+    struct tl_event events[1];
+};
+
+int pycbc_timeline_enabled = 0;
+
+static size_t tl_capacity = TL_DEFAULT_CAPACITY;
+static struct tl_buffer *volatile tl_buffers = NULL;
+static TL_THREAD_LOCAL struct tl_buffer *tl_current = NULL;
+
+/** Key whose destructor releases a thread's buffer when it exits */
+static int tl_key_created = 0;
+#ifdef _WIN32
+static DWORD tl_key;
+#else
+static pthread_key_t tl_key;
+#endif
+
+#ifdef _WIN32
+static VOID WINAPI
+#else
+static void
+#endif
+release_buffer(void *arg)
+{
+    struct tl_buffer *buf = arg;
+
+    if (!buf) {
+        return;
+    }
+
+    tl_current = NULL;
+
+    /** Its events must be complete before another thread may write */
+    TL_BARRIER();
+    buf->in_use = 0;
+}
+
+static int
+create_key(void)
+{
+    if (tl_key_created) {
+        return 0;
+    }
+
+#ifdef _WIN32
+    tl_key = FlsAlloc(release_buffer);
+    if (tl_key == FLS_OUT_OF_INDEXES) {
+        return -1;
+    }
+#else
+    if (pthread_key_create(&tl_key, release_buffer) != 0) {
+        return -1;
+    }
+#endif
+
+    tl_key_created = 1;
+    return 0;
+}
+
+static struct tl_buffer *
+claim_buffer(size_t capacity)
+{
+    struct tl_buffer *buf;
+
+    for (buf = tl_buffers; buf; buf = buf->next) {
+        if (buf->capacity == capacity && !buf->in_use &&
+                TL_CLAIM(&buf->in_use)) {
+            return buf;
+        }
+    }
+    return NULL;
+}
+
+static struct tl_buffer *
+new_buffer(void)
+{
+    struct tl_buffer *buf;
+
+    /**
+     * One more slot than requested, as a reader skips the slot after the
+     * last event (which may be being written)
+     */
+    size_t capacity = tl_capacity + 1;
+
+    buf = claim_buffer(capacity);
+
+    if (!buf) {
+        buf = calloc(1, sizeof(*buf) +
+                     sizeof(struct tl_event) * (capacity - 1));
+        if (!buf) {
+            return NULL;
+        }
+
+        buf->capacity = capacity;
+        buf->in_use = 1;
+
+        do {
+            buf->next = tl_buffers;
+        } while (!TL_CAS(&tl_buffers, buf->next, buf));
+    }
+
+#ifdef _WIN32
+    FlsSetValue(tl_key, buf);
+#else
+    pthread_setspecific(tl_key, buf);
+#endif
+
+    return buf;
+}
+
+void
+pycbc_timeline_span(const char *cat,
+                    const char *name,
+                    lcb_uint64_t begin,
+                    lcb_uint64_t n)
+{
+    struct tl_buffer *buf = tl_current;
+    struct tl_event *ev;
+
+    if (!buf) {
+        buf = tl_current = new_buffer();
+        if (!buf) {
+            return;
+        }
+    }
+
+    ev = buf->events + (buf->nwritten % buf->capacity);
+    ev->tid = PyThread_get_thread_ident();
+    ev->cat = cat;
+    ev->name = name;
+    ev->begin = begin;
+    ev->end = pycbc_monotonic_ns();
+    ev->n = n;
+
+    /** The event must be complete before it is counted */
+    TL_BARRIER();
+    buf->nwritten++;
+}
+
+/**
+ * Copy the events of a buffer to the list, as tuples of
+ * (thread, category, name, begin, end, n)
+ */
+static int
+collect_buffer(struct tl_buffer *buf, PyObject *list, int clear)
+{
+    lcb_uint64_t first, last, ii, valid;
+    struct tl_event *copy;
+    size_t ncopied = 0;
+    int rv = 0;
+
+    last = buf->nwritten;
+    TL_BARRIER();
+
+    first = buf->ncleared;
+    if (last - first > buf->capacity) {
+        first = last - buf->capacity;
+    }
+
+    if (first == last) {
+        return 0;
+    }
+
+    copy = malloc(sizeof(*copy) * (size_t)(last - first));
+    if (!copy) {
+        PyErr_NoMemory();
+        return -1;
+    }
+
+    for (ii = first; ii < last; ii++) {
+        copy[ncopied++] = buf->events[ii % buf->capacity];
+    }
+
+    /**
+     * Anything overwritten while copying is discarded. The event at
+     * 'nwritten' may be being written, so its slot is not valid either
+     */
+    TL_BARRIER();
+    valid = buf->nwritten + 1;
+    valid = valid > buf->capacity ? valid - buf->capacity : 0;
+
+    for (ii = first; ii < last && rv == 0; ii++) {
+        struct tl_event *ev = copy + (ii - first);
+        PyObject *tuple;
+
+        if (ii < valid) {
+            continue;
+        }
+
+        tuple = Py_BuildValue("(kssKKK)", ev->tid, ev->cat, ev->name,
+                              ev->begin, ev->end, ev->n);
+        if (!tuple) {
+            rv = -1;
+            break;
+        }
+
+        rv = PyList_Append(list, tuple);
+        Py_DECREF(tuple);
+    }
+
+    free(copy);
+
+    if (rv == 0 && clear) {
+        buf->ncleared = last;
+    }
+    return rv;
+}
+
+PyObject *
+pycbc_timeline_enable(PyObject *self, PyObject *args, PyObject *kwargs)
+{
+    Py_ssize_t capacity = TL_DEFAULT_CAPACITY;
+    static char *kwlist[] = { "capacity", NULL };
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|n", kwlist,
+                                     &capacity)) {
+        return NULL;
+    }
+
+    if (capacity < 1) {
+        PYCBC_EXC_WRAP(PYCBC_EXC_ARGUMENTS, 0,
+                       "Capacity must be greater than 0");
+        return NULL;
+    }
+
+    if (create_key() == -1) {
+        PYCBC_EXC_WRAP(PYCBC_EXC_INTERNAL, 0,
+                       "Couldn't create the timeline's thread-local key");
+        return NULL;
+    }
+
+    tl_capacity = capacity;
+    pycbc_timeline_enabled = 1;
+
+    (void)self;
+    Py_RETURN_NONE;
+}
+
+PyObject *
+pycbc_timeline_disable(PyObject *self, PyObject *args)
+{
+    pycbc_timeline_enabled = 0;
+
+    (void)self;
+    (void)args;
+    Py_RETURN_NONE;
+}
+
+PyObject *
+pycbc_timeline_collect(PyObject *self, PyObject *args, PyObject *kwargs)
+{
+    PyObject *clear_O = NULL;
+    PyObject *ret;
+    struct tl_buffer *buf;
+    int clear;
+
+    static char *kwlist[] = { "clear", NULL };
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|O", kwlist, &clear_O)) {
+        return NULL;
+    }
+
+    clear = clear_O && PyObject_IsTrue(clear_O);
+
+    ret = PyList_New(0);
+    if (!ret) {
+        return NULL;
+    }
+
+    for (buf = tl_buffers; buf; buf = buf->next) {
+        if (collect_buffer(buf, ret, clear) == -1) {
+            Py_DECREF(ret);
+            return NULL;
+        }
+    }
+
+    (void)self;
+    return ret;
+}
@@ -0,0 +1,458 @@
+/**
+ *     Copyright 2013 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ **/
+
+/**
+ * Recording of the operations performed by a connection, for replaying
+ * later (see couchbase/trace.py).
+ *
+ * Each call (i.e. batch of commands) is written to the trace file once it
+ * has completed. The format is:
+ *
+ * Header (24 bytes):
+ *   "PYCBCTRC", u8 version, u8 flags (PYCBC_TRACE_F_*), 6 reserved bytes,
+ *   u64 wall clock time at the start of the trace, in microseconds
+ *
+ * Each batch:
+ *   u8 op (PYCBC_TRACE_OP_*), u8 flags (PYCBC_TRACE_B_*),
+ *   varint microseconds since the previous batch began (or since the
+ *   start of the trace), varint latency in microseconds,
+ *   varint number of commands, followed by the commands
+ *
+ * Each command:
+ *   varint key length, then the key (or, if the trace was started with
+ *   hashed keys, the u64 FNV-1a hash of the key), followed by
+ *     storage:           varint value size, varint expiry
+ *     get, lock, touch:  varint expiry (or lock time)
+ *     arithmetic:        varint zigzag-encoded delta, u8 create,
+ *                        varint expiry
+ *     others:            nothing
+ *
+ * Fixed-width integers are little-endian, and varints are unsigned LEB128.
+ */
+#include "oputil.h"
+#include <time.h>
+
+#define PYCBC_TRACE_MAGIC "PYCBCTRC"
+#define PYCBC_TRACE_VERSION 1
+
+/** Keys are stored as hashes */
+#define PYCBC_TRACE_F_HASHKEYS 0x01
+
+/** At least one command in the batch failed */
+#define PYCBC_TRACE_B_ERROR 0x01
+
+enum {
+    PYCBC_TRACE_OP_GET = 1,
+    PYCBC_TRACE_OP_LOCK,
+    PYCBC_TRACE_OP_TOUCH,
+    PYCBC_TRACE_OP_ARITH,
+    PYCBC_TRACE_OP_DELETE,
+    PYCBC_TRACE_OP_UNLOCK,
+    PYCBC_TRACE_OP_SET,
+    PYCBC_TRACE_OP_ADD,
+    PYCBC_TRACE_OP_REPLACE,
+    PYCBC_TRACE_OP_APPEND,
+    PYCBC_TRACE_OP_PREPEND,
+    PYCBC_TRACE_OP_OBSERVE
+};
+
+struct pycbc_trace_st {
+    FILE *fp;
+    int flags;
+
+    /** Monotonic start time of the last batch recorded (or of the trace) */
+    lcb_uint64_t last;
+
+    unsigned long long nbatches;
+    unsigned long long ncommands;
+
+    /** Set if a write has failed. Nothing more is written */
+    int failed;
+
+    /** Buffer for the batch being encoded */
+    char *buf;
+    size_t nbuf;
+    size_t alloc;
+};
+
+static int
+reserve(struct pycbc_trace_st *trace, size_t n)
+{
+    char *newbuf;
+    size_t newalloc;
+
+    if (trace->alloc - trace->nbuf >= n) {
+        return 0;
+    }
+
+    newalloc = trace->alloc ? trace->alloc : 256;
+    while (newalloc - trace->nbuf < n) {
+        newalloc *= 2;
+    }
+
+    newbuf = realloc(trace->buf, newalloc);
+    if (!newbuf) {
+        return -1;
+    }
+
+    trace->buf = newbuf;
+    trace->alloc = newalloc;
+    return 0;
+}
+
+static int
+put_bytes(struct pycbc_trace_st *trace, const void *data, size_t n)
+{
+    if (reserve(trace, n) == -1) {
+        return -1;
+    }
+    memcpy(trace->buf + trace->nbuf, data, n);
+    trace->nbuf += n;
+    return 0;
+}
+
+static int
+put_u8(struct pycbc_trace_st *trace, unsigned char c)
+{
+    return put_bytes(trace, &c, 1);
+}
+
+static int
+put_u64(struct pycbc_trace_st *trace, lcb_uint64_t v)
+{
+    unsigned char out[8];
+    int ii;
+
+    for (ii = 0; ii < 8; ii++) {
+        out[ii] = (unsigned char)(v >> (ii * 8));
+    }
+    return put_bytes(trace, out, sizeof(out));
+}
+
+static int
+put_varint(struct pycbc_trace_st *trace, lcb_uint64_t v)
+{
+    unsigned char out[10];
+    size_t n = 0;
+
+    do {
+        out[n] = v & 0x7f;
+        v >>= 7;
+        if (v) {
+            out[n] |= 0x80;
+        }
+        n++;
+    } while (v);
+
+    return put_bytes(trace, out, n);
+}
+
+static lcb_uint64_t
+hash_key(const void *key, size_t nkey)
+{
+    const unsigned char *p = key;
+    lcb_uint64_t h = 0xcbf29ce484222325ULL;
+    size_t ii;
+
+    for (ii = 0; ii < nkey; ii++) {
+        h ^= p[ii];
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
+static int
+put_key(struct pycbc_trace_st *trace, const void *key, lcb_size_t nkey)
+{
+    if (put_varint(trace, nkey) == -1) {
+        return -1;
+    }
+
+    if (trace->flags & PYCBC_TRACE_F_HASHKEYS) {
+        return put_u64(trace, hash_key(key, nkey));
+    }
+    return put_bytes(trace, key, nkey);
+}
+
+static int
+trace_opcode(const struct pycbc_common_vars *cv)
+{
+    switch (cv->optype) {
+    case PYCBC_CMD_GET:
+    case PYCBC_CMD_GAT:
+        return PYCBC_TRACE_OP_GET;
+    case PYCBC_CMD_LOCK:
+        return PYCBC_TRACE_OP_LOCK;
+    case PYCBC_CMD_TOUCH:
+        return PYCBC_TRACE_OP_TOUCH;
+    case PYCBC_CMD_INCR:
+    case PYCBC_CMD_DECR:
+    case PYCBC_CMD_ARITH:
+        return PYCBC_TRACE_OP_ARITH;
+    case PYCBC_CMD_DELETE:
+        return PYCBC_TRACE_OP_DELETE;
+    case PYCBC_CMD_UNLOCK:
+        return PYCBC_TRACE_OP_UNLOCK;
+    case PYCBC_CMD_OBSERVE:
+        return PYCBC_TRACE_OP_OBSERVE;
+
+    case PYCBC_CMD_STORE:
+        switch (cv->cmds.store[0].v.v0.operation) {
+        case LCB_ADD:
+            return PYCBC_TRACE_OP_ADD;
+        case LCB_REPLACE:
+            return PYCBC_TRACE_OP_REPLACE;
+        case LCB_APPEND:
+            return PYCBC_TRACE_OP_APPEND;
+        case LCB_PREPEND:
+            return PYCBC_TRACE_OP_PREPEND;
+        default:
+            return PYCBC_TRACE_OP_SET;
+        }
+
+    default:
+        /** Statistics requests are not replayed */
+        return 0;
+    }
+}
+
+static int
+put_command(struct pycbc_trace_st *trace,
+            const struct pycbc_common_vars *cv,
+            Py_ssize_t ii)
+{
+    switch (cv->optype) {
+    case PYCBC_CMD_GET:
+    case PYCBC_CMD_GAT:
+    case PYCBC_CMD_LOCK: {
+        const lcb_get_cmd_t *cmd = cv->cmds.get + ii;
+        if (put_key(trace, cmd->v.v0.key, cmd->v.v0.nkey) == -1) {
+            return -1;
+        }
+        return put_varint(trace, cmd->v.v0.exptime);
+    }
+
+    case PYCBC_CMD_TOUCH: {
+        const lcb_touch_cmd_t *cmd = cv->cmds.touch + ii;
+        if (put_key(trace, cmd->v.v0.key, cmd->v.v0.nkey) == -1) {
+            return -1;
+        }
+        return put_varint(trace, cmd->v.v0.exptime);
+    }
+
+    case PYCBC_CMD_INCR:
+    case PYCBC_CMD_DECR:
+    case PYCBC_CMD_ARITH: {
+        const lcb_arithmetic_cmd_t *cmd = cv->cmds.arith + ii;
+        lcb_int64_t delta = cmd->v.v0.delta;
+        lcb_uint64_t zigzag;
+
+        zigzag = delta < 0 ? ((lcb_uint64_t)(-(delta + 1)) << 1) | 1
+                           : (lcb_uint64_t)delta << 1;
+
+        if (put_key(trace, cmd->v.v0.key, cmd->v.v0.nkey) == -1 ||
+                put_varint(trace, zigzag) == -1 ||
+                put_u8(trace, cmd->v.v0.create ? 1 : 0) == -1) {
+            return -1;
+        }
+        return put_varint(trace, cmd->v.v0.exptime);
+    }
+
+    case PYCBC_CMD_DELETE: {
+        const lcb_remove_cmd_t *cmd = cv->cmds.remove + ii;
+        return put_key(trace, cmd->v.v0.key, cmd->v.v0.nkey);
+    }
+
+    case PYCBC_CMD_UNLOCK: {
+        const lcb_unlock_cmd_t *cmd = cv->cmds.unlock + ii;
+        return put_key(trace, cmd->v.v0.key, cmd->v.v0.nkey);
+    }
+
+    case PYCBC_CMD_OBSERVE: {
+        const lcb_observe_cmd_t *cmd = cv->cmds.obs + ii;
+        return put_key(trace, cmd->v.v0.key, cmd->v.v0.nkey);
+    }
+
+    case PYCBC_CMD_STORE: {
+        const lcb_store_cmd_t *cmd = cv->cmds.store + ii;
+        if (put_key(trace, cmd->v.v0.key, cmd->v.v0.nkey) == -1 ||
+                put_varint(trace, cmd->v.v0.nbytes) == -1) {
+            return -1;
+        }
+        return put_varint(trace, cmd->v.v0.exptime);
+    }
+
+    default:
+        return 0;
+    }
+}
+
+void
+pycbc_trace_batch(struct pycbc_trace_st *trace,
+                  const struct pycbc_common_vars *cv,
+                  int failed)
+{
+    lcb_uint64_t now = pycbc_trace_now();
+    lcb_uint64_t begin = cv->trace_begin;
+    int op = trace_opcode(cv);
+    Py_ssize_t ii;
+    int rv;
+
+    if (trace->failed || !op || !cv->ncmds) {
+        return;
+    }
+
+    if (begin < trace->last) {
+        /**
+         * Batches are recorded in the order they complete, and their start
+         * times must not go backwards. This happens with operations which
+         * overlapped (from several threads), or were already in progress
+         * when the trace was started.
+         */
+        begin = trace->last;
+    }
+
+    trace->nbuf = 0;
+    rv = put_u8(trace, (unsigned char)op);
+    rv |= put_u8(trace, failed ? PYCBC_TRACE_B_ERROR : 0);
+    rv |= put_varint(trace, begin - trace->last);
+    rv |= put_varint(trace, now - begin);
+    rv |= put_varint(trace, cv->ncmds);
+
+    for (ii = 0; ii < cv->ncmds && rv == 0; ii++) {
+        rv = put_command(trace, cv, ii);
+    }
+
+    if (rv != 0 || fwrite(trace->buf, 1, trace->nbuf, trace->fp) !=
+            trace->nbuf) {
+        trace->failed = 1;
+        return;
+    }
+
+    trace->last = begin;
+    trace->nbatches++;
+    trace->ncommands += cv->ncmds;
+}
+
+lcb_uint64_t
+pycbc_trace_now(void)
+{
+    return pycbc_monotonic_ns() / 1000;
+}
+
+void
+pycbc_trace_close(struct pycbc_trace_st *trace)
+{
+    if (!trace) {
+        return;
+    }
+
+    if (trace->fp) {
+        fclose(trace->fp);
+    }
+    free(trace->buf);
+    free(trace);
+}
+
+PyObject *
+pycbc_Connection__start_trace(pycbc_Connection *self,
+                              PyObject *args,
+                              PyObject *kwargs)
+{
+    const char *path;
+    int hash_keys = 0;
+    struct pycbc_trace_st *trace;
+    int rv;
+
+    static char *kwlist[] = { "path", "hash_keys", NULL };
+
+    rv = PyArg_ParseTupleAndKeywords(args, kwargs, "s|i", kwlist,
+                                     &path, &hash_keys);
+    if (!rv) {
+        PYCBC_EXCTHROW_ARGS();
+        return NULL;
+    }
+
+    if (self->trace) {
+        PYCBC_EXC_WRAP(PYCBC_EXC_ARGUMENTS, 0, "A trace is already running");
+        return NULL;
+    }
+
+    trace = calloc(1, sizeof(*trace));
+    if (!trace) {
+        return PyErr_NoMemory();
+    }
+
+    trace->fp = fopen(path, "wb");
+    if (!trace->fp) {
+        pycbc_trace_close(trace);
+        return PyErr_SetFromErrnoWithFilename(PyExc_IOError, (char *)path);
+    }
+
+    trace->flags = hash_keys ? PYCBC_TRACE_F_HASHKEYS : 0;
+    trace->last = pycbc_trace_now();
+
+    rv = put_bytes(trace, PYCBC_TRACE_MAGIC, 8);
+    rv |= put_u8(trace, PYCBC_TRACE_VERSION);
+    rv |= put_u8(trace, (unsigned char)trace->flags);
+    rv |= put_bytes(trace, "\0\0\0\0\0\0", 6);
+    rv |= put_u64(trace, (lcb_uint64_t)time(NULL) * 1000000);
+
+    if (rv != 0 || fwrite(trace->buf, 1, trace->nbuf, trace->fp) !=
+            trace->nbuf) {
+        pycbc_trace_close(trace);
+        PYCBC_EXC_WRAP(PYCBC_EXC_INTERNAL, 0, "Couldn't write trace header");
+        return NULL;
+    }
+
+    self->trace = trace;
+    Py_RETURN_NONE;
+}
+
+PyObject *
+pycbc_Connection__stop_trace(pycbc_Connection *self,
+                             PyObject *args,
+                             PyObject *kwargs)
+{
+    struct pycbc_trace_st *trace = self->trace;
+    PyObject *ret;
+    int failed;
+
+    (void)args;
+    (void)kwargs;
+
+    if (!trace) {
+        Py_RETURN_NONE;
+    }
+
+    self->trace = NULL;
+    failed = trace->failed || fflush(trace->fp) != 0;
+
+    ret = Py_BuildValue("{s:K,s:K}",
+                        "batches", trace->nbatches,
+                        "commands", trace->ncommands);
+    pycbc_trace_close(trace);
+
+    if (failed) {
+        Py_XDECREF(ret);
+        PYCBC_EXC_WRAP(PYCBC_EXC_INTERNAL, 0,
+                       "Couldn't write to the trace file. The trace is "
+                       "incomplete");
+        return NULL;
+    }
+
+    return ret;
+}
@@ -20,6 +20,12 @@
  * major versions as well.
  */
 #include "pycbc.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
 #if PY_MAJOR_VERSION == 2
 
 unsigned PY_LONG_LONG
@@ -177,6 +183,38 @@ pycbc_get_ttl(PyObject *obj, unsigned long *ttl, int nonzero)
     return 0;
 }
 
+int
+pycbc_get_timeout(PyObject *obj, lcb_uint32_t *usecs)
+{
+    double secs;
+
+    *usecs = 0;
+    if (obj == NULL || obj == Py_None) {
+        return 0;
+    }
+
+    secs = PyFloat_AsDouble(obj);
+    if (secs == -1.0 && PyErr_Occurred()) {
+        PyErr_Clear();
+        PYCBC_EXC_WRAP_OBJ(PYCBC_EXC_ARGUMENTS, 0,
+                           "Timeout must be a number of seconds", obj);
+        return -1;
+    }
+
+    if (secs <= 0 || secs > 4294) {
+        PYCBC_EXC_WRAP_OBJ(PYCBC_EXC_ARGUMENTS, 0,
+                           "Timeout must be positive and less "
+                           "than 4294 seconds", obj);
+        return -1;
+    }
+
+    *usecs = (lcb_uint32_t)(secs * 1000000);
+    if (!*usecs) {
+        *usecs = 1;
+    }
+    return 0;
+}
+
 int
 pycbc_get_u32(PyObject *obj, unsigned long *out)
 {
@@ -202,3 +240,22 @@ pycbc_get_u32(PyObject *obj, unsigned long *out)
     return 0;
 
 }
+
+lcb_uint64_t
+pycbc_monotonic_ns(void)
+{
+#ifdef _WIN32
+    LARGE_INTEGER freq, count;
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&count);
+
+    /** Split to avoid overflowing the multiplication */
+    return (lcb_uint64_t)(count.QuadPart / freq.QuadPart) * 1000000000 +
+            (lcb_uint64_t)(count.QuadPart % freq.QuadPart) * 1000000000 /
+            freq.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (lcb_uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+#endif
+}
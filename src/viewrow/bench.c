@@ -0,0 +1,306 @@
+/**
+ *     Copyright 2013 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ **/
+
+/**
+ * Standalone benchmark for the view row parser.
+ *
+ * A synthetic view response is generated in memory and fed through
+ * lcbex_vrow_feed() in fixed-size chunks, as it would be received from the
+ * network. No server (or libcouchbase) is needed. See the Makefile in this
+ * directory for building it.
+ *
+ *   ./vrow-bench -n 100000 -s 256 -d 3 -c 16384 -i 10
+ */
+
+#define _POSIX_C_SOURCE 200112L
+
+#include "viewrow.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+typedef struct {
+    /** Number of rows in the response */
+    unsigned long nrows;
+
+    /** Approximate size of each row's value, in bytes */
+    size_t rowsize;
+
+    /** Depth of the objects nesting each row's value */
+    unsigned depth;
+
+    /** Size of each chunk passed to lcbex_vrow_feed() */
+    size_t chunksize;
+
+    /** Number of times to parse the response */
+    unsigned iterations;
+} bench_options;
+
+typedef struct {
+    unsigned long rows;
+    size_t rowbytes;
+    int complete;
+    int error;
+} bench_counters;
+
+static lcbex_vrow_buffer response;
+
+static void
+append(const char *s, size_t n)
+{
+    if (response.alloc - response.len < n) {
+        size_t newsize = response.alloc ? response.alloc : 4096;
+
+        while (newsize - response.len < n) {
+            newsize *= 2;
+        }
+
+        response.s = realloc(response.s, newsize);
+        if (!response.s) {
+            fprintf(stderr, "Out of memory\n");
+            exit(EXIT_FAILURE);
+        }
+        response.alloc = newsize;
+    }
+
+    memcpy(response.s + response.len, s, n);
+    response.len += n;
+}
+
+static void
+appendz(const char *s)
+{
+    append(s, strlen(s));
+}
+
+/**
+ * Generate a response in the format returned by the view engine, one row
+ * per line
+ */
+static void
+generate_response(const bench_options *opts)
+{
+    char buf[256];
+    char *text;
+    unsigned long ii;
+    unsigned jj;
+
+    text = malloc(opts->rowsize + 1);
+    for (ii = 0; ii < opts->rowsize; ii++) {
+        text[ii] = 'a' + (ii % 26);
+    }
+    text[opts->rowsize] = '\0';
+
+    sprintf(buf, "{\"total_rows\":%lu,\"rows\":[\r\n", opts->nrows);
+    appendz(buf);
+
+    for (ii = 0; ii < opts->nrows; ii++) {
+        sprintf(buf,
+                "{\"id\":\"doc_%08lu\",\"key\":[\"key_%lu\",%lu],\"value\":",
+                ii, ii % 1000, ii);
+        appendz(buf);
+
+        for (jj = 1; jj < opts->depth; jj++) {
+            sprintf(buf, "{\"level%u\":", jj);
+            appendz(buf);
+        }
+
+        sprintf(buf, "{\"n\":%lu,\"f\":%lu.5,\"b\":true,\"text\":\"", ii, ii);
+        appendz(buf);
+        append(text, opts->rowsize);
+        appendz("\"}");
+
+        for (jj = 1; jj < opts->depth; jj++) {
+            appendz("}");
+        }
+
+        appendz(ii + 1 < opts->nrows ? "},\r\n" : "}\r\n");
+    }
+
+    appendz("]\r\n}\n");
+    free(text);
+}
+
+static void
+row_callback(lcbex_vrow_ctx_t *ctx,
+             const void *cookie,
+             const lcbex_vrow_datum_t *row)
+{
+    bench_counters *counters = (bench_counters *)cookie;
+
+    (void)ctx;
+
+    switch (row->type) {
+    case LCBEX_VROW_ROW:
+        counters->rows++;
+        counters->rowbytes += row->ndata;
+        break;
+
+    case LCBEX_VROW_COMPLETE:
+        counters->complete = 1;
+        break;
+
+    case LCBEX_VROW_ERROR:
+        counters->error = 1;
+        break;
+    }
+}
+
+static double
+now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * Parse the response once.
+ * @return the elapsed time, in seconds
+ */
+static double
+run_once(const bench_options *opts, bench_counters *counters, size_t *peak)
+{
+    lcbex_vrow_ctx_t *ctx;
+    size_t pos;
+    double begin, elapsed;
+
+    memset(counters, 0, sizeof(*counters));
+    *peak = 0;
+
+    ctx = lcbex_vrow_create();
+    lcbex_vrow_set_callback(ctx, row_callback);
+    lcbex_vrow_set_cookie(ctx, counters);
+
+    begin = now();
+
+    for (pos = 0; pos < response.len; pos += opts->chunksize) {
+        size_t n = response.len - pos;
+        size_t inuse;
+
+        if (n > opts->chunksize) {
+            n = opts->chunksize;
+        }
+
+        lcbex_vrow_feed(ctx, response.s + pos, n);
+
+        inuse = ctx->current_buf.alloc + ctx->meta_buf.alloc +
+                ctx->last_hk.alloc;
+        if (inuse > *peak) {
+            *peak = inuse;
+        }
+    }
+
+    elapsed = now() - begin;
+    lcbex_vrow_free(ctx);
+    return elapsed;
+}
+
+static void
+usage(const char *argv0)
+{
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  -n ROWS    Number of rows (default 100000)\n"
+            "  -s BYTES   Size of each row's value (default 128)\n"
+            "  -d DEPTH   Nesting depth of each row's value (default 1)\n"
+            "  -c BYTES   Chunk size (default 16384)\n"
+            "  -i COUNT   Number of iterations (default 5)\n",
+            argv0);
+    exit(EXIT_FAILURE);
+}
+
+int
+main(int argc, char **argv)
+{
+    bench_options opts;
+    bench_counters counters;
+    double total = 0, best = 0;
+    size_t peak = 0;
+    unsigned ii;
+    int c;
+
+    opts.nrows = 100000;
+    opts.rowsize = 128;
+    opts.depth = 1;
+    opts.chunksize = 16384;
+    opts.iterations = 5;
+
+    while ((c = getopt(argc, argv, "n:s:d:c:i:h")) != -1) {
+        switch (c) {
+        case 'n':
+            opts.nrows = strtoul(optarg, NULL, 10);
+            break;
+        case 's':
+            opts.rowsize = strtoul(optarg, NULL, 10);
+            break;
+        case 'd':
+            opts.depth = strtoul(optarg, NULL, 10);
+            break;
+        case 'c':
+            opts.chunksize = strtoul(optarg, NULL, 10);
+            break;
+        case 'i':
+            opts.iterations = strtoul(optarg, NULL, 10);
+            break;
+        default:
+            usage(argv[0]);
+        }
+    }
+
+    if (!opts.chunksize || !opts.iterations || !opts.depth ||
+            opts.depth > 400) {
+        usage(argv[0]);
+    }
+
+    generate_response(&opts);
+
+    printf("Response: %lu rows, %lu bytes, depth %u, chunks of %lu bytes\n",
+           opts.nrows, (unsigned long)response.len, opts.depth,
+           (unsigned long)opts.chunksize);
+
+    for (ii = 0; ii < opts.iterations; ii++) {
+        size_t run_peak;
+        double elapsed = run_once(&opts, &counters, &run_peak);
+
+        if (counters.error || !counters.complete ||
+                counters.rows != opts.nrows) {
+            fprintf(stderr, "Parse failed: %lu rows, complete=%d, error=%d\n",
+                    counters.rows, counters.complete, counters.error);
+            return EXIT_FAILURE;
+        }
+
+        total += elapsed;
+        if (!ii || elapsed < best) {
+            best = elapsed;
+        }
+        if (run_peak > peak) {
+            peak = run_peak;
+        }
+    }
+
+    printf("Best:    %10.1f MB/s %12.0f rows/s\n",
+           response.len / best / 1e6, opts.nrows / best);
+    printf("Average: %10.1f MB/s %12.0f rows/s\n",
+           response.len * opts.iterations / total / 1e6,
+           opts.nrows * opts.iterations / total);
+    printf("Peak buffer size: %lu bytes\n", (unsigned long)peak);
+
+    free(response.s);
+    return EXIT_SUCCESS;
+}
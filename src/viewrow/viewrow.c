@@ -27,9 +27,13 @@
 DECLARE_JSONSL_CALLBACK(row_pop_callback);
 DECLARE_JSONSL_CALLBACK(initial_push_callback);
 DECLARE_JSONSL_CALLBACK(initial_pop_callback);
-DECLARE_JSONSL_CALLBACK(meta_header_complete_callback);
 DECLARE_JSONSL_CALLBACK(trailer_pop_callback);
 
+/**
+ * Once released, a buffer larger than this is shrunk if it is mostly empty
+ */
+#define VROW_SHRINK_MIN 65536
+
 /* conform to void */
 #define JOBJ_RESPONSE_ROOT (void*)1
 #define JOBJ_ROWSET (void*)2
@@ -37,6 +41,11 @@ DECLARE_JSONSL_CALLBACK(trailer_pop_callback);
 static void
 buffer_append(lcbex_vrow_buffer *vb, const void *data, size_t ndata)
 {
+    if (!ndata) {
+        /* the buffer may not be allocated yet */
+        return;
+    }
+
     if (vb->alloc - vb->len < ndata) {
         /* multiple of two */
         size_t wanted_size = 64;
@@ -52,6 +61,31 @@ buffer_append(lcbex_vrow_buffer *vb, const void *data, size_t ndata)
     vb->len += ndata;
 }
 
+/**
+ * Release memory from a buffer which has grown far beyond what it holds,
+ * e.g. after an unusually large row.
+ */
+static void
+buffer_maybe_shrink(lcbex_vrow_buffer *vb)
+{
+    size_t wanted_size = 64;
+    char *tmp;
+
+    if (vb->alloc <= VROW_SHRINK_MIN || vb->len > vb->alloc / 4) {
+        return;
+    }
+
+    while (wanted_size < vb->len * 2) {
+        wanted_size *= 2;
+    }
+
+    tmp = realloc(vb->s, wanted_size);
+    if (tmp) {
+        vb->s = tmp;
+        vb->alloc = wanted_size;
+    }
+}
+
 static void
 buffer_reset(lcbex_vrow_buffer *vb, int free_chunk)
 {
@@ -65,39 +99,58 @@ buffer_reset(lcbex_vrow_buffer *vb, int free_chunk)
 }
 
 /**
- * Gets a buffer, given an (absolute) position offset.
- * It will try to get a buffer of size desired. The actual size is
- * returned in 'actual' (and may be less than desired, maybe even 0)
+ * Absolute position of the end of the data received so far
+ */
+static size_t
+data_end(lcbex_vrow_ctx_t *ctx)
+{
+    if (ctx->chunk) {
+        return ctx->chunk_pos + ctx->nchunk;
+    }
+    return ctx->min_pos + ctx->current_buf.len;
+}
+
+/**
+ * Gets the data between two (absolute) positions as a contiguous region.
+ * 'end' is exclusive. Returns NULL if 'begin' has already been released.
+ *
+ * While data is being fed, it is parsed in place in the caller's buffer,
+ * and current_buf only holds data carried over from earlier calls. If the
+ * region begins in current_buf, the rest of it is copied there from the
+ * caller's buffer.
  */
 static const char *
-get_buffer_region(lcbex_vrow_ctx_t *ctx, size_t pos, size_t desired,
-                  size_t *actual)
+get_buffer_region(lcbex_vrow_ctx_t *ctx, size_t begin, size_t end)
 {
-    const char *ret = ctx->current_buf.s + pos - ctx->min_pos;
-    const char *end = ctx->current_buf.s + ctx->current_buf.len;
-    *actual = end - ret;
+    size_t have = ctx->min_pos + ctx->current_buf.len;
 
-    if (ctx->min_pos > pos) {
+    if (begin < ctx->min_pos) {
         /* swallowed */
-        *actual = 0;
         return NULL;
     }
 
-    assert(ret < end);
-    if (desired < *actual) {
-        *actual = desired;
+    if (ctx->chunk && begin >= ctx->chunk_pos) {
+        return ctx->chunk + (begin - ctx->chunk_pos);
     }
-    return ret;
+
+    if (ctx->chunk && end > have) {
+        assert(end <= ctx->chunk_pos + ctx->nchunk);
+        buffer_append(&ctx->current_buf,
+                      ctx->chunk + (have - ctx->chunk_pos), end - have);
+    }
+
+    return ctx->current_buf.s + (begin - ctx->min_pos);
 }
 
 /**
  * Consolidate the meta data into a single parsable string..
+ * @param end the (absolute) end of the trailer
  */
 static void
-combine_meta(lcbex_vrow_ctx_t *ctx)
+combine_meta(lcbex_vrow_ctx_t *ctx, size_t end)
 {
     const char *meta_trailer;
-    size_t ntrailer;
+    size_t begin = ctx->last_row_endpos + 1;
 
     if (ctx->meta_complete) {
         return;
@@ -109,10 +162,10 @@ combine_meta(lcbex_vrow_ctx_t *ctx)
     ctx->meta_buf.len = ctx->header_len;
 
     /* Append any trailing data */
-    meta_trailer = get_buffer_region(ctx,
-                                     ctx->last_row_endpos + 1, -1, &ntrailer);
-
-    buffer_append(&ctx->meta_buf, meta_trailer, ntrailer);
+    meta_trailer = get_buffer_region(ctx, begin, end);
+    if (meta_trailer && end > begin) {
+        buffer_append(&ctx->meta_buf, meta_trailer, end - begin);
+    }
     ctx->meta_complete = 1;
 }
 
@@ -123,24 +176,6 @@ combine_meta(lcbex_vrow_ctx_t *ctx)
     len--;
 
 
-static void
-meta_header_complete_callback(jsonsl_t jsn,
-                       jsonsl_action_t action,
-                       struct jsonsl_state_st *state,
-                       const jsonsl_char_t *at)
-{
-
-    lcbex_vrow_ctx_t *ctx = (lcbex_vrow_ctx_t*)jsn->data;
-    buffer_append(&ctx->meta_buf,
-                  ctx->current_buf.s, state->pos_begin);
-
-    ctx->header_len = state->pos_begin;
-    jsn->action_callback_PUSH = NULL;
-
-    (void)action;
-    (void)at;
-}
-
 static void
 row_pop_callback(jsonsl_t jsn,
                  jsonsl_action_t action,
@@ -149,30 +184,35 @@ row_pop_callback(jsonsl_t jsn,
 {
     lcbex_vrow_ctx_t *ctx = (lcbex_vrow_ctx_t*)jsn->data;
     const char *rowbuf;
-    size_t szdummy;
 
     if (ctx->have_error) {
         return;
     }
 
-    ctx->keep_pos = state->pos_cur;
-    ctx->last_row_endpos = state->pos_cur;
-    ctx->rowcount++;
-
+    /**
+     * The state's pos_cur is not updated for the closing token of a
+     * container; it still points to the end of the last child. The parser's
+     * own position is that of the closing token.
+     */
     if (state->data == JOBJ_ROWSET) {
-        /* don't care anymore.. */
+        /* don't care anymore.. The trailer begins with the bracket */
+        ctx->last_row_endpos = jsn->pos - 1;
         jsn->action_callback_POP = trailer_pop_callback;
         jsn->action_callback_PUSH = NULL;
         return;
     }
 
+    ctx->keep_pos = jsn->pos + 1;
+    ctx->last_row_endpos = jsn->pos;
+    ctx->rowcount++;
+
 
     /* must be a JSON object! */
     if (!ctx->callback) {
         return;
     }
 
-    rowbuf = get_buffer_region(ctx, state->pos_begin, -1, &szdummy);
+    rowbuf = get_buffer_region(ctx, state->pos_begin, jsn->pos + 1);
 
     {
         /**
@@ -181,7 +221,7 @@ row_pop_callback(jsonsl_t jsn,
         lcbex_vrow_datum_t dt = { 0 };
         dt.type = LCBEX_VROW_ROW;
         dt.data = rowbuf;
-        dt.ndata = state->pos_cur - state->pos_begin + 1;
+        dt.ndata = jsn->pos - state->pos_begin + 1;
         ctx->callback(ctx, ctx->user_cookie, &dt);
     }
 
@@ -201,8 +241,8 @@ parse_error_callback(jsonsl_t jsn,
         /* invoke the callback */
         lcbex_vrow_datum_t dt = { 0 };
         dt.type = LCBEX_VROW_ERROR;
-        dt.data = ctx->current_buf.s;
-        dt.ndata = ctx->current_buf.len;
+        dt.data = get_buffer_region(ctx, ctx->min_pos, data_end(ctx));
+        dt.ndata = data_end(ctx) - ctx->min_pos;
         ctx->callback(ctx, ctx->user_cookie, &dt);
     }
 
@@ -224,7 +264,7 @@ trailer_pop_callback(jsonsl_t jsn,
     if (state->data != JOBJ_RESPONSE_ROOT) {
         return;
     }
-    combine_meta(ctx);
+    combine_meta(ctx, jsn->pos + 1);
     dt.data = ctx->meta_buf.s;
     dt.ndata = ctx->meta_buf.len;
     dt.type = LCBEX_VROW_COMPLETE;
@@ -241,7 +281,7 @@ initial_pop_callback(jsonsl_t jsn,
                      const jsonsl_char_t *at)
 {
     lcbex_vrow_ctx_t *ctx = (lcbex_vrow_ctx_t*)jsn->data;
-    char *key;
+    const char *key;
     int len;
 
     if (ctx->have_error) {
@@ -256,7 +296,7 @@ initial_pop_callback(jsonsl_t jsn,
         return;
     }
 
-    key = ctx->current_buf.s + state->pos_begin;
+    key = get_buffer_region(ctx, state->pos_begin, state->pos_cur);
     len = state->pos_cur - state->pos_begin;
     NORMALIZE_OFFSETS(key, len);
 
@@ -313,45 +353,79 @@ initial_push_callback(jsonsl_t jsn,
     if (state->type == JSONSL_T_LIST && match == JSONSL_MATCH_POSSIBLE) {
         /* we have a match */
         jsn->action_callback_POP = row_pop_callback;
-        jsn->action_callback_PUSH = meta_header_complete_callback;
+        jsn->action_callback_PUSH = NULL;
         state->data = JOBJ_ROWSET;
+
+        /**
+         * Save the header (up to and including the opening bracket) now, so
+         * it need not be kept in the read buffer. This also makes the
+         * metadata valid if there are no rows.
+         */
+        ctx->header_len = state->pos_begin + 1;
+        buffer_append(&ctx->meta_buf,
+                      get_buffer_region(ctx, 0, ctx->header_len),
+                      ctx->header_len);
+        ctx->keep_pos = ctx->header_len;
+        ctx->last_row_endpos = state->pos_begin;
     }
 
     (void)action; /* always PUSH */
     (void)at;
 }
 
+/**
+ * The data is parsed in place. Rows which lie entirely within it are passed
+ * to the callback without being copied. Afterwards, only the data which is
+ * still needed (i.e. after the last row) is kept in current_buf.
+ */
 static void
 feed_data(lcbex_vrow_ctx_t *ctx, const char *data, size_t ndata)
 {
-    size_t old_len = ctx->current_buf.len;
-
-    buffer_append(&ctx->current_buf, data, ndata);
-
-    jsonsl_feed(ctx->jsn, ctx->current_buf.s + old_len, ndata);
-
-    /**
-     * Do we need to cut off some bytes?
-     */
-    if (ctx->keep_pos > ctx->min_pos) {
-        size_t lentmp, diff = ctx->keep_pos - ctx->min_pos;
-        const char *buf = get_buffer_region(ctx,
-                                            ctx->keep_pos, -1, &lentmp);
-
-        memmove(ctx->current_buf.s,
-                buf,
-                ctx->current_buf.len - diff);
-
-        ctx->current_buf.len -= diff;
+    size_t chunk_end;
+
+    ctx->chunk = data;
+    ctx->nchunk = ndata;
+    ctx->chunk_pos = ctx->min_pos + ctx->current_buf.len;
+    chunk_end = ctx->chunk_pos + ndata;
+
+    jsonsl_feed(ctx->jsn, data, ndata);
+
+    if (ctx->keep_pos >= ctx->chunk_pos) {
+        /* Nothing from before this chunk is needed */
+        ctx->current_buf.len = 0;
+        buffer_append(&ctx->current_buf,
+                      data + (ctx->keep_pos - ctx->chunk_pos),
+                      chunk_end - ctx->keep_pos);
+
+    } else {
+        size_t have = ctx->min_pos + ctx->current_buf.len;
+        size_t diff = ctx->keep_pos - ctx->min_pos;
+
+        buffer_append(&ctx->current_buf,
+                      data + (have - ctx->chunk_pos), chunk_end - have);
+
+        if (diff) {
+            memmove(ctx->current_buf.s,
+                    ctx->current_buf.s + diff,
+                    ctx->current_buf.len - diff);
+            ctx->current_buf.len -= diff;
+        }
     }
 
+    buffer_maybe_shrink(&ctx->current_buf);
     ctx->min_pos = ctx->keep_pos;
+    ctx->chunk = NULL;
+    ctx->nchunk = 0;
 }
 
-/* Non-static wrapper */
 void
 lcbex_vrow_feed(lcbex_vrow_ctx_t *ctx, const char *data, size_t ndata)
 {
+    if (ctx->have_error) {
+        /* The data has already been passed to the callback */
+        return;
+    }
+
     feed_data(ctx, data, ndata);
 }
 
@@ -359,7 +433,7 @@ lcbex_vrow_feed(lcbex_vrow_ctx_t *ctx, const char *data, size_t ndata)
 const char *
 lcbex_vrow_get_meta(lcbex_vrow_ctx_t *ctx, size_t *len)
 {
-    combine_meta(ctx);
+    combine_meta(ctx, data_end(ctx));
     *len = ctx->meta_buf.len;
     return ctx->meta_buf.s;
 }
@@ -415,6 +489,8 @@ lcbex_vrow_reset(lcbex_vrow_ctx_t* ctx)
     ctx_copy.user_cookie = ctx->user_cookie;
     ctx_copy.callback = ctx->callback;
     ctx_copy.jpr = ctx->jpr;
+    ctx_copy.row_jprs = ctx->row_jprs;
+    ctx_copy.nrow_jprs = ctx->nrow_jprs;
 
     ctx_copy.current_buf = ctx->current_buf;
     ctx_copy.meta_buf = ctx->meta_buf;
@@ -423,12 +499,60 @@ lcbex_vrow_reset(lcbex_vrow_ctx_t* ctx)
     *ctx = ctx_copy;
 }
 
+static void
+clear_projection(lcbex_vrow_ctx_t *ctx)
+{
+    size_t ii;
+
+    for (ii = 0; ii < ctx->nrow_jprs; ii++) {
+        jsonsl_jpr_destroy(ctx->row_jprs[ii]);
+    }
+
+    free(ctx->row_jprs);
+    ctx->row_jprs = NULL;
+    ctx->nrow_jprs = 0;
+}
+
+int
+lcbex_vrow_set_projection(lcbex_vrow_ctx_t *ctx,
+                          const char * const *paths,
+                          size_t npaths)
+{
+    size_t ii;
+
+    clear_projection(ctx);
+
+    if (!npaths) {
+        return 0;
+    }
+
+    ctx->row_jprs = calloc(npaths, sizeof(*ctx->row_jprs));
+    if (!ctx->row_jprs) {
+        return -1;
+    }
+
+    for (ii = 0; ii < npaths; ii++) {
+        jsonsl_error_t err;
+
+        ctx->row_jprs[ii] = jsonsl_jpr_new(paths[ii], &err);
+        if (!ctx->row_jprs[ii]) {
+            ctx->nrow_jprs = ii;
+            clear_projection(ctx);
+            return -1;
+        }
+    }
+
+    ctx->nrow_jprs = npaths;
+    return 0;
+}
+
 void
 lcbex_vrow_free(lcbex_vrow_ctx_t *ctx)
 {
     jsonsl_jpr_match_state_cleanup(ctx->jsn);
     jsonsl_destroy(ctx->jsn);
     jsonsl_jpr_destroy(ctx->jpr);
+    clear_projection(ctx);
 
     buffer_reset(&ctx->current_buf, 1);
     buffer_reset(&ctx->meta_buf, 1);
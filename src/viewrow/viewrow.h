@@ -22,7 +22,6 @@ extern "C" {
 #endif
 
 #include "../contrib/jsonsl/jsonsl.h"
-#include <libcouchbase/couchbase.h>
 
 typedef struct lcbex_rows_ctx_st lcbex_vrow_ctx_t;
 
@@ -83,12 +82,28 @@ struct lcbex_rows_ctx_st {
     /* jsonpointer match object */
     jsonsl_jpr_t jpr;
 
+    /**
+     * Optional row projection. These are JSON pointers relative to each row
+     * (e.g. "/id" or "/value/price"). The parser itself does not use them;
+     * they are kept here for the row consumer
+     */
+    jsonsl_jpr_t *row_jprs;
+    size_t nrow_jprs;
+
     /* buffer containing the skeleton */
     lcbex_vrow_buffer meta_buf;
 
-    /* scratch/read buffer */
+    /* data carried over from previous calls to feed */
     lcbex_vrow_buffer current_buf;
 
+    /**
+     * The data currently being fed (parsed in place), and the absolute
+     * position of its first byte
+     */
+    const char *chunk;
+    size_t nchunk;
+    size_t chunk_pos;
+
     /* last hash key */
     lcbex_vrow_buffer last_hk;
 
@@ -151,6 +166,16 @@ lcbex_vrow_create(void);
 void
 lcbex_vrow_reset(lcbex_vrow_ctx_t *ctx);
 
+/**
+ * Sets the fields to extract from each row, as JSON pointers relative to the
+ * row. Any previous projection is replaced. Passing 0 paths clears it.
+ * @return 0 on success, -1 if a path is not a valid JSON pointer
+ */
+int
+lcbex_vrow_set_projection(lcbex_vrow_ctx_t *ctx,
+                          const char * const *paths,
+                          size_t npaths);
+
 /**
  * Frees a vrow object created by vrow_create
  */
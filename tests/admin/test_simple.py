@@ -15,7 +15,9 @@
 # limitations under the License.
 #
 
+import json
 import sys
+import tempfile
 
 from couchbase.admin import Admin
 from couchbase.result import HttpResult
@@ -44,6 +46,51 @@ class AdminSimpleSet(CouchbaseTestCase):
         self.assertEqual(htres.url, 'pools/')
         self.assertTrue(htres.success)
 
+    def test_http_sink(self):
+        chunks = []
+        htres = self.admin.http_request('pools/', sink=chunks.append)
+        self.assertTrue(htres.success)
+        self.assertEqual(htres.value, None)
+        self.assertTrue(chunks)
+        body = json.loads(b''.join(chunks).decode('utf-8'))
+        self.assertIsInstance(body, dict)
+        self.assertTrue('pools' in body)
+
+        for use_fd in (False, True):
+            with tempfile.TemporaryFile() as fp:
+                sink = fp.fileno() if use_fd else fp
+                self.admin.http_request('pools/', sink=sink)
+                fp.seek(0)
+                self.assertIsInstance(json.loads(fp.read().decode('utf-8')),
+                                      dict)
+
+        # Errors are raised once the request completes
+        def bad_sink(chunk):
+            raise ZeroDivisionError()
+
+        self.assertRaises(ZeroDivisionError, self.admin.http_request,
+                          'pools/', sink=bad_sink)
+
+        self.assertRaises(ArgumentError, self.admin.http_request,
+                          'pools/', sink=object())
+
+    def test_http_sink_error(self):
+        # Error responses are not written to the sink
+        chunks = []
+        self.assertRaises(HTTPError, self.admin.http_request,
+                          '/badpath', sink=chunks.append)
+        self.assertEqual(chunks, [])
+
+        with tempfile.TemporaryFile() as fp:
+            try:
+                self.admin.http_request('/badpath', sink=fp.fileno())
+                self.fail("Expected HTTPError")
+            except HTTPError as e:
+                self.assertIsInstance(e.objextra, HttpResult)
+                self.assertTrue(e.objextra.http_status >= 400)
+            fp.seek(0)
+            self.assertEqual(fp.read(), b'')
+
     def test_bad_request(self):
         self.assertRaises(HTTPError,
                           self.admin.http_request,
@@ -18,8 +18,11 @@ try:
 except ImportError:
     # Python <3.0 fallback
     from ConfigParser import SafeConfigParser as ConfigParser
+import atexit
 import os
+import subprocess
 import sys
+import threading
 
 import unittest
 from nose.exc import SkipTest
@@ -31,18 +34,76 @@ from couchbase.admin import Admin
 
 CONFIG_FILE = os.path.join(os.path.dirname(__file__), 'tests.ini')
 
+_mock = None
+
+
+def use_mock(config):
+    if os.environ.get('PYCBC_TESTS_MOCK'):
+        return bool(int(os.environ['PYCBC_TESTS_MOCK']))
+    if config.has_option('mock', 'enabled'):
+        return config.getboolean('mock', 'enabled')
+    return False
+
+
+def get_mock():
+    """
+    Return the REST port of the mock server shared by all the tests,
+    starting it if necessary.
+
+    The mock runs in a child process. In this process its threads would
+    need the GIL while the client waits for a response, so connections
+    created with ``unlock_gil=False`` would deadlock.
+    """
+    global _mock
+    if not _mock:
+        proc = subprocess.Popen([sys.executable, '-m', 'couchbase.mockserver',
+                                 '--rest-port', '0',
+                                 '--bucket', 'default',
+                                 '--bucket', 'default_sasl:sasl_password'],
+                                stdout=subprocess.PIPE,
+                                universal_newlines=True,
+                                cwd=os.path.dirname(os.path.dirname(
+                                    os.path.abspath(__file__))))
+        line = proc.stdout.readline()
+        if not line:
+            raise RuntimeError("Couldn't start the mock server")
+
+        proc.stdout.readline()
+
+        # Keep reading whatever the mock writes later, so that it can never
+        # block on a full pipe
+        drain = threading.Thread(target=proc.stdout.read)
+        drain.daemon = True
+        drain.start()
+
+        atexit.register(proc.terminate)
+        _mock = (proc, int(line.split(':')[1]))
+    return _mock[1]
+
 
 class CouchbaseTestCase(unittest.TestCase):
     def setUp(self):
         config = ConfigParser()
         config.read(CONFIG_FILE)
 
-        self.host = config.get('node-1', 'host')
-        self.port = config.getint('node-1', 'port')
-        self.username = config.get('node-1', 'username')
-        self.password = config.get('node-1', 'password')
-        self.bucket_prefix = config.get('node-1', 'bucket_prefix')
-        self.bucket_password = config.get('node-1', 'bucket_password')
+        if use_mock(config):
+            self.host = '127.0.0.1'
+            self.port = get_mock()
+            self.username = 'Administrator'
+            self.password = 'password'
+            self.bucket_prefix = 'default'
+            self.bucket_password = 'sasl_password'
+            self.extra_buckets = True
+        else:
+            self.host = config.get('node-1', 'host')
+            self.port = config.getint('node-1', 'port')
+            self.username = config.get('node-1', 'username')
+            self.password = config.get('node-1', 'password')
+            self.bucket_prefix = config.get('node-1', 'bucket_prefix')
+            self.bucket_password = config.get('node-1', 'bucket_password')
+            self.extra_buckets = bool(int(config.get('node-1',
+                                                     'extra_buckets')))
+
         if not hasattr(self, 'assertIsInstance'):
             def tmp(self, a, *bases):
                 self.assertTrue(isinstance(a, bases))
@@ -55,7 +116,6 @@ class CouchbaseTestCase(unittest.TestCase):
         self.nosleep = os.environ.get('PYCBC_TESTS_NOSLEEP', False)
 
         self._key_counter = 0
-        self.extra_buckets = bool(int(config.get('node-1', 'extra_buckets')))
 
 
     def get_sasl_params(self):
@@ -0,0 +1,117 @@
+#
+# Copyright 2013, Couchbase, Inc.
+# All Rights Reserved
+#
+# Licensed under the Apache License, Version 2.0 (the "License")
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#
+
+import io
+import json
+import unittest
+
+from nose.exc import SkipTest
+
+from couchbase.connection import Connection
+from couchbase.exceptions import CouchbaseError
+from couchbase.mockserver import MockServer
+import couchbase._libcouchbase as _LCB
+
+
+class InflateTest(unittest.TestCase):
+    """
+    These tests run against their own mock server, which compresses its
+    REST and view responses
+    """
+    def setUp(self):
+        self.mock = MockServer()
+        self.mock.start()
+        self.mock.add_view('inflate', 'all',
+                           lambda doc, meta: [(meta['id'], doc)])
+        self.cb = Connection(**self.mock.connection_args())
+
+        # Large enough to be received in several chunks
+        self.kv = dict(('inflate_{0:03}'.format(ii),
+                        {'n': ii, 'pad': 'x' * ii}) for ii in range(200))
+        self.cb.set_multi(self.kv)
+        self.docids = sorted(self.kv.keys())
+
+    def tearDown(self):
+        del self.cb
+        self.mock.stop()
+
+    def check_encodings(self, fn):
+        for encoding in ('gzip', 'deflate'):
+            for row_latency in (0, 0.001):
+                self.mock.http_encoding = encoding
+                self.mock.view_row_latency = row_latency
+                try:
+                    fn()
+                finally:
+                    self.mock.http_encoding = None
+
+    def require_zlib(self):
+        if not _LCB._HAVE_ZLIB:
+            raise SkipTest("Built without zlib")
+
+    def test_not_chunked(self):
+        self.require_zlib()
+
+        def fn():
+            ddoc = self.cb.design_get('inflate', use_devmode=False).value
+            self.assertTrue('all' in ddoc['views'])
+
+            rows = list(self.cb.query('inflate', 'all', streaming=False))
+            self.assertEqual([r.docid for r in rows], self.docids)
+            self.assertEqual([r.value for r in rows],
+                             [self.kv[k] for k in self.docids])
+        self.check_encodings(fn)
+
+    def test_chunked(self):
+        self.require_zlib()
+
+        def fn():
+            view = self.cb.query('inflate', 'all', streaming=True,
+                                 page_rows=7)
+            rows = list(view)
+            self.assertEqual([r.docid for r in rows], self.docids)
+            self.assertEqual([r.value for r in rows],
+                             [self.kv[k] for k in self.docids])
+            self.assertEqual(view.indexed_rows, len(self.kv))
+        self.check_encodings(fn)
+
+    def test_sink(self):
+        self.require_zlib()
+
+        def fn():
+            buf = io.BytesIO()
+            view = self.cb.query('inflate', 'all')
+            self.assertEqual(view.export(buf, fields=['id']), len(self.kv))
+            rows = [json.loads(l)
+                    for l in buf.getvalue().decode('utf-8').splitlines()]
+            self.assertEqual(rows, [{'id': k} for k in self.docids])
+        self.check_encodings(fn)
+
+    def test_without_zlib(self):
+        if _LCB._HAVE_ZLIB:
+            raise SkipTest("Built with zlib")
+
+        def fn():
+            self.assertRaises(CouchbaseError, self.cb.design_get,
+                              'inflate', use_devmode=False)
+            self.assertRaises(CouchbaseError, list,
+                              self.cb.query('inflate', 'all', streaming=True))
+        self.check_encodings(fn)
+
+        # Uncompressed responses are unaffected
+        rows = list(self.cb.query('inflate', 'all', streaming=True))
+        self.assertEqual([r.docid for r in rows], self.docids)
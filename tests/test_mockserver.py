@@ -0,0 +1,109 @@
+#
+# Copyright 2013, Couchbase, Inc.
+# All Rights Reserved
+#
+# Licensed under the Apache License, Version 2.0 (the "License")
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#
+
+import unittest
+
+from couchbase.connection import Connection
+from couchbase.exceptions import (CouchbaseError, TemporaryFailError,
+                                  KeyExistsError, NotFoundError,
+                                  AuthError)
+from couchbase.mockserver import MockServer
+
+
+class MockServerTest(unittest.TestCase):
+    """
+    These tests run against their own mock server, regardless of tests.ini
+    """
+    def setUp(self):
+        self.mock = MockServer(buckets={'default': '',
+                                        'protected': 's3cret'})
+        self.mock.start()
+        self.cb = Connection(**self.mock.connection_args())
+
+    def tearDown(self):
+        del self.cb
+        self.mock.stop()
+
+    def test_kv(self):
+        rv = self.cb.set("foo", {"bar": 1})
+        self.assertTrue(rv.cas)
+        self.assertEqual(self.cb.get("foo").value, {"bar": 1})
+
+        self.assertRaises(KeyExistsError, self.cb.add, "foo", "baz")
+        self.assertRaises(KeyExistsError, self.cb.set, "foo", "baz",
+                          cas=rv.cas + 1)
+
+        self.cb.delete("foo")
+        self.assertRaises(NotFoundError, self.cb.get, "foo")
+
+        self.assertEqual(self.cb.incr("counter", initial=10).value, 10)
+        self.assertEqual(self.cb.incr("counter", amount=5).value, 15)
+
+    def test_lock(self):
+        self.cb.set("locked", "value")
+        rv = self.cb.lock("locked", ttl=5)
+        self.assertRaises(KeyExistsError, self.cb.set, "locked", "other")
+        self.assertRaises(TemporaryFailError, self.cb.lock, "locked", ttl=5)
+        self.cb.unlock("locked", rv.cas)
+        self.cb.set("locked", "other")
+
+    def test_sasl(self):
+        cb = Connection(**self.mock.connection_args('protected'))
+        cb.set("foo", "bar")
+        self.assertRaises(NotFoundError, self.cb.get, "foo")
+
+        args = self.mock.connection_args('protected')
+        args['password'] = 'wrong'
+        self.assertRaises(AuthError, Connection, **args)
+
+    def test_fail_next(self):
+        self.cb.set("foo", "bar")
+        self.mock.fail_next('get')
+        self.assertRaises(TemporaryFailError, self.cb.get, "foo")
+        self.assertEqual(self.cb.get("foo").value, "bar")
+
+    def test_stats(self):
+        self.cb.set("foo", "bar")
+        stats = self.cb.stats()
+        self.assertEqual(int(list(stats['curr_items'].values())[0]), 1)
+
+    def test_views(self):
+        def by_type(doc, meta):
+            if isinstance(doc, dict) and 'type' in doc:
+                yield [doc['type'], doc['n']], doc['n']
+
+        self.mock.add_view('things', 'by_type', by_type, '_sum')
+        for n in range(10):
+            self.cb.set("thing_{0}".format(n),
+                        {'type': 'even' if n % 2 == 0 else 'odd', 'n': n})
+
+        rows = list(self.cb.query('things', 'by_type', reduce=False,
+                                  startkey=['odd'], limit=3))
+        self.assertEqual([r.docid for r in rows],
+                         ['thing_1', 'thing_3', 'thing_5'])
+        self.assertEqual(rows[0].key, ['odd', 1])
+
+        rows = list(self.cb.query('things', 'by_type', group_level=1))
+        self.assertEqual([(r.key, r.value) for r in rows],
+                         [(['even'], 20), (['odd'], 25)])
+
+        self.mock.fail_next('view')
+        self.assertRaises(CouchbaseError, list,
+                          self.cb.query('things', 'by_type'))
+
+if __name__ == '__main__':
+    unittest.main()
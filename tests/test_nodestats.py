@@ -0,0 +1,87 @@
+#
+# Copyright 2013, Couchbase, Inc.
+# All Rights Reserved
+#
+# Licensed under the Apache License, Version 2.0 (the "License")
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#
+
+from threading import Thread
+
+from couchbase import LOCKMODE_WAIT
+from tests.base import ConnectionTestCase
+
+
+class ConnectionNodeStatsTest(ConnectionTestCase):
+
+    def test_keys_by_node(self):
+        kv = self.gen_kv_dict(amount=100, prefix="nodestats_group")
+        groups = self.cb.keys_by_node(kv.keys())
+
+        grouped = []
+        for server, keys in groups.items():
+            self.assertTrue(keys)
+            grouped.extend(keys)
+        self.assertEqual(sorted(grouped), sorted(kv.keys()))
+
+        # The result is stable for the same map
+        self.assertEqual(groups, self.cb.keys_by_node(kv.keys()))
+        self.assertEqual(self.cb.keys_by_node([]), {})
+
+    def test_counters(self):
+        kv = self.gen_kv_dict(amount=20, prefix="nodestats_counters")
+
+        self.cb.set_multi(kv)
+        self.assertEqual(self.cb.node_stats(), {})
+
+        self.cb.track_node_stats = True
+        self.cb.set_multi(kv)
+        self.cb.get_multi(kv.keys())
+        missing = self.gen_key("nodestats_missing")
+        self.cb.delete(missing, quiet=True)
+
+        stats = self.cb.node_stats(reset=True)
+        groups = self.cb.keys_by_node(kv.keys())
+        self.assertTrue(set(groups).issubset(set(stats)))
+
+        self.assertEqual(sum(s['ops'] for s in stats.values()),
+                         len(kv) * 2 + 1)
+        self.assertEqual(sum(s['errors'] for s in stats.values()), 1)
+
+        # The same values were stored and then read back
+        bytes_in = sum(s['bytes_in'] for s in stats.values())
+        self.assertTrue(bytes_in > 0)
+        self.assertEqual(bytes_in, sum(s['bytes_out'] for s in stats.values()))
+
+        self.assertEqual(self.cb.node_stats(), {})
+        self.cb.track_node_stats = False
+
+    def test_counters_threaded(self):
+        # Counters are read while another thread waits without the GIL
+        cb = self.make_connection(lockmode=LOCKMODE_WAIT, unlock_gil=True)
+        kv = self.gen_kv_dict(amount=50, prefix="nodestats_threaded")
+        cb.set_multi(kv)
+        cb.track_node_stats = True
+
+        def run():
+            for _ in range(20):
+                cb.get_multi(kv.keys())
+
+        thr = Thread(target=run)
+        thr.start()
+        nops = 0
+        while thr.is_alive():
+            nops += sum(s['ops'] for s in cb.node_stats(reset=True).values())
+        thr.join()
+        nops += sum(s['ops'] for s in cb.node_stats().values())
+        # A reset may race with an increment, but nothing is over-counted
+        self.assertTrue(0 < nops <= 20 * len(kv))
@@ -0,0 +1,155 @@
+#
+# Copyright 2013, Couchbase, Inc.
+# All Rights Reserved
+#
+# Licensed under the Apache License, Version 2.0 (the "License")
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#
+
+import gc
+import weakref
+
+from couchbase.connection import Connection
+from couchbase.exceptions import ArgumentError, TimeoutError
+from couchbase.mockserver import MockServer
+from couchbase._libcouchbase import LCB_ETIMEDOUT
+
+from tests.base import ConnectionTestCase
+
+
+class ConnectionOpTimeoutTest(ConnectionTestCase):
+
+    def test_bad_timeout(self):
+        key = self.gen_key("optimeout_bad")
+        self.assertRaises(ArgumentError, self.cb.get, key, timeout=-1)
+        self.assertRaises(ArgumentError, self.cb.get, key, timeout=0)
+        self.assertRaises(ArgumentError, self.cb.get, key, timeout="1")
+        self.assertRaises(ArgumentError, self.cb.set, key, "v", timeout=-1)
+
+    def test_generous_timeout(self):
+        kv = self.gen_kv_dict(prefix="optimeout_generous")
+        rvs = self.cb.set_multi(kv, timeout=10)
+        self.assertTrue(rvs.all_ok)
+
+        rvs = self.cb.get_multi(kv.keys(), timeout=10)
+        self.assertTrue(rvs.all_ok)
+        for k, v in kv.items():
+            self.assertEqual(rvs[k].value, v)
+
+        key = list(kv.keys())[0]
+        self.assertEqual(self.cb.get(key, timeout=10).value, kv[key])
+
+    def make_slow_connection(self, mock):
+        # The deadlines below are well within the mock's latency, so the
+        # operations always time out
+        cb = Connection(**mock.connection_args())
+        mock.latency = 0.5
+        return cb
+
+    def test_partial_results(self):
+        kv = self.gen_kv_dict(amount=100, prefix="optimeout_partial")
+
+        with MockServer() as mock:
+            cb = self.make_slow_connection(mock)
+            cb.set_multi(kv)
+
+            # The global timeout is unaffected
+            orig_timeout = cb.timeout
+
+            rvs = cb.get_multi(kv.keys(), timeout=0.05)
+            self.assertEqual(len(rvs), len(kv))
+            self.assertFalse(rvs.all_ok)
+            for k, res in rvs.items():
+                self.assertFalse(res.success)
+                self.assertEqual(res.rc, LCB_ETIMEDOUT)
+
+            self.assertEqual(cb.timeout, orig_timeout)
+
+            # Late replies must not interfere with subsequent operations
+            rvs = cb.get_multi(kv.keys())
+            self.assertTrue(rvs.all_ok)
+            for k, v in kv.items():
+                self.assertEqual(rvs[k].value, v)
+
+    def test_single_timeout(self):
+        key = self.gen_key("optimeout_single")
+
+        with MockServer() as mock:
+            cb = self.make_slow_connection(mock)
+            cb.set(key, "value")
+
+            try:
+                cb.get(key, timeout=0.05)
+                self.fail("Operation did not time out")
+            except TimeoutError as e:
+                self.assertEqual(e.rc, LCB_ETIMEDOUT)
+                self.assertEqual(e.key, key)
+
+            self.assertEqual(cb.get(key).value, "value")
+
+    def test_abandoned_released(self):
+        kv = self.gen_kv_dict(prefix="optimeout_released")
+
+        with MockServer() as mock:
+            cb = self.make_slow_connection(mock)
+            rvs = cb.set_multi(kv, timeout=0.05)
+            self.assertFalse(rvs.all_ok)
+
+            # The results outlive the connection's reference to them
+            conn = weakref.ref(cb)
+            del cb
+            gc.collect()
+            self.assertTrue(conn() is not None)
+            self.assertEqual(len(rvs), len(kv))
+
+            # The connection and its pending operations are collected once
+            # the results are dropped
+            del rvs
+            gc.collect()
+            self.assertTrue(conn() is None)
+
+    def test_timeout_during_view(self):
+        kv = self.gen_kv_dict(amount=30, prefix="optimeout_view")
+        key = list(kv.keys())[0]
+
+        with MockServer(view_row_latency=0.01) as mock:
+            mock.add_view('optimeout', 'all',
+                          lambda doc, meta: [(meta['id'], None)])
+            cb = Connection(**mock.connection_args())
+            cb.set_multi(kv)
+
+            view = cb.query('optimeout', 'all', pipeline_docs=True,
+                            page_rows=5)
+            rows = []
+            for row in view:
+                rows.append(row)
+                if len(rows) != 5:
+                    continue
+
+                # Rows, and the gets for their documents, keep arriving
+                # while this runs. Only the get itself is abandoned
+                mock.latency = 0.1
+                self.assertRaises(TimeoutError, cb.get, key, timeout=0.05)
+                mock.latency = 0
+
+            self.assertEqual(len(rows), len(kv))
+            for row in rows:
+                self.assertTrue(row.doc.success)
+                self.assertEqual(row.doc.value, kv[row.docid])
+
+            # Once its late response has arrived, the get is released from
+            # the connection's list of orphans (which it visits for the GC).
+            # The list is swept at the start of each operation
+            self.assertEqual(cb.get(key).value, kv[key])
+            cb.get(key)
+            orphans = [o for o in gc.get_referents(cb) if isinstance(o, list)]
+            self.assertFalse(any(orphans))
@@ -0,0 +1,91 @@
+#
+# Copyright 2013, Couchbase, Inc.
+# All Rights Reserved
+#
+# Licensed under the Apache License, Version 2.0 (the "License")
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#
+
+import warnings
+
+from couchbase.exceptions import ArgumentError, NotFoundError
+
+from tests.base import ConnectionTestCase
+
+
+class ConnectionReplicaTest(ConnectionTestCase):
+
+    def test_bad_args(self):
+        key = self.gen_key("replica_bad")
+        self.assertRaises(ArgumentError, self.cb.get, key, hedge=-1)
+        self.assertRaises(ArgumentError, self.cb.get, key, ttl=10,
+                          replica_fallback=True)
+        self.assertRaises(ArgumentError, self.cb.get, key, ttl=10,
+                          hedge=0.1)
+
+    def test_fallback(self):
+        key = self.gen_key("replica_fallback")
+        self.cb.set(key, "value")
+        rv = self.cb.get(key, replica_fallback=True)
+        self.assertEqual(rv.value, "value")
+
+        self.cb.delete(key)
+        self.assertRaises(NotFoundError, self.cb.get, key,
+                          replica_fallback=True)
+        rv = self.cb.get(key, replica_fallback=True, quiet=True)
+        self.assertFalse(rv.success)
+
+    def test_hedge_single(self):
+        key = self.gen_key("replica_hedge")
+        self.cb.set(key, "value")
+
+        # Hedge immediately, so both reads are always in flight
+        for _ in range(10):
+            rv = self.cb.get(key, hedge=0.000001)
+            self.assertEqual(rv.value, "value")
+
+    def test_hedge_multi(self):
+        kv = self.gen_kv_dict(amount=100, prefix="replica_hedge_multi")
+        self.cb.set_multi(kv)
+
+        rvs = self.cb.get_multi(kv.keys(), hedge=0.000001,
+                                replica_fallback=True)
+        self.assertTrue(rvs.all_ok)
+        self.assertEqual(len(rvs), len(kv))
+        for k, v in kv.items():
+            self.assertEqual(rvs[k].value, v)
+
+        # Discarded replies must not leak into subsequent operations
+        rvs = self.cb.get_multi(kv.keys())
+        self.assertTrue(rvs.all_ok)
+        self.assertEqual(len(rvs), len(kv))
+
+    def test_duplicate_keys(self):
+        key = self.gen_key("replica_dup")
+        self.cb.set(key, "value")
+
+        # More repeats than fit in a byte, all settling on one result
+        keys = [key] * 300
+        with warnings.catch_warnings():
+            warnings.simplefilter("ignore")
+            rvs = self.cb.get_multi(keys, hedge=0.000001,
+                                    replica_fallback=True)
+            self.assertTrue(rvs.all_ok)
+            self.assertEqual(rvs[key].value, "value")
+
+            self.cb.delete(key)
+            rvs = self.cb.get_multi(keys, hedge=0.000001,
+                                    replica_fallback=True, quiet=True)
+            self.assertFalse(rvs[key].success)
+
+        rv = self.cb.get(key, quiet=True)
+        self.assertFalse(rv.success)
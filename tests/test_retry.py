@@ -0,0 +1,145 @@
+#
+# Copyright 2013, Couchbase, Inc.
+# All Rights Reserved
+#
+# Licensed under the Apache License, Version 2.0 (the "License")
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#
+
+import time
+
+from couchbase.connection import Connection
+from couchbase.exceptions import (
+    ArgumentError, TemporaryFailError, NotFoundError)
+from couchbase.mockserver import MockServer
+from couchbase._libcouchbase import LCB_ETMPFAIL, LCB_EBUSY, LCB_KEY_ENOENT
+
+from tests.base import ConnectionTestCase
+
+
+class ConnectionRetryTest(ConnectionTestCase):
+
+    def test_default_policy(self):
+        policy = self.cb.retry_policy
+        self.assertEqual(policy['max_attempts'], 1)
+        self.assertEqual(set(policy['errors']),
+                         set([LCB_ETMPFAIL, LCB_EBUSY]))
+
+    def test_set_policy(self):
+        self.cb.set_retry_policy(max_attempts=5,
+                                 backoff=0.01,
+                                 factor=3,
+                                 max_backoff=0.1,
+                                 errors=[TemporaryFailError, LCB_KEY_ENOENT])
+
+        policy = self.cb.retry_policy
+        self.assertEqual(policy['max_attempts'], 5)
+        self.assertAlmostEqual(policy['backoff'], 0.01)
+        self.assertAlmostEqual(policy['factor'], 3)
+        self.assertAlmostEqual(policy['max_backoff'], 0.1)
+        self.assertEqual(policy['errors'], (LCB_ETMPFAIL, LCB_KEY_ENOENT))
+
+    def test_bad_policy(self):
+        self.assertRaises(ArgumentError, self.cb.set_retry_policy,
+                          max_attempts=0)
+        self.assertRaises(ArgumentError, self.cb.set_retry_policy,
+                          backoff=1, max_backoff=0.5)
+        self.assertRaises(ArgumentError, self.cb.set_retry_policy,
+                          factor=0.5)
+        self.assertRaises(ArgumentError, self.cb.set_retry_policy,
+                          errors=[ValueError])
+
+    def test_retry_locked(self):
+        self.slowTest()
+        key = self.gen_key("retry_locked")
+        self.cb.set(key, "value")
+        self.cb.lock(key, ttl=1)
+
+        # Without a policy, a second lock fails immediately
+        self.assertRaises(TemporaryFailError, self.cb.lock, key, ttl=1)
+
+        # The lock expires after a second; keep retrying until then
+        self.cb.set_retry_policy(max_attempts=100,
+                                 backoff=0.05,
+                                 max_backoff=0.1)
+        rv = self.cb.lock(key, ttl=1)
+        self.assertTrue(rv.success)
+        self.assertEqual(rv.value, "value")
+
+    def test_retry_only_failed(self):
+        self.slowTest()
+        kv = self.gen_kv_dict(prefix="retry_multi")
+        self.cb.set_multi(kv)
+
+        locked = list(kv.keys())[0]
+        self.cb.lock(locked, ttl=1)
+
+        self.cb.set_retry_policy(max_attempts=100,
+                                 backoff=0.05,
+                                 max_backoff=0.1)
+        rvs = self.cb.lock_multi(kv.keys(), ttl=5)
+        self.assertTrue(rvs.all_ok)
+        self.assertEqual(len(rvs), len(kv))
+        for k, v in rvs.items():
+            self.assertEqual(v.value, kv[k])
+
+        self.cb.unlock_multi(rvs)
+
+    def test_retry_exhausted(self):
+        key = self.gen_key("retry_exhausted")
+        self.cb.delete(key, quiet=True)
+        self.cb.set_retry_policy(max_attempts=3,
+                                 backoff=0.001,
+                                 errors=[NotFoundError])
+        self.assertRaises(NotFoundError, self.cb.get, key)
+
+    def test_retry_backoff_per_key(self):
+        kv = self.gen_kv_dict(amount=2, prefix="retry_per_key")
+        once, thrice = sorted(kv.keys())
+
+        with MockServer() as mock:
+            cb = Connection(**mock.connection_args())
+            cb.set_multi(kv)
+            cb.set_retry_policy(max_attempts=4,
+                                backoff=0.05,
+                                factor=2,
+                                max_backoff=1)
+
+            mock.fail_next(op='get', key=once, count=1)
+            mock.fail_next(op='get', key=thrice, count=3)
+
+            begin = time.time()
+            rvs = cb.get_multi(kv.keys())
+            elapsed = time.time() - begin
+
+            self.assertTrue(rvs.all_ok)
+            for k, v in kv.items():
+                self.assertEqual(rvs[k].value, v)
+
+            # Each retry of the second key waits for its own backoff
+            self.assertTrue(elapsed >= 0.05 + 0.1 + 0.2)
+
+            # The second key runs out of attempts; the first one does not
+            cb.set_retry_policy(max_attempts=3, backoff=0.01)
+            mock.fail_next(op='get', key=once, count=1)
+            mock.fail_next(op='get', key=thrice, count=3)
+
+            try:
+                cb.get_multi(kv.keys())
+                self.fail("Retries were not exhausted")
+            except TemporaryFailError as e:
+                rvs = e.all_results
+
+            self.assertTrue(rvs[once].success)
+            self.assertEqual(rvs[once].value, kv[once])
+            self.assertFalse(rvs[thrice].success)
+            self.assertEqual(rvs[thrice].rc, LCB_ETMPFAIL)
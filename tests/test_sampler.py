@@ -0,0 +1,89 @@
+#
+# Copyright 2013, Couchbase, Inc.
+# All Rights Reserved
+#
+# Licensed under the Apache License, Version 2.0 (the "License")
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#
+import time
+
+from couchbase.exceptions import ArgumentError
+from couchbase.sampler import StatsSampler
+
+from tests.base import ConnectionTestCase
+
+
+class StatsSamplerTest(ConnectionTestCase):
+
+    def test_bad_args(self):
+        self.assertRaises(ArgumentError, StatsSampler, self.cb, [])
+        self.assertRaises(ArgumentError, StatsSampler, self.cb,
+                          ['curr_items'], size=1)
+        self.assertRaises(ArgumentError, StatsSampler, None, ['curr_items'])
+
+    def test_sample(self):
+        sampler = StatsSampler(self.cb, ['curr_items', 'cmd_get', 'version'],
+                               size=3)
+        self.assertEqual(sampler.count, 0)
+        self.assertEqual(sampler.latest(), {})
+        self.assertEqual(sampler.rates(), {})
+
+        # The nodes are known before the first sample
+        self.assertEqual(set(sampler.nodes), set(self.cb.server_nodes))
+
+        sampler.sample()
+        self.assertEqual(sampler.count, 1)
+
+        latest = sampler.latest()
+        stats = self.cb.stats()
+        # Non-numeric values are ignored
+        self.assertFalse('version' in latest)
+        self.assertEqual(set(latest['curr_items'].keys()),
+                         set(stats['curr_items'].keys()))
+
+        for _ in range(4):
+            self.cb.get(self.gen_key("sampler"), quiet=True)
+            time.sleep(0.01)
+            sampler.sample()
+
+        # Only 'size' samples are retained
+        self.assertEqual(sampler.count, 3)
+        history = sampler.history('cmd_get')
+        self.assertEqual(len(history), 3)
+        timestamps = [ts for ts, _ in history]
+        self.assertEqual(timestamps, sorted(timestamps))
+
+        rates = sampler.rates()
+        self.assertTrue(sum(rates['cmd_get'].values()) > 0)
+
+        self.assertRaises(ArgumentError, sampler.history, 'bad_stat')
+
+        sampler.clear()
+        self.assertEqual(sampler.count, 0)
+        self.assertEqual(sampler.history('cmd_get'), [])
+
+    def test_background(self):
+        sampler = StatsSampler(self.make_connection(), ['curr_items'])
+        errors = []
+        sampler.start(interval=0.05, on_error=errors.append)
+
+        # Samples may be read while the thread is collecting them
+        deadline = time.time() + 0.3
+        while time.time() < deadline:
+            sampler.latest()
+            sampler.rates()
+            sampler.history('curr_items')
+
+        sampler.stop()
+
+        self.assertFalse(errors)
+        self.assertTrue(sampler.count >= 2)
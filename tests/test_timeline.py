@@ -0,0 +1,147 @@
+#
+# Copyright 2013, Couchbase, Inc.
+# All Rights Reserved
+#
+# Licensed under the Apache License, Version 2.0 (the "License")
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#
+
+import json
+import threading
+
+from couchbase import timeline
+from couchbase.exceptions import ArgumentError, CouchbaseError
+from tests.base import ConnectionTestCase
+
+
+class TimelineTest(ConnectionTestCase):
+
+    def setUp(self):
+        super(TimelineTest, self).setUp()
+        timeline.events(clear=True)
+
+    def tearDown(self):
+        timeline.disable()
+        timeline.events(clear=True)
+        super(TimelineTest, self).tearDown()
+
+    def spans(self, thread=None):
+        spans = timeline.events(clear=True)
+        if thread is not None:
+            spans = [s for s in spans if s[0] == thread]
+        return set((s[1], s[2]) for s in spans)
+
+    def test_kv(self):
+        key = self.gen_key("timeline")
+
+        self.cb.set(key, {"value": 1})
+        self.assertEqual(self.spans(), set())
+
+        timeline.enable()
+        self.cb.set(key, {"value": 1})
+        self.cb.get(key)
+        self.cb.incr(key + "_ctr", initial=1)
+
+        spans = self.spans()
+        for expected in (('operation', 'store'), ('operation', 'get'),
+                         ('operation', 'arithmetic'), ('schedule', 'store'),
+                         ('wait', 'lcb_wait'), ('gil', 'acquire'),
+                         ('callback', 'store_callback'),
+                         ('callback', 'get_callback'),
+                         ('encode', 'key'), ('encode', 'value'),
+                         ('decode', 'key'), ('decode', 'value')):
+            self.assertTrue(expected in spans, expected)
+
+        timeline.disable()
+        self.cb.get(key)
+        self.assertEqual(self.spans(), set())
+
+    def test_http(self):
+        timeline.enable()
+        self.assertRaises(CouchbaseError, self.cb.design_get,
+                          "timeline_nonexistent")
+
+        spans = self.spans()
+        self.assertTrue(('operation', 'http') in spans)
+        self.assertTrue(('schedule', 'http') in spans)
+        self.assertTrue(('callback', 'http_complete_callback') in spans)
+
+    def test_threads(self):
+        key = self.gen_key("timeline_threads")
+        self.cb.set(key, "value")
+        cb = self.make_connection()
+
+        timeline.enable()
+        t = threading.Thread(target=cb.get, args=(key,))
+        t.start()
+        t.join()
+
+        self.assertTrue(('operation', 'get') in self.spans(t.ident))
+
+    def test_capacity(self):
+        timeline.enable(capacity=5)
+        cb = self.make_connection()
+
+        # Only a new thread gets a buffer of the new size
+        def run():
+            for _ in range(10):
+                cb.get(self.gen_key("timeline_capacity"), quiet=True)
+
+        t = threading.Thread(target=run)
+        t.start()
+        t.join()
+
+        spans = [s for s in timeline.events() if s[0] == t.ident]
+        self.assertEqual(len(spans), 5)
+        self.assertEqual(spans, sorted(spans, key=lambda s: s[4]))
+
+        self.assertRaises(ArgumentError, timeline.enable, capacity=0)
+
+    def test_thread_exit(self):
+        key = self.gen_key("timeline_exit")
+        self.cb.set(key, "value")
+        cb = self.make_connection()
+
+        # Each thread reuses the buffer of the one before it, but the
+        # spans of the exited threads are still reported
+        timeline.enable()
+        for _ in range(3):
+            t = threading.Thread(target=cb.get, args=(key,))
+            t.start()
+            t.join()
+
+        spans = [s for s in timeline.events()
+                 if s[1:3] == ('operation', 'get')]
+        self.assertEqual(len(spans), 3)
+
+    def test_dump(self):
+        timeline.enable()
+        self.cb.set(self.gen_key("timeline_dump"), "value")
+
+        trace = timeline.chrome_trace()
+        json.loads(json.dumps(trace))
+
+        events = trace['traceEvents']
+        names = [e for e in events if e['ph'] == 'M']
+        self.assertTrue(names)
+        self.assertEqual(names[0]['name'], 'thread_name')
+
+        spans = [e for e in events if e['ph'] == 'X']
+        self.assertTrue(spans)
+        for e in spans:
+            self.assertTrue(e['dur'] >= 0)
+            self.assertTrue(e['cat'] in ('operation', 'schedule', 'wait',
+                                         'callback', 'gil', 'encode',
+                                         'decode'))
+
+        # The dump cleared the recorded spans
+        self.assertEqual(timeline.events(), [])
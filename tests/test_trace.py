@@ -0,0 +1,125 @@
+#
+# Copyright 2013, Couchbase, Inc.
+# All Rights Reserved
+#
+# Licensed under the Apache License, Version 2.0 (the "License")
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#
+
+import os
+import tempfile
+
+from couchbase import FMT_BYTES
+from couchbase.exceptions import ArgumentError, NotFoundError
+from couchbase.trace import (TraceFile, TraceFormatError, replay, summarize,
+                             hashed_key)
+from tests.base import ConnectionTestCase
+
+
+class ConnectionTraceTest(ConnectionTestCase):
+
+    def setUp(self):
+        super(ConnectionTraceTest, self).setUp()
+        fd, self.path = tempfile.mkstemp(suffix='.trace')
+        os.close(fd)
+
+    def tearDown(self):
+        self.cb.stop_trace()
+        os.unlink(self.path)
+        super(ConnectionTraceTest, self).tearDown()
+
+    def record(self, hash_keys=False):
+        kv = self.gen_kv_dict(amount=3, prefix="trace")
+        kv = dict((k, b'x' * (n + 1)) for n, k in enumerate(kv.keys()))
+        key = sorted(kv.keys())[0]
+
+        self.cb.start_trace(self.path, hash_keys=hash_keys)
+        self.cb.set_multi(kv, ttl=100, format=FMT_BYTES)
+        self.cb.get(key)
+        self.cb.incr(key + "_ctr", amount=-3, initial=5)
+        rv = self.cb.lock(key, ttl=5)
+        self.cb.unlock(key, rv.cas)
+        self.cb.delete_multi(kv.keys())
+        self.assertRaises(NotFoundError, self.cb.get, key)
+        self.cb.stats()
+
+        rv = self.cb.stop_trace()
+        self.assertEqual(rv, {'batches': 7, 'commands': 11})
+        return kv, key
+
+    def test_record(self):
+        kv, key = self.record()
+
+        with TraceFile(self.path) as trace:
+            self.assertFalse(trace.hashed_keys)
+            batches = list(trace)
+
+        self.assertEqual([b.name for b in batches],
+                         ['set', 'get', 'arithmetic', 'lock', 'unlock',
+                          'delete', 'get'])
+        self.assertEqual([b.failed for b in batches],
+                         [False] * 6 + [True])
+
+        starts = [b.start for b in batches]
+        self.assertEqual(starts, sorted(starts))
+
+        stored = dict((c.key.decode('utf-8'), (c.size, c.ttl))
+                      for c in batches[0].commands)
+        self.assertEqual(stored,
+                         dict((k, (len(v), 100)) for k, v in kv.items()))
+
+        cmd = batches[2].commands[0]
+        self.assertEqual(cmd.key.decode('utf-8'), key + "_ctr")
+        self.assertEqual((cmd.delta, cmd.create), (-3, True))
+        self.assertEqual(batches[3].commands[0].ttl, 5)
+
+    def test_hash_keys(self):
+        kv, key = self.record(hash_keys=True)
+
+        with TraceFile(self.path) as trace:
+            self.assertTrue(trace.hashed_keys)
+            batches = list(trace)
+
+        # Keys keep their length, and the same key gets the same name
+        get_key = batches[1].commands[0].key
+        self.assertEqual(len(get_key), len(key))
+        self.assertNotEqual(get_key.decode('ascii'), key)
+        self.assertEqual(batches[3].commands[0].key, get_key)
+        self.assertEqual(len(hashed_key(0xabc, 40)), 40)
+
+    def test_replay(self):
+        self.record()
+
+        info = summarize(self.path)
+        self.assertEqual(info['batches'], 7)
+        self.assertEqual(info['errors'], 1)
+
+        rv = replay(self.cb, self.path, speed=0)
+        self.assertEqual(rv['batches'], 7)
+        self.assertEqual(rv['commands'], 11)
+        self.assertEqual(rv['skipped'], 0)
+        self.assertEqual(rv['ops']['get']['errors'], 1)
+        self.assertEqual(rv['errors'], 1)
+        self.assertTrue(rv['latency_us']['p50'] > 0)
+
+    def test_errors(self):
+        self.cb.start_trace(self.path)
+        self.assertRaises(ArgumentError, self.cb.start_trace, self.path)
+        self.cb.stop_trace()
+        self.assertEqual(self.cb.stop_trace(), None)
+
+        self.assertRaises(IOError, self.cb.start_trace,
+                          os.path.join(self.path, "nonexistent"))
+
+        with open(self.path, 'wb') as fp:
+            fp.write(b'not a trace file at all!')
+        self.assertRaises(TraceFormatError, TraceFile, self.path)
@@ -14,10 +14,13 @@
 # See the License for the specific language governing permissions and
 # limitations under the License.
 #
+import unittest
+
 from tests.base import ConnectionTestCase
 
 from couchbase.transcoder import Transcoder
-from couchbase import Couchbase
+from couchbase import Couchbase, FMT_JSON, FMT_BYTES, FMT_UTF8, FMT_PICKLE
+import couchbase._libcouchbase as _LCB
 from couchbase.connection import Connection
 import couchbase.exceptions as E
 
@@ -178,3 +181,55 @@ class ConnectionTranscoderTest(ConnectionTestCase):
 
         c = Couchbase.connect(**self.make_connargs(transcoder=Transcoder))
         c.set(key, "value")
+
+    def test_transcoder_cycle(self):
+        import gc, weakref
+
+        # A transcoder referring back to its connection is collected
+        cb = self.make_connection()
+        tc = MangledTranscoder()
+        tc.conn = cb
+        cb.transcoder = tc
+        cb.set("key_tc_cycle", "value")
+
+        ref = weakref.ref(cb)
+        del cb, tc
+        gc.collect()
+        self.assertTrue(ref() is None)
+
+
+@unittest.skipUnless(hasattr(_LCB, '_convbench'),
+                     "Built without PYCBC_CONVBENCH=1")
+class ConversionBenchTest(unittest.TestCase):
+    """
+    Checks the conversion microbenchmark (used by examples/convbench.py),
+    which needs no connection
+    """
+    def test_value_ops(self):
+        values = (({'a': [1, 2]}, FMT_JSON), (b'bytes', FMT_BYTES),
+                  (u'\u00e9t\u00e9', FMT_UTF8), (set([1]), FMT_PICKLE))
+
+        for tc in (None, Transcoder()):
+            for op in ('encode', 'decode', 'encode_value', 'decode_value'):
+                for value, fmt in values:
+                    rv = _LCB._convbench(op, value, fmt, iterations=10,
+                                         transcoder=tc)
+                    self.assertEqual(rv['iterations'], 10)
+                    self.assertTrue(rv['ns_per_op'] > 0)
+                    self.assertTrue(rv['encoded_size'] > 0)
+
+    def test_key_ops(self):
+        for tc in (None, Transcoder()):
+            for op in ('encode_key', 'decode_key'):
+                rv = _LCB._convbench(op, u"key", iterations=10,
+                                     transcoder=tc)
+                self.assertEqual(rv['encoded_size'], 3)
+
+    def test_errors(self):
+        self.assertRaises(E.ArgumentError, _LCB._convbench, "bogus", "value")
+        self.assertRaises(E.ArgumentError, _LCB._convbench, "encode",
+                          "value", FMT_UTF8, iterations=0)
+        self.assertRaises(E.ValueFormatError, _LCB._convbench, "encode",
+                          object(), FMT_JSON)
+        self.assertRaises(E.ValueFormatError, _LCB._convbench, "decode",
+                          u"text", FMT_BYTES)
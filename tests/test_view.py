@@ -117,6 +117,31 @@ class ConnectionViewTest(ConnectionTestCase):
             self.assertTrue(row['id'] in DOCS_JSON)
             self.assertTrue(row['key'] in jkey_pure)
 
+    def test_view_multi(self):
+        results = self.cb._view_multi([
+            ("blog", "recent_posts", {'limit': 1}),
+            ("blog", "recent_posts", 'limit=2'),
+            ("blog", "recent_posts", None)
+        ])
+        self.assertEqual(len(results), 3)
+        for ret in results:
+            self.assertTrue(ret.success)
+
+        self.assertEqual(len(results[0].value['rows']), 1)
+        self.assertEqual(len(results[1].value['rows']), 2)
+        self.assertEqual(results[2].value['total_rows'],
+                         len(results[2].value['rows']))
+
+        queries = [("blog", "recent_posts", None),
+                   ("blog", "nonexist", None)]
+        self.assertRaises(HTTPError, self.cb._view_multi, queries)
+
+        results = self.cb._view_multi(queries, quiet=True)
+        self.assertTrue(results[0].success)
+        self.assertFalse(results[1].success)
+
+        self.assertEqual(self.cb._view_multi([]), [])
+
     def test_missing_view(self):
         self.assertRaises(HTTPError,
                           self.cb._view,
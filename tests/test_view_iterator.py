@@ -14,11 +14,18 @@
 # See the License for the specific language governing permissions and
 # limitations under the License.
 #
+import time
+import unittest
+
 from nose.exc import SkipTest
 
 from tests.base import ConnectionTestCase
+from couchbase.connection import Connection
+from couchbase.mockserver import MockServer
 from couchbase.views.iterator import (
     View, ViewRow, RowProcessor, AlreadyQueriedError)
+from couchbase.views.parallel import ParallelView
+from couchbase.views.paginator import Paginator
 
 from couchbase.views.params import Query, UNSPEC
 from couchbase.exceptions import CouchbaseError
@@ -194,6 +201,28 @@ class ViewIteratorTest(ConnectionTestCase):
                           reduce=True,
                           include_docs=True)
 
+    def test_pipeline_docs(self):
+        ret = self.cb.query("beer", "brewery_beers", limit=30,
+                            pipeline_docs=True)
+        self.assertTrue(ret.include_docs)
+        self.assertTrue(ret.streaming)
+
+        rows = list(ret)
+        self.assertEqual(len(rows), 30)
+        for r in rows:
+            self.assertIsInstance(r.doc, Result)
+            self.assertTrue(r.doc.success)
+            self.assertEqual(r.doc.key, r.docid)
+            mc_doc = self.cb.get(r.docid)
+            self.assertEqual(r.doc.cas, mc_doc.cas)
+            self.assertEqual(r.doc.value, mc_doc.value)
+
+        self.assertRaises(ArgumentError,
+                          self.cb.query,
+                          "beer", "by_location",
+                          reduce=True,
+                          pipeline_docs=True)
+
     def test_bad_view(self):
         ret = self.cb.query("beer", "bad_view")
         self.assertIsInstance(ret, View)
@@ -204,6 +233,10 @@ class ViewIteratorTest(ConnectionTestCase):
         ret = self.cb.query("beer", "brewery_beers", streaming=True, limit=100)
         rows = list(ret)
         self.assertEqual(len(rows), 100)
+        for r in rows:
+            self.assertIsInstance(r, ViewRow)
+            self.assertIsInstance(r.key, list)
+            self.assertTrue(r.docid)
 
         # Get all the views
         ret = self.cb.query("beer", "brewery_beers", streaming=True)
@@ -215,6 +248,253 @@ class ViewIteratorTest(ConnectionTestCase):
         self.assertIsInstance(ret.raw.value, dict)
         self.assertTrue('total_rows' in ret.raw.value)
 
+    def test_fields(self):
+        import io, json
+
+        ret = self.cb.query("beer", "brewery_beers", fields=["id"], limit=20)
+        self.assertTrue(ret.streaming)
+        self.assertEqual(ret.fields, ("/id",))
+
+        rows = list(ret)
+        self.assertEqual(len(rows), 20)
+        for r in rows:
+            self.assertTrue(r.docid)
+            self.assertEqual(r.key, None)
+            self.assertEqual(r.value, None)
+
+        full = list(self.cb.query("beer", "brewery_beers", limit=20))
+        self.assertEqual([r.docid for r in rows], [r.docid for r in full])
+
+        # Nested paths keep the row's structure
+        ret = self.cb.query("beer", "brewery_beers",
+                            fields=["key/0", "/id"], limit=5)
+        for r in ret:
+            self.assertEqual(len(r.key), 1)
+            self.assertTrue(r.docid)
+
+        # List elements keep their position. Brewery rows have no second
+        # key element, so nothing is extracted for them
+        full = list(self.cb.query("beer", "brewery_beers", limit=20))
+        rows = list(self.cb.query("beer", "brewery_beers", fields=["key/1"],
+                                  limit=20))
+        self.assertTrue(any(len(r.key) == 2 for r in full))
+        self.assertEqual([r.key for r in rows],
+                         [[None, r.key[1]] if len(r.key) == 2 else None
+                          for r in full])
+
+        buf = io.BytesIO()
+        ret = self.cb.query("beer", "brewery_beers", limit=20)
+        ret.export(buf, fields=["key/1"])
+        keys = [json.loads(l).get('key')
+                for l in buf.getvalue().decode('utf-8').splitlines()]
+        self.assertEqual(keys, [r.key for r in rows])
+
+        # 'id' is always extracted with include_docs
+        ret = self.cb.query("beer", "brewery_beers", fields=["key"],
+                            include_docs=True, limit=5)
+        for r in ret:
+            self.assertTrue(r.key)
+            self.assertEqual(r.doc.key, r.docid)
+
+        self.assertRaises(ArgumentError, self.cb.query,
+                          "beer", "brewery_beers", fields=[1])
+
+        ret = self.cb.query("beer", "brewery_beers", fields=["a//b"])
+        self.assertRaises(ArgumentError, tuple, ret)
+
+    def test_page_limits(self):
+        pages = []
+
+        class PageRecorder(RowProcessor):
+            def handle_rows(self, rows, *args, **kwargs):
+                pages.append(len(rows))
+                return super(PageRecorder, self).handle_rows(
+                    rows, *args, **kwargs)
+
+        ret = self.cb.query("beer", "brewery_beers", limit=50,
+                            streaming=True, page_rows=7,
+                            row_processor=PageRecorder())
+        rows = list(ret)
+        self.assertEqual(len(rows), 50)
+        self.assertEqual(sum(pages), 50)
+        self.assertTrue(max(pages) <= 7)
+
+        # A page always holds at least one row
+        pages = []
+        ret = self.cb.query("beer", "brewery_beers", limit=10,
+                            streaming=True, page_bytes=1,
+                            row_processor=PageRecorder())
+        self.assertEqual(len(list(ret)), 10)
+        self.assertEqual(pages, [1] * 10)
+
+        self.assertRaises(ArgumentError, self.cb.query,
+                          "beer", "brewery_beers", page_rows=0)
+
+    def test_parallel(self):
+        splits = [["f"], ["m"], ["s"]]
+        ret = ParallelView(self.cb, "beer", "brewery_beers", splits,
+                           fields=["id"], page_rows=50)
+        self.assertEqual(len(ret.views), 4)
+
+        rows = list(ret)
+        full = list(self.cb.query("beer", "brewery_beers", fields=["id"]))
+        self.assertEqual([r.docid for r in rows], [r.docid for r in full])
+        self.assertEqual(ret.rows_returned, len(full))
+        self.assertRaises(AlreadyQueriedError, tuple, ret)
+
+        # Later sub-ranges are buffered in full, past the page limits
+        ret = ParallelView(self.cb, "beer", "brewery_beers", [["b"]],
+                           fields=["id"], page_rows=5)
+        self.assertTrue(len([r for r in full if r.key >= ["b"]]) > 16 * 5)
+        rows = list(ret)
+        self.assertEqual([r.docid for r in rows], [r.docid for r in full])
+
+        # The overall limit applies across sub-ranges
+        q = Query(mapkey_range=[["a"], ["z"]], limit=30)
+        ret = ParallelView(self.cb, "beer", "brewery_beers", [["b"]],
+                           query=q)
+        rows = list(ret)
+        full = list(self.cb.query("beer", "brewery_beers", query=q))
+        self.assertEqual(len(rows), 30)
+        self.assertEqual([r.key for r in rows], [r.key for r in full])
+
+        # Exports write each sub-range in turn, without buffering the rows
+        import io, json
+        full = list(self.cb.query("beer", "brewery_beers", fields=["id"]))
+        ret = ParallelView(self.cb, "beer", "brewery_beers", splits,
+                           fields=["id"])
+        buf = io.BytesIO()
+        self.assertEqual(ret.export(buf), len(full))
+        self.assertEqual(ret.rows_returned, len(full))
+        rows = [json.loads(l)
+                for l in buf.getvalue().decode('utf-8').splitlines()]
+        self.assertEqual(rows, [{'id': r.docid} for r in full])
+        self.assertRaises(AlreadyQueriedError, tuple, ret)
+        self.assertTrue(all(v.raw is None for v in ret.views))
+
+        q = Query(mapkey_range=[["a"], ["z"]], limit=30)
+        ret = ParallelView(self.cb, "beer", "brewery_beers", [["b"]],
+                           query=q)
+        buf = io.BytesIO()
+        self.assertEqual(ret.export(buf, fields=["key"]), 30)
+        rows = [json.loads(l)
+                for l in buf.getvalue().decode('utf-8').splitlines()]
+        full = list(self.cb.query("beer", "brewery_beers", query=q))
+        self.assertEqual(rows, [{'key': r.key} for r in full])
+
+        # Stopping early cancels every sub-view's request
+        ret = ParallelView(self.cb, "beer", "brewery_beers", splits,
+                           page_rows=10)
+        it = iter(ret)
+        next(it)
+        it.close()
+        self.assertTrue(all(v.raw is None for v in ret.views))
+
+        self.assertRaises(ArgumentError, ParallelView,
+                          self.cb, "beer", "brewery_beers", splits, skip=1)
+        self.assertRaises(ArgumentError, ParallelView,
+                          self.cb, "beer", "brewery_beers", [])
+        self.assertEqual(ParallelView.split_range(0, 100, 4), [25, 50, 75])
+
+    def test_paginator(self):
+        q = Query(mapkey_range=[["a"], ["c"]])
+        full = list(self.cb.query("beer", "brewery_beers", query=q))
+        self.assertTrue(len(full) > 100)
+
+        for prefetch in (True, False):
+            pages = list(Paginator(self.cb, "beer", "brewery_beers", 30,
+                                   query=q, prefetch=prefetch))
+            self.assertTrue(all(len(p) == 30 for p in pages[:-1]))
+            self.assertEqual([r.docid for p in pages for r in p],
+                             [r.docid for r in full])
+
+        # Resume from the position reached after the first page
+        pgn = Paginator(self.cb, "beer", "brewery_beers", 25, query=q)
+        first = next(iter(pgn))
+        self.assertEqual(pgn.position, (first[-1].key, first[-1].docid))
+
+        rest = Paginator(self.cb, "beer", "brewery_beers", 25, query=q,
+                         resume=pgn.position, prefetch=False)
+        self.assertEqual([r.docid for p in rest for r in p],
+                         [r.docid for r in full[25:]])
+
+        self.assertRaises(ArgumentError, Paginator,
+                          self.cb, "beer", "brewery_beers", 10, skip=20)
+        self.assertRaises(ArgumentError, Paginator,
+                          self.cb, "beer", "brewery_beers", 0)
+
+    def test_export(self):
+        import io, json, os, tempfile
+
+        q = Query(mapkey_range=[["a"], ["c"]])
+        full = list(self.cb.query("beer", "brewery_beers", query=q))
+
+        buf = io.BytesIO()
+        view = self.cb.query("beer", "brewery_beers", query=q)
+        self.assertEqual(view.export(buf), len(full))
+        self.assertRaises(AlreadyQueriedError, tuple, view)
+        self.assertTrue(view.indexed_rows)
+
+        lines = buf.getvalue().decode('utf-8').splitlines()
+        rows = [json.loads(l) for l in lines]
+        self.assertEqual([r['id'] for r in rows], [r.docid for r in full])
+        self.assertEqual([r['key'] for r in rows], [r.key for r in full])
+
+        fd, path = tempfile.mkstemp()
+        os.close(fd)
+        try:
+            view = self.cb.query("beer", "brewery_beers", query=q)
+            view.export(path, fields=["id"])
+            with open(path, 'rb') as fp:
+                rows = [json.loads(l.decode('utf-8')) for l in fp]
+            self.assertEqual(rows, [{'id': r.docid} for r in full])
+        finally:
+            os.unlink(path)
+
+        view = self.cb.query("beer", "brewery_beers", include_docs=True)
+        self.assertRaises(ArgumentError, view.export, io.BytesIO())
+
+        # Error responses are not exported
+        buf = io.BytesIO()
+        view = self.cb.query("beer", "bad_view")
+        self.assertRaises(HTTPError, view.export, buf)
+        self.assertEqual(buf.getvalue(), b'')
+
+        # A failed export cancels its request
+        class FullSink(object):
+            def write(self, data):
+                raise IOError("No space left")
+
+        view = self.cb.query("beer", "brewery_beers", query=q)
+        self.assertRaises(IOError, view.export, FullSink())
+        self.assertTrue(view.raw is None)
+        self.assertEqual(len(list(self.cb.query("beer", "brewery_beers",
+                                                query=q))),
+                         len(full))
+
+    def test_aggregate(self):
+        q = Query(mapkey_range=[["a"], ["c"]])
+        full = list(self.cb.query("beer", "brewery_beers", query=q))
+
+        ret = self.cb.query("beer", "brewery_beers", query=q).aggregate()
+        self.assertEqual(ret['count'], len(full))
+        self.assertEqual(ret['values'], 0)
+        self.assertEqual(ret['min'], None)
+        self.assertEqual(ret['histogram'], None)
+
+        # by_location emits 1 for each brewery
+        ret = self.cb.query("beer", "by_location", reduce=False).aggregate(
+            "value", bounds=[1, 2])
+        self.assertTrue(ret['count'])
+        self.assertEqual(ret['values'], ret['count'])
+        self.assertEqual(ret['sum'], ret['count'])
+        self.assertEqual((ret['min'], ret['max']), (1, 1))
+        self.assertEqual(ret['histogram'], [0, ret['count'], 0])
+
+        view = self.cb.query("beer", "brewery_beers", query=q)
+        self.assertRaises(ArgumentError, view.aggregate, "key/0",
+                          bounds=[2, 1])
+
     def test_streaming_dtor(self):
         # Ensure that the internal lcb_http_request_t is destroyed if the
         # Python object is destroyed before the results are done.
@@ -311,3 +591,55 @@ class ViewIteratorTest(ConnectionTestCase):
         ret = self.cb.query("beer", "brewery_beers", limit=0)
         for row in ret:
             raise Exception("...")
+
+
+class PaginatorPrefetchTest(unittest.TestCase):
+    """
+    Runs against its own mock server, which delays each view response
+    """
+    def setUp(self):
+        self.mock = MockServer(view_latency=0.3)
+        self.mock.start()
+        self.mock.add_view('pgn', 'all',
+                           lambda doc, meta: [(meta['id'], None)])
+        self.cb = Connection(**self.mock.connection_args())
+        self.cb.set_multi(dict(('pgn_{0:02}'.format(ii), ii)
+                               for ii in range(15)))
+
+    def tearDown(self):
+        del self.cb
+        self.mock.stop()
+
+    def consume(self, prefetch):
+        begin = time.time()
+        docids = []
+        for page in Paginator(self.cb, 'pgn', 'all', 5, prefetch=prefetch):
+            docids.extend(r.docid for r in page)
+            # The next page is computed while this runs
+            self.mock.latency = 0.3
+            self.cb.get('pgn_00')
+            self.mock.latency = 0
+        return time.time() - begin, docids
+
+    def test_overlap(self):
+        elapsed, docids = self.consume(False)
+        self.assertEqual(docids, ['pgn_{0:02}'.format(ii)
+                                  for ii in range(15)])
+
+        # Four requests (the last one finding no rows) and three gets, one
+        # after the other, against the first request and the three gets
+        pf_elapsed, pf_docids = self.consume(True)
+        self.assertEqual(pf_docids, docids)
+        self.assertTrue(pf_elapsed + 0.6 < elapsed)
+
+    def test_cancel(self):
+        pgn = Paginator(self.cb, 'pgn', 'all', 5)
+        it = iter(pgn)
+        self.assertEqual(len(next(it)), 5)
+        self.assertTrue(pgn._next is not None)
+
+        it.close()
+        self.assertTrue(pgn._next is None)
+
+        # The connection is not left waiting for the cancelled request
+        self.assertEqual(self.cb.get('pgn_00').value, 0)